@@ -1,5 +1,7 @@
 #include "common-ggml.h"
 
+#include <algorithm>
+#include <cstring>
 #include <regex>
 #include <map>
 
@@ -14,6 +16,8 @@ static const std::map<std::string, enum ggml_ftype> GGML_FTYPE_MAP = {
     {"q4_k", GGML_FTYPE_MOSTLY_Q4_K},
     {"q5_k", GGML_FTYPE_MOSTLY_Q5_K},
     {"q6_k", GGML_FTYPE_MOSTLY_Q6_K},
+    {"f8_e4m3", GGML_FTYPE_MOSTLY_F8_E4M3},
+    {"f8_e5m2", GGML_FTYPE_MOSTLY_F8_E5M2},
 };
 
 void ggml_print_ftypes(FILE * fp) {
@@ -24,7 +28,7 @@ void ggml_print_ftypes(FILE * fp) {
 
 enum ggml_ftype ggml_parse_ftype(const char * str) {
     enum ggml_ftype ftype;
-    if (str[0] == 'q') {
+    if (str[0] == 'q' || str[0] == 'f') {
         const auto it = GGML_FTYPE_MAP.find(str);
         if (it == GGML_FTYPE_MAP.end()) {
             fprintf(stderr, "%s: unknown ftype '%s'\n", __func__, str);
@@ -38,12 +42,53 @@ enum ggml_ftype ggml_parse_ftype(const char * str) {
     return ftype;
 }
 
+// time and sizes of the tensors quantized to each type
+struct ggml_quantize_type_stats {
+    int     n_tensors = 0;
+    size_t  size_org  = 0; // of the input
+    size_t  size_new  = 0;
+    int64_t t_us      = 0;
+};
+
+static void ggml_print_quantize_stats(const char * func, const std::map<ggml_type, ggml_quantize_type_stats> & stats) {
+    for (const auto & it : stats) {
+        const ggml_quantize_type_stats & st = it.second;
+        printf("%s: %8s: %4d tensors, %10.2f MB -> %10.2f MB in %8.2f s, %8.2f MB/s\n", func,
+                ggml_type_name(it.first), st.n_tensors, st.size_org/1024.0/1024.0, st.size_new/1024.0/1024.0,
+                st.t_us/1e6, st.size_org/1024.0/1024.0/std::max<double>(st.t_us/1e6, 1e-6));
+    }
+}
+
+static bool ggml_should_quantize(
+        const std::string & name,
+        const std::vector<std::string> & to_quant,
+        const std::vector<std::string> & to_skip) {
+    bool quantize = false;
+
+    for (const auto & s : to_quant) {
+        if (std::regex_match(name, std::regex(s))) {
+            quantize = true;
+            break;
+        }
+    }
+
+    for (const auto & s : to_skip) {
+        if (std::regex_match(name, std::regex(s))) {
+            quantize = false;
+            break;
+        }
+    }
+
+    return quantize;
+}
+
 bool ggml_common_quantize_0(
         std::ifstream & finp,
         std::ofstream & fout,
         const ggml_ftype ftype,
         const std::vector<std::string> & to_quant,
-        const std::vector<std::string> & to_skip) {
+        const std::vector<std::string> & to_skip,
+        int n_threads) {
 
     ggml_type qtype = GGML_TYPE_F32;
 
@@ -58,6 +103,8 @@ bool ggml_common_quantize_0(
         case GGML_FTYPE_MOSTLY_Q4_K: qtype = GGML_TYPE_Q4_K; break;
         case GGML_FTYPE_MOSTLY_Q5_K: qtype = GGML_TYPE_Q5_K; break;
         case GGML_FTYPE_MOSTLY_Q6_K: qtype = GGML_TYPE_Q6_K; break;
+        case GGML_FTYPE_MOSTLY_F8_E4M3: qtype = GGML_TYPE_F8_E4M3; break;
+        case GGML_FTYPE_MOSTLY_F8_E5M2: qtype = GGML_TYPE_F8_E5M2; break;
         case GGML_FTYPE_UNKNOWN:
         case GGML_FTYPE_ALL_F32:
         case GGML_FTYPE_MOSTLY_F16:
@@ -89,6 +136,8 @@ bool ggml_common_quantize_0(
     size_t total_size_org = 0;
     size_t total_size_new = 0;
 
+    std::map<ggml_type, ggml_quantize_type_stats> stats;
+
     std::vector<float> work;
 
     std::vector<uint8_t>     data_u8;
@@ -120,26 +169,8 @@ bool ggml_common_quantize_0(
 
         printf("%64s - [%5d, %5d, %5d], type = %6s ", name.data(), ne[0], ne[1], ne[2], ggml_type_name((ggml_type) ttype));
 
-        bool quantize = false;
-
-        // check if we should quantize this tensor
-        for (const auto & s : to_quant) {
-            if (std::regex_match(name, std::regex(s))) {
-                quantize = true;
-                break;
-            }
-        }
-
-        // check if we should skip this tensor
-        for (const auto & s : to_skip) {
-            if (std::regex_match(name, std::regex(s))) {
-                quantize = false;
-                break;
-            }
-        }
-
         // quantize only 2D tensors
-        quantize &= (n_dims == 2);
+        bool quantize = ggml_should_quantize(name, to_quant, to_skip) && n_dims == 2;
 
         if (quantize) {
             if (ttype != GGML_TYPE_F32 && ttype != GGML_TYPE_F16) {
@@ -178,6 +209,8 @@ bool ggml_common_quantize_0(
         if (quantize) {
             work.resize(nelements); // for quantization
 
+            const int64_t t_start_us = ggml_time_us();
+
             size_t cur_size = 0;
             switch ((ggml_type) ttype) {
                 case GGML_TYPE_Q4_0:
@@ -190,8 +223,10 @@ bool ggml_common_quantize_0(
                 case GGML_TYPE_Q4_K:
                 case GGML_TYPE_Q5_K:
                 case GGML_TYPE_Q6_K:
+                case GGML_TYPE_F8_E4M3:
+                case GGML_TYPE_F8_E5M2:
                     {
-                        cur_size = ggml_quantize_chunk((ggml_type) ttype, data_f32.data(), work.data(), 0, nelements/ne[0], ne[0], nullptr);
+                        cur_size = ggml_quantize_chunk_mt((ggml_type) ttype, data_f32.data(), work.data(), 0, nelements/ne[0], ne[0], nullptr, n_threads, nullptr);
                     } break;
                 case GGML_TYPE_F32:
                 case GGML_TYPE_F16:
@@ -222,10 +257,18 @@ bool ggml_common_quantize_0(
                     }
             }
 
+            const int64_t t_us = ggml_time_us() - t_start_us;
+
+            ggml_quantize_type_stats & st = stats[(ggml_type) ttype];
+            st.n_tensors += 1;
+            st.size_org  += nelements * sizeof(float);
+            st.size_new  += cur_size;
+            st.t_us      += t_us;
+
             fout.write(reinterpret_cast<char *>(work.data()), cur_size);
             total_size_new += cur_size;
 
-            printf("size = %8.2f MB -> %8.2f MB\n", nelements * sizeof(float)/1024.0/1024.0, cur_size/1024.0/1024.0);
+            printf("size = %8.2f MB -> %8.2f MB, %8.2f ms\n", nelements * sizeof(float)/1024.0/1024.0, cur_size/1024.0/1024.0, t_us/1000.0);
         } else {
             printf("size = %8.3f MB\n", data_u8.size()/1024.0/1024.0);
             fout.write(reinterpret_cast<char *>(data_u8.data()), data_u8.size());
@@ -238,5 +281,173 @@ bool ggml_common_quantize_0(
     printf("%s: model size  = %8.2f MB\n", __func__, total_size_org/1024.0/1024.0);
     printf("%s: quant size  = %8.2f MB | ftype = %d (%s)\n", __func__, total_size_new/1024.0/1024.0, ftype, ggml_type_name(qtype));
 
+    ggml_print_quantize_stats(__func__, stats);
+
     return true;
 }
+
+bool ggml_common_quantize_gguf(
+        const std::string & fname_inp,
+        const std::string & fname_out,
+        const ggml_ftype ftype,
+        const std::vector<std::string> & to_quant,
+        const std::vector<std::string> & to_skip,
+        int n_threads) {
+    // the types of GGML_FTYPE_MAP
+    bool supported = false;
+    for (const auto & it : GGML_FTYPE_MAP) {
+        supported |= it.second == ftype;
+    }
+    if (!supported) {
+        fprintf(stderr, "%s: invalid model type %d\n", __func__, ftype);
+        return false;
+    }
+
+    const ggml_type qtype = ggml_ftype_to_ggml_type(ftype);
+
+    // only the meta data of the input is loaded, the data of the tensors is read from the file one tensor at a time
+    struct ggml_context * ctx_inp_meta = nullptr;
+
+    struct gguf_init_params params = {
+        /*.no_alloc = */ true,
+        /*.ctx      = */ &ctx_inp_meta,
+    };
+
+    struct gguf_context * ctx_inp = gguf_init_from_file(fname_inp.c_str(), params);
+    if (!ctx_inp) {
+        fprintf(stderr, "%s: failed to load '%s'\n", __func__, fname_inp.c_str());
+        return false;
+    }
+
+    auto finp = std::ifstream(fname_inp, std::ios::binary);
+    auto fout = std::ofstream(fname_out, std::ios::binary);
+    if (!finp || !fout) {
+        fprintf(stderr, "%s: failed to open '%s' or '%s'\n", __func__, fname_inp.c_str(), fname_out.c_str());
+        gguf_free(ctx_inp);
+        ggml_free(ctx_inp_meta);
+        return false;
+    }
+
+    const int n_tensors = gguf_get_n_tensors(ctx_inp);
+
+    // the tensors of the output with their new types, for the offsets in the meta data
+    struct ggml_init_params params_out = {
+        /*.mem_size   =*/ (n_tensors + 1)*ggml_tensor_overhead(),
+        /*.mem_buffer =*/ nullptr,
+        /*.no_alloc   =*/ true,
+    };
+    struct ggml_context * ctx_out_meta = ggml_init(params_out);
+
+    struct gguf_context * ctx_out = gguf_init_empty();
+    gguf_set_kv(ctx_out, ctx_inp);
+    gguf_set_val_u32(ctx_out, "general.file_type", ftype);
+    // the output is written with the default alignment
+    gguf_remove_key(ctx_out, "general.alignment");
+
+    std::vector<bool> quantize(n_tensors);
+
+    for (int i = 0; i < n_tensors; ++i) {
+        const char * name = gguf_get_tensor_name(ctx_inp, i);
+        const ggml_tensor * t = ggml_get_tensor(ctx_inp_meta, name);
+
+        quantize[i] = ggml_should_quantize(name, to_quant, to_skip) && ggml_n_dims(t) == 2 &&
+            (t->type == GGML_TYPE_F32 || t->type == GGML_TYPE_F16 || t->type == GGML_TYPE_BF16) &&
+            t->ne[0] % ggml_blck_size(qtype) == 0;
+
+        ggml_tensor * t_out = ggml_new_tensor(ctx_out_meta, quantize[i] ? qtype : t->type, GGML_MAX_DIMS, t->ne);
+        ggml_set_name(t_out, name);
+        gguf_add_tensor(ctx_out, t_out);
+    }
+
+    {
+        std::vector<uint8_t> meta(gguf_get_meta_size(ctx_out));
+        gguf_get_meta_data(ctx_out, meta.data());
+        fout.write(reinterpret_cast<const char *>(meta.data()), meta.size());
+    }
+
+    const size_t data_offset = gguf_get_data_offset(ctx_inp);
+    const size_t alignment   = gguf_get_alignment(ctx_out);
+
+    size_t total_size_org = 0;
+    size_t total_size_new = 0;
+
+    std::map<ggml_type, ggml_quantize_type_stats> stats;
+
+    std::vector<uint8_t> data;
+    std::vector<float>   data_f32;
+    std::vector<uint8_t> work;
+
+    const std::vector<char> pad(alignment, 0);
+
+    bool ok = true;
+
+    for (int i = 0; i < n_tensors && ok; ++i) {
+        const char * name = gguf_get_tensor_name(ctx_inp, i);
+        const ggml_tensor * t = ggml_get_tensor(ctx_inp_meta, name);
+
+        const int64_t nelements = ggml_nelements(t);
+
+        data.resize(ggml_nbytes(t));
+        finp.seekg(data_offset + gguf_get_tensor_offset(ctx_inp, i));
+        finp.read(reinterpret_cast<char *>(data.data()), data.size());
+        if (!finp) {
+            fprintf(stderr, "%s: failed to read the data of tensor '%s'\n", __func__, name);
+            ok = false;
+            break;
+        }
+
+        printf("[%4d/%4d] %48s - [%5d, %5d, %5d], type = %6s, ", i + 1, n_tensors, name,
+                (int) t->ne[0], (int) t->ne[1], (int) t->ne[2], ggml_type_name(t->type));
+
+        const uint8_t * data_out = data.data();
+        size_t          size_out = data.size();
+
+        if (quantize[i]) {
+            data_f32.resize(nelements);
+            if (t->type == GGML_TYPE_F32) {
+                memcpy(data_f32.data(), data.data(), data.size());
+            } else {
+                ggml_internal_get_type_traits(t->type).to_float(data.data(), data_f32.data(), nelements);
+            }
+
+            work.resize(ggml_row_size(qtype, t->ne[0])*(nelements/t->ne[0]));
+
+            const int64_t t_start_us = ggml_time_us();
+
+            size_out = ggml_quantize_chunk_mt(qtype, data_f32.data(), work.data(), 0, nelements/t->ne[0], t->ne[0], nullptr, n_threads, nullptr);
+            data_out = work.data();
+
+            const int64_t t_us = ggml_time_us() - t_start_us;
+
+            ggml_quantize_type_stats & st = stats[qtype];
+            st.n_tensors += 1;
+            st.size_org  += data.size();
+            st.size_new  += size_out;
+            st.t_us      += t_us;
+
+            printf("size = %8.2f MB -> %8.2f MB, %8.2f ms\n", data.size()/1024.0/1024.0, size_out/1024.0/1024.0, t_us/1000.0);
+        } else {
+            printf("size = %8.3f MB\n", data.size()/1024.0/1024.0);
+        }
+
+        fout.write(reinterpret_cast<const char *>(data_out), size_out);
+        fout.write(pad.data(), GGML_PAD(size_out, alignment) - size_out);
+
+        total_size_org += data.size();
+        total_size_new += size_out;
+    }
+
+    if (ok) {
+        printf("%s: model size  = %8.2f MB\n", __func__, total_size_org/1024.0/1024.0);
+        printf("%s: quant size  = %8.2f MB | ftype = %d (%s)\n", __func__, total_size_new/1024.0/1024.0, ftype, ggml_type_name(qtype));
+
+        ggml_print_quantize_stats(__func__, stats);
+    }
+
+    gguf_free(ctx_out);
+    ggml_free(ctx_out_meta);
+    gguf_free(ctx_inp);
+    ggml_free(ctx_inp_meta);
+
+    return ok;
+}
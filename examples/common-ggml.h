@@ -10,9 +10,21 @@ enum ggml_ftype ggml_parse_ftype(const char * str);
 
 void ggml_print_ftypes(FILE * fp = stderr);
 
+// the rows of each tensor are quantized with n_threads threads
 bool ggml_common_quantize_0(
         std::ifstream & finp,
         std::ofstream & fout,
         const ggml_ftype ftype,
         const std::vector<std::string> & to_quant,
-        const std::vector<std::string> & to_skip);
+        const std::vector<std::string> & to_skip,
+        int n_threads = 1);
+
+// quantizes the 2D tensors of a GGUF file whose names match to_quant (and not to_skip), the other tensors and the
+// key-value pairs are copied; the tensors are read, quantized and written one at a time
+bool ggml_common_quantize_gguf(
+        const std::string & fname_inp,
+        const std::string & fname_out,
+        const ggml_ftype ftype,
+        const std::vector<std::string> & to_quant,
+        const std::vector<std::string> & to_skip,
+        int n_threads = 1);
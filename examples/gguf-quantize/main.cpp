@@ -0,0 +1,49 @@
+#include "ggml.h"
+
+#include "common-ggml.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+// usage:
+//  ./gguf-quantize model-f16.gguf model-q4_0.gguf q4_0 [n_threads] [regex of the tensors to quantize]
+//
+int main(int argc, char ** argv) {
+    if (argc < 4 || argc > 6) {
+        fprintf(stderr, "usage: %s model-f32.gguf model-quant.gguf type [n_threads] [regex]\n", argv[0]);
+        ggml_print_ftypes(stderr);
+        return 1;
+    }
+
+    // needed to initialize f16 tables
+    {
+        struct ggml_init_params params = { 0, NULL, false };
+        struct ggml_context * ctx = ggml_init(params);
+        ggml_free(ctx);
+    }
+
+    const std::string fname_inp = argv[1];
+    const std::string fname_out = argv[2];
+
+    const ggml_ftype ftype = ggml_parse_ftype(argv[3]);
+
+    const int n_threads = argc > 4 ? atoi(argv[4]) : (int) std::thread::hardware_concurrency();
+
+    // by default all the 2D tensors
+    const std::vector<std::string> to_quant = { argc > 5 ? argv[5] : ".*" };
+
+    const int64_t t_start_us = ggml_time_us();
+
+    if (!ggml_common_quantize_gguf(fname_inp, fname_out, ftype, to_quant, {}, n_threads)) {
+        fprintf(stderr, "%s: failed to quantize model from '%s'\n", __func__, fname_inp.c_str());
+        return 1;
+    }
+
+    printf("\n");
+    printf("%s: quantize time = %8.2f ms with %d threads\n", __func__, (ggml_time_us() - t_start_us)/1000.0f, n_threads);
+
+    return 0;
+}
@@ -397,17 +397,15 @@ struct ggml_cgraph * gpt2_graph(
     const int n_ctx   = hparams.n_ctx;
     const int n_head  = hparams.n_head;
 
-    // since we are using ggml-alloc, this buffer only needs enough space to hold the ggml_tensor and ggml_cgraph structs, but not the tensor data
-    static size_t buf_size = ggml_tensor_overhead()*GGML_DEFAULT_GRAPH_SIZE + ggml_graph_overhead();
-    static std::vector<uint8_t> buf(buf_size);
-
+    // since we are using ggml-alloc, the context only needs enough space to hold the ggml_tensor and ggml_cgraph structs, but not the tensor data
+    // the graph arena reuses the same memory at every call, the graph of the previous call is invalidated
     struct ggml_init_params params = {
-        /*.mem_size   =*/ buf_size,
-        /*.mem_buffer =*/ buf.data(),
+        /*.mem_size   =*/ ggml_tensor_overhead()*GGML_DEFAULT_GRAPH_SIZE + ggml_graph_overhead(),
+        /*.mem_buffer =*/ NULL,
         /*.no_alloc   =*/ true, // the tensors will be allocated later by ggml_gallocr_alloc_graph()
     };
 
-    struct ggml_context * ctx = ggml_init(params);
+    struct ggml_context * ctx = ggml_graph_arena(params);
 
     struct ggml_cgraph  * gf = ggml_new_graph(ctx);
 
@@ -656,7 +654,8 @@ struct ggml_cgraph * gpt2_graph(
 
     ggml_build_forward_expand(gf, inpL);
 
-    ggml_free(ctx);
+    // compute the element-wise ops after mul_mat and norm in a single pass on the CPU
+    ggml_graph_fuse(gf);
 
     return gf;
 }
@@ -698,7 +697,7 @@ bool gpt2_eval(
     }
 
     // run the computation
-    struct ggml_cplan plan = ggml_graph_plan(gf, n_threads);
+    struct ggml_cplan plan = ggml_graph_plan(gf, n_threads, nullptr);
     static std::vector<uint8_t> work_buffer;
     work_buffer.resize(plan.work_size);
     plan.work_data = work_buffer.data();
@@ -874,6 +873,7 @@ int main(int argc, char ** argv) {
     }
 
     ggml_free(model.ctx_w);
+    ggml_graph_arena_free();
 
     return 0;
 }
@@ -559,17 +559,15 @@ struct ggml_cgraph * gpt2_graph(
     const int n_ctx   = hparams.n_ctx;
     const int n_head  = hparams.n_head;
 
-    // since we are using ggml-alloc, this buffer only needs enough space to hold the ggml_tensor and ggml_cgraph structs, but not the tensor data
-    static size_t buf_size = ggml_tensor_overhead()*GPT2_MAX_NODES + ggml_graph_overhead_custom(GPT2_MAX_NODES, false);
-    static std::vector<uint8_t> buf(buf_size);
-
+    // since we are using ggml-alloc, the context only needs enough space to hold the ggml_tensor and ggml_cgraph structs, but not the tensor data
+    // the graph arena reuses the same memory at every call, the graph of the previous call is invalidated
     struct ggml_init_params params = {
-        /*.mem_size   =*/ buf_size,
-        /*.mem_buffer =*/ buf.data(),
+        /*.mem_size   =*/ ggml_tensor_overhead()*GPT2_MAX_NODES + ggml_graph_overhead_custom(GPT2_MAX_NODES, false),
+        /*.mem_buffer =*/ NULL,
         /*.no_alloc   =*/ true, // the tensors will be allocated later by ggml_gallocr_alloc_graph()
     };
 
-    struct ggml_context * ctx = ggml_init(params);
+    struct ggml_context * ctx = ggml_graph_arena(params);
 
     struct ggml_cgraph  * gf = ggml_new_graph_custom(ctx, GPT2_MAX_NODES, false);
 
@@ -851,7 +849,8 @@ struct ggml_cgraph * gpt2_graph(
 
     ggml_build_forward_expand(gf, inpL);
 
-    ggml_free(ctx);
+    // compute the element-wise ops after mul_mat and norm in a single pass on the CPU
+    ggml_graph_fuse(gf);
 
     return gf;
 }
@@ -1065,6 +1064,7 @@ int main(int argc, char ** argv) {
     }
 
     ggml_free(model.ctx_w);
+    ggml_graph_arena_free();
 
     ggml_backend_sched_free(sched);
     ggml_backend_buffer_free(model.buffer_kv);
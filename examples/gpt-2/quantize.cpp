@@ -24,7 +24,7 @@ struct gpt2_hparams {
 };
 
 // quantize a model
-bool gpt2_model_quantize(const std::string & fname_inp, const std::string & fname_out, ggml_ftype ftype) {
+bool gpt2_model_quantize(const std::string & fname_inp, const std::string & fname_out, ggml_ftype ftype, int n_threads) {
     gpt_vocab vocab;
 
     printf("%s: loading model from '%s'\n", __func__, fname_inp.c_str());
@@ -122,7 +122,7 @@ bool gpt2_model_quantize(const std::string & fname_inp, const std::string & fnam
         "model/h.*/mlp/c_proj/w",
     };
 
-    if (!ggml_common_quantize_0(finp, fout, ftype, to_quant, {})) {
+    if (!ggml_common_quantize_0(finp, fout, ftype, to_quant, {}, n_threads)) {
         fprintf(stderr, "%s: failed to quantize model '%s'\n", __func__, fname_inp.c_str());
         return false;
     }
@@ -134,11 +134,11 @@ bool gpt2_model_quantize(const std::string & fname_inp, const std::string & fnam
 }
 
 // usage:
-//  ./gpt-2-quantize models/gpt-2-117M/ggml-model.bin models/gpt-2-117M/ggml-model-quant.bin type
+//  ./gpt-2-quantize models/gpt-2-117M/ggml-model.bin models/gpt-2-117M/ggml-model-quant.bin type [n_threads]
 //
 int main(int argc, char ** argv) {
-    if (argc != 4) {
-        fprintf(stderr, "usage: %s model-f32.bin model-quant.bin type\n", argv[0]);
+    if (argc != 4 && argc != 5) {
+        fprintf(stderr, "usage: %s model-f32.bin model-quant.bin type [n_threads]\n", argv[0]);
         ggml_print_ftypes(stderr);
         return 1;
     }
@@ -155,6 +155,8 @@ int main(int argc, char ** argv) {
 
     const ggml_ftype ftype = ggml_parse_ftype(argv[3]);
 
+    const int n_threads = argc > 4 ? atoi(argv[4]) : 1;
+
     const int64_t t_main_start_us = ggml_time_us();
 
     int64_t t_quantize_us = 0;
@@ -163,7 +165,7 @@ int main(int argc, char ** argv) {
     {
         const int64_t t_start_us = ggml_time_us();
 
-        if (!gpt2_model_quantize(fname_inp, fname_out, ggml_ftype(ftype))) {
+        if (!gpt2_model_quantize(fname_inp, fname_out, ggml_ftype(ftype), n_threads)) {
             fprintf(stderr, "%s: failed to quantize model from '%s'\n", __func__, fname_inp.c_str());
             return 1;
         }
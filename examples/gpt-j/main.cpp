@@ -590,6 +590,7 @@ bool gptj_eval(
 
     // run the computation
     ggml_build_forward_expand(gf, inpL);
+    ggml_graph_fuse(gf);
     ggml_graph_compute_with_ctx(ctx0, gf, n_threads);
 
     //if (n_past%100 == 0) {
@@ -25,7 +25,7 @@ struct gptj_hparams {
 };
 
 // quantize a model
-bool gptj_model_quantize(const std::string & fname_inp, const std::string & fname_out, ggml_ftype ftype) {
+bool gptj_model_quantize(const std::string & fname_inp, const std::string & fname_out, ggml_ftype ftype, int n_threads) {
     gpt_vocab vocab;
 
     printf("%s: loading model from '%s'\n", __func__, fname_inp.c_str());
@@ -120,7 +120,7 @@ bool gptj_model_quantize(const std::string & fname_inp, const std::string & fnam
         ".*weight",
     };
 
-    if (!ggml_common_quantize_0(finp, fout, ftype, to_quant, {})) {
+    if (!ggml_common_quantize_0(finp, fout, ftype, to_quant, {}, n_threads)) {
         fprintf(stderr, "%s: failed to quantize model '%s'\n", __func__, fname_inp.c_str());
         return false;
     }
@@ -132,11 +132,11 @@ bool gptj_model_quantize(const std::string & fname_inp, const std::string & fnam
 }
 
 // usage:
-//  ./gpt-2-quantize models/gpt-2-117M/ggml-model.bin models/gpt-2-117M/ggml-model-quant.bin type
+//  ./gpt-2-quantize models/gpt-2-117M/ggml-model.bin models/gpt-2-117M/ggml-model-quant.bin type [n_threads]
 //
 int main(int argc, char ** argv) {
-    if (argc != 4) {
-        fprintf(stderr, "usage: %s model-f32.bin model-quant.bin type\n", argv[0]);
+    if (argc != 4 && argc != 5) {
+        fprintf(stderr, "usage: %s model-f32.bin model-quant.bin type [n_threads]\n", argv[0]);
         ggml_print_ftypes(stderr);
         return 1;
     }
@@ -153,6 +153,8 @@ int main(int argc, char ** argv) {
 
     const ggml_ftype ftype = ggml_parse_ftype(argv[3]);
 
+    const int n_threads = argc > 4 ? atoi(argv[4]) : 1;
+
     const int64_t t_main_start_us = ggml_time_us();
 
     int64_t t_quantize_us = 0;
@@ -161,7 +163,7 @@ int main(int argc, char ** argv) {
     {
         const int64_t t_start_us = ggml_time_us();
 
-        if (!gptj_model_quantize(fname_inp, fname_out, ggml_ftype(ftype))) {
+        if (!gptj_model_quantize(fname_inp, fname_out, ggml_ftype(ftype), n_threads)) {
             fprintf(stderr, "%s: failed to quantize model from '%s'\n", __func__, fname_inp.c_str());
             return 1;
         }
@@ -345,7 +345,7 @@ static void ggml_disconnect_node_from_graph(ggml_tensor * t) {
 }
 
 static void ggml_graph_compute_helper(std::vector<uint8_t> & buf, ggml_cgraph * graph, int n_threads) {
-    struct ggml_cplan plan = ggml_graph_plan(graph, n_threads);
+    struct ggml_cplan plan = ggml_graph_plan(graph, n_threads, nullptr);
 
     if (plan.work_size > 0) {
         buf.resize(plan.work_size);
@@ -1358,6 +1358,7 @@ struct ggml_cgraph  * sam_encode_image(
 
     ggml_build_forward_expand(gf, cur);
     ggml_disconnect_node_from_graph(state.embd_img);
+    ggml_graph_fuse(gf);
 
     //ggml_graph_print(&gf);
 
@@ -49,6 +49,12 @@ GGML_API ggml_gallocr_t ggml_gallocr_new(ggml_backend_buffer_type_t buft);
 GGML_API ggml_gallocr_t ggml_gallocr_new_n(ggml_backend_buffer_type_t * bufts, int n_bufs);
 GGML_API void           ggml_gallocr_free(ggml_gallocr_t galloc);
 
+// offline planning for ggml_gallocr_reserve (default: off)
+// the lifetime of every allocation is taken from the allocation order of the graph, the offsets are then assigned again
+// by decreasing size, each tensor in the smallest gap left by the tensors alive at the same time,
+// and the smaller of the two layouts is kept for each buffer
+GGML_API void           ggml_gallocr_set_plan(ggml_gallocr_t galloc, bool plan);
+
 // pre-allocate buffers from a measure graph - does not allocate or modify the graph
 // call with a worst-case graph to avoid buffer reallocations
 // not strictly required for single buffer usage: ggml_gallocr_alloc_graph will reallocate the buffers automatically if needed
@@ -66,6 +72,17 @@ GGML_API bool ggml_gallocr_alloc_graph(ggml_gallocr_t galloc, struct ggml_cgraph
 
 GGML_API size_t ggml_gallocr_get_buffer_size(ggml_gallocr_t galloc, int buffer_id);
 
+// lower bound of the buffer size for the last reserved graph: the largest sum of the sizes of the tensors alive at the same time
+GGML_API size_t ggml_gallocr_get_buffer_min_size(ggml_gallocr_t galloc, int buffer_id);
+
+// reorders the nodes of the graph to reduce the peak of the sum of the sizes of the live tensors in the compute buffers
+// dependencies are kept: the sources of the nodes, the accesses to the tensors written by the nodes (ggml_cpy,
+// inplace ops) in their original order, and the nodes fused after a node (see ggml_graph_fuse) stay after it
+// the last node stays last, and with node_buffer_ids (see ggml_gallocr_reserve_n) the nodes of a buffer are kept together
+// the result depends only on the topology of the graph, reorder both the measure graph and the computed graphs
+// returns true if the order of the nodes changed
+GGML_API bool ggml_graph_reorder_for_memory(struct ggml_cgraph * graph, const int * node_buffer_ids);
+
 // Utils
 // Create a buffer and allocate all the tensors in a ggml_context
 GGML_API struct ggml_backend_buffer * ggml_backend_alloc_ctx_tensors_from_buft(struct ggml_context * ctx, ggml_backend_buffer_type_t buft);
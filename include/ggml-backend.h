@@ -103,6 +103,13 @@ extern "C" {
 
     GGML_API GGML_CALL bool ggml_backend_is_cpu                (ggml_backend_t backend);
     GGML_API           void ggml_backend_cpu_set_n_threads     (ggml_backend_t backend_cpu, int n_threads);
+    GGML_API           void ggml_backend_cpu_set_threadpool    (ggml_backend_t backend_cpu, ggml_threadpool_t threadpool);
+    GGML_API           void ggml_backend_cpu_set_exec_mode     (ggml_backend_t backend_cpu, enum ggml_graph_exec_mode exec_mode);
+    // async: ggml_backend_graph_compute_async returns immediately and the graph is computed by the threadpool
+    // use ggml_backend_synchronize or the backend events before accessing the results (default: false)
+    // the status of an async graph is returned by the next ggml_backend_graph_compute(_async) or ggml_backend_graph_plan_compute
+    // of the backend: if a graph failed, that call returns the failure and does not compute its graph
+    GGML_API           void ggml_backend_cpu_set_async         (ggml_backend_t backend_cpu, bool async);
     GGML_API           void ggml_backend_cpu_set_abort_callback(ggml_backend_t backend_cpu, ggml_abort_callback abort_callback, void * abort_callback_data);
 
     // Create a backend buffer from an existing pointer
@@ -114,6 +121,23 @@ extern "C" {
     GGML_API ggml_backend_buffer_type_t ggml_backend_cpu_hbm_buffer_type(void);
 #endif
 
+    // NUMA aware CPU buffer types, the nodes are the ones found by ggml_numa_init()
+    // without NUMA (or outside of Linux) the buffers are regular CPU buffers
+    enum ggml_backend_cpu_numa_mode {
+        GGML_BACKEND_CPU_NUMA_INTERLEAVE, // pages interleaved across the nodes
+        GGML_BACKEND_CPU_NUMA_DISTRIBUTE, // the rows of each tensor are split in one block per node, matching the row partition of mul_mat
+        GGML_BACKEND_CPU_NUMA_REPLICATE,  // one copy of the buffer per node, the threads read the copy of their node (read-only data such as weights)
+    };
+
+    GGML_API GGML_CALL ggml_backend_buffer_type_t ggml_backend_cpu_numa_buffer_type(enum ggml_backend_cpu_numa_mode mode);
+
+    // CPU buffer type for weights: the 2D Q4_0 tensors are repacked when they are set into the interleaved layout
+    // of the fastest gemv/gemm kernels of the CPU (GGML_TYPE_Q4_0_8_8 with AVX2), and unpacked when they are read
+    // the repacked tensors can only be used as src0 of mul_mat, and their views cannot be used at all:
+    // the CPU backend does not support the other ops on them, and ggml_graph_plan asserts it
+    // the tensors keep their type, without kernels for the CPU this is a regular CPU buffer
+    GGML_API GGML_CALL ggml_backend_buffer_type_t ggml_backend_cpu_repack_buffer_type(void);
+
     //
     // Backend registry
     //
@@ -206,6 +230,10 @@ extern "C" {
     // Reset all assignments and allocators - must be called before changing the node backends
     GGML_API void                 ggml_backend_sched_reset(ggml_backend_sched_t sched);
 
+    // Reorder the nodes of the graphs passed to ggml_backend_sched_reserve and ggml_backend_sched_alloc_graph to reduce the size
+    // of the compute buffers (default: off), the nodes of the graph are modified in place, see ggml_graph_reorder_for_memory
+    GGML_API void                 ggml_backend_sched_set_reorder(ggml_backend_sched_t sched, bool reorder);
+
     // Set a callback to be called for each resulting node during graph compute
     GGML_API void                 ggml_backend_sched_set_eval_callback(ggml_backend_sched_t sched, ggml_backend_sched_eval_callback callback, void * user_data);
 
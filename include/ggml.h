@@ -234,6 +234,7 @@
 #endif
 #define GGML_MAX_OP_PARAMS      64
 #define GGML_DEFAULT_N_THREADS  4
+#define GGML_MAX_N_THREADS      512
 #define GGML_DEFAULT_GRAPH_SIZE 2048
 #if UINTPTR_MAX == 0xFFFFFFFF
     #define GGML_MEM_ALIGN 4
@@ -393,6 +394,8 @@ extern "C" {
         GGML_TYPE_Q4_0_4_4 = 31,
         GGML_TYPE_Q4_0_4_8 = 32,
         GGML_TYPE_Q4_0_8_8 = 33,
+        GGML_TYPE_F8_E4M3 = 34, // 8-bit floats with a scale per block of 32
+        GGML_TYPE_F8_E5M2 = 35,
         GGML_TYPE_COUNT,
     };
 
@@ -437,6 +440,8 @@ extern "C" {
         GGML_FTYPE_MOSTLY_Q4_0_4_4 = 25, // except 1d tensors
         GGML_FTYPE_MOSTLY_Q4_0_4_8 = 26, // except 1d tensors
         GGML_FTYPE_MOSTLY_Q4_0_8_8 = 27, // except 1d tensors
+        GGML_FTYPE_MOSTLY_F8_E4M3 = 28, // except 1d tensors
+        GGML_FTYPE_MOSTLY_F8_E5M2 = 29, // except 1d tensors
     };
 
     // available tensor operations:
@@ -567,6 +572,7 @@ extern "C" {
         GGML_TENSOR_FLAG_INPUT  = 1,
         GGML_TENSOR_FLAG_OUTPUT = 2,
         GGML_TENSOR_FLAG_PARAM  = 4,
+        GGML_TENSOR_FLAG_FUSED  = 8, // computed together with the previous node, see ggml_graph_fuse
     };
 
     // ggml object
@@ -628,6 +634,45 @@ extern "C" {
     // If it returns true, the computation is aborted
     typedef bool (*ggml_abort_callback)(void * data);
 
+    // scheduling priorities of the compute threads
+    enum ggml_sched_priority {
+        GGML_SCHED_PRIO_NORMAL,
+        GGML_SCHED_PRIO_MEDIUM,
+        GGML_SCHED_PRIO_HIGH,
+        GGML_SCHED_PRIO_REALTIME
+    };
+
+    // threadpool params
+    // use ggml_threadpool_params_default() or ggml_threadpool_params_init() to populate the defaults
+    struct ggml_threadpool_params {
+        bool                     cpumask[GGML_MAX_N_THREADS]; // mask of cpu cores (all-zeros means use default affinity settings)
+        int                      n_threads;                   // number of threads
+        enum ggml_sched_priority prio;                        // thread priority
+        uint32_t                 poll;                        // polling level (0 - no polling, 100 - aggressive polling)
+        bool                     strict_cpu;                  // strict cpu placement: each thread is pinned to a single cpu of the mask
+        bool                     paused;                      // start in paused state
+    };
+
+    // time spent by the threads of a threadpool waiting in barriers
+    // threads first spin for a budget derived from the polling level and then go to sleep
+    struct ggml_threadpool_stats {
+        int64_t n_barriers; // number of barrier waits
+        int64_t n_sleeps;   // number of barrier waits that exhausted the spin budget and slept
+        int64_t t_spin_us;  // time spent spinning
+        int64_t t_sleep_us; // time spent sleeping
+    };
+
+    struct ggml_threadpool;     // forward declaration, see ggml.c
+    struct ggml_graph_capture;  // forward declaration, see ggml.c
+
+    // how the threads of ggml_graph_compute() are synchronized between the nodes of a graph
+    enum ggml_graph_exec_mode {
+        GGML_GRAPH_EXEC_MODE_SEQUENTIAL = 0, // barrier after every node
+        GGML_GRAPH_EXEC_MODE_DEPENDENCY = 1, // barrier only before nodes that depend on the nodes computed since the last barrier
+    };
+
+    typedef struct ggml_threadpool * ggml_threadpool_t;
+
     // the compute plan that needs to be prepared for ggml_graph_compute()
     // since https://github.com/ggerganov/ggml/issues/287
     struct ggml_cplan {
@@ -635,10 +680,16 @@ extern "C" {
         uint8_t * work_data; // work buffer, to be allocated by caller before calling to `ggml_graph_compute()`
 
         int n_threads;
+        struct ggml_threadpool * threadpool; // if NULL, a disposable threadpool is created for each compute
+
+        enum ggml_graph_exec_mode exec_mode;
 
         // abort ggml_graph_compute when true
         ggml_abort_callback abort_callback;
         void *              abort_callback_data;
+
+        // status of the graph submitted with this plan to ggml_graph_compute_async(), set when the graph is done
+        enum ggml_status async_status;
     };
 
     enum ggml_cgraph_eval_order {
@@ -777,6 +828,17 @@ extern "C" {
     GGML_API struct ggml_context * ggml_init(struct ggml_init_params params);
     GGML_API void                  ggml_free(struct ggml_context * ctx);
 
+    // remove all the objects of the context, its memory (and its chunks, see ggml_set_mem_grow) is reused by the next objects
+    // the tensors and graphs of the context are invalidated
+    GGML_API void                  ggml_reset(struct ggml_context * ctx);
+
+    // a context of the calling thread for the tensors and graphs rebuilt at every step (e.g. before ggml_gallocr_alloc_graph)
+    // the first call creates it with params, the next calls reset it: the objects of the previous call are invalidated
+    // params.mem_buffer must be NULL: the context grows by chunks of params.mem_size bytes and its memory is reused by the next calls
+    // do not call ggml_free on it, call ggml_graph_arena_free before the thread exits
+    GGML_API struct ggml_context * ggml_graph_arena(struct ggml_init_params params);
+    GGML_API void                  ggml_graph_arena_free(void);
+
     GGML_API size_t  ggml_used_mem(const struct ggml_context * ctx);
 
     GGML_API size_t  ggml_set_scratch (struct ggml_context * ctx, struct ggml_scratch scratch);
@@ -787,6 +849,15 @@ extern "C" {
     GGML_API size_t  ggml_get_mem_size       (const struct ggml_context * ctx);
     GGML_API size_t  ggml_get_max_tensor_size(const struct ggml_context * ctx);
 
+    // let the memory pool of the context grow (default: chunk_size = 0, the pool does not grow)
+    // when the pool is full, a chunk of at least chunk_size bytes is added to it: the tensors and graphs do not move,
+    // ggml_get_mem_size and ggml_used_mem include the chunks
+    // with recycle, the chunks are kept when the context is freed and reused by the next contexts that grow with recycle
+    GGML_API void    ggml_set_mem_grow(struct ggml_context * ctx, size_t chunk_size, bool recycle);
+
+    // free the chunks kept for reuse
+    GGML_API void    ggml_free_mem_chunks(void);
+
     GGML_API struct ggml_tensor * ggml_new_tensor(
             struct ggml_context * ctx,
             enum   ggml_type type,
@@ -830,6 +901,11 @@ extern "C" {
     GGML_API struct ggml_tensor * ggml_get_next_tensor (const struct ggml_context * ctx, struct ggml_tensor * tensor);
     GGML_API struct ggml_tensor * ggml_get_tensor(struct ggml_context * ctx, const char * name);
 
+    // index the names of the tensors of the context in a hash table (default: off)
+    // ggml_get_tensor and ggml_graph_get_tensor with the graphs of the context are then O(1) instead of a linear search
+    // the index is maintained by ggml_set_name and ggml_format_name: names written directly to tensor->name are not indexed
+    GGML_API void                 ggml_set_name_index(struct ggml_context * ctx, bool enable);
+
     GGML_API struct ggml_tensor * ggml_set_zero(struct ggml_tensor * tensor);
     GGML_API struct ggml_tensor * ggml_set_i32 (struct ggml_tensor * tensor, int32_t value);
     GGML_API struct ggml_tensor * ggml_set_f32 (struct ggml_tensor * tensor, float value);
@@ -2054,17 +2130,85 @@ extern "C" {
     GGML_API void                 ggml_graph_reset       (struct ggml_cgraph * cgraph);  // zero grads
     GGML_API void                 ggml_graph_clear       (struct ggml_cgraph * cgraph);
 
+    // marks the chains of element-wise ops that the CPU backend can compute in a single pass over the rows
+    // (e.g. mul_mat -> add -> gelu, norm -> mul -> add, scale -> soft_max), returns the number of fused nodes
+    // the intermediate results of a chain are not written, tensors that are needed after the graph is computed
+    // must be marked with ggml_set_output before calling this
+    // call it after building the graph and before allocating it with ggml_gallocr
+    GGML_API int                  ggml_graph_fuse        (struct ggml_cgraph * cgraph);
+
     GGML_API size_t ggml_graph_overhead(void);
     GGML_API size_t ggml_graph_overhead_custom(size_t size, bool grads);
 
+    // cpu topology
+
+    // fills cpumask (GGML_MAX_N_THREADS entries) with the cpus best suited for compute threads:
+    // the first hardware thread of each physical core, skipping the efficiency cores of hybrid cpus
+    // returns the number of cpus in the mask, or 0 if the topology is not known on this platform
+    // the topology is read on the first call (or the first threadpool) and cached
+    GGML_API int ggml_cpu_get_compute_mask(bool * cpumask);
+
+    // default number of compute threads: one per performance core if the topology is known
+    GGML_API int ggml_cpu_get_n_threads_default(void);
+
+    // threadpool
+    // the worker threads are created once and parked between graphs, so that
+    // repeated calls to ggml_graph_compute() do not pay the thread creation cost
+    // if no cpumask is given and there are enough compute cpus (see ggml_cpu_get_compute_mask),
+    // the worker threads are kept on those cpus, except in the threadpools that ggml_graph_compute()
+    // creates for a single graph when cplan.threadpool is NULL
+    // a threadpool can be shared by several callers, their graphs are computed one at a time and each graph uses
+    // the first cplan.n_threads threads of the pool
+    // the worker threads apply the priority and their cpumask once, when they start
+    // the calling thread computes a part of each graph as worker 0: it gets the priority of the threadpool and the
+    // first cpu of the mask (strict_cpu) or the whole mask only when it resumes a paused threadpool (ggml_threadpool_resume,
+    // or the first graph computed after a pause), and these settings are not restored
+    GGML_API struct ggml_threadpool_params ggml_threadpool_params_default(int n_threads);
+    GGML_API void                          ggml_threadpool_params_init   (struct ggml_threadpool_params * p, int n_threads); // n_threads <= 0: ggml_cpu_get_n_threads_default()
+    GGML_API bool                          ggml_threadpool_params_match  (const struct ggml_threadpool_params * p0, const struct ggml_threadpool_params * p1);
+    // splits the cpus of params->cpumask (the compute cpus if the mask is empty) in n_parts disjoint sets, so that
+    // graphs computed at the same time on the threadpools of the parts do not compete for the same cores
+    // part i gets n_threads[i] cpus (NULL: an even split of all the cpus), with one thread pinned to each cpu
+    // the other fields are copied from params
+    // returns false if there are not enough cpus
+    GGML_API bool                          ggml_threadpool_params_partition(const struct ggml_threadpool_params * params, int n_parts, const int * n_threads, struct ggml_threadpool_params * parts);
+    GGML_API struct ggml_threadpool *      ggml_threadpool_new          (struct ggml_threadpool_params  * params);
+    GGML_API void                          ggml_threadpool_free         (struct ggml_threadpool * threadpool);
+    GGML_API int                           ggml_threadpool_get_n_threads(struct ggml_threadpool * threadpool);
+    GGML_API void                          ggml_threadpool_pause        (struct ggml_threadpool * threadpool);
+    GGML_API void                          ggml_threadpool_resume       (struct ggml_threadpool * threadpool);
+    GGML_API void                          ggml_threadpool_get_stats    (struct ggml_threadpool * threadpool, struct ggml_threadpool_stats * stats);
+    GGML_API void                          ggml_threadpool_reset_stats  (struct ggml_threadpool * threadpool);
+
     // ggml_graph_plan() has to be called before ggml_graph_compute()
     // when plan.work_size > 0, caller must allocate memory for plan.work_data
-    GGML_API struct ggml_cplan ggml_graph_plan   (const struct ggml_cgraph * cgraph, int n_threads /*= GGML_DEFAULT_N_THREADS*/);
+    GGML_API struct ggml_cplan ggml_graph_plan   (
+                  const struct ggml_cgraph * cgraph,
+                                       int   n_threads, /* = GGML_DEFAULT_N_THREADS */
+                    struct ggml_threadpool * threadpool /* = NULL */ );
     GGML_API enum ggml_status  ggml_graph_compute(      struct ggml_cgraph * cgraph, struct ggml_cplan * cplan);
+    // asynchronous ggml_graph_compute(): the graph is computed by a thread of cplan->threadpool and the call returns immediately
+    // the graph, the plan and its work buffer must stay valid until ggml_threadpool_wait() returns
+    // only one graph is in flight per threadpool, a new submission waits for the previous one
+    GGML_API void              ggml_graph_compute_async(struct ggml_cgraph * cgraph, struct ggml_cplan * cplan);
+    // waits for the async graph of the threadpool and returns its status
+    // with a shared threadpool this may be the graph of another caller, the status of each graph is in its plan (async_status)
+    GGML_API enum ggml_status  ggml_threadpool_wait(struct ggml_threadpool * threadpool);
     // same as ggml_graph_compute() but the work data is allocated as a part of the context
     // note: the drawback of this API is that you must have ensured that the context has enough memory for the work data
     GGML_API enum ggml_status  ggml_graph_compute_with_ctx(struct ggml_context * ctx, struct ggml_cgraph * cgraph, int n_threads);
 
+    // graph capture
+    // the schedule of the graph (nodes to compute, fused nodes, barriers) is built once and reused by each
+    // ggml_graph_capture_compute(), which is cheaper than ggml_graph_compute() for graphs that are evaluated many times
+    // the graph and the plan (incl. its work buffer) must stay valid while captured
+    // the nodes of the graph and their shapes must not change, but the data of the tensors and the op params
+    // that do not change the shapes (e.g. n_past of ggml_diag_mask_inf) can be updated between two computes
+    // the schedule is rebuilt when the tensors are moved to other addresses
+    GGML_API struct ggml_graph_capture * ggml_graph_capture_new    (struct ggml_cgraph * cgraph, const struct ggml_cplan * cplan);
+    GGML_API enum ggml_status            ggml_graph_capture_compute(struct ggml_graph_capture * capture);
+    GGML_API void                        ggml_graph_capture_free   (struct ggml_graph_capture * capture);
+
     GGML_API struct ggml_tensor * ggml_graph_get_tensor(struct ggml_cgraph * cgraph, const char * name);
 
     GGML_API void                 ggml_graph_export(const struct ggml_cgraph * cgraph, const char * fname);
@@ -2297,6 +2441,32 @@ extern "C" {
                    int64_t   n_per_row,
                const float * imatrix);
 
+    // ggml_quantize_chunk with the rows split between n_threads threads, or the threads of threadpool if not NULL
+    // (the threadpool is shared with the graphs computed on it, see ggml_graph_compute)
+    // for the interleaved types (Q4_0_4_4, ...) nrows must be a multiple of the rows of a group
+    GGML_API size_t ggml_quantize_chunk_mt(
+            enum ggml_type   type,
+               const float * src,
+                      void * dst,
+                   int64_t   start,
+                   int64_t   nrows,
+                   int64_t   n_per_row,
+               const float * imatrix,
+                       int   n_threads,
+      struct ggml_threadpool * threadpool);
+
+    // packs the raw codes of an fp8 tensor (e.g. float8_e4m3fn) with the scales of its checkpoint into
+    // GGML_TYPE_F8_E4M3/GGML_TYPE_F8_E5M2, one scale for every n_per_scale values (n for a per-tensor scale)
+    // the codes are kept as they are unless a scale is out of the range of fp16, those blocks are quantized again
+    // n and n_per_scale must be multiples of the block size, returns the size of the data written to dst
+    GGML_API size_t ggml_quantize_fp8(
+            enum ggml_type   type,
+             const uint8_t * src,
+               const float * scale,
+                   int64_t   n_per_scale,
+                      void * dst,
+                   int64_t   n);
+
     //
     // gguf
     //
@@ -2455,6 +2625,7 @@ extern "C" {
     GGML_API int ggml_cpu_has_matmul_int8(void);
     GGML_API int ggml_cpu_has_cann       (void);
     GGML_API int ggml_cpu_has_llamafile  (void);
+    GGML_API int ggml_cpu_has_amx        (void);
 
     //
     // Internal types and functions exposed for tests and benchmarks
@@ -2493,6 +2664,7 @@ extern "C" {
         int64_t                  ncols; // number of columns to process simultaneously
         ggml_gemv_t              gemv;
         ggml_gemm_t              gemm;
+        ggml_vec_dot_t           vec_dot_cols; // one row of x with nrc columns of y, for the small batches
     } ggml_type_traits_t;
 
     GGML_API ggml_type_traits_t ggml_internal_get_type_traits(enum ggml_type type);
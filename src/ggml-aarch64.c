@@ -351,6 +351,103 @@ size_t quantize_q4_0_8x8(const float * restrict src, void * restrict dst, int64_
     return quantize_q4_0_nr_bl(src, dst, nrow, n_per_row, 8, 8);
 }
 
+// Repacking of Q4_0 data into the interleaved formats, see ggml_backend_cpu_repack_buffer_type
+
+enum ggml_type ggml_repack_q4_0_type(void) {
+#if defined(__ARM_NEON) && defined(__aarch64__) && ! ((defined(_MSC_VER)) && ! defined(__clang__))
+#if defined(__ARM_FEATURE_SVE) && defined(__ARM_FEATURE_MATMUL_INT8)
+    if (ggml_cpu_has_sve() && ggml_sve_cnt_b == QK8_0) {
+        return GGML_TYPE_Q4_0_8_8;
+    }
+#endif
+#if defined(__ARM_FEATURE_MATMUL_INT8)
+    return GGML_TYPE_Q4_0_4_8;
+#else
+    return GGML_TYPE_Q4_0_4_4;
+#endif
+#elif defined(__AVX2__) && defined(__F16C__) && defined(__FMA__)
+    return GGML_TYPE_Q4_0_8_8;
+#else
+    return GGML_TYPE_Q4_0;
+#endif
+}
+
+static void ggml_repack_q4_0_params(enum ggml_type type, int * nrows_interleaved, int * blck_size_interleave) {
+    switch (type) {
+        case GGML_TYPE_Q4_0_4_4: *nrows_interleaved = 4; *blck_size_interleave = 4; break;
+        case GGML_TYPE_Q4_0_4_8: *nrows_interleaved = 4; *blck_size_interleave = 8; break;
+        case GGML_TYPE_Q4_0_8_8: *nrows_interleaved = 8; *blck_size_interleave = 8; break;
+        default: GGML_ABORT("%s: not an interleaved Q4_0 type: %s", __func__, ggml_type_name(type));
+    }
+}
+
+void ggml_repack_q4_0(enum ggml_type type, void * restrict dst, const void * restrict src, int64_t nrow, int64_t n_per_row) {
+    int nrows_interleaved;
+    int blck_size_interleave;
+    ggml_repack_q4_0_params(type, &nrows_interleaved, &blck_size_interleave);
+
+    assert(n_per_row % QK4_0 == 0);
+    assert(nrow % nrows_interleaved == 0);
+    const int64_t nb = n_per_row / QK4_0;
+
+    const block_q4_0 * in = (const block_q4_0 *) src;
+    block_q4_0 tmp[8];
+
+    for (int64_t b = 0; b < nrow; b += nrows_interleaved) {
+        for (int64_t x = 0; x < nb; x++) {
+            for (int i = 0; i < nrows_interleaved; i++) {
+                tmp[i] = in[(b + i) * nb + x];
+            }
+            if (nrows_interleaved == 8) {
+                ((block_q4_0x8 *) dst)[(b / 8) * nb + x] = make_block_q4_0x8(tmp, blck_size_interleave, 0x88);
+            } else {
+                ((block_q4_0x4 *) dst)[(b / 4) * nb + x] = make_block_q4_0x4(tmp, blck_size_interleave, 0x88);
+            }
+        }
+    }
+}
+
+void ggml_unpack_q4_0(enum ggml_type type, void * restrict dst, const void * restrict src, int64_t nrow, int64_t n_per_row) {
+    int nrows_interleaved;
+    int blck_size_interleave;
+    ggml_repack_q4_0_params(type, &nrows_interleaved, &blck_size_interleave);
+
+    assert(n_per_row % QK4_0 == 0);
+    assert(nrow % nrows_interleaved == 0);
+    const int64_t nb = n_per_row / QK4_0;
+
+    block_q4_0 * out = (block_q4_0 *) dst;
+
+    // inverse of make_block_q4_0x4 and make_block_q4_0x8
+    for (int64_t b = 0; b < nrow; b += nrows_interleaved) {
+        for (int64_t x = 0; x < nb; x++) {
+            const ggml_half * d;
+            const uint8_t   * qs;
+            if (nrows_interleaved == 8) {
+                const block_q4_0x8 * in = (const block_q4_0x8 *) src + (b / 8) * nb + x;
+                d  = in->d;
+                qs = in->qs;
+            } else {
+                const block_q4_0x4 * in = (const block_q4_0x4 *) src + (b / 4) * nb + x;
+                d  = in->d;
+                qs = in->qs;
+            }
+
+            for (int i = 0; i < nrows_interleaved; i++) {
+                out[(b + i) * nb + x].d = d[i];
+            }
+
+            for (int i = 0; i < QK4_0 / 2 * nrows_interleaved; i++) {
+                int src_offset = (i / (nrows_interleaved * blck_size_interleave)) * blck_size_interleave;
+                int src_id = (i % (nrows_interleaved * blck_size_interleave)) / blck_size_interleave;
+                src_offset += (i % blck_size_interleave);
+
+                out[(b + src_id) * nb + x].qs[src_offset] = qs[i] ^ 0x88;
+            }
+        }
+    }
+}
+
 void ggml_gemv_q4_0_4x4_q8_0(int n, float * restrict s, size_t bs, const void * restrict vx, const void * restrict vy, int nr, int nc) {
     const int qk = QK8_0;
     const int nb = n / qk;
@@ -684,6 +781,48 @@ void ggml_gemv_q4_0_8x8_q8_0(int n, float * restrict s, size_t bs, const void *
     GGML_ASSERT((ggml_cpu_has_sve() || ggml_cpu_has_matmul_int8()) &&
                 "__ARM_FEATURE_SVE and __ARM_FEATURE_MATMUL_INT8 not defined, use the Q4_0_4_4 quantization format for optimal "
                 "performance");
+#elif defined(__AVX2__) && defined(__F16C__) && defined(__FMA__)
+    // the nibbles are unsigned once the xor mask is removed, the offset of 8 is subtracted as 8*sum(a)
+    // the 8 bytes of a column are next to each other: each 256-bit load holds 4 columns
+    const __m256i m4    = _mm256_set1_epi8(0x0F);
+    const __m256i mxor  = _mm256_set1_epi8((char) 0x88);
+    const __m256i eight = _mm256_set1_epi8(8);
+    const __m256i ones  = _mm256_set1_epi16(1);
+    const __m256i perm  = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7); // undoes the lane order of hadd
+
+    const block_q8_0 * a_ptr = (const block_q8_0 *) vy;
+    for (int x = 0; x < nc / ncols_interleaved; x++) {
+        const block_q4_0x8 * b_ptr = (const block_q4_0x8 *) vx + (x * nb);
+
+        __m256 acc = _mm256_setzero_ps();
+        for (int l = 0; l < nb; l++) {
+            __m256i sum0 = _mm256_setzero_si256(); // columns 0-3
+            __m256i sum1 = _mm256_setzero_si256(); // columns 4-7
+            __m256i corr = _mm256_setzero_si256();
+            for (int k = 0; k < (qk / (2 * blocklen)); k++) {
+                const __m256i a0 = _mm256_broadcastq_epi64(_mm_loadl_epi64((const __m128i *) (a_ptr[l].qs + k * blocklen)));
+                const __m256i a1 = _mm256_broadcastq_epi64(_mm_loadl_epi64((const __m128i *) (a_ptr[l].qs + k * blocklen + qk / 2)));
+                const __m256i q0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (b_ptr[l].qs + k * ncols_interleaved * blocklen)), mxor);
+                const __m256i q1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (b_ptr[l].qs + k * ncols_interleaved * blocklen + 32)), mxor);
+
+                sum0 = _mm256_add_epi16(sum0, _mm256_maddubs_epi16(_mm256_and_si256(q0, m4), a0));
+                sum0 = _mm256_add_epi16(sum0, _mm256_maddubs_epi16(_mm256_and_si256(_mm256_srli_epi16(q0, 4), m4), a1));
+                sum1 = _mm256_add_epi16(sum1, _mm256_maddubs_epi16(_mm256_and_si256(q1, m4), a0));
+                sum1 = _mm256_add_epi16(sum1, _mm256_maddubs_epi16(_mm256_and_si256(_mm256_srli_epi16(q1, 4), m4), a1));
+                corr = _mm256_add_epi16(corr, _mm256_maddubs_epi16(eight, a0));
+                corr = _mm256_add_epi16(corr, _mm256_maddubs_epi16(eight, a1));
+            }
+
+            const __m256i isum0 = _mm256_madd_epi16(_mm256_sub_epi16(sum0, corr), ones);
+            const __m256i isum1 = _mm256_madd_epi16(_mm256_sub_epi16(sum1, corr), ones);
+            const __m256i isum  = _mm256_permutevar8x32_epi32(_mm256_hadd_epi32(isum0, isum1), perm);
+
+            const __m256 d = _mm256_mul_ps(_mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) b_ptr[l].d)),
+                                           _mm256_set1_ps(GGML_FP16_TO_FP32(a_ptr[l].d)));
+            acc = _mm256_fmadd_ps(_mm256_cvtepi32_ps(isum), d, acc);
+        }
+        _mm256_storeu_ps(s + x * ncols_interleaved, acc);
+    }
 #else
     float sumf[8];
     int sumi;
@@ -2143,6 +2282,64 @@ void ggml_gemm_q4_0_8x8_q8_0(int n, float * restrict s, size_t bs, const void *
     GGML_ASSERT((ggml_cpu_has_sve() || ggml_cpu_has_matmul_int8()) &&
                 "__ARM_FEATURE_SVE and __ARM_FEATURE_MATMUL_INT8 not defined, use the Q4_0_4_4 quantization format for optimal "
                 "performance");
+#elif defined(__AVX2__) && defined(__F16C__) && defined(__FMA__)
+    // same as the AVX2 gemv, the nibbles of a block are decoded once for the 4 rows of src1
+    const __m256i m4    = _mm256_set1_epi8(0x0F);
+    const __m256i mxor  = _mm256_set1_epi8((char) 0x88);
+    const __m256i eight = _mm256_set1_epi8(8);
+    const __m256i ones  = _mm256_set1_epi16(1);
+    const __m256i perm  = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+
+    for (int y = 0; y < nr / 4; y++) {
+        const block_q8_0x4 * a_ptr = (const block_q8_0x4 *) vy + (y * nb);
+        for (int x = 0; x < nc / ncols_interleaved; x++) {
+            const block_q4_0x8 * b_ptr = (const block_q4_0x8 *) vx + (x * nb);
+
+            __m256 acc[4];
+            for (int m = 0; m < 4; m++) {
+                acc[m] = _mm256_setzero_ps();
+            }
+            for (int l = 0; l < nb; l++) {
+                __m256i lo[2][2]; // [k][columns 0-3, 4-7]
+                __m256i hi[2][2];
+                for (int k = 0; k < (qk / (2 * blocklen)); k++) {
+                    for (int c = 0; c < 2; c++) {
+                        const __m256i q = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (b_ptr[l].qs + k * ncols_interleaved * blocklen + c * 32)), mxor);
+                        lo[k][c] = _mm256_and_si256(q, m4);
+                        hi[k][c] = _mm256_and_si256(_mm256_srli_epi16(q, 4), m4);
+                    }
+                }
+                const __m256 db = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) b_ptr[l].d));
+
+                for (int m = 0; m < 4; m++) {
+                    __m256i sum0 = _mm256_setzero_si256();
+                    __m256i sum1 = _mm256_setzero_si256();
+                    __m256i corr = _mm256_setzero_si256();
+                    for (int k = 0; k < (qk / (2 * blocklen)); k++) {
+                        const __m256i a0 = _mm256_broadcastq_epi64(_mm_loadl_epi64((const __m128i *) (a_ptr[l].qs + k * 4 * blocklen + m * blocklen)));
+                        const __m256i a1 = _mm256_broadcastq_epi64(_mm_loadl_epi64((const __m128i *) (a_ptr[l].qs + k * 4 * blocklen + m * blocklen + qk / 2 * 4)));
+
+                        sum0 = _mm256_add_epi16(sum0, _mm256_maddubs_epi16(lo[k][0], a0));
+                        sum0 = _mm256_add_epi16(sum0, _mm256_maddubs_epi16(hi[k][0], a1));
+                        sum1 = _mm256_add_epi16(sum1, _mm256_maddubs_epi16(lo[k][1], a0));
+                        sum1 = _mm256_add_epi16(sum1, _mm256_maddubs_epi16(hi[k][1], a1));
+                        corr = _mm256_add_epi16(corr, _mm256_maddubs_epi16(eight, a0));
+                        corr = _mm256_add_epi16(corr, _mm256_maddubs_epi16(eight, a1));
+                    }
+
+                    const __m256i isum0 = _mm256_madd_epi16(_mm256_sub_epi16(sum0, corr), ones);
+                    const __m256i isum1 = _mm256_madd_epi16(_mm256_sub_epi16(sum1, corr), ones);
+                    const __m256i isum  = _mm256_permutevar8x32_epi32(_mm256_hadd_epi32(isum0, isum1), perm);
+
+                    const __m256 d = _mm256_mul_ps(db, _mm256_set1_ps(GGML_FP16_TO_FP32(a_ptr[l].d[m])));
+                    acc[m] = _mm256_fmadd_ps(_mm256_cvtepi32_ps(isum), d, acc[m]);
+                }
+            }
+            for (int m = 0; m < 4; m++) {
+                _mm256_storeu_ps(s + (y * 4 + m) * bs + x * ncols_interleaved, acc[m]);
+            }
+        }
+    }
 #else
     float sumf[4][8];
     int sumi;
@@ -114,6 +114,8 @@ struct ggml_dyn_tallocr {
     int n_free_blocks;
     struct free_block free_blocks[MAX_FREE_BLOCKS];
     size_t max_size;
+    size_t live_size;     // sum of the sizes of the allocated blocks
+    size_t max_live_size; // lower bound of max_size for any placement of the same allocations
 
 #ifdef GGML_ALLOCATOR_DEBUG
     struct {
@@ -223,6 +225,8 @@ static size_t ggml_dyn_tallocr_alloc(struct ggml_dyn_tallocr * alloc, size_t siz
 #endif
 
     alloc->max_size = MAX(alloc->max_size, offset + size);
+    alloc->live_size += size;
+    alloc->max_live_size = MAX(alloc->max_live_size, alloc->live_size);
 
     return offset;
 
@@ -239,6 +243,8 @@ static void ggml_dyn_tallocr_free_tensor(struct ggml_dyn_tallocr * alloc, size_t
     remove_allocated_tensor(alloc, offset, tensor);
 #endif
 
+    alloc->live_size -= size;
+
     // see if we can merge with an existing block
     for (int i = 0; i < alloc->n_free_blocks; i++) {
         struct free_block * block = &alloc->free_blocks[i];
@@ -294,6 +300,8 @@ static void ggml_dyn_tallocr_reset(struct ggml_dyn_tallocr * alloc) {
     alloc->free_blocks[0].offset = 0;
     alloc->free_blocks[0].size = SIZE_MAX/2; // restrict maximum size of a measure allocator to half size_t max to avoid overflows
     alloc->max_size = 0;
+    alloc->live_size = 0;
+    alloc->max_live_size = 0;
 }
 
 static struct ggml_dyn_tallocr * ggml_dyn_tallocr_new(size_t alignment) {
@@ -304,6 +312,8 @@ static struct ggml_dyn_tallocr * ggml_dyn_tallocr_new(size_t alignment) {
         /*.n_free_blocks = */ 0,
         /*.free_blocks   = */ {{0}},
         /*.max_size      = */ 0,
+        /*.live_size     = */ 0,
+        /*.max_live_size = */ 0,
 #ifdef GGML_ALLOCATOR_DEBUG
         /*.allocated_tensors = */ {{0}},
 #endif
@@ -332,9 +342,20 @@ struct hash_node {
     int n_views;
     int buffer_id;
     size_t offset; // offset within the buffer
+    int interval_id; // index + 1 of the allocation in galloc->intervals, 0 = not allocated from a buffer
     bool allocated;
 };
 
+// lifetime of an allocation from a dynamic allocator, in allocation and free events of the graph
+// tensors computed inplace share the allocation of their parent
+struct alloc_interval {
+    int buffer_id;
+    int start;
+    int end; // INT_MAX = never freed
+    size_t size;
+    size_t offset;
+};
+
 struct tensor_alloc {
     int buffer_id;
     size_t offset;
@@ -365,6 +386,12 @@ struct ggml_gallocr {
 
     struct leaf_alloc * leaf_allocs; // [n_leafs]
     int n_leafs;
+
+    bool plan; // see ggml_gallocr_set_plan
+    struct alloc_interval * intervals; // [n_intervals]
+    int n_intervals;
+    int intervals_capacity;
+    int n_events;
 };
 
 ggml_gallocr_t ggml_gallocr_new_n(ggml_backend_buffer_type_t * bufts, int n_bufs) {
@@ -447,11 +474,16 @@ void ggml_gallocr_free(ggml_gallocr_t galloc) {
     free(galloc->buf_tallocs);
     free(galloc->node_allocs);
     free(galloc->leaf_allocs);
+    free(galloc->intervals);
     free(galloc);
 }
 
 typedef struct ggml_gallocr * ggml_gallocr_t;
 
+void ggml_gallocr_set_plan(ggml_gallocr_t galloc, bool plan) {
+    galloc->plan = plan;
+}
+
 static struct hash_node * ggml_gallocr_hash_get(ggml_gallocr_t galloc, struct ggml_tensor * t) {
     size_t i = ggml_hash_find_or_insert(&galloc->hash_set, t);
     return &galloc->hash_values[i];
@@ -472,6 +504,22 @@ static bool ggml_gallocr_is_allocated(ggml_gallocr_t galloc, struct ggml_tensor
     return t->data != NULL || ggml_gallocr_hash_get(galloc, t)->allocated;
 }
 
+static int ggml_gallocr_add_interval(ggml_gallocr_t galloc, int buffer_id, size_t size, size_t offset) {
+    if (galloc->n_intervals == galloc->intervals_capacity) {
+        galloc->intervals_capacity = MAX(64, 2*galloc->intervals_capacity);
+        galloc->intervals = realloc(galloc->intervals, galloc->intervals_capacity * sizeof(struct alloc_interval));
+        GGML_ASSERT(galloc->intervals != NULL);
+    }
+    galloc->intervals[galloc->n_intervals++] = (struct alloc_interval) {
+        /*.buffer_id = */ buffer_id,
+        /*.start     = */ galloc->n_events++,
+        /*.end       = */ INT_MAX,
+        /*.size      = */ size,
+        /*.offset    = */ offset,
+    };
+    return galloc->n_intervals;
+}
+
 static void ggml_gallocr_allocate_node(ggml_gallocr_t galloc, struct ggml_tensor * node, int buffer_id) {
     struct hash_node * hn = ggml_gallocr_hash_get(galloc, node);
 
@@ -514,6 +562,7 @@ static void ggml_gallocr_allocate_node(ggml_gallocr_t galloc, struct ggml_tensor
                             assert(view_src_hn->offset == p_hn->offset);
                             hn->buffer_id = p_hn->buffer_id;
                             hn->offset = p_hn->offset;
+                            hn->interval_id = view_src_hn->interval_id;
                             p_hn->allocated = false; // avoid freeing the parent
                             view_src_hn->allocated = false;
                             return;
@@ -522,6 +571,7 @@ static void ggml_gallocr_allocate_node(ggml_gallocr_t galloc, struct ggml_tensor
                         AT_PRINTF("reusing parent %s for %s\n", parent->name, node->name);
                         hn->buffer_id = p_hn->buffer_id;
                         hn->offset = p_hn->offset;
+                        hn->interval_id = p_hn->interval_id;
                         p_hn->allocated = false; // avoid freeing the parent
                         return;
                     }
@@ -535,6 +585,7 @@ static void ggml_gallocr_allocate_node(ggml_gallocr_t galloc, struct ggml_tensor
         size_t offset = ggml_dyn_tallocr_alloc(alloc, size, node);
         hn->buffer_id = buffer_id;
         hn->offset = offset;
+        hn->interval_id = ggml_gallocr_add_interval(galloc, buffer_id, aligned_offset(NULL, size, alloc->alignment), offset);
         return;
     }
 }
@@ -554,6 +605,10 @@ static void ggml_gallocr_free_node(ggml_gallocr_t galloc, struct ggml_tensor * n
     size_t size = ggml_backend_buft_get_alloc_size(buft, node);
     ggml_dyn_tallocr_free_tensor(alloc, offset, size, node);
     hn->allocated = false;
+
+    if (hn->interval_id > 0) {
+        galloc->intervals[hn->interval_id - 1].end = galloc->n_events++;
+    }
 }
 
 static int get_node_buffer_id(const int * node_buffer_ids, int i) {
@@ -564,6 +619,8 @@ static void ggml_gallocr_alloc_graph_impl(ggml_gallocr_t galloc, struct ggml_cgr
     // clear hash tables
     ggml_hash_set_reset(&galloc->hash_set);
     memset(galloc->hash_values, 0, sizeof(struct hash_node) * galloc->hash_set.size);
+    galloc->n_intervals = 0;
+    galloc->n_events = 0;
 
     // allocate leafs
     // these may be tensors that the application is not using in the graph, but may still want to allocate for other purposes
@@ -607,62 +664,202 @@ static void ggml_gallocr_alloc_graph_impl(ggml_gallocr_t galloc, struct ggml_cgr
 
     // allocate tensors
     for (int i = 0; i < graph->n_nodes; i++) {
-        struct ggml_tensor * node = graph->nodes[i];
-        int buffer_id = get_node_buffer_id(node_buffer_ids, i);
-
-        // allocate parents (only leafs need to be allocated at this point)
-        for (int j = 0; j < GGML_MAX_SRC; j++) {
-            struct ggml_tensor * parent = node->src[j];
-            if (parent == NULL) {
-                continue;
-            }
-            ggml_gallocr_allocate_node(galloc, parent, buffer_id);
+        // the nodes fused after this one (see ggml_graph_fuse) are computed together with it, the parents of
+        // all of them are released only after all of them are allocated so that their memory is not reused
+        // while the fused nodes are computed
+        int i_end = i + 1;
+        while (i_end < graph->n_nodes && (graph->nodes[i_end]->flags & GGML_TENSOR_FLAG_FUSED)) {
+            i_end++;
         }
 
-        // allocate node
-        ggml_gallocr_allocate_node(galloc, node, buffer_id);
+        for (int k = i; k < i_end; k++) {
+            struct ggml_tensor * node = graph->nodes[k];
+            int buffer_id = get_node_buffer_id(node_buffer_ids, k);
 
-        AT_PRINTF("exec: %s (%s) <= ", ggml_op_desc(node), node->name);
-        for (int j = 0; j < GGML_MAX_SRC; j++) {
-            struct ggml_tensor * parent = node->src[j];
-            if (parent == NULL) {
-                continue;
+            // allocate parents (only leafs need to be allocated at this point)
+            for (int j = 0; j < GGML_MAX_SRC; j++) {
+                struct ggml_tensor * parent = node->src[j];
+                if (parent == NULL) {
+                    continue;
+                }
+                ggml_gallocr_allocate_node(galloc, parent, buffer_id);
             }
-            AT_PRINTF("%s", parent->name);
-            if (j < GGML_MAX_SRC - 1 && node->src[j + 1] != NULL) {
-                AT_PRINTF(", ");
+
+            // allocate node
+            ggml_gallocr_allocate_node(galloc, node, buffer_id);
+
+            AT_PRINTF("exec: %s (%s) <= ", ggml_op_desc(node), node->name);
+            for (int j = 0; j < GGML_MAX_SRC; j++) {
+                struct ggml_tensor * parent = node->src[j];
+                if (parent == NULL) {
+                    continue;
+                }
+                AT_PRINTF("%s", parent->name);
+                if (j < GGML_MAX_SRC - 1 && node->src[j + 1] != NULL) {
+                    AT_PRINTF(", ");
+                }
             }
+            AT_PRINTF("\n");
         }
-        AT_PRINTF("\n");
 
-        // update parents
-        for (int j = 0; j < GGML_MAX_SRC; j++) {
-            struct ggml_tensor * parent = node->src[j];
-            if (parent == NULL) {
-                continue;
-            }
-            struct hash_node * p_hn = ggml_gallocr_hash_get(galloc, parent);
-            p_hn->n_children -= 1;
-
-            AT_PRINTF("parent %s: %d children, %d views, allocated: %d\n",
-                parent->name, p_hn->n_children, p_hn->n_views, p_hn->allocated);
-
-            if (p_hn->n_children == 0 && p_hn->n_views == 0) {
-                if (ggml_is_view(parent)) {
-                    struct ggml_tensor * view_src = parent->view_src;
-                    struct hash_node * view_src_hn = ggml_gallocr_hash_get(galloc, view_src);
-                    view_src_hn->n_views -= 1;
-                    AT_PRINTF("view_src %s: %d children, %d views\n",
-                        view_src->name, view_src_hn->n_children, view_src_hn->n_views);
-                    if (view_src_hn->n_views == 0 && view_src_hn->n_children == 0 && view_src_hn->allocated) {
-                        ggml_gallocr_free_node(galloc, view_src);
+        for (int k = i; k < i_end; k++) {
+            struct ggml_tensor * node = graph->nodes[k];
+
+            // update parents
+            for (int j = 0; j < GGML_MAX_SRC; j++) {
+                struct ggml_tensor * parent = node->src[j];
+                if (parent == NULL) {
+                    continue;
+                }
+                struct hash_node * p_hn = ggml_gallocr_hash_get(galloc, parent);
+                p_hn->n_children -= 1;
+
+                AT_PRINTF("parent %s: %d children, %d views, allocated: %d\n",
+                    parent->name, p_hn->n_children, p_hn->n_views, p_hn->allocated);
+
+                if (p_hn->n_children == 0 && p_hn->n_views == 0) {
+                    if (ggml_is_view(parent)) {
+                        struct ggml_tensor * view_src = parent->view_src;
+                        struct hash_node * view_src_hn = ggml_gallocr_hash_get(galloc, view_src);
+                        view_src_hn->n_views -= 1;
+                        AT_PRINTF("view_src %s: %d children, %d views\n",
+                            view_src->name, view_src_hn->n_children, view_src_hn->n_views);
+                        if (view_src_hn->n_views == 0 && view_src_hn->n_children == 0 && view_src_hn->allocated) {
+                            ggml_gallocr_free_node(galloc, view_src);
+                        }
+                    }
+                    else if (p_hn->allocated) {
+                        ggml_gallocr_free_node(galloc, parent);
                     }
                 }
-                else if (p_hn->allocated) {
-                    ggml_gallocr_free_node(galloc, parent);
+                AT_PRINTF("\n");
+            }
+        }
+
+        i = i_end - 1;
+    }
+}
+
+// offline planning: the allocations are placed again from their lifetimes, largest first, each one in the smallest
+// gap between the allocations already placed that overlap with it in time (greedy by size)
+
+static int ggml_gallocr_interval_cmp(const void * a, const void * b) {
+    const struct alloc_interval * ia = *(const struct alloc_interval * const *)a;
+    const struct alloc_interval * ib = *(const struct alloc_interval * const *)b;
+    if (ia->size != ib->size) {
+        return ia->size > ib->size ? -1 : 1;
+    }
+    return ia->start - ib->start;
+}
+
+// returns the buffer size needed with the new offsets, written to planned_offsets[interval index]
+static size_t ggml_gallocr_plan_buffer(ggml_gallocr_t galloc, struct ggml_dyn_tallocr * alloc, size_t * planned_offsets) {
+    struct alloc_interval ** order  = malloc(galloc->n_intervals * sizeof(struct alloc_interval *));
+    struct alloc_interval ** placed = malloc(galloc->n_intervals * sizeof(struct alloc_interval *)); // sorted by planned offset
+    GGML_ASSERT(order != NULL && placed != NULL);
+
+    int n = 0;
+    for (int i = 0; i < galloc->n_intervals; i++) {
+        if (galloc->buf_tallocs[galloc->intervals[i].buffer_id] == alloc) {
+            order[n++] = &galloc->intervals[i];
+        }
+    }
+    qsort(order, n, sizeof(struct alloc_interval *), ggml_gallocr_interval_cmp);
+
+    size_t max_size = 0;
+    int n_placed = 0;
+    for (int i = 0; i < n; i++) {
+        struct alloc_interval * iv = order[i];
+        size_t best_offset = SIZE_MAX;
+        size_t best_gap = SIZE_MAX;
+        size_t prev_end = 0;
+        for (int j = 0; j < n_placed; j++) {
+            const struct alloc_interval * p = placed[j];
+            const size_t p_offset = planned_offsets[p - galloc->intervals];
+            if (p->start >= iv->end || iv->start >= p->end) {
+                continue; // not alive at the same time
+            }
+            if (p_offset >= prev_end) {
+                const size_t gap = p_offset - prev_end;
+                if (gap >= iv->size && gap < best_gap) {
+                    best_gap = gap;
+                    best_offset = prev_end;
                 }
             }
-            AT_PRINTF("\n");
+            prev_end = MAX(prev_end, p_offset + p->size);
+        }
+        if (best_offset == SIZE_MAX) {
+            best_offset = prev_end;
+        }
+        planned_offsets[iv - galloc->intervals] = best_offset;
+        max_size = MAX(max_size, best_offset + iv->size);
+
+        // keep placed sorted by offset
+        int insert_pos = n_placed;
+        while (insert_pos > 0 && planned_offsets[placed[insert_pos - 1] - galloc->intervals] > best_offset) {
+            placed[insert_pos] = placed[insert_pos - 1];
+            insert_pos--;
+        }
+        placed[insert_pos] = iv;
+        n_placed++;
+    }
+
+    free(order);
+    free(placed);
+
+    return max_size;
+}
+
+static void ggml_gallocr_plan(ggml_gallocr_t galloc) {
+    if (galloc->n_intervals == 0) {
+        return;
+    }
+
+    size_t * planned_offsets = malloc(galloc->n_intervals * sizeof(size_t));
+    GGML_ASSERT(planned_offsets != NULL);
+
+    for (int i = 0; i < galloc->n_buffers; i++) {
+        struct ggml_dyn_tallocr * alloc = galloc->buf_tallocs[i];
+
+        // the same allocator may be shared by several buffers
+        bool done = false;
+        for (int j = 0; j < i; j++) {
+            done = done || galloc->buf_tallocs[j] == alloc;
+        }
+        if (done) {
+            continue;
+        }
+
+        size_t planned_size = ggml_gallocr_plan_buffer(galloc, alloc, planned_offsets);
+
+#ifndef NDEBUG
+        fprintf(stderr, "%s: %s buffer: %.02f MiB in allocation order, %.02f MiB planned, %.02f MiB lower bound\n", __func__,
+                ggml_backend_buft_name(galloc->bufts[i]),
+                alloc->max_size / 1024.0 / 1024.0, planned_size / 1024.0 / 1024.0, alloc->max_live_size / 1024.0 / 1024.0);
+#endif
+
+        if (planned_size >= alloc->max_size) {
+            continue;
+        }
+
+        alloc->max_size = planned_size;
+        for (int k = 0; k < galloc->n_intervals; k++) {
+            if (galloc->buf_tallocs[galloc->intervals[k].buffer_id] == alloc) {
+                galloc->intervals[k].offset = planned_offsets[k];
+            }
+        }
+    }
+
+    free(planned_offsets);
+
+    // move the tensors to the offsets of their allocations
+    for (size_t i = 0; i < galloc->hash_set.size; i++) {
+        if (!ggml_bitset_get(galloc->hash_set.used, i)) {
+            continue;
+        }
+        struct hash_node * hn = &galloc->hash_values[i];
+        if (hn->interval_id > 0) {
+            hn->offset = galloc->intervals[hn->interval_id - 1].offset;
         }
     }
 }
@@ -691,6 +888,10 @@ bool ggml_gallocr_reserve_n(ggml_gallocr_t galloc, struct ggml_cgraph * graph, c
     // allocate in hash table
     ggml_gallocr_alloc_graph_impl(galloc, graph, node_buffer_ids, leaf_buffer_ids);
 
+    if (galloc->plan) {
+        ggml_gallocr_plan(galloc);
+    }
+
     // set the node_allocs from the hash table
     if (galloc->n_nodes < graph->n_nodes) {
         free(galloc->node_allocs);
@@ -925,6 +1126,442 @@ size_t ggml_gallocr_get_buffer_size(ggml_gallocr_t galloc, int buffer_id) {
     return ggml_backend_buffer_get_size(galloc->buffers[buffer_id]);
 }
 
+size_t ggml_gallocr_get_buffer_min_size(ggml_gallocr_t galloc, int buffer_id) {
+    GGML_ASSERT(buffer_id >= 0 && buffer_id < galloc->n_buffers);
+
+    for (int i = 0; i < buffer_id; i++) {
+        if (galloc->buf_tallocs[i] == galloc->buf_tallocs[buffer_id]) {
+            // same allocator as a previous buffer, see ggml_gallocr_get_buffer_size
+            return 0;
+        }
+    }
+
+    return galloc->buf_tallocs[buffer_id]->max_live_size;
+}
+
+// node reordering
+
+// the nodes are scheduled in units: a node and the nodes fused after it (see ggml_graph_fuse)
+// the memory model is the one of ggml_gallocr: a tensor is allocated when its node is computed and freed after its
+// last use, views use the memory of their view_src
+
+static bool ggml_reorder_is_view_op(enum ggml_op op) {
+    return op == GGML_OP_NONE || op == GGML_OP_VIEW || op == GGML_OP_RESHAPE || op == GGML_OP_PERMUTE || op == GGML_OP_TRANSPOSE;
+}
+
+static struct ggml_tensor * ggml_reorder_owner(struct ggml_tensor * t) {
+    return t->view_src != NULL ? t->view_src : t;
+}
+
+struct ggml_reorder_ctx {
+    struct ggml_cgraph * graph;
+    int n_units;
+    int * unit_start;     // [n_units + 1], first node of the unit
+    int * unit_buffer_id; // [n_units]
+
+    int * edges;          // [n_edges][2], (from, to)
+    int n_edges;
+    int edges_capacity;
+    int * consumers;      // [n_edges], units that depend on the unit, indexed by consumers_start
+    int * consumers_start;// [n_units + 1]
+    int * n_deps;         // [n_units]
+
+    struct ggml_hash_set hash_set;
+    int    * uses;        // [hash_set.size], uses of an owner by the sources of the nodes
+    int    * buffer_id;   // [hash_set.size], buffer of an owner
+    size_t * size;        // [hash_set.size], 0 if the owner is not allocated by ggml_gallocr
+    int    * scratch;     // [hash_set.size]
+    int n_buffers;
+};
+
+static size_t ggml_reorder_id(struct ggml_reorder_ctx * rctx, struct ggml_tensor * t) {
+    return ggml_hash_find_or_insert(&rctx->hash_set, t);
+}
+
+static void ggml_reorder_add_edge(struct ggml_reorder_ctx * rctx, int from, int to) {
+    if (from == -1 || from == to) {
+        return;
+    }
+    if (rctx->n_edges == rctx->edges_capacity) {
+        rctx->edges_capacity = MAX(256, 2*rctx->edges_capacity);
+        rctx->edges = realloc(rctx->edges, rctx->edges_capacity * 2 * sizeof(int));
+        GGML_ASSERT(rctx->edges != NULL);
+    }
+    rctx->edges[2*rctx->n_edges + 0] = from;
+    rctx->edges[2*rctx->n_edges + 1] = to;
+    rctx->n_edges++;
+}
+
+// bytes allocated minus bytes freed by computing unit u, uses is the number of remaining uses of each owner
+static int64_t ggml_reorder_unit_delta(struct ggml_reorder_ctx * rctx, int u, const int * uses) {
+    struct ggml_cgraph * graph = rctx->graph;
+    int64_t delta = 0;
+
+    for (int i = rctx->unit_start[u]; i < rctx->unit_start[u + 1]; i++) {
+        struct ggml_tensor * node = graph->nodes[i];
+        if (node->view_src == NULL && !(node->flags & GGML_TENSOR_FLAG_INPUT)) {
+            delta += rctx->size[ggml_reorder_id(rctx, node)];
+        }
+        for (int j = 0; j < GGML_MAX_SRC; j++) {
+            if (node->src[j] != NULL) {
+                rctx->scratch[ggml_reorder_id(rctx, ggml_reorder_owner(node->src[j]))] += 1;
+            }
+        }
+    }
+    for (int i = rctx->unit_start[u]; i < rctx->unit_start[u + 1]; i++) {
+        struct ggml_tensor * node = graph->nodes[i];
+        for (int j = 0; j < GGML_MAX_SRC; j++) {
+            if (node->src[j] == NULL) {
+                continue;
+            }
+            struct ggml_tensor * owner = ggml_reorder_owner(node->src[j]);
+            size_t id = ggml_reorder_id(rctx, owner);
+            if (rctx->scratch[id] > 0) {
+                if (rctx->scratch[id] == uses[id] && !(owner->flags & GGML_TENSOR_FLAG_OUTPUT)) {
+                    delta -= rctx->size[id];
+                }
+                rctx->scratch[id] = 0;
+            }
+        }
+    }
+
+    return delta;
+}
+
+enum ggml_reorder_strategy {
+    GGML_REORDER_ORIGINAL,  // the order of the graph
+    GGML_REORDER_MIN_DELTA, // the unit that allocates the fewest bytes, the most recently ready one on ties
+    GGML_REORDER_FREE_LIFO, // the unit that frees the most bytes if any frees memory, otherwise the most recently ready one
+};
+
+// simulates the allocation of the units in the order of the strategy, returns the sum of the peaks of the buffers
+// and the number of changes of buffer between consecutive units
+static size_t ggml_reorder_run(struct ggml_reorder_ctx * rctx, enum ggml_reorder_strategy strategy, int * order, int * n_switches) {
+    struct ggml_cgraph * graph = rctx->graph;
+    const int n_units = rctx->n_units;
+
+    int    * uses   = malloc(rctx->hash_set.size * sizeof(int));
+    int    * n_deps = malloc(n_units * sizeof(int));
+    int    * ready  = malloc(n_units * sizeof(int)); // in the order they became ready
+    size_t * live   = calloc(rctx->n_buffers, sizeof(size_t));
+    size_t * peak   = calloc(rctx->n_buffers, sizeof(size_t));
+    GGML_ASSERT(uses != NULL && n_deps != NULL && ready != NULL && live != NULL && peak != NULL);
+
+    memcpy(uses,   rctx->uses,   rctx->hash_set.size * sizeof(int));
+    memcpy(n_deps, rctx->n_deps, n_units * sizeof(int));
+
+    // leafs and inputs are allocated before the first node
+    for (int i = 0; i < graph->n_leafs; i++) {
+        size_t id = ggml_reorder_id(rctx, graph->leafs[i]);
+        live[rctx->buffer_id[id]] += rctx->size[id];
+    }
+    for (int i = 0; i < graph->n_nodes; i++) {
+        struct ggml_tensor * node = graph->nodes[i];
+        if (node->flags & GGML_TENSOR_FLAG_INPUT && node->view_src == NULL) {
+            size_t id = ggml_reorder_id(rctx, node);
+            live[rctx->buffer_id[id]] += rctx->size[id];
+        }
+    }
+    for (int b = 0; b < rctx->n_buffers; b++) {
+        peak[b] = live[b];
+    }
+
+    int n_ready = 0;
+    for (int u = 0; u < n_units; u++) {
+        if (n_deps[u] == 0) {
+            ready[n_ready++] = u;
+        }
+    }
+
+    const int last_unit = n_units - 1;
+    int prev_buffer_id = -1;
+    *n_switches = 0;
+
+    for (int k = 0; k < n_units; k++) {
+        GGML_ASSERT(n_ready > 0);
+
+        // the last node of the graph is usually its result and stays last
+        int best = -1;
+        if (strategy == GGML_REORDER_ORIGINAL) {
+            for (int r = 0; r < n_ready; r++) {
+                if (best == -1 || ready[r] < ready[best]) {
+                    best = r;
+                }
+            }
+        } else {
+            int64_t best_delta = INT64_MAX;
+            bool best_same_buffer = false;
+            for (int r = n_ready - 1; r >= 0; r--) {
+                const int u = ready[r];
+                if (u == last_unit && n_ready > 1) {
+                    continue;
+                }
+                const bool same_buffer = rctx->unit_buffer_id[u] == prev_buffer_id;
+                if (best != -1 && best_same_buffer && !same_buffer) {
+                    continue;
+                }
+                int64_t delta = ggml_reorder_unit_delta(rctx, u, uses);
+                if (strategy == GGML_REORDER_FREE_LIFO && delta > 0) {
+                    delta = 1;
+                }
+                if (best == -1 || (same_buffer && !best_same_buffer) || delta < best_delta) {
+                    best = r;
+                    best_delta = delta;
+                    best_same_buffer = same_buffer;
+                }
+            }
+        }
+
+        const int u = ready[best];
+        memmove(&ready[best], &ready[best + 1], (n_ready - best - 1) * sizeof(int));
+        n_ready--;
+
+        order[k] = u;
+        if (prev_buffer_id != -1 && rctx->unit_buffer_id[u] != prev_buffer_id) {
+            (*n_switches)++;
+        }
+        prev_buffer_id = rctx->unit_buffer_id[u];
+
+        // allocate the nodes of the unit, then free the sources that are not used anymore
+        for (int i = rctx->unit_start[u]; i < rctx->unit_start[u + 1]; i++) {
+            struct ggml_tensor * node = graph->nodes[i];
+            if (node->view_src == NULL && !(node->flags & GGML_TENSOR_FLAG_INPUT)) {
+                size_t id = ggml_reorder_id(rctx, node);
+                live[rctx->buffer_id[id]] += rctx->size[id];
+                peak[rctx->buffer_id[id]] = MAX(peak[rctx->buffer_id[id]], live[rctx->buffer_id[id]]);
+            }
+        }
+        for (int i = rctx->unit_start[u]; i < rctx->unit_start[u + 1]; i++) {
+            struct ggml_tensor * node = graph->nodes[i];
+            for (int j = 0; j < GGML_MAX_SRC; j++) {
+                if (node->src[j] == NULL) {
+                    continue;
+                }
+                struct ggml_tensor * owner = ggml_reorder_owner(node->src[j]);
+                size_t id = ggml_reorder_id(rctx, owner);
+                if (--uses[id] == 0 && !(owner->flags & GGML_TENSOR_FLAG_OUTPUT)) {
+                    live[rctx->buffer_id[id]] -= rctx->size[id];
+                }
+            }
+        }
+
+        for (int e = rctx->consumers_start[u]; e < rctx->consumers_start[u + 1]; e++) {
+            const int c = rctx->consumers[e];
+            if (--n_deps[c] == 0) {
+                ready[n_ready++] = c;
+            }
+        }
+    }
+
+    size_t total = 0;
+    for (int b = 0; b < rctx->n_buffers; b++) {
+        total += peak[b];
+    }
+
+    free(uses);
+    free(n_deps);
+    free(ready);
+    free(live);
+    free(peak);
+
+    return total;
+}
+
+bool ggml_graph_reorder_for_memory(struct ggml_cgraph * graph, const int * node_buffer_ids) {
+    const int n_nodes = graph->n_nodes;
+    if (n_nodes < 3) {
+        return false;
+    }
+
+    struct ggml_reorder_ctx rctx = { 0 };
+    rctx.graph = graph;
+
+    // units
+    rctx.unit_start     = malloc((n_nodes + 1) * sizeof(int));
+    rctx.unit_buffer_id = malloc(n_nodes * sizeof(int));
+    int * node_unit     = malloc(n_nodes * sizeof(int));
+    GGML_ASSERT(rctx.unit_start != NULL && rctx.unit_buffer_id != NULL && node_unit != NULL);
+    for (int i = 0; i < n_nodes; i++) {
+        if (i == 0 || !(graph->nodes[i]->flags & GGML_TENSOR_FLAG_FUSED)) {
+            rctx.unit_start[rctx.n_units] = i;
+            rctx.unit_buffer_id[rctx.n_units] = get_node_buffer_id(node_buffer_ids, i);
+            rctx.n_buffers = MAX(rctx.n_buffers, rctx.unit_buffer_id[rctx.n_units] + 1);
+            rctx.n_units++;
+        }
+        node_unit[i] = rctx.n_units - 1;
+    }
+    rctx.unit_start[rctx.n_units] = n_nodes;
+    const int n_units = rctx.n_units;
+
+    // tensors
+    rctx.hash_set  = ggml_hash_set_new((size_t)n_nodes * (GGML_MAX_SRC + 2) + graph->n_leafs);
+    rctx.uses      = calloc(rctx.hash_set.size, sizeof(int));
+    rctx.buffer_id = malloc(rctx.hash_set.size * sizeof(int));
+    rctx.size      = calloc(rctx.hash_set.size, sizeof(size_t));
+    rctx.scratch   = calloc(rctx.hash_set.size, sizeof(int));
+    int  * producer    = malloc(rctx.hash_set.size * sizeof(int)); // unit of the node, -1 if not a node
+    int  * last_access = malloc(rctx.hash_set.size * sizeof(int));
+    bool * written     = calloc(rctx.hash_set.size, sizeof(bool));
+    GGML_ASSERT(rctx.uses != NULL && rctx.buffer_id != NULL && rctx.size != NULL && rctx.scratch != NULL);
+    GGML_ASSERT(producer != NULL && last_access != NULL && written != NULL);
+    for (size_t i = 0; i < rctx.hash_set.size; i++) {
+        rctx.buffer_id[i] = -1;
+        producer[i] = -1;
+        last_access[i] = -1;
+    }
+
+    for (int i = 0; i < n_nodes; i++) {
+        struct ggml_tensor * node = graph->nodes[i];
+        size_t id = ggml_reorder_id(&rctx, node);
+        producer[id] = node_unit[i];
+        rctx.buffer_id[id] = rctx.unit_buffer_id[node_unit[i]];
+        if (node->view_src == NULL && node->data == NULL) {
+            rctx.size[id] = ggml_nbytes(node);
+        }
+        if (node->view_src != NULL && !ggml_reorder_is_view_op(node->op)) {
+            // the node writes to the memory of view_src
+            written[ggml_reorder_id(&rctx, node->view_src)] = true;
+        }
+    }
+    for (int i = 0; i < graph->n_leafs; i++) {
+        struct ggml_tensor * leaf = graph->leafs[i];
+        if (leaf->view_src == NULL && leaf->data == NULL) {
+            rctx.size[ggml_reorder_id(&rctx, leaf)] = ggml_nbytes(leaf);
+        }
+    }
+
+    // dependencies: the sources of the nodes, and the order of the accesses to a tensor that is written by a node
+    rctx.n_deps = calloc(n_units, sizeof(int));
+    rctx.consumers_start = calloc(n_units + 1, sizeof(int));
+    GGML_ASSERT(rctx.n_deps != NULL && rctx.consumers_start != NULL);
+
+    for (int i = 0; i < n_nodes; i++) {
+        struct ggml_tensor * node = graph->nodes[i];
+        const int u = node_unit[i];
+
+        struct ggml_tensor * deps[GGML_MAX_SRC + 2];
+        int n_tensor_deps = 0;
+        for (int j = 0; j < GGML_MAX_SRC; j++) {
+            if (node->src[j] != NULL) {
+                deps[n_tensor_deps++] = node->src[j];
+                size_t owner_id = ggml_reorder_id(&rctx, ggml_reorder_owner(node->src[j]));
+                rctx.uses[owner_id] += 1;
+                if (rctx.buffer_id[owner_id] == -1) {
+                    rctx.buffer_id[owner_id] = rctx.unit_buffer_id[u];
+                }
+            }
+        }
+        if (node->view_src != NULL) {
+            deps[n_tensor_deps++] = node->view_src;
+        }
+
+        for (int d = 0; d < n_tensor_deps; d++) {
+            ggml_reorder_add_edge(&rctx, producer[ggml_reorder_id(&rctx, deps[d])], u);
+        }
+
+        // tensors written by the graph: every access stays after the previous one
+        deps[n_tensor_deps++] = node;
+        for (int d = 0; d < n_tensor_deps; d++) {
+            size_t owner_id = ggml_reorder_id(&rctx, ggml_reorder_owner(deps[d]));
+            if (!written[owner_id]) {
+                continue;
+            }
+            ggml_reorder_add_edge(&rctx, last_access[owner_id], u);
+            last_access[owner_id] = u;
+        }
+    }
+
+    // tensors that are not used by any node
+    for (size_t i = 0; i < rctx.hash_set.size; i++) {
+        rctx.buffer_id[i] = MAX(rctx.buffer_id[i], 0);
+    }
+
+    const int * edges = rctx.edges;
+    const int n_edges = rctx.n_edges;
+    for (int e = 0; e < n_edges; e++) {
+        rctx.consumers_start[edges[2*e + 0] + 1]++;
+        rctx.n_deps[edges[2*e + 1]]++;
+    }
+    for (int u = 0; u < n_units; u++) {
+        rctx.consumers_start[u + 1] += rctx.consumers_start[u];
+    }
+    rctx.consumers = malloc(MAX(n_edges, 1) * sizeof(int));
+    int * fill = malloc(n_units * sizeof(int));
+    GGML_ASSERT(rctx.consumers != NULL && fill != NULL);
+    memcpy(fill, rctx.consumers_start, n_units * sizeof(int));
+    for (int e = 0; e < n_edges; e++) {
+        rctx.consumers[fill[edges[2*e + 0]]++] = edges[2*e + 1];
+    }
+    free(fill);
+    free(rctx.edges);
+    free(producer);
+    free(last_access);
+    free(written);
+    free(node_unit);
+
+    // keep the order with the smallest peak, without more changes of buffer than the original order
+    int * order      = malloc(n_units * sizeof(int));
+    int * best_order = malloc(n_units * sizeof(int));
+    GGML_ASSERT(order != NULL && best_order != NULL);
+
+    int best_switches;
+    const size_t orig_peak = ggml_reorder_run(&rctx, GGML_REORDER_ORIGINAL, best_order, &best_switches);
+    size_t best_peak = orig_peak;
+    const int orig_switches = best_switches;
+
+    const enum ggml_reorder_strategy strategies[] = { GGML_REORDER_MIN_DELTA, GGML_REORDER_FREE_LIFO };
+    for (size_t s = 0; s < sizeof(strategies)/sizeof(strategies[0]); s++) {
+        int n_switches;
+        size_t peak = ggml_reorder_run(&rctx, strategies[s], order, &n_switches);
+        if (peak < best_peak && n_switches <= orig_switches) {
+            best_peak = peak;
+            int * tmp = best_order;
+            best_order = order;
+            order = tmp;
+        }
+    }
+
+    AT_PRINTF("%s: peak %zu -> %zu bytes\n", __func__, orig_peak, best_peak);
+
+    const bool reordered = best_peak < orig_peak;
+    if (reordered) {
+        struct ggml_tensor ** nodes = malloc(n_nodes * sizeof(struct ggml_tensor *));
+        struct ggml_tensor ** grads = graph->grads ? malloc(n_nodes * sizeof(struct ggml_tensor *)) : NULL;
+        GGML_ASSERT(nodes != NULL && (graph->grads == NULL || grads != NULL));
+        int n = 0;
+        for (int k = 0; k < n_units; k++) {
+            const int u = best_order[k];
+            for (int i = rctx.unit_start[u]; i < rctx.unit_start[u + 1]; i++) {
+                if (grads) {
+                    grads[n] = graph->grads[i];
+                }
+                nodes[n++] = graph->nodes[i];
+            }
+        }
+        memcpy(graph->nodes, nodes, n_nodes * sizeof(struct ggml_tensor *));
+        if (grads) {
+            memcpy(graph->grads, grads, n_nodes * sizeof(struct ggml_tensor *));
+        }
+        free(nodes);
+        free(grads);
+    }
+
+    free(order);
+    free(best_order);
+    free(rctx.unit_start);
+    free(rctx.unit_buffer_id);
+    free(rctx.consumers);
+    free(rctx.consumers_start);
+    free(rctx.n_deps);
+    ggml_hash_set_free(&rctx.hash_set);
+    free(rctx.uses);
+    free(rctx.buffer_id);
+    free(rctx.size);
+    free(rctx.scratch);
+
+    return reordered;
+}
+
 // utils
 
 static bool alloc_tensor_range(struct ggml_context * ctx,
@@ -0,0 +1,447 @@
+#define GGML_COMMON_DECL_C
+#include "ggml-common.h"
+
+#include "ggml-amx.h"
+#include "ggml-impl.h"
+
+#include <string.h>
+
+// AMX (Advanced Matrix Extensions) kernels for mul_mat
+//
+// a tile operation multiplies 16 rows of B (the activations) with 16 rows of A (the weights) for 32 values of k
+// the weights are packed per thread into the layout of the tiles, 32 rows at a time, and multiplied with
+// 32 rows of B at a time in 2x2 tiles:
+//   BF16: TDPBF16PS accumulates in the result tiles over all of k
+//   Q8_0/Q4_0: TDPBSSD for each block of 32 quants, the int32 results are scaled with AVX512 and accumulated in floats
+//
+// the kernels are compiled with target attributes and only used after ggml_amx_init found AMX at runtime
+
+#if defined(__x86_64__) && defined(__linux__) && (defined(__GNUC__) || defined(__clang__))
+#define GGML_AMX_SUPPORTED
+#endif
+
+#if defined(GGML_AMX_SUPPORTED)
+#include <cpuid.h>
+#include <immintrin.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define GGML_AMX_TARGET __attribute__((target("amx-tile,amx-int8,amx-bf16,avx512f,avx512bw,avx512vl,f16c")))
+
+#define GGML_AMX_ARCH_REQ_XCOMP_PERM 0x1023
+#define GGML_AMX_XFEATURE_XTILEDATA  18
+#endif
+
+#define GGML_AMX_TILE_N 16 // rows (and columns of the result) per tile
+#define GGML_AMX_TILE_K 32 // values of k per tile operation
+#define GGML_AMX_MIN_N  16 // fewer rows of B leave most of the tiles empty, the vec_dot kernels are faster then
+
+static bool ggml_amx_is_enabled = false;
+
+void ggml_amx_init(void) {
+#if defined(GGML_AMX_SUPPORTED)
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & (1u << 27))) { // OSXSAVE
+        return;
+    }
+
+    // the OS must save the opmask and ZMM registers for the AVX512 part of the kernels
+    unsigned int xcr0_lo, xcr0_hi;
+    __asm__ __volatile__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+    if ((xcr0_lo & 0xe6) != 0xe6) {
+        return;
+    }
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return;
+    }
+
+    const bool avx512   = (ebx & (1u << 16)) && (ebx & (1u << 30)) && (ebx & (1u << 31)); // F, BW, VL
+    const bool amx_bf16 = edx & (1u << 22);
+    const bool amx_tile = edx & (1u << 24);
+    const bool amx_int8 = edx & (1u << 25);
+
+    if (!avx512 || !amx_bf16 || !amx_tile || !amx_int8) {
+        return;
+    }
+
+    // Linux only gives the tile data state to the processes that ask for it
+    if (syscall(SYS_arch_prctl, GGML_AMX_ARCH_REQ_XCOMP_PERM, GGML_AMX_XFEATURE_XTILEDATA) != 0) {
+        return;
+    }
+
+    ggml_amx_is_enabled = true;
+#endif
+}
+
+bool ggml_amx_enabled(void) {
+    return ggml_amx_is_enabled;
+}
+
+// scratch layout: the 2 packed panels of A followed by a copy of the last, partial tile of B
+static size_t ggml_amx_panel_size(enum ggml_type Atype, int64_t k) {
+    switch (Atype) {
+        case GGML_TYPE_BF16:
+            return GGML_PAD(GGML_AMX_TILE_N*k*sizeof(ggml_bf16_t), 64);
+        case GGML_TYPE_Q8_0:
+        case GGML_TYPE_Q4_0:
+            // int8 quants and a float scale per row and block, k in blocks
+            return GGML_PAD(GGML_AMX_TILE_N*k*QK8_0, 64) + GGML_PAD(GGML_AMX_TILE_N*k*sizeof(float), 64);
+        default:
+            return 0;
+    }
+}
+
+static size_t ggml_amx_tail_size(enum ggml_type Atype, int64_t k) {
+    switch (Atype) {
+        case GGML_TYPE_BF16:
+            return GGML_PAD(GGML_AMX_TILE_N*k*sizeof(ggml_bf16_t), 64);
+        case GGML_TYPE_Q8_0:
+        case GGML_TYPE_Q4_0:
+            return GGML_PAD(GGML_AMX_TILE_N*k*sizeof(block_q8_0), 64);
+        default:
+            return 0;
+    }
+}
+
+size_t ggml_amx_work_size(enum ggml_type Atype, int64_t k) {
+    if (!ggml_amx_is_enabled || ggml_amx_panel_size(Atype, k) == 0) {
+        return 0;
+    }
+    // + 64 to align the start of the scratch memory
+    return 2*ggml_amx_panel_size(Atype, k) + ggml_amx_tail_size(Atype, k) + 64;
+}
+
+#if defined(GGML_AMX_SUPPORTED)
+
+struct ggml_amx_tilecfg {
+    uint8_t  palette_id;
+    uint8_t  start_row;
+    uint8_t  reserved[14];
+    uint16_t colsb[16];
+    uint8_t  rows[16];
+};
+
+// tmm0-1: 2 tiles of B with b_colsb bytes of k per row, tmm2-3: 2 packed tiles of A with a_rows rows, tmm4-7: the 2x2 results
+GGML_AMX_TARGET static void ggml_amx_tile_config(int b_colsb, int a_rows) {
+    struct ggml_amx_tilecfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+
+    cfg.palette_id = 1;
+    for (int t = 0; t < 2; ++t) {
+        cfg.rows[t]  = GGML_AMX_TILE_N;
+        cfg.colsb[t] = b_colsb;
+    }
+    for (int t = 2; t < 4; ++t) {
+        cfg.rows[t]  = a_rows;
+        cfg.colsb[t] = 64;
+    }
+    for (int t = 4; t < 8; ++t) {
+        cfg.rows[t]  = GGML_AMX_TILE_N;
+        cfg.colsb[t] = GGML_AMX_TILE_N*sizeof(float);
+    }
+
+    _tile_loadconfig(&cfg);
+}
+
+// copy the result tile r (16x16 floats) into the valid part of C
+static void ggml_amx_store_partial(const float * r, float * C, int64_t ldc, int nr, int nc) {
+    for (int i = 0; i < nr; ++i) {
+        memcpy(C + i*ldc, r + i*GGML_AMX_TILE_N, nc*sizeof(float));
+    }
+}
+
+//
+// BF16
+//
+
+// pack 16 rows of A in pairs of k: the 32-bit word g of the row n of a tile of k is at [g][n]
+static void ggml_amx_pack_bf16(uint32_t * GGML_RESTRICT dst, const ggml_bf16_t * GGML_RESTRICT A, int64_t lda, int64_t k, int nrows) {
+    const int64_t nkb = k/GGML_AMX_TILE_K;
+
+    for (int n = 0; n < GGML_AMX_TILE_N; ++n) {
+        if (n >= nrows) {
+            for (int64_t kb = 0; kb < nkb; ++kb) {
+                for (int g = 0; g < GGML_AMX_TILE_K/2; ++g) {
+                    dst[kb*256 + g*GGML_AMX_TILE_N + n] = 0;
+                }
+            }
+            continue;
+        }
+        const ggml_bf16_t * row = A + n*lda;
+        for (int64_t kb = 0; kb < nkb; ++kb) {
+            for (int g = 0; g < GGML_AMX_TILE_K/2; ++g) {
+                uint32_t w;
+                memcpy(&w, row + kb*GGML_AMX_TILE_K + 2*g, sizeof(w));
+                dst[kb*256 + g*GGML_AMX_TILE_N + n] = w;
+            }
+        }
+    }
+}
+
+GGML_AMX_TARGET static void ggml_amx_mul_mat_bf16(int64_t m, int64_t n, int64_t k,
+                                                  const ggml_bf16_t * A, int64_t lda,
+                                                  const ggml_bf16_t * B, int64_t ldb,
+                                                  float * C, int64_t ldc,
+                                                  char * work, int ith, int nth) {
+    const int64_t nkb = k/GGML_AMX_TILE_K;
+
+    const size_t panel_size = ggml_amx_panel_size(GGML_TYPE_BF16, k);
+
+    uint32_t    * panel[2] = { (uint32_t *) work, (uint32_t *) (work + panel_size) };
+    ggml_bf16_t * tail     = (ggml_bf16_t *) (work + 2*panel_size);
+
+    // B rows that do not fill a tile are copied into tail, padded with zeros
+    const int64_t n_full = n - n % GGML_AMX_TILE_N;
+    if (n_full < n) {
+        memset(tail, 0, GGML_AMX_TILE_N*k*sizeof(ggml_bf16_t));
+        for (int64_t i = n_full; i < n; ++i) {
+            memcpy(tail + (i - n_full)*k, B + i*ldb, k*sizeof(ggml_bf16_t));
+        }
+    }
+
+    ggml_amx_tile_config(GGML_AMX_TILE_K*sizeof(ggml_bf16_t), GGML_AMX_TILE_K/2);
+
+    float r[GGML_AMX_TILE_N*GGML_AMX_TILE_N] __attribute__((aligned(64)));
+
+    for (int64_t m0 = 2*GGML_AMX_TILE_N*ith; m0 < m; m0 += 2*GGML_AMX_TILE_N*nth) {
+        int mr[2];
+        for (int j = 0; j < 2; ++j) {
+            const int64_t m1 = m0 + j*GGML_AMX_TILE_N;
+            mr[j] = (int) MAX(0, MIN(GGML_AMX_TILE_N, m - m1));
+            ggml_amx_pack_bf16(panel[j], A + MIN(m1, m - 1)*lda, lda, k, mr[j]);
+        }
+
+        for (int64_t n0 = 0; n0 < n; n0 += 2*GGML_AMX_TILE_N) {
+            const ggml_bf16_t * b[2]    = { B, B };
+            int64_t             ldbt[2] = { ldb, ldb };
+            int                 nr[2];
+            for (int i = 0; i < 2; ++i) {
+                const int64_t n1 = n0 + i*GGML_AMX_TILE_N;
+                nr[i] = (int) MAX(0, MIN(GGML_AMX_TILE_N, n - n1));
+                if (nr[i] == GGML_AMX_TILE_N) {
+                    b[i] = B + n1*ldb; ldbt[i] = ldb;
+                } else if (nr[i] > 0) {
+                    b[i] = tail; ldbt[i] = k;
+                } else {
+                    b[i] = b[0]; ldbt[i] = ldbt[0]; // computed and dropped
+                }
+            }
+
+            _tile_zero(4);
+            _tile_zero(5);
+            _tile_zero(6);
+            _tile_zero(7);
+
+            for (int64_t kb = 0; kb < nkb; ++kb) {
+                _tile_loadd(0, b[0] + kb*GGML_AMX_TILE_K, ldbt[0]*sizeof(ggml_bf16_t));
+                _tile_loadd(1, b[1] + kb*GGML_AMX_TILE_K, ldbt[1]*sizeof(ggml_bf16_t));
+                _tile_loadd(2, panel[0] + kb*256, 64);
+                _tile_loadd(3, panel[1] + kb*256, 64);
+
+                _tile_dpbf16ps(4, 0, 2);
+                _tile_dpbf16ps(5, 0, 3);
+                _tile_dpbf16ps(6, 1, 2);
+                _tile_dpbf16ps(7, 1, 3);
+            }
+
+            float * c = C + n0*ldc + m0;
+
+#define GGML_AMX_STORE(t, i, j)                                                                   \
+            if (nr[i] == GGML_AMX_TILE_N && mr[j] == GGML_AMX_TILE_N) {                           \
+                _tile_stored(t, c + i*GGML_AMX_TILE_N*ldc + j*GGML_AMX_TILE_N, ldc*sizeof(float)); \
+            } else if (nr[i] > 0 && mr[j] > 0) {                                                  \
+                _tile_stored(t, r, GGML_AMX_TILE_N*sizeof(float));                                \
+                ggml_amx_store_partial(r, c + i*GGML_AMX_TILE_N*ldc + j*GGML_AMX_TILE_N, ldc, nr[i], mr[j]); \
+            }
+
+            GGML_AMX_STORE(4, 0, 0)
+            GGML_AMX_STORE(5, 0, 1)
+            GGML_AMX_STORE(6, 1, 0)
+            GGML_AMX_STORE(7, 1, 1)
+        }
+    }
+
+    _tile_release();
+}
+
+//
+// Q8_0 and Q4_0
+//
+
+// pack the quants of 16 rows of A in groups of 4: the 32-bit word g of the row n of a block is at [g][n],
+// the scales of a block are stored as 16 floats
+static void ggml_amx_pack_q(int8_t * GGML_RESTRICT qs, float * GGML_RESTRICT d, enum ggml_type Atype,
+                            const void * GGML_RESTRICT A, int64_t lda, int64_t nkb, int nrows) {
+    for (int n = 0; n < GGML_AMX_TILE_N; ++n) {
+        for (int64_t kb = 0; kb < nkb; ++kb) {
+            int8_t q[QK8_0];
+
+            if (n >= nrows) {
+                memset(q, 0, sizeof(q));
+                d[kb*GGML_AMX_TILE_N + n] = 0.0f;
+            } else if (Atype == GGML_TYPE_Q8_0) {
+                const block_q8_0 * x = (const block_q8_0 *) A + n*lda + kb;
+                memcpy(q, x->qs, sizeof(q));
+                d[kb*GGML_AMX_TILE_N + n] = GGML_FP16_TO_FP32(x->d);
+            } else {
+                const block_q4_0 * x = (const block_q4_0 *) A + n*lda + kb;
+                for (int j = 0; j < QK4_0/2; ++j) {
+                    q[j]           = (int8_t) (x->qs[j] & 0xF) - 8;
+                    q[j + QK4_0/2] = (int8_t) (x->qs[j] >>  4) - 8;
+                }
+                d[kb*GGML_AMX_TILE_N + n] = GGML_FP16_TO_FP32(x->d);
+            }
+
+            for (int g = 0; g < QK8_0/4; ++g) {
+                memcpy(qs + kb*512 + g*64 + n*4, q + 4*g, 4);
+            }
+        }
+    }
+}
+
+GGML_AMX_TARGET static void ggml_amx_mul_mat_q(int64_t m, int64_t n, int64_t nkb,
+                                               const void * A, int64_t lda, enum ggml_type Atype,
+                                               const block_q8_0 * B, int64_t ldb,
+                                               float * C, int64_t ldc,
+                                               char * work, int ith, int nth) {
+    const size_t panel_size = ggml_amx_panel_size(Atype, nkb);
+    const size_t qs_size    = GGML_PAD(GGML_AMX_TILE_N*nkb*QK8_0, 64);
+
+    int8_t * qs[2] = { (int8_t *) work,             (int8_t *) (work + panel_size) };
+    float  * d[2]  = { (float  *) (work + qs_size), (float  *) (work + panel_size + qs_size) };
+
+    block_q8_0 * tail = (block_q8_0 *) (work + 2*panel_size);
+
+    const int64_t n_full = n - n % GGML_AMX_TILE_N;
+    if (n_full < n) {
+        memset(tail, 0, GGML_AMX_TILE_N*nkb*sizeof(block_q8_0));
+        for (int64_t i = n_full; i < n; ++i) {
+            memcpy(tail + (i - n_full)*nkb, B + i*ldb, nkb*sizeof(block_q8_0));
+        }
+    }
+
+    ggml_amx_tile_config(QK8_0, QK8_0/4);
+
+    int32_t r[4][GGML_AMX_TILE_N*GGML_AMX_TILE_N] __attribute__((aligned(64)));
+    float acc[4][GGML_AMX_TILE_N*GGML_AMX_TILE_N] __attribute__((aligned(64)));
+
+    for (int64_t m0 = 2*GGML_AMX_TILE_N*ith; m0 < m; m0 += 2*GGML_AMX_TILE_N*nth) {
+        int mr[2];
+        for (int j = 0; j < 2; ++j) {
+            const int64_t m1 = m0 + j*GGML_AMX_TILE_N;
+            mr[j] = (int) MAX(0, MIN(GGML_AMX_TILE_N, m - m1));
+            ggml_amx_pack_q(qs[j], d[j], Atype, (const char *) A + MIN(m1, m - 1)*lda*ggml_type_size(Atype), lda, nkb, mr[j]);
+        }
+
+        for (int64_t n0 = 0; n0 < n; n0 += 2*GGML_AMX_TILE_N) {
+            const block_q8_0 * b[2]    = { B, B };
+            int64_t            ldbt[2] = { ldb, ldb };
+            int                nr[2];
+            for (int i = 0; i < 2; ++i) {
+                const int64_t n1 = n0 + i*GGML_AMX_TILE_N;
+                nr[i] = (int) MAX(0, MIN(GGML_AMX_TILE_N, n - n1));
+                if (nr[i] == GGML_AMX_TILE_N) {
+                    b[i] = B + n1*ldb; ldbt[i] = ldb;
+                } else if (nr[i] > 0) {
+                    b[i] = tail; ldbt[i] = nkb;
+                } else {
+                    b[i] = b[0]; ldbt[i] = ldbt[0]; // computed and dropped
+                }
+            }
+
+            memset(acc, 0, sizeof(acc));
+
+            for (int64_t kb = 0; kb < nkb; ++kb) {
+                _tile_zero(4);
+                _tile_zero(5);
+                _tile_zero(6);
+                _tile_zero(7);
+
+                _tile_loadd(0, b[0][kb].qs, ldbt[0]*sizeof(block_q8_0));
+                _tile_loadd(1, b[1][kb].qs, ldbt[1]*sizeof(block_q8_0));
+                _tile_loadd(2, qs[0] + kb*512, 64);
+                _tile_loadd(3, qs[1] + kb*512, 64);
+
+                _tile_dpbssd(4, 0, 2);
+                _tile_dpbssd(5, 0, 3);
+                _tile_dpbssd(6, 1, 2);
+                _tile_dpbssd(7, 1, 3);
+
+                _tile_stored(4, r[0], 64);
+                _tile_stored(5, r[1], 64);
+                _tile_stored(6, r[2], 64);
+                _tile_stored(7, r[3], 64);
+
+                const __m512 d0 = _mm512_loadu_ps(d[0] + kb*GGML_AMX_TILE_N);
+                const __m512 d1 = _mm512_loadu_ps(d[1] + kb*GGML_AMX_TILE_N);
+
+                for (int i = 0; i < 2; ++i) {
+                    for (int64_t l = 0; l < GGML_AMX_TILE_N; ++l) {
+                        const __m512 db = _mm512_set1_ps(GGML_FP16_TO_FP32(b[i][l*ldbt[i] + kb].d));
+                        float * acc0 = acc[2*i + 0] + l*GGML_AMX_TILE_N;
+                        float * acc1 = acc[2*i + 1] + l*GGML_AMX_TILE_N;
+                        _mm512_store_ps(acc0, _mm512_fmadd_ps(_mm512_cvtepi32_ps(_mm512_load_si512(r[2*i + 0] + l*GGML_AMX_TILE_N)),
+                                                              _mm512_mul_ps(db, d0), _mm512_load_ps(acc0)));
+                        _mm512_store_ps(acc1, _mm512_fmadd_ps(_mm512_cvtepi32_ps(_mm512_load_si512(r[2*i + 1] + l*GGML_AMX_TILE_N)),
+                                                              _mm512_mul_ps(db, d1), _mm512_load_ps(acc1)));
+                    }
+                }
+            }
+
+            for (int i = 0; i < 2; ++i) {
+                for (int j = 0; j < 2; ++j) {
+                    if (nr[i] > 0 && mr[j] > 0) {
+                        ggml_amx_store_partial(acc[2*i + j], C + (n0 + i*GGML_AMX_TILE_N)*ldc + m0 + j*GGML_AMX_TILE_N, ldc, nr[i], mr[j]);
+                    }
+                }
+            }
+        }
+    }
+
+    _tile_release();
+}
+
+#endif // GGML_AMX_SUPPORTED
+
+bool ggml_amx_mul_mat(int64_t m, int64_t n, int64_t k,
+                      const void * A, int64_t lda,
+                      const void * B, int64_t ldb,
+                            float * C, int64_t ldc,
+                      void * work, int ith, int nth,
+                      enum ggml_type Atype, enum ggml_type Btype) {
+    if (!ggml_amx_is_enabled || n < GGML_AMX_MIN_N) {
+        return false;
+    }
+
+#if defined(GGML_AMX_SUPPORTED)
+    char * wdata = (char *) GGML_PAD((uintptr_t) work, 64);
+
+    switch (Atype) {
+        case GGML_TYPE_BF16:
+            if (Btype != GGML_TYPE_BF16 || k % GGML_AMX_TILE_K != 0) {
+                return false;
+            }
+            ggml_amx_mul_mat_bf16(m, n, k, (const ggml_bf16_t *) A, lda, (const ggml_bf16_t *) B, ldb, C, ldc, wdata, ith, nth);
+            return true;
+        case GGML_TYPE_Q8_0:
+        case GGML_TYPE_Q4_0:
+            if (Btype != GGML_TYPE_Q8_0) {
+                return false;
+            }
+            ggml_amx_mul_mat_q(m, n, k, A, lda, Atype, (const block_q8_0 *) B, ldb, C, ldc, wdata, ith, nth);
+            return true;
+        default:
+            return false;
+    }
+#else
+    GGML_UNUSED(m); GGML_UNUSED(k);
+    GGML_UNUSED(A); GGML_UNUSED(lda);
+    GGML_UNUSED(B); GGML_UNUSED(ldb);
+    GGML_UNUSED(C); GGML_UNUSED(ldc);
+    GGML_UNUSED(work); GGML_UNUSED(ith); GGML_UNUSED(nth);
+    GGML_UNUSED(Atype); GGML_UNUSED(Btype);
+    return false;
+#endif
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "ggml.h"
+
+// GGML internal header
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// checks that the CPU has AMX-TILE, AMX-INT8 and AMX-BF16 and requests the permission to use the tiles from the OS,
+// called once from ggml_init
+void ggml_amx_init(void);
+bool ggml_amx_enabled(void);
+
+// the scratch memory each thread needs for ggml_amx_mul_mat, 0 if there is no AMX kernel for the type
+size_t ggml_amx_work_size(enum ggml_type Atype, int64_t k);
+
+// C = Aᵀ * B with AMX tiles for the rows of A (m×k) and B (n×k) and the columns of C (n×m), like llamafile_sgemm
+// A is BF16 with B BF16, or Q8_0/Q4_0 with B Q8_0; lda and ldb are in blocks (elements for BF16), k too, ldc in floats
+// work is the scratch memory of the thread (see ggml_amx_work_size)
+// returns false if the types or the shapes are not supported, nothing is computed then
+bool ggml_amx_mul_mat(int64_t m, int64_t n, int64_t k,
+                      const void * A, int64_t lda,
+                      const void * B, int64_t ldb,
+                            float * C, int64_t ldc,
+                      void * work, int ith, int nth,
+                      enum ggml_type Atype, enum ggml_type Btype);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,7 @@
 #include "ggml-backend-impl.h"
 #include "ggml-alloc.h"
 #include "ggml-impl.h"
+#include "ggml-aarch64.h"
 
 #include <assert.h>
 #include <limits.h>
@@ -9,6 +10,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__gnu_linux__)
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
@@ -721,13 +729,466 @@ ggml_backend_buffer_type_t ggml_backend_cpu_hbm_buffer_type(void) {
 }
 #endif
 
+// NUMA aware buffer types
+
+struct ggml_backend_cpu_numa_buffer_context {
+    enum ggml_backend_cpu_numa_mode mode;
+
+    int    n_nodes;
+    int    n_copies;                  // REPLICATE: one copy per node, otherwise 1
+    size_t size;                      // size of each copy
+    void * data[GGML_NUMA_MAX_NODES]; // data[0] is the base of the buffer
+};
+
+GGML_CALL static const char * ggml_backend_cpu_numa_buffer_get_name(ggml_backend_buffer_t buffer) {
+    return "CPU_NUMA";
+
+    GGML_UNUSED(buffer);
+}
+
+GGML_CALL static void * ggml_backend_cpu_numa_buffer_get_base(ggml_backend_buffer_t buffer) {
+    struct ggml_backend_cpu_numa_buffer_context * ctx = (struct ggml_backend_cpu_numa_buffer_context *)buffer->context;
+    return ctx->data[0];
+}
+
+static void ggml_backend_cpu_numa_buffer_context_free(struct ggml_backend_cpu_numa_buffer_context * ctx) {
+#if defined(__gnu_linux__)
+    for (int i = 0; i < ctx->n_copies; i++) {
+        munmap(ctx->data[i], ctx->size);
+    }
+#endif
+    free(ctx);
+}
+
+GGML_CALL static void ggml_backend_cpu_numa_buffer_free_buffer(ggml_backend_buffer_t buffer) {
+    ggml_backend_cpu_numa_buffer_context_free((struct ggml_backend_cpu_numa_buffer_context *)buffer->context);
+}
+
+#if defined(__gnu_linux__)
+// sets the memory policy of the pages of [addr, addr + size) that have not been touched yet
+static void ggml_backend_cpu_numa_mbind(void * addr, size_t size, int mode, unsigned long nodemask) {
+    if (syscall(SYS_mbind, addr, size, mode, &nodemask, 8*sizeof(nodemask), 0) != 0) {
+        static bool warned = false;
+        if (!warned) {
+            fprintf(stderr, "%s: warning: mbind failed: %s\n", __func__, strerror(errno));
+            warned = true;
+        }
+    }
+}
+#endif
+
+GGML_CALL static void ggml_backend_cpu_numa_buffer_init_tensor(ggml_backend_buffer_t buffer, struct ggml_tensor * tensor) {
+#if defined(__gnu_linux__)
+    struct ggml_backend_cpu_numa_buffer_context * ctx = (struct ggml_backend_cpu_numa_buffer_context *)buffer->context;
+
+    if (ctx->mode != GGML_BACKEND_CPU_NUMA_DISTRIBUTE || tensor->view_src != NULL) {
+        return;
+    }
+
+    // place the block of rows [k*nrows/n_nodes, (k+1)*nrows/n_nodes) on node k
+    // the pages at the boundaries of the blocks go to the node of the block they start in
+    const int       n_nodes  = ctx->n_nodes;
+    const int64_t   nrows    = ggml_nrows(tensor);
+    const size_t    row_size = ggml_row_size(tensor->type, tensor->ne[0]);
+    const uintptr_t page     = (uintptr_t) sysconf(_SC_PAGESIZE);
+    const uintptr_t data     = (uintptr_t) tensor->data;
+
+    if (nrows < n_nodes) {
+        return;
+    }
+
+    for (int k = 0; k < n_nodes; k++) {
+        uintptr_t b = data + row_size*(nrows*k/n_nodes);
+        uintptr_t e = data + row_size*(nrows*(k + 1)/n_nodes);
+
+        // do not change the pages shared with the previous and next tensors
+        b = k == 0 ? GGML_PAD(b, page) : b & ~(page - 1);
+        e = e & ~(page - 1);
+
+        if (e > b) {
+            ggml_backend_cpu_numa_mbind((void *) b, e - b, MPOL_PREFERRED, 1UL << k);
+        }
+    }
+#else
+    GGML_UNUSED(buffer);
+    GGML_UNUSED(tensor);
+#endif
+}
+
+GGML_CALL static void ggml_backend_cpu_numa_buffer_set_tensor(ggml_backend_buffer_t buffer, struct ggml_tensor * tensor, const void * data, size_t offset, size_t size) {
+    struct ggml_backend_cpu_numa_buffer_context * ctx = (struct ggml_backend_cpu_numa_buffer_context *)buffer->context;
+
+    const size_t tensor_offset = (char *)tensor->data - (char *)ctx->data[0];
+    for (int i = 0; i < ctx->n_copies; i++) {
+        memcpy((char *)ctx->data[i] + tensor_offset + offset, data, size);
+    }
+}
+
+GGML_CALL static bool ggml_backend_cpu_numa_buffer_cpy_tensor(ggml_backend_buffer_t buffer, const struct ggml_tensor * src, struct ggml_tensor * dst) {
+    if (ggml_backend_buffer_is_host(src->buffer)) {
+        ggml_backend_cpu_numa_buffer_set_tensor(buffer, dst, src->data, 0, ggml_nbytes(src));
+        return true;
+    }
+    return false;
+}
+
+GGML_CALL static void ggml_backend_cpu_numa_buffer_clear(ggml_backend_buffer_t buffer, uint8_t value) {
+    struct ggml_backend_cpu_numa_buffer_context * ctx = (struct ggml_backend_cpu_numa_buffer_context *)buffer->context;
+
+    for (int i = 0; i < ctx->n_copies; i++) {
+        memset(ctx->data[i], value, ctx->size);
+    }
+}
+
+static struct ggml_backend_buffer_i cpu_numa_backend_buffer_i = {
+    /* .get_name        = */ ggml_backend_cpu_numa_buffer_get_name,
+    /* .free_buffer     = */ ggml_backend_cpu_numa_buffer_free_buffer,
+    /* .get_base        = */ ggml_backend_cpu_numa_buffer_get_base,
+    /* .init_tensor     = */ ggml_backend_cpu_numa_buffer_init_tensor,
+    /* .set_tensor      = */ ggml_backend_cpu_numa_buffer_set_tensor,
+    /* .get_tensor      = */ ggml_backend_cpu_buffer_get_tensor, // reads the first copy
+    /* .cpy_tensor      = */ ggml_backend_cpu_numa_buffer_cpy_tensor,
+    /* .clear           = */ ggml_backend_cpu_numa_buffer_clear,
+    /* .reset           = */ NULL,
+};
+
+void * ggml_backend_cpu_numa_replica(const struct ggml_tensor * tensor, int node) {
+    ggml_backend_buffer_t buffer = tensor->buffer;
+
+    if (buffer == NULL || buffer->iface.free_buffer != ggml_backend_cpu_numa_buffer_free_buffer) {
+        return NULL;
+    }
+
+    struct ggml_backend_cpu_numa_buffer_context * ctx = (struct ggml_backend_cpu_numa_buffer_context *)buffer->context;
+    if (node >= ctx->n_copies) {
+        return NULL;
+    }
+
+    return (char *)ctx->data[node] + ((char *)tensor->data - (char *)ctx->data[0]);
+}
+
+GGML_CALL static const char * ggml_backend_cpu_numa_buffer_type_get_name(ggml_backend_buffer_type_t buft) {
+    switch ((enum ggml_backend_cpu_numa_mode)(intptr_t)buft->context) {
+        case GGML_BACKEND_CPU_NUMA_INTERLEAVE: return "CPU_NUMA_INTERLEAVE";
+        case GGML_BACKEND_CPU_NUMA_DISTRIBUTE: return "CPU_NUMA_DISTRIBUTE";
+        case GGML_BACKEND_CPU_NUMA_REPLICATE:  return "CPU_NUMA_REPLICATE";
+    }
+    return "CPU_NUMA";
+}
+
+GGML_CALL static ggml_backend_buffer_t ggml_backend_cpu_numa_buffer_type_alloc_buffer(ggml_backend_buffer_type_t buft, size_t size) {
+#if defined(__gnu_linux__)
+    const int n_nodes = (int) ggml_numa_n_nodes();
+
+    if (n_nodes > 1) {
+        struct ggml_backend_cpu_numa_buffer_context * ctx = calloc(1, sizeof(struct ggml_backend_cpu_numa_buffer_context));
+        if (ctx == NULL) {
+            return NULL;
+        }
+
+        ctx->mode     = (enum ggml_backend_cpu_numa_mode)(intptr_t)buft->context;
+        ctx->n_nodes  = n_nodes;
+        ctx->n_copies = ctx->mode == GGML_BACKEND_CPU_NUMA_REPLICATE ? n_nodes : 1;
+        ctx->size     = GGML_PAD(MAX(size, 1), (size_t) sysconf(_SC_PAGESIZE));
+
+        for (int i = 0; i < ctx->n_copies; i++) {
+            // the pages are placed on the first touch, so the policy has to be set before the data is written
+            void * data = mmap(NULL, ctx->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (data == MAP_FAILED) {
+                fprintf(stderr, "%s: failed to allocate buffer of size %zu\n", __func__, ctx->size);
+                ctx->n_copies = i;
+                ggml_backend_cpu_numa_buffer_context_free(ctx);
+                return NULL;
+            }
+            ctx->data[i] = data;
+
+            switch (ctx->mode) {
+                case GGML_BACKEND_CPU_NUMA_INTERLEAVE:
+                    ggml_backend_cpu_numa_mbind(data, ctx->size, MPOL_INTERLEAVE, (1UL << n_nodes) - 1);
+                    break;
+                case GGML_BACKEND_CPU_NUMA_REPLICATE:
+                    ggml_backend_cpu_numa_mbind(data, ctx->size, MPOL_PREFERRED, 1UL << i);
+                    break;
+                case GGML_BACKEND_CPU_NUMA_DISTRIBUTE:
+                    break; // per tensor, see init_tensor
+            }
+        }
+
+        return ggml_backend_buffer_init(buft, cpu_numa_backend_buffer_i, ctx, ctx->size);
+    }
+#endif
+
+    // not a NUMA system, use a regular CPU buffer
+    ggml_backend_buffer_t buffer = ggml_backend_buft_alloc_buffer(ggml_backend_cpu_buffer_type(), size);
+    if (buffer != NULL) {
+        buffer->buft = buft;
+    }
+    return buffer;
+}
+
+GGML_CALL ggml_backend_buffer_type_t ggml_backend_cpu_numa_buffer_type(enum ggml_backend_cpu_numa_mode mode) {
+    static struct ggml_backend_buffer_type ggml_backend_cpu_numa_buffer_types[] = {
+        {
+            /* .iface    = */ {
+                /* .get_name         = */ ggml_backend_cpu_numa_buffer_type_get_name,
+                /* .alloc_buffer     = */ ggml_backend_cpu_numa_buffer_type_alloc_buffer,
+                /* .get_alignment    = */ ggml_backend_cpu_buffer_type_get_alignment,
+                /* .get_max_size     = */ NULL, // defaults to SIZE_MAX
+                /* .get_alloc_size   = */ NULL, // defaults to ggml_nbytes
+                /* .is_host          = */ ggml_backend_cpu_buffer_type_is_host,
+            },
+            /* .context  = */ (void *)(intptr_t) GGML_BACKEND_CPU_NUMA_INTERLEAVE,
+        },
+        {
+            /* .iface    = */ {
+                /* .get_name         = */ ggml_backend_cpu_numa_buffer_type_get_name,
+                /* .alloc_buffer     = */ ggml_backend_cpu_numa_buffer_type_alloc_buffer,
+                /* .get_alignment    = */ ggml_backend_cpu_buffer_type_get_alignment,
+                /* .get_max_size     = */ NULL, // defaults to SIZE_MAX
+                /* .get_alloc_size   = */ NULL, // defaults to ggml_nbytes
+                /* .is_host          = */ ggml_backend_cpu_buffer_type_is_host,
+            },
+            /* .context  = */ (void *)(intptr_t) GGML_BACKEND_CPU_NUMA_DISTRIBUTE,
+        },
+        {
+            /* .iface    = */ {
+                /* .get_name         = */ ggml_backend_cpu_numa_buffer_type_get_name,
+                /* .alloc_buffer     = */ ggml_backend_cpu_numa_buffer_type_alloc_buffer,
+                /* .get_alignment    = */ ggml_backend_cpu_buffer_type_get_alignment,
+                /* .get_max_size     = */ NULL, // defaults to SIZE_MAX
+                /* .get_alloc_size   = */ NULL, // defaults to ggml_nbytes
+                /* .is_host          = */ ggml_backend_cpu_buffer_type_is_host,
+            },
+            /* .context  = */ (void *)(intptr_t) GGML_BACKEND_CPU_NUMA_REPLICATE,
+        },
+    };
+
+    GGML_ASSERT((size_t) mode < sizeof(ggml_backend_cpu_numa_buffer_types)/sizeof(ggml_backend_cpu_numa_buffer_types[0]));
+
+    return &ggml_backend_cpu_numa_buffer_types[mode];
+}
+
+// CPU buffer type with the Q4_0 weights repacked into the interleaved formats of the gemv/gemm kernels
+
+// the tensors repacked by the buffer have the interleaved type in extra, see ggml_backend_cpu_repack_type
+GGML_CALL static void ggml_backend_cpu_repack_buffer_init_tensor(ggml_backend_buffer_t buffer, struct ggml_tensor * tensor) {
+    const enum ggml_type type = ggml_repack_q4_0_type();
+
+    tensor->extra = NULL;
+
+    if (tensor->type != GGML_TYPE_Q4_0 || type == GGML_TYPE_Q4_0 || tensor->view_src != NULL || ggml_n_dims(tensor) != 2 ||
+        tensor->ne[1] % ggml_internal_get_type_traits(type).ncols != 0 || !ggml_is_contiguous(tensor)) {
+        return;
+    }
+
+    tensor->extra = (void *)(intptr_t) type;
+
+    GGML_UNUSED(buffer);
+}
+
+// the rows are repacked in groups of ncols, the groups partially covered by [offset, offset + size) are
+// unpacked, updated and repacked again
+GGML_CALL static void ggml_backend_cpu_repack_buffer_set_tensor(ggml_backend_buffer_t buffer, struct ggml_tensor * tensor, const void * data, size_t offset, size_t size) {
+    if (tensor->extra == NULL) {
+        memcpy((char *)tensor->data + offset, data, size);
+        return;
+    }
+
+    const enum ggml_type type       = (enum ggml_type)(intptr_t) tensor->extra;
+    const int64_t        nrows      = ggml_internal_get_type_traits(type).ncols;
+    const size_t         group_size = nrows*tensor->nb[1];
+
+    void * tmp = NULL;
+
+    for (size_t g = offset/group_size*group_size; g < offset + size; g += group_size) {
+        char * dst = (char *)tensor->data + g;
+
+        if (g >= offset && g + group_size <= offset + size) {
+            ggml_repack_q4_0(type, dst, (const char *)data + (g - offset), nrows, tensor->ne[0]);
+            continue;
+        }
+
+        if (tmp == NULL) {
+            tmp = malloc(group_size);
+            GGML_ASSERT(tmp != NULL);
+        }
+
+        const size_t b = MAX(g, offset);
+        const size_t e = MIN(g + group_size, offset + size);
+
+        ggml_unpack_q4_0(type, tmp, dst, nrows, tensor->ne[0]);
+        memcpy((char *)tmp + (b - g), (const char *)data + (b - offset), e - b);
+        ggml_repack_q4_0(type, dst, tmp, nrows, tensor->ne[0]);
+    }
+
+    free(tmp);
+
+    GGML_UNUSED(buffer);
+}
+
+GGML_CALL static void ggml_backend_cpu_repack_buffer_get_tensor(ggml_backend_buffer_t buffer, const struct ggml_tensor * tensor, void * data, size_t offset, size_t size) {
+    if (tensor->extra == NULL) {
+        memcpy(data, (const char *)tensor->data + offset, size);
+        return;
+    }
+
+    const enum ggml_type type       = (enum ggml_type)(intptr_t) tensor->extra;
+    const int64_t        nrows      = ggml_internal_get_type_traits(type).ncols;
+    const size_t         group_size = nrows*tensor->nb[1];
+
+    void * tmp = NULL;
+
+    for (size_t g = offset/group_size*group_size; g < offset + size; g += group_size) {
+        const char * src = (const char *)tensor->data + g;
+
+        if (g >= offset && g + group_size <= offset + size) {
+            ggml_unpack_q4_0(type, (char *)data + (g - offset), src, nrows, tensor->ne[0]);
+            continue;
+        }
+
+        if (tmp == NULL) {
+            tmp = malloc(group_size);
+            GGML_ASSERT(tmp != NULL);
+        }
+
+        const size_t b = MAX(g, offset);
+        const size_t e = MIN(g + group_size, offset + size);
+
+        ggml_unpack_q4_0(type, tmp, src, nrows, tensor->ne[0]);
+        memcpy((char *)data + (b - offset), (const char *)tmp + (b - g), e - b);
+    }
+
+    free(tmp);
+
+    GGML_UNUSED(buffer);
+}
+
+GGML_CALL static bool ggml_backend_cpu_repack_buffer_cpy_tensor(ggml_backend_buffer_t buffer, const struct ggml_tensor * src, struct ggml_tensor * dst) {
+    if (ggml_backend_buffer_is_host(src->buffer)) {
+        ggml_backend_cpu_repack_buffer_set_tensor(buffer, dst, src->data, 0, ggml_nbytes(src));
+        return true;
+    }
+    return false;
+}
+
+static struct ggml_backend_buffer_i cpu_repack_backend_buffer_i = {
+    /* .get_name        = */ ggml_backend_cpu_buffer_name,
+    /* .free_buffer     = */ ggml_backend_cpu_buffer_free_buffer,
+    /* .get_base        = */ ggml_backend_cpu_buffer_get_base,
+    /* .init_tensor     = */ ggml_backend_cpu_repack_buffer_init_tensor,
+    /* .set_tensor      = */ ggml_backend_cpu_repack_buffer_set_tensor,
+    /* .get_tensor      = */ ggml_backend_cpu_repack_buffer_get_tensor,
+    /* .cpy_tensor      = */ ggml_backend_cpu_repack_buffer_cpy_tensor,
+    /* .clear           = */ ggml_backend_cpu_buffer_clear,
+    /* .reset           = */ NULL,
+};
+
+enum ggml_type ggml_backend_cpu_repack_type(const struct ggml_tensor * tensor) {
+    ggml_backend_buffer_t buffer = tensor->buffer;
+
+    if (tensor->extra == NULL || buffer == NULL || buffer->iface.init_tensor != ggml_backend_cpu_repack_buffer_init_tensor) {
+        return tensor->type;
+    }
+
+    return (enum ggml_type)(intptr_t) tensor->extra;
+}
+
+// the data of the tensor, or of the tensor it is a view of, is repacked
+static bool ggml_backend_cpu_is_repacked(const struct ggml_tensor * tensor) {
+    if (tensor->view_src != NULL) {
+        tensor = tensor->view_src;
+    }
+    return ggml_backend_cpu_repack_type(tensor) != tensor->type;
+}
+
+bool ggml_backend_cpu_repack_supports_op(const struct ggml_tensor * op) {
+    if (ggml_backend_cpu_is_repacked(op)) {
+        return false;
+    }
+
+    for (int i = 0; i < GGML_MAX_SRC; i++) {
+        const struct ggml_tensor * src = op->src[i];
+        if (src == NULL || !ggml_backend_cpu_is_repacked(src)) {
+            continue;
+        }
+        if (op->op != GGML_OP_MUL_MAT || i != 0 || src->view_src != NULL) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+GGML_CALL static const char * ggml_backend_cpu_repack_buffer_type_get_name(ggml_backend_buffer_type_t buft) {
+    return "CPU_REPACK";
+
+    GGML_UNUSED(buft);
+}
+
+GGML_CALL static ggml_backend_buffer_t ggml_backend_cpu_repack_buffer_type_alloc_buffer(ggml_backend_buffer_type_t buft, size_t size) {
+    ggml_backend_buffer_t buffer = ggml_backend_cpu_buffer_type_alloc_buffer(buft, size);
+    if (buffer != NULL) {
+        buffer->iface = cpu_repack_backend_buffer_i;
+    }
+    return buffer;
+}
+
+GGML_CALL static bool ggml_backend_cpu_repack_buffer_type_is_host(ggml_backend_buffer_type_t buft) {
+    // the data of the repacked tensors is not in the layout of their type
+    return ggml_repack_q4_0_type() == GGML_TYPE_Q4_0;
+
+    GGML_UNUSED(buft);
+}
+
+GGML_CALL ggml_backend_buffer_type_t ggml_backend_cpu_repack_buffer_type(void) {
+    static struct ggml_backend_buffer_type ggml_backend_cpu_repack_buffer_type = {
+        /* .iface    = */ {
+            /* .get_name         = */ ggml_backend_cpu_repack_buffer_type_get_name,
+            /* .alloc_buffer     = */ ggml_backend_cpu_repack_buffer_type_alloc_buffer,
+            /* .get_alignment    = */ ggml_backend_cpu_buffer_type_get_alignment,
+            /* .get_max_size     = */ NULL, // defaults to SIZE_MAX
+            /* .get_alloc_size   = */ NULL, // defaults to ggml_nbytes
+            /* .is_host          = */ ggml_backend_cpu_repack_buffer_type_is_host,
+        },
+        /* .context  = */ NULL,
+    };
+
+    return &ggml_backend_cpu_repack_buffer_type;
+}
+
+// a threadpool created by the backend, it is freed when it has been replaced (e.g. the number of threads changed)
+// and the plans created with it have been freed
+struct ggml_backend_cpu_threadpool {
+    ggml_threadpool_t threadpool;
+    int               n_refs; // the backend while it uses the threadpool, and each plan created with it
+};
+
+static void ggml_backend_cpu_threadpool_release(struct ggml_backend_cpu_threadpool * tp) {
+    if (tp != NULL && --tp->n_refs == 0) {
+        ggml_threadpool_free(tp->threadpool);
+        free(tp);
+    }
+}
+
 struct ggml_backend_cpu_context {
-    int n_threads;
+    int                 n_threads;
+    ggml_threadpool_t   threadpool;       // set by the user with ggml_backend_cpu_set_threadpool
+    struct ggml_backend_cpu_threadpool * threadpool_owned; // created on demand when the user did not provide one
+
+    enum ggml_graph_exec_mode exec_mode;
+
     void * work_data;
     size_t work_size;
 
     ggml_abort_callback abort_callback;
     void *              abort_callback_data;
+
+    // async mode (see ggml_backend_cpu_set_async)
+    bool              async;
+    struct ggml_cplan async_cplan;   // plan of the graph in flight
+    ggml_threadpool_t async_pending; // threadpool computing the graph in flight, NULL if none
+    enum ggml_status  async_status;  // first failure of the async graphs, returned by the next compute
+    uint64_t          n_graphs;      // number of graphs submitted, used by the events
 };
 
 GGML_CALL static const char * ggml_backend_cpu_name(ggml_backend_t backend) {
@@ -736,8 +1197,38 @@ GGML_CALL static const char * ggml_backend_cpu_name(ggml_backend_t backend) {
     GGML_UNUSED(backend);
 }
 
+// waits for the graph in flight, if any
+// its status is kept until the next compute: the threadpool may be shared, and ggml_threadpool_wait returns the
+// status of its last graph, which may belong to another backend
+GGML_CALL static void ggml_backend_cpu_synchronize(ggml_backend_t backend) {
+    struct ggml_backend_cpu_context * cpu_ctx = (struct ggml_backend_cpu_context *)backend->context;
+
+    if (cpu_ctx->async_pending != NULL) {
+        ggml_threadpool_wait(cpu_ctx->async_pending);
+        cpu_ctx->async_pending = NULL;
+
+        if (cpu_ctx->async_status == GGML_STATUS_SUCCESS) {
+            cpu_ctx->async_status = cpu_ctx->async_cplan.async_status;
+        }
+    }
+}
+
+// waits for the graph in flight and returns the first failure of the async graphs since the last call
+static enum ggml_status ggml_backend_cpu_async_status(ggml_backend_t backend) {
+    struct ggml_backend_cpu_context * cpu_ctx = (struct ggml_backend_cpu_context *)backend->context;
+
+    ggml_backend_cpu_synchronize(backend);
+
+    const enum ggml_status status = cpu_ctx->async_status;
+    cpu_ctx->async_status = GGML_STATUS_SUCCESS;
+
+    return status;
+}
+
 GGML_CALL static void ggml_backend_cpu_free(ggml_backend_t backend) {
     struct ggml_backend_cpu_context * cpu_ctx = (struct ggml_backend_cpu_context *)backend->context;
+    ggml_backend_cpu_synchronize(backend);
+    ggml_backend_cpu_threadpool_release(cpu_ctx->threadpool_owned);
     free(cpu_ctx->work_data);
     free(cpu_ctx);
     free(backend);
@@ -749,9 +1240,40 @@ GGML_CALL static ggml_backend_buffer_type_t ggml_backend_cpu_get_default_buffer_
     GGML_UNUSED(backend);
 }
 
+// returns the threadpool used for the graphs of this backend
+// the threads of the owned threadpool are kept alive between graphs, so that
+// evaluating many small graphs in a row does not pay the thread creation cost
+static ggml_threadpool_t ggml_backend_cpu_get_threadpool(ggml_backend_t backend) {
+    struct ggml_backend_cpu_context * cpu_ctx = (struct ggml_backend_cpu_context *)backend->context;
+
+    if (cpu_ctx->threadpool != NULL) {
+        return cpu_ctx->threadpool;
+    }
+
+    if (cpu_ctx->threadpool_owned != NULL && ggml_threadpool_get_n_threads(cpu_ctx->threadpool_owned->threadpool) != cpu_ctx->n_threads) {
+        // the graph in flight may be computed by the previous threadpool,
+        // the plans created with it keep it alive
+        ggml_backend_cpu_synchronize(backend);
+        ggml_backend_cpu_threadpool_release(cpu_ctx->threadpool_owned);
+        cpu_ctx->threadpool_owned = NULL;
+    }
+
+    if (cpu_ctx->threadpool_owned == NULL) {
+        struct ggml_threadpool_params tpp = ggml_threadpool_params_default(cpu_ctx->n_threads);
+        cpu_ctx->threadpool_owned = malloc(sizeof(struct ggml_backend_cpu_threadpool));
+        GGML_ASSERT(cpu_ctx->threadpool_owned != NULL);
+        cpu_ctx->threadpool_owned->threadpool = ggml_threadpool_new(&tpp);
+        cpu_ctx->threadpool_owned->n_refs     = 1;
+    }
+
+    return cpu_ctx->threadpool_owned->threadpool;
+}
+
 struct ggml_backend_plan_cpu {
     struct ggml_cplan cplan;
     struct ggml_cgraph cgraph;
+    struct ggml_graph_capture * capture;
+    struct ggml_backend_cpu_threadpool * threadpool_owned; // the owned threadpool of cplan, if any
 };
 
 GGML_CALL static ggml_backend_graph_plan_t ggml_backend_cpu_graph_plan_create(ggml_backend_t backend, const struct ggml_cgraph * cgraph) {
@@ -759,27 +1281,41 @@ GGML_CALL static ggml_backend_graph_plan_t ggml_backend_cpu_graph_plan_create(gg
 
     struct ggml_backend_plan_cpu * cpu_plan = malloc(sizeof(struct ggml_backend_plan_cpu));
 
-    cpu_plan->cplan = ggml_graph_plan(cgraph, cpu_ctx->n_threads);
+    cpu_plan->cplan = ggml_graph_plan(cgraph, cpu_ctx->n_threads, ggml_backend_cpu_get_threadpool(backend));
     cpu_plan->cgraph = *cgraph; // FIXME: deep copy
 
+    // the backend may replace its threadpool while the plan still uses it
+    cpu_plan->threadpool_owned = NULL;
+    if (cpu_ctx->threadpool == NULL) {
+        cpu_plan->threadpool_owned = cpu_ctx->threadpool_owned;
+        cpu_plan->threadpool_owned->n_refs++;
+    }
+
     if (cpu_plan->cplan.work_size > 0) {
         cpu_plan->cplan.work_data = malloc(cpu_plan->cplan.work_size);
         if (cpu_plan->cplan.work_data == NULL) {
+            ggml_backend_cpu_threadpool_release(cpu_plan->threadpool_owned);
             free(cpu_plan);
             return NULL;
         }
     }
 
+    cpu_plan->cplan.exec_mode           = cpu_ctx->exec_mode;
     cpu_plan->cplan.abort_callback      = cpu_ctx->abort_callback;
     cpu_plan->cplan.abort_callback_data = cpu_ctx->abort_callback_data;
 
+    // the plan is computed many times, build the schedule of the graph once
+    cpu_plan->capture = ggml_graph_capture_new(&cpu_plan->cgraph, &cpu_plan->cplan);
+
     return cpu_plan;
 }
 
 GGML_CALL static void ggml_backend_cpu_graph_plan_free(ggml_backend_t backend, ggml_backend_graph_plan_t plan) {
     struct ggml_backend_plan_cpu * cpu_plan = (struct ggml_backend_plan_cpu *)plan;
 
+    ggml_graph_capture_free(cpu_plan->capture);
     free(cpu_plan->cplan.work_data);
+    ggml_backend_cpu_threadpool_release(cpu_plan->threadpool_owned);
     free(cpu_plan);
 
     GGML_UNUSED(backend);
@@ -788,15 +1324,24 @@ GGML_CALL static void ggml_backend_cpu_graph_plan_free(ggml_backend_t backend, g
 GGML_CALL static enum ggml_status ggml_backend_cpu_graph_plan_compute(ggml_backend_t backend, ggml_backend_graph_plan_t plan) {
     struct ggml_backend_plan_cpu * cpu_plan = (struct ggml_backend_plan_cpu *)plan;
 
-    return ggml_graph_compute(&cpu_plan->cgraph, &cpu_plan->cplan);
+    const enum ggml_status status = ggml_backend_cpu_async_status(backend);
+    if (status != GGML_STATUS_SUCCESS) {
+        return status;
+    }
 
-    GGML_UNUSED(backend);
+    return ggml_graph_capture_compute(cpu_plan->capture);
 }
 
 GGML_CALL static enum ggml_status ggml_backend_cpu_graph_compute(ggml_backend_t backend, struct ggml_cgraph * cgraph) {
     struct ggml_backend_cpu_context * cpu_ctx = (struct ggml_backend_cpu_context *)backend->context;
 
-    struct ggml_cplan cplan = ggml_graph_plan(cgraph, cpu_ctx->n_threads);
+    // the previous graph may still be using the work buffer and the threadpool
+    const enum ggml_status status = ggml_backend_cpu_async_status(backend);
+    if (status != GGML_STATUS_SUCCESS) {
+        return status;
+    }
+
+    struct ggml_cplan cplan = ggml_graph_plan(cgraph, cpu_ctx->n_threads, ggml_backend_cpu_get_threadpool(backend));
 
     if (cpu_ctx->work_size < cplan.work_size) {
         free(cpu_ctx->work_data);
@@ -808,14 +1353,29 @@ GGML_CALL static enum ggml_status ggml_backend_cpu_graph_compute(ggml_backend_t
         cpu_ctx->work_size = cplan.work_size;
     }
     cplan.work_data = cpu_ctx->work_data;
+    cplan.exec_mode = cpu_ctx->exec_mode;
 
     cplan.abort_callback      = cpu_ctx->abort_callback;
     cplan.abort_callback_data = cpu_ctx->abort_callback_data;
 
+    cpu_ctx->n_graphs++;
+
+    if (cpu_ctx->async) {
+        // the status of the graph is returned by the next compute, see ggml_backend_cpu_synchronize
+        cpu_ctx->async_cplan   = cplan;
+        cpu_ctx->async_pending = cplan.threadpool;
+        ggml_graph_compute_async(cgraph, &cpu_ctx->async_cplan);
+        return GGML_STATUS_SUCCESS;
+    }
+
     return ggml_graph_compute(cgraph, &cplan);
 }
 
 GGML_CALL static bool ggml_backend_cpu_supports_op(ggml_backend_t backend, const struct ggml_tensor * op) {
+    if (!ggml_backend_cpu_repack_supports_op(op)) {
+        return false;
+    }
+
     switch (op->op) {
         case GGML_OP_CPY:
             return
@@ -833,7 +1393,56 @@ GGML_CALL static bool ggml_backend_cpu_supports_op(ggml_backend_t backend, const
 }
 
 GGML_CALL static bool ggml_backend_cpu_supports_buft(ggml_backend_t backend, ggml_backend_buffer_type_t buft) {
-    return ggml_backend_buft_is_host(buft);
+    return ggml_backend_buft_is_host(buft) || buft == ggml_backend_cpu_repack_buffer_type();
+
+    GGML_UNUSED(backend);
+}
+
+// events
+// an event records the number of graphs submitted to the backend, since at most one graph is in flight
+// the event is complete unless it was recorded after the graph in flight was submitted
+
+GGML_CALL static ggml_backend_event_t ggml_backend_cpu_event_new(ggml_backend_t backend) {
+    uint64_t * n_graphs = malloc(sizeof(uint64_t));
+    if (n_graphs == NULL) {
+        return NULL;
+    }
+    *n_graphs = 0;
+
+    ggml_backend_event_t event = malloc(sizeof(struct ggml_backend_event));
+    if (event == NULL) {
+        free(n_graphs);
+        return NULL;
+    }
+
+    event->backend = backend;
+    event->context = n_graphs;
+
+    return event;
+}
+
+GGML_CALL static void ggml_backend_cpu_event_free(ggml_backend_event_t event) {
+    free(event->context);
+    free(event);
+}
+
+GGML_CALL static void ggml_backend_cpu_event_record(ggml_backend_event_t event) {
+    struct ggml_backend_cpu_context * cpu_ctx = (struct ggml_backend_cpu_context *)event->backend->context;
+
+    *(uint64_t *)event->context = cpu_ctx->n_graphs;
+}
+
+GGML_CALL static void ggml_backend_cpu_event_synchronize(ggml_backend_event_t event) {
+    struct ggml_backend_cpu_context * cpu_ctx = (struct ggml_backend_cpu_context *)event->backend->context;
+
+    if (*(uint64_t *)event->context == cpu_ctx->n_graphs) {
+        ggml_backend_cpu_synchronize(event->backend);
+    }
+}
+
+GGML_CALL static void ggml_backend_cpu_event_wait(ggml_backend_t backend, ggml_backend_event_t event) {
+    // the graphs of the CPU backend are submitted from the calling thread, so waiting is blocking
+    ggml_backend_event_synchronize(event);
 
     GGML_UNUSED(backend);
 }
@@ -845,7 +1454,7 @@ static struct ggml_backend_i cpu_backend_i = {
     /* .set_tensor_async        = */ NULL,
     /* .get_tensor_async        = */ NULL,
     /* .cpy_tensor_async        = */ NULL,
-    /* .synchronize             = */ NULL,
+    /* .synchronize             = */ ggml_backend_cpu_synchronize,
     /* .graph_plan_create       = */ ggml_backend_cpu_graph_plan_create,
     /* .graph_plan_free         = */ ggml_backend_cpu_graph_plan_free,
     /* .graph_plan_update       = */ NULL,
@@ -854,11 +1463,11 @@ static struct ggml_backend_i cpu_backend_i = {
     /* .supports_op             = */ ggml_backend_cpu_supports_op,
     /* .supports_buft           = */ ggml_backend_cpu_supports_buft,
     /* .offload_op              = */ NULL,
-    /* .event_new               = */ NULL,
-    /* .event_free              = */ NULL,
-    /* .event_record            = */ NULL,
-    /* .event_wait              = */ NULL,
-    /* .event_synchronize       = */ NULL,
+    /* .event_new               = */ ggml_backend_cpu_event_new,
+    /* .event_free              = */ ggml_backend_cpu_event_free,
+    /* .event_record            = */ ggml_backend_cpu_event_record,
+    /* .event_wait              = */ ggml_backend_cpu_event_wait,
+    /* .event_synchronize       = */ ggml_backend_cpu_event_synchronize,
 };
 
 static ggml_guid_t ggml_backend_cpu_guid(void) {
@@ -873,10 +1482,17 @@ ggml_backend_t ggml_backend_cpu_init(void) {
     }
 
     ctx->n_threads           = GGML_DEFAULT_N_THREADS;
+    ctx->threadpool          = NULL;
+    ctx->threadpool_owned    = NULL;
+    ctx->exec_mode           = GGML_GRAPH_EXEC_MODE_SEQUENTIAL;
     ctx->work_data           = NULL;
     ctx->work_size           = 0;
     ctx->abort_callback      = NULL;
     ctx->abort_callback_data = NULL;
+    ctx->async               = false;
+    ctx->async_pending       = NULL;
+    ctx->async_status        = GGML_STATUS_SUCCESS;
+    ctx->n_graphs            = 0;
 
     ggml_backend_t cpu_backend = malloc(sizeof(struct ggml_backend));
     if (cpu_backend == NULL) {
@@ -903,6 +1519,36 @@ void ggml_backend_cpu_set_n_threads(ggml_backend_t backend_cpu, int n_threads) {
     ctx->n_threads = n_threads;
 }
 
+void ggml_backend_cpu_set_threadpool(ggml_backend_t backend_cpu, ggml_threadpool_t threadpool) {
+    GGML_ASSERT(ggml_backend_is_cpu(backend_cpu));
+
+    struct ggml_backend_cpu_context * ctx = (struct ggml_backend_cpu_context *)backend_cpu->context;
+
+    ggml_backend_cpu_synchronize(backend_cpu);
+
+    if (ctx->threadpool && ctx->threadpool != threadpool) {
+        // already had a different threadpool, pause/suspend it before switching
+        ggml_threadpool_pause(ctx->threadpool);
+    }
+    ctx->threadpool = threadpool;
+}
+
+void ggml_backend_cpu_set_exec_mode(ggml_backend_t backend_cpu, enum ggml_graph_exec_mode exec_mode) {
+    GGML_ASSERT(ggml_backend_is_cpu(backend_cpu));
+
+    struct ggml_backend_cpu_context * ctx = (struct ggml_backend_cpu_context *)backend_cpu->context;
+    ctx->exec_mode = exec_mode;
+}
+
+void ggml_backend_cpu_set_async(ggml_backend_t backend_cpu, bool async) {
+    GGML_ASSERT(ggml_backend_is_cpu(backend_cpu));
+
+    struct ggml_backend_cpu_context * ctx = (struct ggml_backend_cpu_context *)backend_cpu->context;
+
+    ggml_backend_cpu_synchronize(backend_cpu);
+    ctx->async = async;
+}
+
 void ggml_backend_cpu_set_abort_callback(ggml_backend_t backend_cpu, ggml_abort_callback abort_callback, void * abort_callback_data) {
     GGML_ASSERT(ggml_backend_is_cpu(backend_cpu));
 
@@ -1080,6 +1726,8 @@ struct ggml_backend_sched {
     char * context_buffer;
     size_t context_buffer_size;
 
+    bool reorder; // see ggml_backend_sched_set_reorder
+
     bool debug;
 };
 
@@ -1479,6 +2127,14 @@ static void ggml_backend_sched_split_graph(ggml_backend_sched_t sched, struct gg
         }
     }
 
+    // optional: reorder the nodes to reduce the size of the compute buffers, keeping the nodes of a backend together
+    if (sched->reorder) {
+        for (int i = 0; i < graph->n_nodes; i++) {
+            sched->node_backend_ids[i] = tensor_backend_id(graph->nodes[i]);
+        }
+        ggml_graph_reorder_for_memory(graph, sched->node_backend_ids);
+    }
+
     // pass 5: split graph, find tensors that need to be copied
     {
         int i_split = 0;
@@ -1985,6 +2641,10 @@ void ggml_backend_sched_synchronize(ggml_backend_sched_t sched) {
     }
 }
 
+void ggml_backend_sched_set_reorder(ggml_backend_sched_t sched, bool reorder) {
+    sched->reorder = reorder;
+}
+
 void ggml_backend_sched_set_eval_callback(ggml_backend_sched_t sched, ggml_backend_sched_eval_callback callback, void * user_data) {
     sched->callback_eval = callback;
     sched->callback_eval_user_data = user_data;
@@ -203,6 +203,16 @@ typedef struct {
 } block_q8_1;
 static_assert(sizeof(block_q8_1) == 2*sizeof(ggml_half) + QK8_1, "wrong q8_1 block size/padding");
 
+// FP8: x = d * fp8 with E4M3 (4 bits of exponent, 3 of mantissa, max 448, no infinities) or E5M2 (the upper
+// byte of a fp16) values
+// a checkpoint with a scale per tensor (or per block of a multiple of 32) has the same d in all the blocks
+#define QK_F8 32
+typedef struct {
+    ggml_half d;       // scale
+    uint8_t qs[QK_F8]; // fp8 values
+} block_f8;
+static_assert(sizeof(block_f8) == sizeof(ggml_half) + QK_F8, "wrong f8 block size/padding");
+
 typedef struct {
     ggml_half d[4];        // deltas for 4 q4_0 blocks
     uint8_t qs[QK4_0 * 2]; // nibbles / quants for 4 q4_0 blocks
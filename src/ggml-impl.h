@@ -748,6 +748,27 @@ static size_t ggml_hash_find_or_insert(struct ggml_hash_set * hash_set, struct g
     GGML_ABORT("fatal error");
 }
 
+// NUMA
+
+#define GGML_NUMA_MAX_NODES 8
+
+// number of NUMA nodes found by ggml_numa_init(), 0 if it was not called
+uint32_t ggml_numa_n_nodes(void);
+
+// copy of the data of a tensor of a replicated NUMA CPU buffer on the given node
+// returns NULL if the tensor is not replicated (see ggml_backend_cpu_numa_buffer_type)
+void * ggml_backend_cpu_numa_replica(const struct ggml_tensor * tensor, int node);
+
+// CPU repacking
+
+// type of the data of a tensor for the CPU kernels: the interleaved type its rows were repacked to by
+// ggml_backend_cpu_repack_buffer_type, the type of the tensor otherwise
+enum ggml_type ggml_backend_cpu_repack_type(const struct ggml_tensor * tensor);
+
+// the repacked tensors are only read by mul_mat as its src0, the other ops (and the views) would read the interleaved
+// blocks as regular blocks: false if op reads or writes a repacked tensor in any other way
+bool ggml_backend_cpu_repack_supports_op(const struct ggml_tensor * op);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,242 @@
+// a CPU variant of the kernels in ggml-quants.c
+//
+// with GGML_CPU_VARIANTS this file is compiled once per instruction set, with GGML_CPU_VARIANT set to the name
+// of the variant (avx2, avx512, ...) and the matching -m flags; ggml_init selects the best variant the CPU
+// supports and replaces the kernels of the quantized types in the type traits
+//
+// every external symbol of ggml-quants.c gets the name of the variant appended so the copies do not collide,
+// a function added to ggml-quants.c without a rename below shows up as a duplicate symbol at link time
+
+#if !defined(GGML_CPU_VARIANT)
+#error "GGML_CPU_VARIANT must be defined"
+#endif
+
+#define GGML_VARIANT_NAME_IMPL(name, variant) name ## _ ## variant
+#define GGML_VARIANT_NAME_EXPAND(name, variant) GGML_VARIANT_NAME_IMPL(name, variant)
+#define GGML_VARIANT_NAME(name) GGML_VARIANT_NAME_EXPAND(name, GGML_CPU_VARIANT)
+
+#define quantize_row_q4_0_ref     GGML_VARIANT_NAME(quantize_row_q4_0_ref)
+#define quantize_row_q4_1_ref     GGML_VARIANT_NAME(quantize_row_q4_1_ref)
+#define quantize_row_q5_0_ref     GGML_VARIANT_NAME(quantize_row_q5_0_ref)
+#define quantize_row_q5_1_ref     GGML_VARIANT_NAME(quantize_row_q5_1_ref)
+#define quantize_row_q8_0_ref     GGML_VARIANT_NAME(quantize_row_q8_0_ref)
+#define quantize_row_q8_1_ref     GGML_VARIANT_NAME(quantize_row_q8_1_ref)
+#define quantize_row_q2_K_ref     GGML_VARIANT_NAME(quantize_row_q2_K_ref)
+#define quantize_row_q3_K_ref     GGML_VARIANT_NAME(quantize_row_q3_K_ref)
+#define quantize_row_q4_K_ref     GGML_VARIANT_NAME(quantize_row_q4_K_ref)
+#define quantize_row_q5_K_ref     GGML_VARIANT_NAME(quantize_row_q5_K_ref)
+#define quantize_row_q6_K_ref     GGML_VARIANT_NAME(quantize_row_q6_K_ref)
+#define quantize_row_q8_K_ref     GGML_VARIANT_NAME(quantize_row_q8_K_ref)
+#define quantize_row_iq3_xxs_ref  GGML_VARIANT_NAME(quantize_row_iq3_xxs_ref)
+#define quantize_row_q4_0         GGML_VARIANT_NAME(quantize_row_q4_0)
+#define quantize_row_q4_1         GGML_VARIANT_NAME(quantize_row_q4_1)
+#define quantize_row_q5_0         GGML_VARIANT_NAME(quantize_row_q5_0)
+#define quantize_row_q5_1         GGML_VARIANT_NAME(quantize_row_q5_1)
+#define quantize_row_q8_0         GGML_VARIANT_NAME(quantize_row_q8_0)
+#define quantize_row_q8_1         GGML_VARIANT_NAME(quantize_row_q8_1)
+#define quantize_row_q2_K         GGML_VARIANT_NAME(quantize_row_q2_K)
+#define quantize_row_q3_K         GGML_VARIANT_NAME(quantize_row_q3_K)
+#define quantize_row_q4_K         GGML_VARIANT_NAME(quantize_row_q4_K)
+#define quantize_row_q5_K         GGML_VARIANT_NAME(quantize_row_q5_K)
+#define quantize_row_q6_K         GGML_VARIANT_NAME(quantize_row_q6_K)
+#define quantize_row_q8_K         GGML_VARIANT_NAME(quantize_row_q8_K)
+#define quantize_row_iq3_xxs      GGML_VARIANT_NAME(quantize_row_iq3_xxs)
+#define dequantize_row_q4_0       GGML_VARIANT_NAME(dequantize_row_q4_0)
+#define dequantize_row_q4_1       GGML_VARIANT_NAME(dequantize_row_q4_1)
+#define dequantize_row_q5_0       GGML_VARIANT_NAME(dequantize_row_q5_0)
+#define dequantize_row_q5_1       GGML_VARIANT_NAME(dequantize_row_q5_1)
+#define dequantize_row_q8_0       GGML_VARIANT_NAME(dequantize_row_q8_0)
+#define dequantize_row_q2_K       GGML_VARIANT_NAME(dequantize_row_q2_K)
+#define dequantize_row_q3_K       GGML_VARIANT_NAME(dequantize_row_q3_K)
+#define dequantize_row_q4_K       GGML_VARIANT_NAME(dequantize_row_q4_K)
+#define dequantize_row_q5_K       GGML_VARIANT_NAME(dequantize_row_q5_K)
+#define dequantize_row_q6_K       GGML_VARIANT_NAME(dequantize_row_q6_K)
+#define dequantize_row_q8_K       GGML_VARIANT_NAME(dequantize_row_q8_K)
+#define dequantize_row_iq2_xxs    GGML_VARIANT_NAME(dequantize_row_iq2_xxs)
+#define dequantize_row_iq3_xxs    GGML_VARIANT_NAME(dequantize_row_iq3_xxs)
+#define ggml_vec_dot_q4_0_q8_0    GGML_VARIANT_NAME(ggml_vec_dot_q4_0_q8_0)
+#define ggml_vec_dot_q4_1_q8_1    GGML_VARIANT_NAME(ggml_vec_dot_q4_1_q8_1)
+#define ggml_vec_dot_q5_0_q8_0    GGML_VARIANT_NAME(ggml_vec_dot_q5_0_q8_0)
+#define ggml_vec_dot_q5_1_q8_1    GGML_VARIANT_NAME(ggml_vec_dot_q5_1_q8_1)
+#define ggml_vec_dot_q8_0_q8_0    GGML_VARIANT_NAME(ggml_vec_dot_q8_0_q8_0)
+#define ggml_vec_dot_q4_0_q8_0_cols GGML_VARIANT_NAME(ggml_vec_dot_q4_0_q8_0_cols)
+#define ggml_vec_dot_q8_0_q8_0_cols GGML_VARIANT_NAME(ggml_vec_dot_q8_0_q8_0_cols)
+#define ggml_vec_dot_q2_K_q8_K    GGML_VARIANT_NAME(ggml_vec_dot_q2_K_q8_K)
+#define ggml_vec_dot_q3_K_q8_K    GGML_VARIANT_NAME(ggml_vec_dot_q3_K_q8_K)
+#define ggml_vec_dot_q4_K_q8_K    GGML_VARIANT_NAME(ggml_vec_dot_q4_K_q8_K)
+#define ggml_vec_dot_q5_K_q8_K    GGML_VARIANT_NAME(ggml_vec_dot_q5_K_q8_K)
+#define ggml_vec_dot_q6_K_q8_K    GGML_VARIANT_NAME(ggml_vec_dot_q6_K_q8_K)
+#define ggml_vec_dot_iq2_xxs_q8_K GGML_VARIANT_NAME(ggml_vec_dot_iq2_xxs_q8_K)
+#define ggml_vec_dot_iq3_xxs_q8_K GGML_VARIANT_NAME(ggml_vec_dot_iq3_xxs_q8_K)
+#define ggml_vec_dot_iq1_s_q8_K   GGML_VARIANT_NAME(ggml_vec_dot_iq1_s_q8_K)
+#define ggml_vec_dot_iq1_m_q8_K   GGML_VARIANT_NAME(ggml_vec_dot_iq1_m_q8_K)
+#define ggml_vec_dot_iq3_s_q8_K   GGML_VARIANT_NAME(ggml_vec_dot_iq3_s_q8_K)
+#define quantize_iq2_xxs          GGML_VARIANT_NAME(quantize_iq2_xxs)
+#define quantize_iq3_xxs          GGML_VARIANT_NAME(quantize_iq3_xxs)
+#define quantize_q2_K             GGML_VARIANT_NAME(quantize_q2_K)
+#define quantize_q3_K             GGML_VARIANT_NAME(quantize_q3_K)
+#define quantize_q4_K             GGML_VARIANT_NAME(quantize_q4_K)
+#define quantize_q5_K             GGML_VARIANT_NAME(quantize_q5_K)
+#define quantize_q6_K             GGML_VARIANT_NAME(quantize_q6_K)
+#define quantize_q4_0             GGML_VARIANT_NAME(quantize_q4_0)
+#define quantize_q4_1             GGML_VARIANT_NAME(quantize_q4_1)
+#define quantize_q5_0             GGML_VARIANT_NAME(quantize_q5_0)
+#define quantize_q5_1             GGML_VARIANT_NAME(quantize_q5_1)
+#define quantize_q8_0             GGML_VARIANT_NAME(quantize_q8_0)
+#define iq2xs_init_impl           GGML_VARIANT_NAME(iq2xs_init_impl)
+#define iq2xs_free_impl           GGML_VARIANT_NAME(iq2xs_free_impl)
+#define iq3xs_init_impl           GGML_VARIANT_NAME(iq3xs_init_impl)
+#define iq3xs_free_impl           GGML_VARIANT_NAME(iq3xs_free_impl)
+#define dequantize_row_iq2_xs     GGML_VARIANT_NAME(dequantize_row_iq2_xs)
+#define dequantize_row_iq2_s      GGML_VARIANT_NAME(dequantize_row_iq2_s)
+#define quantize_row_iq2_s        GGML_VARIANT_NAME(quantize_row_iq2_s)
+#define dequantize_row_iq3_s      GGML_VARIANT_NAME(dequantize_row_iq3_s)
+#define quantize_row_iq3_s        GGML_VARIANT_NAME(quantize_row_iq3_s)
+#define dequantize_row_iq1_s      GGML_VARIANT_NAME(dequantize_row_iq1_s)
+#define dequantize_row_iq1_m      GGML_VARIANT_NAME(dequantize_row_iq1_m)
+#define dequantize_row_iq4_nl     GGML_VARIANT_NAME(dequantize_row_iq4_nl)
+#define quantize_row_iq4_nl       GGML_VARIANT_NAME(quantize_row_iq4_nl)
+#define dequantize_row_iq4_xs     GGML_VARIANT_NAME(dequantize_row_iq4_xs)
+#define quantize_row_iq4_xs       GGML_VARIANT_NAME(quantize_row_iq4_xs)
+#define ggml_vec_dot_iq2_xs_q8_K  GGML_VARIANT_NAME(ggml_vec_dot_iq2_xs_q8_K)
+#define ggml_vec_dot_iq2_s_q8_K   GGML_VARIANT_NAME(ggml_vec_dot_iq2_s_q8_K)
+#define ggml_vec_dot_iq4_nl_q8_0  GGML_VARIANT_NAME(ggml_vec_dot_iq4_nl_q8_0)
+#define ggml_vec_dot_iq4_xs_q8_K  GGML_VARIANT_NAME(ggml_vec_dot_iq4_xs_q8_K)
+#define quantize_iq2_xs           GGML_VARIANT_NAME(quantize_iq2_xs)
+#define quantize_iq3_s            GGML_VARIANT_NAME(quantize_iq3_s)
+#define quantize_row_iq3_s_ref    GGML_VARIANT_NAME(quantize_row_iq3_s_ref)
+#define quantize_iq1_s            GGML_VARIANT_NAME(quantize_iq1_s)
+#define quantize_iq1_m            GGML_VARIANT_NAME(quantize_iq1_m)
+#define quantize_iq4_nl           GGML_VARIANT_NAME(quantize_iq4_nl)
+#define quantize_row_iq4_nl_ref   GGML_VARIANT_NAME(quantize_row_iq4_nl_ref)
+#define quantize_iq4_xs           GGML_VARIANT_NAME(quantize_iq4_xs)
+#define quantize_row_iq4_xs_ref   GGML_VARIANT_NAME(quantize_row_iq4_xs_ref)
+#define quantize_iq2_s            GGML_VARIANT_NAME(quantize_iq2_s)
+#define quantize_row_iq2_s_ref    GGML_VARIANT_NAME(quantize_row_iq2_s_ref)
+#define quantize_row_f8_e4m3_ref  GGML_VARIANT_NAME(quantize_row_f8_e4m3_ref)
+#define quantize_row_f8_e5m2_ref  GGML_VARIANT_NAME(quantize_row_f8_e5m2_ref)
+#define quantize_row_f8_e4m3      GGML_VARIANT_NAME(quantize_row_f8_e4m3)
+#define quantize_row_f8_e5m2      GGML_VARIANT_NAME(quantize_row_f8_e5m2)
+#define dequantize_row_f8_e4m3    GGML_VARIANT_NAME(dequantize_row_f8_e4m3)
+#define dequantize_row_f8_e5m2    GGML_VARIANT_NAME(dequantize_row_f8_e5m2)
+#define ggml_vec_dot_f8_e4m3_f16  GGML_VARIANT_NAME(ggml_vec_dot_f8_e4m3_f16)
+#define ggml_vec_dot_f8_e5m2_f16  GGML_VARIANT_NAME(ggml_vec_dot_f8_e5m2_f16)
+#define ggml_vec_dot_f8_e4m3_f16_cols GGML_VARIANT_NAME(ggml_vec_dot_f8_e4m3_f16_cols)
+#define ggml_vec_dot_f8_e5m2_f16_cols GGML_VARIANT_NAME(ggml_vec_dot_f8_e5m2_f16_cols)
+#define quantize_f8_e4m3          GGML_VARIANT_NAME(quantize_f8_e4m3)
+#define quantize_f8_e5m2          GGML_VARIANT_NAME(quantize_f8_e5m2)
+#define ggml_validate_row_data    GGML_VARIANT_NAME(ggml_validate_row_data)
+
+#include "ggml-quants.c"
+
+// the iq2/iq3 quantization functions need the grids of iq2xs_init_impl/iq3xs_init_impl, which are only
+// initialized for the copy in ggml-quants.c, so only their dot products and dequantization are replaced
+void GGML_VARIANT_NAME(ggml_quants_variant_init)(ggml_type_traits_t * traits) {
+#if defined(__AVX2__)
+    const int64_t nrows_k = 2;
+    const bool    vec_dot_cols = true;
+#else
+    const int64_t nrows_k = 1;
+    const bool    vec_dot_cols = false;
+#endif
+
+    traits[GGML_TYPE_Q4_0].to_float         = (ggml_to_float_t) dequantize_row_q4_0;
+    traits[GGML_TYPE_Q4_0].from_float       = quantize_row_q4_0;
+    traits[GGML_TYPE_Q4_0].from_float_ref   = (ggml_from_float_t) quantize_row_q4_0_ref;
+    traits[GGML_TYPE_Q4_0].vec_dot          = ggml_vec_dot_q4_0_q8_0;
+    traits[GGML_TYPE_Q4_0].vec_dot_cols     = vec_dot_cols ? ggml_vec_dot_q4_0_q8_0_cols : NULL;
+
+    traits[GGML_TYPE_Q4_1].to_float         = (ggml_to_float_t) dequantize_row_q4_1;
+    traits[GGML_TYPE_Q4_1].from_float       = quantize_row_q4_1;
+    traits[GGML_TYPE_Q4_1].from_float_ref   = (ggml_from_float_t) quantize_row_q4_1_ref;
+    traits[GGML_TYPE_Q4_1].vec_dot          = ggml_vec_dot_q4_1_q8_1;
+
+    traits[GGML_TYPE_Q5_0].to_float         = (ggml_to_float_t) dequantize_row_q5_0;
+    traits[GGML_TYPE_Q5_0].from_float       = quantize_row_q5_0;
+    traits[GGML_TYPE_Q5_0].from_float_ref   = (ggml_from_float_t) quantize_row_q5_0_ref;
+    traits[GGML_TYPE_Q5_0].vec_dot          = ggml_vec_dot_q5_0_q8_0;
+
+    traits[GGML_TYPE_Q5_1].to_float         = (ggml_to_float_t) dequantize_row_q5_1;
+    traits[GGML_TYPE_Q5_1].from_float       = quantize_row_q5_1;
+    traits[GGML_TYPE_Q5_1].from_float_ref   = (ggml_from_float_t) quantize_row_q5_1_ref;
+    traits[GGML_TYPE_Q5_1].vec_dot          = ggml_vec_dot_q5_1_q8_1;
+
+    traits[GGML_TYPE_Q8_0].to_float         = (ggml_to_float_t) dequantize_row_q8_0;
+    traits[GGML_TYPE_Q8_0].from_float       = quantize_row_q8_0;
+    traits[GGML_TYPE_Q8_0].from_float_ref   = (ggml_from_float_t) quantize_row_q8_0_ref;
+    traits[GGML_TYPE_Q8_0].vec_dot          = ggml_vec_dot_q8_0_q8_0;
+    traits[GGML_TYPE_Q8_0].vec_dot_cols     = vec_dot_cols ? ggml_vec_dot_q8_0_q8_0_cols : NULL;
+
+    traits[GGML_TYPE_Q8_1].from_float       = quantize_row_q8_1;
+    traits[GGML_TYPE_Q8_1].from_float_ref   = (ggml_from_float_t) quantize_row_q8_1_ref;
+
+    traits[GGML_TYPE_Q2_K].to_float         = (ggml_to_float_t) dequantize_row_q2_K;
+    traits[GGML_TYPE_Q2_K].from_float       = quantize_row_q2_K;
+    traits[GGML_TYPE_Q2_K].from_float_ref   = (ggml_from_float_t) quantize_row_q2_K_ref;
+    traits[GGML_TYPE_Q2_K].vec_dot          = ggml_vec_dot_q2_K_q8_K;
+
+    traits[GGML_TYPE_Q3_K].to_float         = (ggml_to_float_t) dequantize_row_q3_K;
+    traits[GGML_TYPE_Q3_K].from_float       = quantize_row_q3_K;
+    traits[GGML_TYPE_Q3_K].from_float_ref   = (ggml_from_float_t) quantize_row_q3_K_ref;
+    traits[GGML_TYPE_Q3_K].vec_dot          = ggml_vec_dot_q3_K_q8_K;
+
+    traits[GGML_TYPE_Q4_K].to_float         = (ggml_to_float_t) dequantize_row_q4_K;
+    traits[GGML_TYPE_Q4_K].from_float       = quantize_row_q4_K;
+    traits[GGML_TYPE_Q4_K].from_float_ref   = (ggml_from_float_t) quantize_row_q4_K_ref;
+    traits[GGML_TYPE_Q4_K].vec_dot          = ggml_vec_dot_q4_K_q8_K;
+    traits[GGML_TYPE_Q4_K].nrows            = nrows_k;
+
+    traits[GGML_TYPE_Q5_K].to_float         = (ggml_to_float_t) dequantize_row_q5_K;
+    traits[GGML_TYPE_Q5_K].from_float       = quantize_row_q5_K;
+    traits[GGML_TYPE_Q5_K].from_float_ref   = (ggml_from_float_t) quantize_row_q5_K_ref;
+    traits[GGML_TYPE_Q5_K].vec_dot          = ggml_vec_dot_q5_K_q8_K;
+    traits[GGML_TYPE_Q5_K].nrows            = nrows_k;
+
+    traits[GGML_TYPE_Q6_K].to_float         = (ggml_to_float_t) dequantize_row_q6_K;
+    traits[GGML_TYPE_Q6_K].from_float       = quantize_row_q6_K;
+    traits[GGML_TYPE_Q6_K].from_float_ref   = (ggml_from_float_t) quantize_row_q6_K_ref;
+    traits[GGML_TYPE_Q6_K].vec_dot          = ggml_vec_dot_q6_K_q8_K;
+    traits[GGML_TYPE_Q6_K].nrows            = nrows_k;
+
+    traits[GGML_TYPE_IQ2_XXS].to_float      = (ggml_to_float_t) dequantize_row_iq2_xxs;
+    traits[GGML_TYPE_IQ2_XXS].vec_dot       = ggml_vec_dot_iq2_xxs_q8_K;
+
+    traits[GGML_TYPE_IQ2_XS].to_float       = (ggml_to_float_t) dequantize_row_iq2_xs;
+    traits[GGML_TYPE_IQ2_XS].vec_dot        = ggml_vec_dot_iq2_xs_q8_K;
+
+    traits[GGML_TYPE_IQ3_XXS].to_float      = (ggml_to_float_t) dequantize_row_iq3_xxs;
+    traits[GGML_TYPE_IQ3_XXS].vec_dot       = ggml_vec_dot_iq3_xxs_q8_K;
+
+    traits[GGML_TYPE_IQ3_S].to_float        = (ggml_to_float_t) dequantize_row_iq3_s;
+    traits[GGML_TYPE_IQ3_S].vec_dot         = ggml_vec_dot_iq3_s_q8_K;
+
+    traits[GGML_TYPE_IQ2_S].to_float        = (ggml_to_float_t) dequantize_row_iq2_s;
+    traits[GGML_TYPE_IQ2_S].vec_dot         = ggml_vec_dot_iq2_s_q8_K;
+
+    traits[GGML_TYPE_IQ1_S].to_float        = (ggml_to_float_t) dequantize_row_iq1_s;
+    traits[GGML_TYPE_IQ1_S].vec_dot         = ggml_vec_dot_iq1_s_q8_K;
+
+    traits[GGML_TYPE_IQ1_M].to_float        = (ggml_to_float_t) dequantize_row_iq1_m;
+    traits[GGML_TYPE_IQ1_M].vec_dot         = ggml_vec_dot_iq1_m_q8_K;
+
+    traits[GGML_TYPE_IQ4_NL].to_float       = (ggml_to_float_t) dequantize_row_iq4_nl;
+    traits[GGML_TYPE_IQ4_NL].from_float     = quantize_row_iq4_nl;
+    traits[GGML_TYPE_IQ4_NL].from_float_ref = (ggml_from_float_t) quantize_row_iq4_nl_ref;
+    traits[GGML_TYPE_IQ4_NL].vec_dot        = ggml_vec_dot_iq4_nl_q8_0;
+
+    traits[GGML_TYPE_IQ4_XS].to_float       = (ggml_to_float_t) dequantize_row_iq4_xs;
+    traits[GGML_TYPE_IQ4_XS].from_float     = quantize_row_iq4_xs;
+    traits[GGML_TYPE_IQ4_XS].from_float_ref = (ggml_from_float_t) quantize_row_iq4_xs_ref;
+    traits[GGML_TYPE_IQ4_XS].vec_dot        = ggml_vec_dot_iq4_xs_q8_K;
+
+    traits[GGML_TYPE_Q8_K].from_float       = quantize_row_q8_K;
+    traits[GGML_TYPE_Q8_K].from_float_ref   = (ggml_from_float_t) quantize_row_q8_K_ref;
+
+    traits[GGML_TYPE_F8_E4M3].to_float      = (ggml_to_float_t) dequantize_row_f8_e4m3;
+    traits[GGML_TYPE_F8_E4M3].vec_dot       = ggml_vec_dot_f8_e4m3_f16;
+    traits[GGML_TYPE_F8_E4M3].vec_dot_cols  = vec_dot_cols ? ggml_vec_dot_f8_e4m3_f16_cols : NULL;
+
+    traits[GGML_TYPE_F8_E5M2].to_float      = (ggml_to_float_t) dequantize_row_f8_e5m2;
+    traits[GGML_TYPE_F8_E5M2].vec_dot       = ggml_vec_dot_f8_e5m2_f16;
+    traits[GGML_TYPE_F8_E5M2].vec_dot_cols  = vec_dot_cols ? ggml_vec_dot_f8_e5m2_f16_cols : NULL;
+}
@@ -127,6 +127,15 @@ static inline __m256 mul_sum_i8_pairs_float(const __m256i x, const __m256i y) {
 #endif
 }
 
+// multiply int16_t, add results pairwise and accumulate into acc
+static inline __m256i mul_sum_i16_pairs_acc_int32(const __m256i acc, const __m256i x, const __m256i y) {
+#if defined(__AVXVNNI__) || (defined(__AVX512VNNI__) && defined(__AVX512VL__))
+    return _mm256_dpwssd_epi32(acc, x, y);
+#else
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(x, y));
+#endif
+}
+
 static inline __m128i packNibbles( __m256i bytes )
 {
     // Move bits within 16-bit lanes from 0000_abcd_0000_efgh into 0000_0000_abcd_efgh
@@ -3588,6 +3597,158 @@ void dequantize_row_iq4_xs(const block_iq4_xs * restrict x, float * restrict y,
     }
 }
 
+//===================================== FP8 ===============================================
+
+// the largest absolute value of a block is mapped to the largest finite E4M3 value
+// E5M2 uses the same scale so that the fp16 d stays in the normal range
+#define GGML_F8_QMAX 448.0f
+
+// rounds to the nearest fp8 value with m mantissa bits and the given exponent bias, ties to even
+// values above the largest finite value max_q saturate to it, NaN becomes 0x7f
+static inline uint8_t fp32_to_fp8(float f, const int m, const int bias, const uint32_t max_q) {
+    union { float f; uint32_t u; } v = { f };
+    const uint8_t sign = (v.u >> 24) & 0x80;
+    v.u &= 0x7fffffff;
+    if (v.u > 0x7f800000) {
+        return sign | 0x7f;
+    }
+    uint32_t q;
+    if (v.u < (uint32_t) (128 - bias) << 23) {
+        // subnormal, in units of 2^(1 - bias - m): adding 2^23 rounds the scaled value to an integer
+        union { float f; uint32_t u; } t = { v.f*(float)(1 << (bias - 1 + m)) + 8388608.0f };
+        q = t.u - 0x4b000000;
+    } else {
+        q = v.u - ((uint32_t) (127 - bias) << 23);
+        q += (1u << (22 - m)) - 1 + ((q >> (23 - m)) & 1);
+        q >>= 23 - m;
+    }
+    return sign | (uint8_t) MIN(q, max_q);
+}
+
+static inline uint8_t fp32_to_f8_e4m3(float f) { return fp32_to_fp8(f, 3,  7, 0x7e); }
+static inline uint8_t fp32_to_f8_e5m2(float f) { return fp32_to_fp8(f, 2, 15, 0x7b); }
+
+// E5M2 is the upper byte of fp16
+// E4M3 moved to the fp16 bit positions is the value times 2^-8, the callers fold the 2^8 into d
+// (the NaN codes 0x7f/0xff are never produced by the quantization and decode as ±480)
+static inline ggml_fp16_t f8_e5m2_to_fp16(uint8_t q) { return (ggml_fp16_t) (q << 8); }
+static inline ggml_fp16_t f8_e4m3_to_fp16(uint8_t q) { return (ggml_fp16_t) (((q & 0x80) << 8) | ((q & 0x7f) << 7)); }
+
+#define GGML_F8_E4M3_SCALE 256.0f
+
+#if defined(__AVX2__) && defined(__F16C__)
+// 16 fp8 values to the fp16 bits, as above
+static inline __m256i f8_e5m2_to_fp16_x16(const uint8_t * q) {
+    return _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) q)), 8);
+}
+
+// (sign extended, the shift puts the sign in bits 15 and 14, the mask clears bit 14)
+static inline __m256i f8_e4m3_to_fp16_x16(const uint8_t * q) {
+    const __m256i h = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) q));
+    return _mm256_and_si256(_mm256_slli_epi16(h, 7), _mm256_set1_epi16((short) 0xbf80));
+}
+#endif
+
+static void quantize_row_f8_impl(const float * restrict x, block_f8 * restrict y, int64_t k, bool e5m2) {
+    assert(k % QK_F8 == 0);
+    const int64_t nb = k / QK_F8;
+
+    for (int64_t i = 0; i < nb; i++) {
+        float amax = 0.0f;
+        for (int j = 0; j < QK_F8; j++) {
+            amax = MAX(amax, fabsf(x[i*QK_F8 + j]));
+        }
+
+        y[i].d = GGML_FP32_TO_FP16(amax / GGML_F8_QMAX);
+
+        // scale with the rounded d so that the dequantized values do not pick up its rounding error
+        const float d  = GGML_FP16_TO_FP32(y[i].d);
+        const float id = d ? 1.0f/d : 0.0f;
+
+        if (e5m2) {
+            for (int j = 0; j < QK_F8; j++) {
+                y[i].qs[j] = fp32_to_f8_e5m2(x[i*QK_F8 + j]*id);
+            }
+        } else {
+            for (int j = 0; j < QK_F8; j++) {
+                y[i].qs[j] = fp32_to_f8_e4m3(x[i*QK_F8 + j]*id);
+            }
+        }
+    }
+}
+
+void quantize_row_f8_e4m3_ref(const float * restrict x, block_f8 * restrict y, int64_t k) {
+    quantize_row_f8_impl(x, y, k, false);
+}
+
+void quantize_row_f8_e5m2_ref(const float * restrict x, block_f8 * restrict y, int64_t k) {
+    quantize_row_f8_impl(x, y, k, true);
+}
+
+void quantize_row_f8_e4m3(const float * restrict x, void * restrict y, int64_t k) {
+    quantize_row_f8_impl(x, y, k, false);
+}
+
+void quantize_row_f8_e5m2(const float * restrict x, void * restrict y, int64_t k) {
+    quantize_row_f8_impl(x, y, k, true);
+}
+
+size_t quantize_f8_e4m3(const float * restrict src, void * restrict dst, int64_t nrow, int64_t n_per_row, const float * quant_weights) {
+    (void)quant_weights; // not used
+    const size_t row_size = ggml_row_size(GGML_TYPE_F8_E4M3, n_per_row);
+    quantize_row_f8_impl(src, dst, (int64_t)nrow*n_per_row, false);
+    return nrow * row_size;
+}
+
+size_t quantize_f8_e5m2(const float * restrict src, void * restrict dst, int64_t nrow, int64_t n_per_row, const float * quant_weights) {
+    (void)quant_weights; // not used
+    const size_t row_size = ggml_row_size(GGML_TYPE_F8_E5M2, n_per_row);
+    quantize_row_f8_impl(src, dst, (int64_t)nrow*n_per_row, true);
+    return nrow * row_size;
+}
+
+void dequantize_row_f8_e4m3(const block_f8 * restrict x, float * restrict y, int64_t k) {
+    assert(k % QK_F8 == 0);
+    const int64_t nb = k / QK_F8;
+
+    for (int64_t i = 0; i < nb; i++) {
+        const float d = GGML_FP16_TO_FP32(x[i].d) * GGML_F8_E4M3_SCALE;
+#if defined(__AVX2__) && defined(__F16C__)
+        const __m256 vd = _mm256_set1_ps(d);
+        for (int j = 0; j < QK_F8; j += 16) {
+            const __m256i h = f8_e4m3_to_fp16_x16(x[i].qs + j);
+            _mm256_storeu_ps(y + i*QK_F8 + j + 0, _mm256_mul_ps(vd, _mm256_cvtph_ps(_mm256_castsi256_si128(h))));
+            _mm256_storeu_ps(y + i*QK_F8 + j + 8, _mm256_mul_ps(vd, _mm256_cvtph_ps(_mm256_extracti128_si256(h, 1))));
+        }
+#else
+        for (int j = 0; j < QK_F8; j++) {
+            y[i*QK_F8 + j] = d * GGML_FP16_TO_FP32(f8_e4m3_to_fp16(x[i].qs[j]));
+        }
+#endif
+    }
+}
+
+void dequantize_row_f8_e5m2(const block_f8 * restrict x, float * restrict y, int64_t k) {
+    assert(k % QK_F8 == 0);
+    const int64_t nb = k / QK_F8;
+
+    for (int64_t i = 0; i < nb; i++) {
+        const float d = GGML_FP16_TO_FP32(x[i].d);
+#if defined(__AVX2__) && defined(__F16C__)
+        const __m256 vd = _mm256_set1_ps(d);
+        for (int j = 0; j < QK_F8; j += 16) {
+            const __m256i h = f8_e5m2_to_fp16_x16(x[i].qs + j);
+            _mm256_storeu_ps(y + i*QK_F8 + j + 0, _mm256_mul_ps(vd, _mm256_cvtph_ps(_mm256_castsi256_si128(h))));
+            _mm256_storeu_ps(y + i*QK_F8 + j + 8, _mm256_mul_ps(vd, _mm256_cvtph_ps(_mm256_extracti128_si256(h, 1))));
+        }
+#else
+        for (int j = 0; j < QK_F8; j++) {
+            y[i*QK_F8 + j] = d * GGML_FP16_TO_FP32(f8_e5m2_to_fp16(x[i].qs[j]));
+        }
+#endif
+    }
+}
+
 //===================================== Q8_K ==============================================
 
 void quantize_row_q8_K_ref(const float * restrict x, block_q8_K * restrict y, int64_t k) {
@@ -3687,6 +3848,37 @@ static inline __m128i get_scale_shuffle(int i) {
     };
     return _mm_loadu_si128((const __m128i*)k_shuffle + i);
 }
+#if defined(__AVX2__)
+// the 6-bit scales (low half) and mins (high half) of a q4_K or q5_K block as 16-bit integers
+static inline __m256i get_mins_and_scales_k4(const uint8_t * restrict scales) {
+    static const uint32_t kmask1 = 0x3f3f3f3f;
+    static const uint32_t kmask2 = 0x0f0f0f0f;
+    static const uint32_t kmask3 = 0x03030303;
+
+    uint32_t utmp[4];
+
+    memcpy(utmp, scales, 12);
+    utmp[3] = ((utmp[2] >> 4) & kmask2) | (((utmp[1] >> 6) & kmask3) << 4);
+    const uint32_t uaux = utmp[1] & kmask1;
+    utmp[1] = (utmp[2] & kmask2) | (((utmp[0] >> 6) & kmask3) << 4);
+    utmp[2] = uaux;
+    utmp[0] &= kmask1;
+
+    return _mm256_cvtepu8_epi16(_mm_set_epi32(utmp[3], utmp[2], utmp[1], utmp[0]));
+}
+
+// sum of the products of the mins of a q4_K or q5_K block with the sums of the 32-element groups of a q8_K block
+static inline __m128i get_mins_dot_k4(const __m256i mins_and_scales, const __m256i bsums) {
+    const __m128i q8s = _mm_hadd_epi16(_mm256_extracti128_si256(bsums, 0), _mm256_extracti128_si256(bsums, 1));
+    return _mm_madd_epi16(_mm256_extracti128_si256(mins_and_scales, 1), q8s);
+}
+
+static inline float hsum_float_4(__m128 x) {
+    x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    x = _mm_add_ss(x, _mm_movehdup_ps(x));
+    return _mm_cvtss_f32(x);
+}
+#endif
 #elif defined(__loongarch_asx)
 // shuffles to pick the required scales in dot products
 static inline __m256i get_scale_shuffle_q3k(int i) {
@@ -5470,6 +5662,288 @@ void ggml_vec_dot_q8_0_q8_0(int n, float * restrict s, size_t bs, const void * r
     *s = sumf;
 }
 
+#if defined(__AVX2__)
+// number of columns of y dotted at once by the *_cols kernels, the accumulators of the columns stay in registers
+// (8 columns with the 32 registers of AVX512VL were measured no faster)
+#define GGML_VEC_DOT_COLS 4
+
+// nc <= GGML_VEC_DOT_COLS columns, nc is a constant once inlined so that the loops over the columns are unrolled
+static inline void ggml_vec_dot_q4_0_q8_0_cols_impl(int nb, float * restrict s, size_t bs, const block_q4_0 * restrict x, const char * restrict vy, size_t by, const int nc) {
+    const __m256i off = _mm256_set1_epi8(8);
+
+    __m256 acc[GGML_VEC_DOT_COLS];
+    for (int j = 0; j < nc; ++j) {
+        acc[j] = _mm256_setzero_ps();
+    }
+
+    for (int ib = 0; ib < nb; ++ib) {
+        const float dx = GGML_FP16_TO_FP32(x[ib].d);
+
+        // unpack the block of x once for all the columns
+        const __m256i qx = _mm256_sub_epi8(bytes_from_nibbles_32(x[ib].qs), off);
+        const __m256i ax = _mm256_sign_epi8(qx, qx);
+
+        for (int j = 0; j < nc; ++j) {
+            const block_q8_0 * restrict y = (const block_q8_0 *) (vy + j*by) + ib;
+
+            const __m256  d  = _mm256_set1_ps(dx * GGML_FP16_TO_FP32(y->d));
+            const __m256i sy = _mm256_sign_epi8(_mm256_loadu_si256((const __m256i *) y->qs), qx);
+
+            acc[j] = _mm256_fmadd_ps(d, mul_sum_us8_pairs_float(ax, sy), acc[j]);
+        }
+    }
+
+    for (int j = 0; j < nc; ++j) {
+        s[j*bs] = hsum_float_8(acc[j]);
+    }
+}
+
+static inline void ggml_vec_dot_q8_0_q8_0_cols_impl(int nb, float * restrict s, size_t bs, const block_q8_0 * restrict x, const char * restrict vy, size_t by, const int nc) {
+    __m256 acc[GGML_VEC_DOT_COLS];
+    for (int j = 0; j < nc; ++j) {
+        acc[j] = _mm256_setzero_ps();
+    }
+
+    for (int ib = 0; ib < nb; ++ib) {
+        const float dx = GGML_FP16_TO_FP32(x[ib].d);
+
+        const __m256i qx = _mm256_loadu_si256((const __m256i *) x[ib].qs);
+        const __m256i ax = _mm256_sign_epi8(qx, qx);
+
+        for (int j = 0; j < nc; ++j) {
+            const block_q8_0 * restrict y = (const block_q8_0 *) (vy + j*by) + ib;
+
+            const __m256  d  = _mm256_set1_ps(dx * GGML_FP16_TO_FP32(y->d));
+            const __m256i sy = _mm256_sign_epi8(_mm256_loadu_si256((const __m256i *) y->qs), qx);
+
+            acc[j] = _mm256_fmadd_ps(d, mul_sum_us8_pairs_float(ax, sy), acc[j]);
+        }
+    }
+
+    for (int j = 0; j < nc; ++j) {
+        s[j*bs] = hsum_float_8(acc[j]);
+    }
+}
+
+#if defined(__F16C__)
+// the block of x is converted to floats once for all the columns, with d (and the 2^8 of E4M3) folded in
+static inline void ggml_vec_dot_f8_f16_cols_impl(int nb, float * restrict s, size_t bs, const block_f8 * restrict x, const char * restrict vy, size_t by, const int nc, const bool e5m2) {
+    if (nc == 1) {
+        // one column is faster with the independent sums of the row kernel
+        if (e5m2) {
+            ggml_vec_dot_f8_e5m2_f16(nb*QK_F8, s, bs, x, 0, vy, 0, 1);
+        } else {
+            ggml_vec_dot_f8_e4m3_f16(nb*QK_F8, s, bs, x, 0, vy, 0, 1);
+        }
+        return;
+    }
+
+    // two accumulators per column to shorten the chains of fma
+    __m256 acc0[GGML_VEC_DOT_COLS];
+    __m256 acc1[GGML_VEC_DOT_COLS];
+    for (int j = 0; j < nc; ++j) {
+        acc0[j] = _mm256_setzero_ps();
+        acc1[j] = _mm256_setzero_ps();
+    }
+
+    const __m256 scale = _mm256_set1_ps(e5m2 ? 1.0f : GGML_F8_E4M3_SCALE);
+
+    for (int ib = 0; ib < nb; ++ib) {
+        const __m256 d = _mm256_mul_ps(scale, _mm256_set1_ps(GGML_FP16_TO_FP32(x[ib].d)));
+
+        const __m256i h0 = e5m2 ? f8_e5m2_to_fp16_x16(x[ib].qs +  0) : f8_e4m3_to_fp16_x16(x[ib].qs +  0);
+        const __m256i h1 = e5m2 ? f8_e5m2_to_fp16_x16(x[ib].qs + 16) : f8_e4m3_to_fp16_x16(x[ib].qs + 16);
+
+        const __m256 fx0 = _mm256_mul_ps(d, _mm256_cvtph_ps(_mm256_castsi256_si128(h0)));
+        const __m256 fx1 = _mm256_mul_ps(d, _mm256_cvtph_ps(_mm256_extracti128_si256(h0, 1)));
+        const __m256 fx2 = _mm256_mul_ps(d, _mm256_cvtph_ps(_mm256_castsi256_si128(h1)));
+        const __m256 fx3 = _mm256_mul_ps(d, _mm256_cvtph_ps(_mm256_extracti128_si256(h1, 1)));
+
+        for (int j = 0; j < nc; ++j) {
+            const ggml_fp16_t * restrict y = (const ggml_fp16_t *) (vy + j*by) + ib*QK_F8;
+
+            acc0[j] = _mm256_fmadd_ps(fx0, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (y +  0))), acc0[j]);
+            acc1[j] = _mm256_fmadd_ps(fx1, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (y +  8))), acc1[j]);
+            acc0[j] = _mm256_fmadd_ps(fx2, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (y + 16))), acc0[j]);
+            acc1[j] = _mm256_fmadd_ps(fx3, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (y + 24))), acc1[j]);
+        }
+    }
+
+    for (int j = 0; j < nc; ++j) {
+        s[j*bs] = hsum_float_8(_mm256_add_ps(acc0[j], acc1[j]));
+    }
+}
+
+static inline void ggml_vec_dot_f8_e4m3_f16_cols_impl(int nb, float * restrict s, size_t bs, const block_f8 * restrict x, const char * restrict vy, size_t by, const int nc) {
+    ggml_vec_dot_f8_f16_cols_impl(nb, s, bs, x, vy, by, nc, false);
+}
+
+static inline void ggml_vec_dot_f8_e5m2_f16_cols_impl(int nb, float * restrict s, size_t bs, const block_f8 * restrict x, const char * restrict vy, size_t by, const int nc) {
+    ggml_vec_dot_f8_f16_cols_impl(nb, s, bs, x, vy, by, nc, true);
+}
+#endif
+
+// the groups of 4 columns, then the rest with 2 and 1 columns
+#define GGML_VEC_DOT_COLS_LOOP(impl, nb, s, bs, x, vy, by, nrc)                           \
+    do {                                                                                  \
+        int j = 0;                                                                        \
+        for (; j + GGML_VEC_DOT_COLS <= (nrc); j += GGML_VEC_DOT_COLS) {                  \
+            impl(nb, (s) + j*(bs), bs, x, (const char *) (vy) + j*(by), by, GGML_VEC_DOT_COLS); \
+        }                                                                                 \
+        if (j + 2 <= (nrc)) {                                                             \
+            impl(nb, (s) + j*(bs), bs, x, (const char *) (vy) + j*(by), by, 2);           \
+            j += 2;                                                                       \
+        }                                                                                 \
+        if (j < (nrc)) {                                                                  \
+            impl(nb, (s) + j*(bs), bs, x, (const char *) (vy) + j*(by), by, 1);           \
+        }                                                                                 \
+    } while (0)
+#endif
+
+void ggml_vec_dot_q4_0_q8_0_cols(int n, float * restrict s, size_t bs, const void * restrict vx, size_t bx, const void * restrict vy, size_t by, int nrc) {
+    assert(n % QK8_0 == 0);
+    UNUSED(bx);
+
+#if defined(__AVX2__)
+    GGML_VEC_DOT_COLS_LOOP(ggml_vec_dot_q4_0_q8_0_cols_impl, n / QK8_0, s, bs, (const block_q4_0 *) vx, vy, by, nrc);
+#else
+    for (int j = 0; j < nrc; ++j) {
+        ggml_vec_dot_q4_0_q8_0(n, s + j*bs, 0, vx, 0, (const char *) vy + j*by, 0, 1);
+    }
+#endif
+}
+
+void ggml_vec_dot_q8_0_q8_0_cols(int n, float * restrict s, size_t bs, const void * restrict vx, size_t bx, const void * restrict vy, size_t by, int nrc) {
+    assert(n % QK8_0 == 0);
+    UNUSED(bx);
+
+#if defined(__AVX2__)
+    GGML_VEC_DOT_COLS_LOOP(ggml_vec_dot_q8_0_q8_0_cols_impl, n / QK8_0, s, bs, (const block_q8_0 *) vx, vy, by, nrc);
+#else
+    for (int j = 0; j < nrc; ++j) {
+        ggml_vec_dot_q8_0_q8_0(n, s + j*bs, 0, vx, 0, (const char *) vy + j*by, 0, 1);
+    }
+#endif
+}
+
+void ggml_vec_dot_f8_e4m3_f16(int n, float * restrict s, size_t bs, const void * restrict vx, size_t bx, const void * restrict vy, size_t by, int nrc) {
+    assert(n % QK_F8 == 0);
+    assert(nrc == 1);
+    UNUSED(nrc);
+    UNUSED(bx);
+    UNUSED(by);
+    UNUSED(bs);
+
+    const block_f8    * restrict x = vx;
+    const ggml_fp16_t * restrict y = vy;
+
+    const int nb = n / QK_F8;
+
+    float sumf = 0.0f;
+
+#if defined(__AVX2__) && defined(__F16C__)
+    __m256 acc = _mm256_setzero_ps();
+
+    for (int ib = 0; ib < nb; ++ib) {
+        const __m256i h0 = f8_e4m3_to_fp16_x16(x[ib].qs +  0);
+        const __m256i h1 = f8_e4m3_to_fp16_x16(x[ib].qs + 16);
+
+        __m256 p0 = _mm256_mul_ps(_mm256_cvtph_ps(_mm256_castsi256_si128(h0)),      _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (y +  0))));
+        __m256 p1 = _mm256_mul_ps(_mm256_cvtph_ps(_mm256_extracti128_si256(h0, 1)), _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (y +  8))));
+        p0 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm256_castsi256_si128(h1)),      _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (y + 16))), p0);
+        p1 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm256_extracti128_si256(h1, 1)), _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (y + 24))), p1);
+
+        acc = _mm256_fmadd_ps(_mm256_set1_ps(GGML_FP16_TO_FP32(x[ib].d)), _mm256_add_ps(p0, p1), acc);
+        y += QK_F8;
+    }
+
+    sumf = hsum_float_8(acc);
+#else
+    for (int ib = 0; ib < nb; ++ib) {
+        float sumb = 0.0f;
+        for (int j = 0; j < QK_F8; ++j) {
+            sumb += GGML_FP16_TO_FP32(f8_e4m3_to_fp16(x[ib].qs[j])) * GGML_FP16_TO_FP32(y[j]);
+        }
+        sumf += GGML_FP16_TO_FP32(x[ib].d) * sumb;
+        y += QK_F8;
+    }
+#endif
+
+    *s = sumf * GGML_F8_E4M3_SCALE;
+}
+
+void ggml_vec_dot_f8_e5m2_f16(int n, float * restrict s, size_t bs, const void * restrict vx, size_t bx, const void * restrict vy, size_t by, int nrc) {
+    assert(n % QK_F8 == 0);
+    assert(nrc == 1);
+    UNUSED(nrc);
+    UNUSED(bx);
+    UNUSED(by);
+    UNUSED(bs);
+
+    const block_f8    * restrict x = vx;
+    const ggml_fp16_t * restrict y = vy;
+
+    const int nb = n / QK_F8;
+
+    float sumf = 0.0f;
+
+#if defined(__AVX2__) && defined(__F16C__)
+    __m256 acc = _mm256_setzero_ps();
+
+    for (int ib = 0; ib < nb; ++ib) {
+        const __m256i h0 = f8_e5m2_to_fp16_x16(x[ib].qs +  0);
+        const __m256i h1 = f8_e5m2_to_fp16_x16(x[ib].qs + 16);
+
+        __m256 p0 = _mm256_mul_ps(_mm256_cvtph_ps(_mm256_castsi256_si128(h0)),      _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (y +  0))));
+        __m256 p1 = _mm256_mul_ps(_mm256_cvtph_ps(_mm256_extracti128_si256(h0, 1)), _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (y +  8))));
+        p0 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm256_castsi256_si128(h1)),      _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (y + 16))), p0);
+        p1 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm256_extracti128_si256(h1, 1)), _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (y + 24))), p1);
+
+        acc = _mm256_fmadd_ps(_mm256_set1_ps(GGML_FP16_TO_FP32(x[ib].d)), _mm256_add_ps(p0, p1), acc);
+        y += QK_F8;
+    }
+
+    sumf = hsum_float_8(acc);
+#else
+    for (int ib = 0; ib < nb; ++ib) {
+        float sumb = 0.0f;
+        for (int j = 0; j < QK_F8; ++j) {
+            sumb += GGML_FP16_TO_FP32(f8_e5m2_to_fp16(x[ib].qs[j])) * GGML_FP16_TO_FP32(y[j]);
+        }
+        sumf += GGML_FP16_TO_FP32(x[ib].d) * sumb;
+        y += QK_F8;
+    }
+#endif
+
+    *s = sumf;
+}
+
+void ggml_vec_dot_f8_e4m3_f16_cols(int n, float * restrict s, size_t bs, const void * restrict vx, size_t bx, const void * restrict vy, size_t by, int nrc) {
+    assert(n % QK_F8 == 0);
+    UNUSED(bx);
+
+#if defined(__AVX2__) && defined(__F16C__)
+    GGML_VEC_DOT_COLS_LOOP(ggml_vec_dot_f8_e4m3_f16_cols_impl, n / QK_F8, s, bs, (const block_f8 *) vx, vy, by, nrc);
+#else
+    for (int j = 0; j < nrc; ++j) {
+        ggml_vec_dot_f8_e4m3_f16(n, s + j*bs, 0, vx, 0, (const char *) vy + j*by, 0, 1);
+    }
+#endif
+}
+
+void ggml_vec_dot_f8_e5m2_f16_cols(int n, float * restrict s, size_t bs, const void * restrict vx, size_t bx, const void * restrict vy, size_t by, int nrc) {
+    assert(n % QK_F8 == 0);
+    UNUSED(bx);
+
+#if defined(__AVX2__) && defined(__F16C__)
+    GGML_VEC_DOT_COLS_LOOP(ggml_vec_dot_f8_e5m2_f16_cols_impl, n / QK_F8, s, bs, (const block_f8 *) vx, vy, by, nrc);
+#else
+    for (int j = 0; j < nrc; ++j) {
+        ggml_vec_dot_f8_e5m2_f16(n, s + j*bs, 0, vx, 0, (const char *) vy + j*by, 0, 1);
+    }
+#endif
+}
+
 void ggml_vec_dot_q2_K_q8_K(int n, float * restrict s, size_t bs, const void * restrict vx, size_t bx, const void * restrict vy, size_t by, int nrc) {
     assert(nrc == 1);
     UNUSED(nrc);
@@ -6831,7 +7305,11 @@ void ggml_vec_dot_q3_K_q8_K(int n, float * restrict s, size_t bs, const void * r
 
 void ggml_vec_dot_q4_K_q8_K(int n, float * restrict s, size_t bs, const void * restrict vx, size_t bx, const void * restrict vy, size_t by, int nrc) {
     assert(n % QK_K == 0);
+#if defined(__AVX2__)
+    assert((nrc == 2) || (nrc == 1));
+#else
     assert(nrc == 1);
+#endif
     UNUSED(nrc);
     UNUSED(bx);
     UNUSED(by);
@@ -6842,6 +7320,83 @@ void ggml_vec_dot_q4_K_q8_K(int n, float * restrict s, size_t bs, const void * r
 
     const int nb = n / QK_K;
 
+#if defined(__AVX2__)
+    if (nrc == 2) {
+        // 2 rows of x with 2 columns of y: the nibbles and the quants are loaded and unpacked once for both products
+        const block_q4_K * restrict vx0 = vx;
+        const block_q4_K * restrict vx1 = (const block_q4_K *) ((const uint8_t*)vx + bx);
+        const block_q8_K * restrict vy0 = vy;
+        const block_q8_K * restrict vy1 = (const block_q8_K *) ((const uint8_t*)vy + by);
+
+        const __m256i m4 = _mm256_set1_epi8(0xF);
+
+        __m256 acc[2][2]; // [row of x][column of y]
+        __m128 acc_m[2][2];
+        for (int r = 0; r < 2; r++) {
+            for (int c = 0; c < 2; c++) {
+                acc[r][c]   = _mm256_setzero_ps();
+                acc_m[r][c] = _mm_setzero_ps();
+            }
+        }
+
+        for (int i = 0; i < nb; ++i) {
+            const block_q4_K * restrict bx01[2] = { &vx0[i], &vx1[i] };
+            const block_q8_K * restrict by01[2] = { &vy0[i], &vy1[i] };
+
+            __m256i scales[2];
+            for (int r = 0; r < 2; r++) {
+                const __m256i mins_and_scales = get_mins_and_scales_k4(bx01[r]->scales);
+                for (int c = 0; c < 2; c++) {
+                    const __m128i prod = get_mins_dot_k4(mins_and_scales, _mm256_loadu_si256((const __m256i*)by01[c]->bsums));
+                    const float dmin = -by01[c]->d * GGML_FP16_TO_FP32(bx01[r]->dmin);
+                    acc_m[r][c] = _mm_fmadd_ps(_mm_set1_ps(dmin), _mm_cvtepi32_ps(prod), acc_m[r][c]);
+                }
+                const __m128i sc128 = _mm256_extracti128_si256(mins_and_scales, 0);
+                scales[r] = MM256_SET_M128I(sc128, sc128);
+            }
+
+            __m256i sumi[2][2] = {{ _mm256_setzero_si256(), _mm256_setzero_si256() }, { _mm256_setzero_si256(), _mm256_setzero_si256() }};
+
+            for (int j = 0; j < QK_K/64; ++j) {
+                __m256i q8l[2];
+                __m256i q8h[2];
+                for (int c = 0; c < 2; c++) {
+                    q8l[c] = _mm256_loadu_si256((const __m256i*)(by01[c]->qs + 64*j));
+                    q8h[c] = _mm256_loadu_si256((const __m256i*)(by01[c]->qs + 64*j + 32));
+                }
+
+                for (int r = 0; r < 2; r++) {
+                    const __m256i scale_l = _mm256_shuffle_epi8(scales[r], get_scale_shuffle_k4(2*j+0));
+                    const __m256i scale_h = _mm256_shuffle_epi8(scales[r], get_scale_shuffle_k4(2*j+1));
+
+                    const __m256i q4bits = _mm256_loadu_si256((const __m256i*)(bx01[r]->qs + 32*j));
+                    const __m256i q4l = _mm256_and_si256(q4bits, m4);
+                    const __m256i q4h = _mm256_and_si256(_mm256_srli_epi16(q4bits, 4), m4);
+
+                    for (int c = 0; c < 2; c++) {
+                        sumi[r][c] = mul_sum_i16_pairs_acc_int32(sumi[r][c], scale_l, _mm256_maddubs_epi16(q4l, q8l[c]));
+                        sumi[r][c] = mul_sum_i16_pairs_acc_int32(sumi[r][c], scale_h, _mm256_maddubs_epi16(q4h, q8h[c]));
+                    }
+                }
+            }
+
+            for (int r = 0; r < 2; r++) {
+                for (int c = 0; c < 2; c++) {
+                    const __m256 vd = _mm256_set1_ps(by01[c]->d * GGML_FP16_TO_FP32(bx01[r]->d));
+                    acc[r][c] = _mm256_fmadd_ps(vd, _mm256_cvtepi32_ps(sumi[r][c]), acc[r][c]);
+                }
+            }
+        }
+
+        for (int c = 0; c < 2; c++) {
+            for (int r = 0; r < 2; r++) {
+                s[c*bs + r] = hsum_float_8(acc[r][c]) + hsum_float_4(acc_m[r][c]);
+            }
+        }
+        return;
+    }
+#endif
+
     static const uint32_t kmask1 = 0x3f3f3f3f;
     static const uint32_t kmask2 = 0x0f0f0f0f;
     static const uint32_t kmask3 = 0x03030303;
@@ -6943,7 +7498,8 @@ void ggml_vec_dot_q4_K_q8_K(int n, float * restrict s, size_t bs, const void * r
         const __m128i sc128  = _mm256_extracti128_si256(mins_and_scales, 0);
         const __m256i scales = MM256_SET_M128I(sc128, sc128);
 
-        __m256i sumi = _mm256_setzero_si256();
+        __m256i sumi_l = _mm256_setzero_si256();
+        __m256i sumi_h = _mm256_setzero_si256();
 
         for (int j = 0; j < QK_K/64; ++j) {
 
@@ -6955,19 +7511,16 @@ void ggml_vec_dot_q4_K_q8_K(int n, float * restrict s, size_t bs, const void * r
             const __m256i q4h = _mm256_and_si256(_mm256_srli_epi16(q4bits, 4), m4);
 
             const __m256i q8l = _mm256_loadu_si256((const __m256i*)q8); q8 += 32;
-            __m256i p16l = _mm256_maddubs_epi16(q4l, q8l);
-            p16l = _mm256_madd_epi16(scale_l, p16l);
+            const __m256i p16l = _mm256_maddubs_epi16(q4l, q8l);
+            sumi_l = mul_sum_i16_pairs_acc_int32(sumi_l, scale_l, p16l);
 
             const __m256i q8h = _mm256_loadu_si256((const __m256i*)q8); q8 += 32;
-            __m256i p16h = _mm256_maddubs_epi16(q4h, q8h);
-            p16h = _mm256_madd_epi16(scale_h, p16h);
-            const __m256i sumj = _mm256_add_epi32(p16l, p16h);
-
-            sumi = _mm256_add_epi32(sumi, sumj);
+            const __m256i p16h = _mm256_maddubs_epi16(q4h, q8h);
+            sumi_h = mul_sum_i16_pairs_acc_int32(sumi_h, scale_h, p16h);
         }
 
         __m256 vd = _mm256_set1_ps(d);
-        acc = _mm256_fmadd_ps(vd, _mm256_cvtepi32_ps(sumi), acc);
+        acc = _mm256_fmadd_ps(vd, _mm256_cvtepi32_ps(_mm256_add_epi32(sumi_l, sumi_h)), acc);
 
     }
 
@@ -7399,7 +7952,11 @@ void ggml_vec_dot_q4_K_q8_K(int n, float * restrict s, size_t bs, const void * r
 
 void ggml_vec_dot_q5_K_q8_K(int n, float * restrict s, size_t bs, const void * restrict vx, size_t bx, const void * restrict vy,  size_t by, int nrc) {
     assert(n % QK_K == 0);
+#if defined(__AVX2__)
+    assert((nrc == 2) || (nrc == 1));
+#else
     assert(nrc == 1);
+#endif
     UNUSED(nrc);
     UNUSED(bx);
     UNUSED(by);
@@ -7410,6 +7967,88 @@ void ggml_vec_dot_q5_K_q8_K(int n, float * restrict s, size_t bs, const void * r
 
     const int nb = n / QK_K;
 
+#if defined(__AVX2__)
+    if (nrc == 2) {
+        // 2 rows of x with 2 columns of y, see ggml_vec_dot_q4_K_q8_K
+        const block_q5_K * restrict vx0 = vx;
+        const block_q5_K * restrict vx1 = (const block_q5_K *) ((const uint8_t*)vx + bx);
+        const block_q8_K * restrict vy0 = vy;
+        const block_q8_K * restrict vy1 = (const block_q8_K *) ((const uint8_t*)vy + by);
+
+        const __m256i m4   = _mm256_set1_epi8(0xF);
+        const __m256i mone = _mm256_set1_epi8(1);
+
+        __m256 acc[2][2]; // [row of x][column of y]
+        __m128 acc_m[2][2];
+        for (int r = 0; r < 2; r++) {
+            for (int c = 0; c < 2; c++) {
+                acc[r][c]   = _mm256_setzero_ps();
+                acc_m[r][c] = _mm_setzero_ps();
+            }
+        }
+
+        for (int i = 0; i < nb; ++i) {
+            const block_q5_K * restrict bx01[2] = { &vx0[i], &vx1[i] };
+            const block_q8_K * restrict by01[2] = { &vy0[i], &vy1[i] };
+
+            __m256i scales[2];
+            __m256i hbits[2];
+            for (int r = 0; r < 2; r++) {
+                const __m256i mins_and_scales = get_mins_and_scales_k4(bx01[r]->scales);
+                for (int c = 0; c < 2; c++) {
+                    const __m128i prod = get_mins_dot_k4(mins_and_scales, _mm256_loadu_si256((const __m256i*)by01[c]->bsums));
+                    const float dmin = -by01[c]->d * GGML_FP16_TO_FP32(bx01[r]->dmin);
+                    acc_m[r][c] = _mm_fmadd_ps(_mm_set1_ps(dmin), _mm_cvtepi32_ps(prod), acc_m[r][c]);
+                }
+                const __m128i sc128 = _mm256_extracti128_si256(mins_and_scales, 0);
+                scales[r] = MM256_SET_M128I(sc128, sc128);
+                hbits[r]  = _mm256_loadu_si256((const __m256i*)bx01[r]->qh);
+            }
+
+            __m256i sumi[2][2] = {{ _mm256_setzero_si256(), _mm256_setzero_si256() }, { _mm256_setzero_si256(), _mm256_setzero_si256() }};
+
+            for (int j = 0; j < QK_K/64; ++j) {
+                __m256i q8l[2];
+                __m256i q8h[2];
+                for (int c = 0; c < 2; c++) {
+                    q8l[c] = _mm256_loadu_si256((const __m256i*)(by01[c]->qs + 64*j));
+                    q8h[c] = _mm256_loadu_si256((const __m256i*)(by01[c]->qs + 64*j + 32));
+                }
+
+                for (int r = 0; r < 2; r++) {
+                    const __m256i scale_l = _mm256_shuffle_epi8(scales[r], get_scale_shuffle_k4(2*j+0));
+                    const __m256i scale_h = _mm256_shuffle_epi8(scales[r], get_scale_shuffle_k4(2*j+1));
+
+                    const __m256i q5bits = _mm256_loadu_si256((const __m256i*)(bx01[r]->qs + 32*j));
+                    const __m256i q5h_l  = _mm256_slli_epi16(_mm256_and_si256(_mm256_srli_epi16(hbits[r], 2*j+0), mone), 4);
+                    const __m256i q5h_h  = _mm256_slli_epi16(_mm256_and_si256(_mm256_srli_epi16(hbits[r], 2*j+1), mone), 4);
+                    const __m256i q5l = _mm256_add_epi8(_mm256_and_si256(q5bits, m4), q5h_l);
+                    const __m256i q5h = _mm256_add_epi8(_mm256_and_si256(_mm256_srli_epi16(q5bits, 4), m4), q5h_h);
+
+                    for (int c = 0; c < 2; c++) {
+                        sumi[r][c] = mul_sum_i16_pairs_acc_int32(sumi[r][c], scale_l, _mm256_maddubs_epi16(q5l, q8l[c]));
+                        sumi[r][c] = mul_sum_i16_pairs_acc_int32(sumi[r][c], scale_h, _mm256_maddubs_epi16(q5h, q8h[c]));
+                    }
+                }
+            }
+
+            for (int r = 0; r < 2; r++) {
+                for (int c = 0; c < 2; c++) {
+                    const __m256 vd = _mm256_set1_ps(by01[c]->d * GGML_FP16_TO_FP32(bx01[r]->d));
+                    acc[r][c] = _mm256_fmadd_ps(vd, _mm256_cvtepi32_ps(sumi[r][c]), acc[r][c]);
+                }
+            }
+        }
+
+        for (int c = 0; c < 2; c++) {
+            for (int r = 0; r < 2; r++) {
+                s[c*bs + r] = hsum_float_8(acc[r][c]) + hsum_float_4(acc_m[r][c]);
+            }
+        }
+        return;
+    }
+#endif
+
     static const uint32_t kmask1 = 0x3f3f3f3f;
     static const uint32_t kmask2 = 0x0f0f0f0f;
     static const uint32_t kmask3 = 0x03030303;
@@ -7546,13 +8185,11 @@ void ggml_vec_dot_q5_K_q8_K(int n, float * restrict s, size_t bs, const void * r
             const __m256i q8_0 = _mm256_loadu_si256((const __m256i*)q8); q8 += 32;
             const __m256i q8_1 = _mm256_loadu_si256((const __m256i*)q8); q8 += 32;
 
-            __m256i p16_0 = _mm256_maddubs_epi16(q5_0, q8_0);
-            __m256i p16_1 = _mm256_maddubs_epi16(q5_1, q8_1);
+            const __m256i p16_0 = _mm256_maddubs_epi16(q5_0, q8_0);
+            const __m256i p16_1 = _mm256_maddubs_epi16(q5_1, q8_1);
 
-            p16_0 = _mm256_madd_epi16(scale_0, p16_0);
-            p16_1 = _mm256_madd_epi16(scale_1, p16_1);
-
-            sumi = _mm256_add_epi32(sumi, _mm256_add_epi32(p16_0, p16_1));
+            sumi = mul_sum_i16_pairs_acc_int32(sumi, scale_0, p16_0);
+            sumi = mul_sum_i16_pairs_acc_int32(sumi, scale_1, p16_1);
 
         }
 
@@ -8036,7 +8673,11 @@ void ggml_vec_dot_q5_K_q8_K(int n, float * restrict s, size_t bs, const void * r
 
 void ggml_vec_dot_q6_K_q8_K(int n, float * restrict s, size_t bs, const void * restrict vx, size_t bx, const void * restrict vy, size_t by, int nrc) {
     assert(n % QK_K == 0);
+#if defined(__AVX2__)
+    assert((nrc == 2) || (nrc == 1));
+#else
     assert(nrc == 1);
+#endif
     UNUSED(nrc);
     UNUSED(bx);
     UNUSED(by);
@@ -8047,6 +8688,84 @@ void ggml_vec_dot_q6_K_q8_K(int n, float * restrict s, size_t bs, const void * r
 
     const int nb = n / QK_K;
 
+#if defined(__AVX2__)
+    if (nrc == 2) {
+        // 2 rows of x with 2 columns of y: the quants of x are unpacked once, and the 32*q8 offsets are computed once
+        const block_q6_K * restrict vx0 = vx;
+        const block_q6_K * restrict vx1 = (const block_q6_K *) ((const uint8_t*)vx + bx);
+        const block_q8_K * restrict vy0 = vy;
+        const block_q8_K * restrict vy1 = (const block_q8_K *) ((const uint8_t*)vy + by);
+
+        const __m256i m4   = _mm256_set1_epi8(0xF);
+        const __m256i m2   = _mm256_set1_epi8(3);
+        const __m256i m32s = _mm256_set1_epi8(32);
+
+        __m256 acc[2][2]; // [row of x][column of y]
+        for (int r = 0; r < 2; r++) {
+            for (int c = 0; c < 2; c++) {
+                acc[r][c] = _mm256_setzero_ps();
+            }
+        }
+
+        for (int i = 0; i < nb; ++i) {
+            const block_q6_K * restrict bx01[2] = { &vx0[i], &vx1[i] };
+            const block_q8_K * restrict by01[2] = { &vy0[i], &vy1[i] };
+
+            const __m128i scales[2] = {
+                _mm_loadu_si128((const __m128i*)bx01[0]->scales),
+                _mm_loadu_si128((const __m128i*)bx01[1]->scales),
+            };
+
+            __m256i sumi[2][2] = {{ _mm256_setzero_si256(), _mm256_setzero_si256() }, { _mm256_setzero_si256(), _mm256_setzero_si256() }};
+
+            for (int j = 0; j < QK_K/128; ++j) {
+                __m256i q8[2][4];
+                __m256i q8s[2][4];
+                for (int c = 0; c < 2; c++) {
+                    for (int l = 0; l < 4; l++) {
+                        q8[c][l]  = _mm256_loadu_si256((const __m256i*)(by01[c]->qs + 128*j + 32*l));
+                        q8s[c][l] = _mm256_maddubs_epi16(m32s, q8[c][l]);
+                    }
+                }
+
+                for (int r = 0; r < 2; r++) {
+                    const __m256i q4bits1 = _mm256_loadu_si256((const __m256i*)(bx01[r]->ql + 64*j));
+                    const __m256i q4bits2 = _mm256_loadu_si256((const __m256i*)(bx01[r]->ql + 64*j + 32));
+                    const __m256i q4bitsH = _mm256_loadu_si256((const __m256i*)(bx01[r]->qh + 32*j));
+
+                    __m256i q6[4];
+                    q6[0] = _mm256_or_si256(_mm256_and_si256(q4bits1, m4), _mm256_slli_epi16(_mm256_and_si256(q4bitsH, m2), 4));
+                    q6[1] = _mm256_or_si256(_mm256_and_si256(q4bits2, m4), _mm256_slli_epi16(_mm256_and_si256(_mm256_srli_epi16(q4bitsH, 2), m2), 4));
+                    q6[2] = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(q4bits1, 4), m4), _mm256_slli_epi16(_mm256_and_si256(_mm256_srli_epi16(q4bitsH, 4), m2), 4));
+                    q6[3] = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(q4bits2, 4), m4), _mm256_slli_epi16(_mm256_and_si256(_mm256_srli_epi16(q4bitsH, 6), m2), 4));
+
+                    for (int l = 0; l < 4; l++) {
+                        const __m256i scale = _mm256_cvtepi8_epi16(_mm_shuffle_epi8(scales[r], get_scale_shuffle(4*j + l)));
+                        for (int c = 0; c < 2; c++) {
+                            const __m256i p16 = _mm256_sub_epi16(_mm256_maddubs_epi16(q6[l], q8[c][l]), q8s[c][l]);
+                            sumi[r][c] = mul_sum_i16_pairs_acc_int32(sumi[r][c], scale, p16);
+                        }
+                    }
+                }
+            }
+
+            for (int r = 0; r < 2; r++) {
+                for (int c = 0; c < 2; c++) {
+                    const __m256 vd = _mm256_set1_ps(by01[c]->d * GGML_FP16_TO_FP32(bx01[r]->d));
+                    acc[r][c] = _mm256_fmadd_ps(vd, _mm256_cvtepi32_ps(sumi[r][c]), acc[r][c]);
+                }
+            }
+        }
+
+        for (int c = 0; c < 2; c++) {
+            for (int r = 0; r < 2; r++) {
+                s[c*bs + r] = hsum_float_8(acc[r][c]);
+            }
+        }
+        return;
+    }
+#endif
+
 #ifdef __ARM_NEON
     float sum = 0;
 
@@ -8160,7 +8879,8 @@ void ggml_vec_dot_q6_K_q8_K(int n, float * restrict s, size_t bs, const void * r
 
         const __m128i scales = _mm_loadu_si128((const __m128i*)x[i].scales);
 
-        __m256i sumi = _mm256_setzero_si256();
+        __m256i sumi_0 = _mm256_setzero_si256();
+        __m256i sumi_1 = _mm256_setzero_si256();
 
         int is = 0;
 
@@ -8206,17 +8926,14 @@ void ggml_vec_dot_q6_K_q8_K(int n, float * restrict s, size_t bs, const void * r
             p16_2 = _mm256_sub_epi16(p16_2, q8s_2);
             p16_3 = _mm256_sub_epi16(p16_3, q8s_3);
 
-            p16_0 = _mm256_madd_epi16(_mm256_cvtepi8_epi16(scale_0), p16_0);
-            p16_1 = _mm256_madd_epi16(_mm256_cvtepi8_epi16(scale_1), p16_1);
-            p16_2 = _mm256_madd_epi16(_mm256_cvtepi8_epi16(scale_2), p16_2);
-            p16_3 = _mm256_madd_epi16(_mm256_cvtepi8_epi16(scale_3), p16_3);
-
-            sumi = _mm256_add_epi32(sumi, _mm256_add_epi32(p16_0, p16_1));
-            sumi = _mm256_add_epi32(sumi, _mm256_add_epi32(p16_2, p16_3));
+            sumi_0 = mul_sum_i16_pairs_acc_int32(sumi_0, _mm256_cvtepi8_epi16(scale_0), p16_0);
+            sumi_1 = mul_sum_i16_pairs_acc_int32(sumi_1, _mm256_cvtepi8_epi16(scale_1), p16_1);
+            sumi_0 = mul_sum_i16_pairs_acc_int32(sumi_0, _mm256_cvtepi8_epi16(scale_2), p16_2);
+            sumi_1 = mul_sum_i16_pairs_acc_int32(sumi_1, _mm256_cvtepi8_epi16(scale_3), p16_3);
 
         }
 
-        acc = _mm256_fmadd_ps(_mm256_broadcast_ss(&d), _mm256_cvtepi32_ps(sumi), acc);
+        acc = _mm256_fmadd_ps(_mm256_broadcast_ss(&d), _mm256_cvtepi32_ps(_mm256_add_epi32(sumi_0, sumi_1)), acc);
     }
 
     *s = hsum_float_8(acc);
@@ -11644,7 +12361,6 @@ void ggml_vec_dot_iq4_nl_q8_0(int n, float * restrict s, size_t bs, const void *
 
     const __m128i values128 = _mm_loadu_si128((const __m128i*)kvalues_iq4nl);
     const __m128i m4b  = _mm_set1_epi8(0x0f);
-    const __m256i mone = _mm256_set1_epi16(1);
 
     __m256 accum1 = _mm256_setzero_ps();
     __m256 accum2 = _mm256_setzero_ps();
@@ -11657,14 +12373,12 @@ void ggml_vec_dot_iq4_nl_q8_0(int n, float * restrict s, size_t bs, const void *
                                               _mm_shuffle_epi8(values128, _mm_and_si128(q4bits_1, m4b)));
         const __m256i q4b_2 = MM256_SET_M128I(_mm_shuffle_epi8(values128, _mm_and_si128(_mm_srli_epi16(q4bits_2, 4), m4b)),
                                               _mm_shuffle_epi8(values128, _mm_and_si128(q4bits_2, m4b)));
-        const __m256i p16_1 = mul_add_epi8(q4b_1, q8b_1);
-        const __m256i p16_2 = mul_add_epi8(q4b_2, q8b_2);
-        const __m256i p_1 = _mm256_madd_epi16(p16_1, mone);
-        const __m256i p_2 = _mm256_madd_epi16(p16_2, mone);
+        const __m256 p_1 = mul_sum_i8_pairs_float(q4b_1, q8b_1);
+        const __m256 p_2 = mul_sum_i8_pairs_float(q4b_2, q8b_2);
         accum1 = _mm256_fmadd_ps(_mm256_set1_ps(GGML_FP16_TO_FP32(y[ib + 0].d)*GGML_FP16_TO_FP32(x[ib + 0].d)),
-                _mm256_cvtepi32_ps(p_1), accum1);
+                p_1, accum1);
         accum2 = _mm256_fmadd_ps(_mm256_set1_ps(GGML_FP16_TO_FP32(y[ib + 1].d)*GGML_FP16_TO_FP32(x[ib + 1].d)),
-                _mm256_cvtepi32_ps(p_2), accum2);
+                p_2, accum2);
     }
 
     sumf = hsum_float_8(_mm256_add_ps(accum1, accum2));
@@ -11878,10 +12592,8 @@ void ggml_vec_dot_iq4_xs_q8_K(int n, float * restrict s, size_t bs, const void *
             const int16_t ls1 = ((x[ibl].scales_l[ib/2] & 0xf) | ((sh << 4) & 0x30)) - 32;
             const int16_t ls2 = ((x[ibl].scales_l[ib/2] >>  4) | ((sh << 2) & 0x30)) - 32;
             sh >>= 4;
-            const __m256i p_1 = _mm256_madd_epi16(p16_1, _mm256_set1_epi16(ls1));
-            const __m256i p_2 = _mm256_madd_epi16(p16_2, _mm256_set1_epi16(ls2));
-            sumi1 = _mm256_add_epi32(p_1, sumi1);
-            sumi2 = _mm256_add_epi32(p_2, sumi2);
+            sumi1 = mul_sum_i16_pairs_acc_int32(sumi1, p16_1, _mm256_set1_epi16(ls1));
+            sumi2 = mul_sum_i16_pairs_acc_int32(sumi2, p16_2, _mm256_set1_epi16(ls2));
         }
         accum = _mm256_fmadd_ps(_mm256_set1_ps(GGML_FP16_TO_FP32(x[ibl].d)*y[ibl].d),
                 _mm256_cvtepi32_ps(_mm256_add_epi32(sumi1, sumi2)), accum);
@@ -14854,6 +15566,24 @@ bool ggml_validate_row_data(enum ggml_type type, const void * data, size_t nbyte
             {
                 VALIDATE_ROW_DATA_DVEC_F16_IMPL(block_q4_0x8, data, nbytes / sizeof(block_q4_0x8), 8);
             } break;
+        case GGML_TYPE_F8_E4M3:
+        case GGML_TYPE_F8_E5M2:
+            {
+                // the NaN codes of E4M3, the inf and NaN codes of E5M2
+                const uint8_t mask = type == GGML_TYPE_F8_E4M3 ? 0x7f : 0x7c;
+                const block_f8 * q = (const block_f8 *) data;
+                for (size_t i = 0; i < nb; ++i) {
+                    if (!validate_fp16(q[i].d, i)) {
+                        return false;
+                    }
+                    for (int j = 0; j < QK_F8; ++j) {
+                        if ((q[i].qs[j] & mask) == mask) {
+                            fprintf(stderr, "%s: found inf or nan value at block %zu\n", __func__, i);
+                            return false;
+                        }
+                    }
+                }
+            } break;
 
         case GGML_TYPE_I8:
         case GGML_TYPE_I16:
@@ -27,6 +27,7 @@
 #include <signal.h>
 #if defined(__gnu_linux__)
 #include <syscall.h>
+#include <linux/futex.h>
 #endif
 
 #ifdef GGML_USE_OPENMP
@@ -48,6 +49,10 @@ int ggml_sve_cnt_b = 0;
 #include <llamafile/sgemm.h>
 #endif
 
+#ifdef GGML_USE_AMX
+#include "ggml-amx.h"
+#endif
+
 #if defined(_MSC_VER)
 // disable "possible loss of data" to avoid hundreds of casts
 // we should just be careful :)
@@ -120,6 +125,19 @@ static int sched_yield (void) {
     Sleep (0);
     return 0;
 }
+
+typedef SRWLOCK ggml_mutex_t;
+typedef CONDITION_VARIABLE ggml_cond_t;
+
+#define ggml_mutex_init(m)     InitializeSRWLock(m)
+#define ggml_mutex_destroy(m)
+#define ggml_mutex_lock(m)     AcquireSRWLockExclusive(m)
+#define ggml_mutex_unlock(m)   ReleaseSRWLockExclusive(m)
+
+#define ggml_cond_init(c)      InitializeConditionVariable(c)
+#define ggml_cond_destroy(c)
+#define ggml_cond_wait(c, m)   SleepConditionVariableSRW(c, m, INFINITE, 0)
+#define ggml_cond_broadcast(c) WakeAllConditionVariable(c)
 #else
 #include <pthread.h>
 #include <stdatomic.h>
@@ -130,6 +148,19 @@ typedef void * thread_ret_t;
 #include <sys/stat.h>
 #include <unistd.h>
 
+typedef pthread_mutex_t ggml_mutex_t;
+typedef pthread_cond_t  ggml_cond_t;
+
+#define ggml_mutex_init(m)     pthread_mutex_init(m, NULL)
+#define ggml_mutex_destroy(m)  pthread_mutex_destroy(m)
+#define ggml_mutex_lock(m)     pthread_mutex_lock(m)
+#define ggml_mutex_unlock(m)   pthread_mutex_unlock(m)
+
+#define ggml_cond_init(c)      pthread_cond_init(c, NULL)
+#define ggml_cond_destroy(c)   pthread_cond_destroy(c)
+#define ggml_cond_wait(c, m)   pthread_cond_wait(c, m)
+#define ggml_cond_broadcast(c) pthread_cond_broadcast(c)
+
 #endif
 
 typedef pthread_t ggml_thread_t;
@@ -633,7 +664,14 @@ static void ggml_vec_dot_f32(int n, float * restrict s, size_t bs, const float *
 static void ggml_vec_dot_f16(int n, float * restrict s, size_t bs, ggml_fp16_t * restrict x, size_t bx, ggml_fp16_t * restrict y, size_t by, int nrc);
 static void ggml_vec_dot_bf16(int n, float * restrict s, size_t bs, ggml_bf16_t * restrict x, size_t bx, ggml_bf16_t * restrict y, size_t by, int nrc);
 
-static const ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
+#if defined(GGML_USE_CPU_VARIANTS)
+// the kernels of the quantized types are replaced in ggml_init by the CPU variant selected in ggml_cpu_variant_init
+#define GGML_TYPE_TRAITS_CONST
+#else
+#define GGML_TYPE_TRAITS_CONST const
+#endif
+
+static GGML_TYPE_TRAITS_CONST ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
     [GGML_TYPE_I8] = {
         .type_name                = "i8",
         .blck_size                = 1,
@@ -700,6 +738,9 @@ static const ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
         .nrows                    = 2,
 #else
         .nrows                    = 1,
+#endif
+#if defined (__AVX2__)
+        .vec_dot_cols             = ggml_vec_dot_q4_0_q8_0_cols,
 #endif
     },
     [GGML_TYPE_Q4_1] = {
@@ -781,6 +822,9 @@ static const ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
         .nrows                    = 2,
 #else
         .nrows                    = 1,
+#endif
+#if defined (__AVX2__)
+        .vec_dot_cols             = ggml_vec_dot_q8_0_q8_0_cols,
 #endif
     },
     [GGML_TYPE_Q8_1] = {
@@ -827,7 +871,11 @@ static const ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
         .from_float_ref           = (ggml_from_float_t) quantize_row_q4_K_ref,
         .vec_dot                  = ggml_vec_dot_q4_K_q8_K,
         .vec_dot_type             = GGML_TYPE_Q8_K,
+#if defined (__AVX2__)
+        .nrows                    = 2,
+#else
         .nrows                    = 1,
+#endif
     },
     [GGML_TYPE_Q5_K] = {
         .type_name                = "q5_K",
@@ -839,7 +887,11 @@ static const ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
         .from_float_ref           = (ggml_from_float_t) quantize_row_q5_K_ref,
         .vec_dot                  = ggml_vec_dot_q5_K_q8_K,
         .vec_dot_type             = GGML_TYPE_Q8_K,
+#if defined (__AVX2__)
+        .nrows                    = 2,
+#else
         .nrows                    = 1,
+#endif
     },
     [GGML_TYPE_Q6_K] = {
         .type_name                = "q6_K",
@@ -851,7 +903,11 @@ static const ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
         .from_float_ref           = (ggml_from_float_t) quantize_row_q6_K_ref,
         .vec_dot                  = ggml_vec_dot_q6_K_q8_K,
         .vec_dot_type             = GGML_TYPE_Q8_K,
+#if defined (__AVX2__)
+        .nrows                    = 2,
+#else
         .nrows                    = 1,
+#endif
     },
     [GGML_TYPE_IQ2_XXS] = {
         .type_name                = "iq2_xxs",
@@ -1027,6 +1083,36 @@ static const ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
         .ncols                    = 8,
         .gemv                     = ggml_gemv_q4_0_8x8_q8_0,
         .gemm                     = ggml_gemm_q4_0_8x8_q8_0,
+    },
+    [GGML_TYPE_F8_E4M3] = {
+        .type_name                = "f8_e4m3",
+        .blck_size                = QK_F8,
+        .type_size                = sizeof(block_f8),
+        .is_quantized             = true,
+        .to_float                 = (ggml_to_float_t) dequantize_row_f8_e4m3,
+        .from_float               = quantize_row_f8_e4m3,
+        .from_float_ref           = (ggml_from_float_t) quantize_row_f8_e4m3_ref,
+        .vec_dot                  = ggml_vec_dot_f8_e4m3_f16,
+        .vec_dot_type             = GGML_TYPE_F16,
+        .nrows                    = 1,
+#if defined (__AVX2__) && defined (__F16C__)
+        .vec_dot_cols             = ggml_vec_dot_f8_e4m3_f16_cols,
+#endif
+    },
+    [GGML_TYPE_F8_E5M2] = {
+        .type_name                = "f8_e5m2",
+        .blck_size                = QK_F8,
+        .type_size                = sizeof(block_f8),
+        .is_quantized             = true,
+        .to_float                 = (ggml_to_float_t) dequantize_row_f8_e5m2,
+        .from_float               = quantize_row_f8_e5m2,
+        .from_float_ref           = (ggml_from_float_t) quantize_row_f8_e5m2_ref,
+        .vec_dot                  = ggml_vec_dot_f8_e5m2_f16,
+        .vec_dot_type             = GGML_TYPE_F16,
+        .nrows                    = 1,
+#if defined (__AVX2__) && defined (__F16C__)
+        .vec_dot_cols             = ggml_vec_dot_f8_e5m2_f16_cols,
+#endif
     }
 };
 
@@ -1036,6 +1122,96 @@ ggml_type_traits_t ggml_internal_get_type_traits(enum ggml_type type) {
     return type_traits[type];
 }
 
+//
+// CPU variants
+//
+
+#if defined(GGML_USE_CPU_VARIANTS)
+
+#include <cpuid.h>
+
+struct ggml_cpu_variant {
+    const char * name;
+    void (*init)(ggml_type_traits_t * traits);
+    bool avx_vnni;
+    bool avx512;
+    bool avx512_vnni;
+};
+
+// in order of preference, all of them require AVX2, FMA and F16C
+static const struct ggml_cpu_variant ggml_cpu_variants[] = {
+    { "avx512_vnni", ggml_quants_variant_init_avx512_vnni, false, true,  true  },
+    { "avx512",      ggml_quants_variant_init_avx512,      false, true,  false },
+    { "avx_vnni",    ggml_quants_variant_init_avx_vnni,    true,  false, false },
+    { "avx2",        ggml_quants_variant_init_avx2,        false, false, false },
+};
+
+static const struct ggml_cpu_variant * ggml_cpu_variant = NULL;
+
+static void ggml_cpu_variant_init(void) {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return;
+    }
+
+    const bool fma     = ecx & (1u << 12);
+    const bool osxsave = ecx & (1u << 27);
+    const bool avx     = ecx & (1u << 28);
+    const bool f16c    = ecx & (1u << 29);
+
+    if (!osxsave || !avx) {
+        return;
+    }
+
+    // the OS must save the YMM and, for AVX512, the opmask and ZMM registers
+    unsigned int xcr0_lo, xcr0_hi;
+    __asm__ __volatile__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+    const bool os_avx    = (xcr0_lo & 0x06) == 0x06;
+    const bool os_avx512 = (xcr0_lo & 0xe6) == 0xe6;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return;
+    }
+
+    const bool avx2        = ebx & (1u << 5);
+    const bool avx512      = (ebx & (1u << 16)) && (ebx & (1u << 17)) && (ebx & (1u << 30)) && (ebx & (1u << 31)) && os_avx512; // F, DQ, BW, VL
+    const bool avx512_vnni = ecx & (1u << 11);
+
+    bool avx_vnni = false;
+    if (__get_cpuid_count(7, 1, &eax, &ebx, &ecx, &edx)) {
+        avx_vnni = eax & (1u << 4);
+    }
+
+    if (!os_avx || !avx2 || !fma || !f16c) {
+        return;
+    }
+
+    // GGML_CPU_VARIANT=<name> selects a variant explicitly, e.g. to compare them on one machine
+    const char * name = getenv("GGML_CPU_VARIANT");
+
+    for (size_t i = 0; i < sizeof(ggml_cpu_variants)/sizeof(ggml_cpu_variants[0]); ++i) {
+        const struct ggml_cpu_variant * variant = &ggml_cpu_variants[i];
+
+        if ((variant->avx_vnni    && !avx_vnni) ||
+            (variant->avx512      && !avx512)   ||
+            (variant->avx512_vnni && !avx512_vnni)) {
+            continue;
+        }
+        if (name && *name && strcmp(name, variant->name) != 0) {
+            continue;
+        }
+
+        variant->init(type_traits);
+        ggml_cpu_variant = variant;
+
+        GGML_PRINT_DEBUG("%s: using the %s CPU variant\n", __func__, variant->name);
+        break;
+    }
+}
+
+#endif
+
 //
 // simd mappings
 //
@@ -1846,10 +2022,24 @@ static inline void __lsx_f16x4_store(ggml_fp16_t * x, __m128 y) {
 // ggml context
 //
 
+// memory added to the pool of a context when it is full, see ggml_set_mem_grow
+struct ggml_mem_chunk {
+    struct ggml_mem_chunk * next; // previous chunk of the context, or next recycled chunk
+    size_t size;                  // size of the memory of the chunk
+    size_t offs;                  // offset of the memory of the chunk in the offsets of the objects of the context
+};
+
+// the memory of a chunk follows it
+#define GGML_MEM_CHUNK_HEADER_SIZE GGML_PAD(sizeof(struct ggml_mem_chunk), GGML_MEM_ALIGN)
+
 struct ggml_context {
     size_t mem_size;
     void* mem_buffer;
     bool   mem_buffer_owned;
+    size_t mem_grow;    // minimum size of the chunks added to the pool when it is full, 0 = the pool does not grow
+    bool   mem_recycle; // the chunks are recycled when the context is freed
+    struct ggml_mem_chunk * chunks; // the most recent first
+    struct ggml_mem_chunk * chunks_spare; // chunks kept by ggml_reset, in the order they are reused
     bool   no_alloc;
     bool   no_alloc_save; // this is used to save the no_alloc state when using scratch buffers
 
@@ -1860,6 +2050,8 @@ struct ggml_context {
 
     struct ggml_scratch scratch;
     struct ggml_scratch scratch_save;
+
+    struct ggml_context_name_index * name_index; // NULL unless enabled with ggml_set_name_index
 };
 
 struct ggml_context_container {
@@ -1868,28 +2060,109 @@ struct ggml_context_container {
     struct ggml_context context;
 };
 
-struct ggml_compute_state_shared {
-    const struct ggml_cgraph * cgraph;
-    const struct ggml_cplan * cplan;
+// chunks of the freed contexts that recycle them, protected by the critical section
+static struct ggml_mem_chunk * ggml_recycled_chunks = NULL;
+
+// the memory of an object follows it, in the memory pool of its context or in a chunk
+static inline void * ggml_object_data(struct ggml_object * obj) {
+    return (char *) obj + GGML_OBJECT_SIZE;
+}
 
-    int n_threads;
+static inline struct ggml_object * ggml_data_object(void * data) {
+    return (struct ggml_object *) ((char *) data - GGML_OBJECT_SIZE);
+}
+
+// number of spin iterations per polling level
+// the threads spin for poll*GGML_POLL_SPIN_ITER iterations before going to sleep
+#define GGML_POLL_SPIN_ITER 64
+
+// use of the converted src1 of a mul_mat shared with the next mul_mats, see ggml_src1_cache_next
+enum ggml_src1_cache_mode {
+    GGML_SRC1_CACHE_NONE,  // src1 is converted at the start of the work buffer, if needed
+    GGML_SRC1_CACHE_STORE, // src1 is converted in the src1 cache at the end of the work buffer
+    GGML_SRC1_CACHE_LOAD,  // src1 was converted in the src1 cache by a previous mul_mat
+};
+
+// a step of the computation of a graph: a node and the nodes fused after it, computed together
+struct ggml_graph_step {
+    int  node_n;  // index of the node in the graph
+    int  n_fused; // number of nodes fused after the node, see ggml_graph_fuse
+    bool sync;    // a barrier is needed after the step
+
+    enum ggml_src1_cache_mode src1_cache;
+};
+
+// threadpool shared by the worker threads of ggml_graph_compute()
+// the workers are created once and parked on a condition variable between graphs
+struct ggml_threadpool {
+    ggml_mutex_t mutex;       // mutex for cond.var
+    ggml_cond_t  cond;        // cond.var for waiting for new work
+
+    ggml_mutex_t graph_mutex; // serializes the graphs of the callers sharing the threadpool
+
+    ggml_mutex_t barrier_mutex; // used for sleeping in ggml_barrier when futexes are not available
+    ggml_cond_t  barrier_cond;
+
+    const struct ggml_cgraph * cgraph;
+    const struct ggml_cplan  * cplan;
 
     // synchronization primitives
+    atomic_int n_graph;       // incremented when there is work to be done (i.e each graph)
+    atomic_int n_active;      // number of secondary threads still working on the current graph
     atomic_int n_barrier;
     atomic_int n_barrier_passed;
+    atomic_int n_barrier_sleepers; // number of threads sleeping in ggml_barrier
 
-    ggml_abort_callback abort_callback; // abort ggml_graph_compute when true
-    void * abort_callback_data;
+    bool stop;                // used for stopping the threadpool altogether, protected by mutex
+    bool pause;               // used for pausing the threadpool, protected by mutex
 
-    atomic_int current_chunk; // currently processing chunk during mul_mat, shared between all the threads
+    struct ggml_compute_state * workers; // per thread state
+    int n_threads_max;        // number of threads in the pool
+    int n_threads_cur;        // number of threads used in the current graph
+
+    int32_t  prio;            // scheduling priority
+    uint32_t poll;            // polling level (0 - no polling)
+    uint32_t n_spin;          // number of spin iterations before sleeping
+
+    // steps of the current graph, see ggml_graph_schedule
+    const struct ggml_graph_step * steps;
+    int                            n_steps;
+    struct ggml_graph_step       * steps_buf; // storage for the steps of the graphs that are not captured, grown as needed
+    int                            steps_size;
+
+    // per node counters for the dynamic work distribution (see ggml_chunk_iter), zeroed for each graph
+    // on NUMA systems each graph node also has one counter per NUMA node (see ggml_chunk_claim_numa)
+    atomic_int * node_chunks;
+    int          node_chunks_size;
+    int          node_chunks_stride; // counters per graph node
 
     enum ggml_status ec;
+
+    // ggml_graph_compute_async: the graphs are submitted to a separate thread that takes the role of the main thread
+    // at most one graph is in flight, protected by async_mutex
+    ggml_mutex_t         async_mutex;
+    ggml_cond_t          async_cond;
+    ggml_thread_t        async_thrd;
+    bool                 async_started; // the thread is created with the first async graph
+    bool                 async_stop;
+    bool                 async_busy;    // a graph is pending or being computed
+    struct ggml_cgraph * async_cgraph;
+    struct ggml_cplan  * async_cplan;
+    enum ggml_status     async_ec;      // status of the last async graph
 };
 
 struct ggml_compute_state {
     ggml_thread_t thrd;
+    bool cpumask[GGML_MAX_N_THREADS]; // all-zeros: no placement
+    int last_graph;
     int ith;
-    struct ggml_compute_state_shared * shared;
+    struct ggml_threadpool * threadpool;
+
+    // barrier statistics, updated only by the owning thread
+    int64_t n_barriers;
+    int64_t n_sleeps;
+    int64_t t_spin_us;
+    int64_t t_sleep_us;
 };
 
 struct ggml_compute_params {
@@ -1900,9 +2173,122 @@ struct ggml_compute_params {
     size_t wsize;
     void * wdata;
 
-    struct ggml_compute_state_shared * shared;
+    struct ggml_threadpool * threadpool;
+
+    // chunk counters of the current node, shared between all the threads
+    atomic_int * chunk;
+
+    // NUMA node the thread runs on, 0 if not NUMA
+    int numa_node;
+
+    // ops to apply to the rows of dst, see ggml_compute_forward_fused
+    struct ggml_fused_ops * fused;
+
+    // mul_mat: where src1 is converted, see ggml_src1_cache_next
+    enum ggml_src1_cache_mode src1_cache;
+};
+
+//
+// dynamic work distribution
+//
+// the rows of a node are split in chunks, each thread processes the chunk ith first and then keeps
+// taking the next unprocessed chunk from the node counter until there are none left
+// this way the faster threads (e.g. on P-cores) end up processing more rows than the slower ones,
+// instead of the slowest thread setting the pace of the whole node
+//
+// usage:
+//
+//   struct ggml_chunk_iter it = ggml_chunk_iter_init(params, nr, row_cost);
+//
+//   int64_t ir0, ir1;
+//   while (ggml_chunk_iter_next(params, &it, &ir0, &ir1)) {
+//       for (int64_t ir = ir0; ir < ir1; ir++) {
+//           ...
+//       }
+//   }
+//
+
+// target cost of a chunk, in number of elements processed
+#define GGML_CHUNK_COST (16*1024)
+
+// max number of chunks per thread, limits the contention on the counter
+#define GGML_CHUNK_MAX_PER_THREAD 8
+
+struct ggml_chunk_iter {
+    int64_t nr;     // number of rows
+    int64_t dr;     // number of rows per chunk
+    int64_t nchunk; // number of chunks
+    int64_t chunk;  // current chunk, -1 before the first one
 };
 
+// returns the index of the next unprocessed chunk
+// the chunks [0, nth) are implicitly taken by the threads with the same index
+static inline int64_t ggml_chunk_claim(const struct ggml_compute_params * params) {
+    return params->nth + atomic_fetch_add(params->chunk, 1);
+}
+
+// row_cost is the approximate number of elements processed per row
+static struct ggml_chunk_iter ggml_chunk_iter_init(const struct ggml_compute_params * params, int64_t nr, int64_t row_cost) {
+    const int nth = params->nth;
+
+    int64_t nchunk = nth;
+
+    // chunking by thread was measured to perform better on NUMA systems, see ggml_compute_forward_mul_mat
+    if (nth > 1 && !ggml_is_numa()) {
+        nchunk = nr*MAX(row_cost, 1)/GGML_CHUNK_COST;
+        nchunk = MIN(MAX(nchunk, nth), (int64_t) nth*GGML_CHUNK_MAX_PER_THREAD);
+    }
+
+    const int64_t dr = MAX(1, (nr + nchunk - 1)/nchunk);
+
+    return (struct ggml_chunk_iter) { nr, dr, (nr + dr - 1)/dr, -1 };
+}
+
+// NUMA: the chunks are split in one contiguous block of nchunk_node chunks per NUMA node
+// a thread first takes the chunks of the block of its own node, then helps the other nodes
+// returns the index of the next unprocessed chunk, or a value >= n_nodes*nchunk_node when none are left
+static int64_t ggml_chunk_claim_numa(const struct ggml_compute_params * params, int n_nodes, int64_t nchunk_node) {
+    for (int i = 0; i < n_nodes; i++) {
+        const int node = (params->numa_node + i) % n_nodes;
+        const int64_t chunk = atomic_fetch_add(&params->chunk[1 + node], 1);
+        if (chunk < nchunk_node) {
+            return node*nchunk_node + chunk;
+        }
+    }
+    return n_nodes*nchunk_node;
+}
+
+// the data of src local to the NUMA node of the thread (see ggml_backend_cpu_numa_buffer_type)
+static inline const char * ggml_compute_src_data(const struct ggml_compute_params * params, const struct ggml_tensor * src) {
+    if (params->numa_node > 0) {
+        const void * data = ggml_backend_cpu_numa_replica(src, params->numa_node);
+        if (data != NULL) {
+            return data;
+        }
+    }
+    return src->data;
+}
+
+// returns false when there are no more rows to process
+static bool ggml_chunk_iter_next(const struct ggml_compute_params * params, struct ggml_chunk_iter * it, int64_t * ir0, int64_t * ir1) {
+    if (it->chunk < 0) {
+        it->chunk = params->ith;
+    } else if (it->nchunk > params->nth) {
+        it->chunk = ggml_chunk_claim(params);
+    } else {
+        return false;
+    }
+
+    if (it->chunk >= it->nchunk) {
+        return false;
+    }
+
+    *ir0 = it->chunk*it->dr;
+    *ir1 = MIN(*ir0 + it->dr, it->nr);
+
+    return true;
+}
+
 //
 // fundamental operations
 //
@@ -2975,7 +3361,6 @@ static_assert(sizeof(struct ggml_tensor)%GGML_MEM_ALIGN == 0, "ggml_tensor size
 // NUMA support
 //
 
-#define GGML_NUMA_MAX_NODES 8
 #define GGML_NUMA_MAX_CPUS 512
 
 struct ggml_numa_node {
@@ -3017,47 +3402,93 @@ inline static void ggml_critical_section_start(void) {
     }
 }
 
-#ifdef GGML_USE_OPENMP
-static void ggml_barrier(struct ggml_compute_state_shared * shared) {
-    if (shared->n_threads == 1) {
-        return;
-    }
+static inline void ggml_thread_cpu_relax(void) {
+#if defined(__SSE3__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    __asm__ volatile("yield" ::: "memory");
+#endif
+}
 
-    #pragma omp barrier
+// sleep until n_barrier_passed changes from passed_old
+static void ggml_barrier_sleep(struct ggml_threadpool * tp, int passed_old) {
+#if defined(__gnu_linux__)
+    while (atomic_load(&tp->n_barrier_passed) == passed_old) {
+        syscall(SYS_futex, &tp->n_barrier_passed, FUTEX_WAIT_PRIVATE, passed_old, NULL, NULL, 0);
+    }
+#else
+    ggml_mutex_lock(&tp->barrier_mutex);
+    while (atomic_load(&tp->n_barrier_passed) == passed_old) {
+        ggml_cond_wait(&tp->barrier_cond, &tp->barrier_mutex);
+    }
+    ggml_mutex_unlock(&tp->barrier_mutex);
+#endif
 }
+
+static void ggml_barrier_wake(struct ggml_threadpool * tp) {
+#if defined(__gnu_linux__)
+    syscall(SYS_futex, &tp->n_barrier_passed, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
 #else
-static void ggml_barrier(struct ggml_compute_state_shared * shared) {
-    if (shared->n_threads == 1) {
+    ggml_mutex_lock(&tp->barrier_mutex);
+    ggml_cond_broadcast(&tp->barrier_cond);
+    ggml_mutex_unlock(&tp->barrier_mutex);
+#endif
+}
+
+// hybrid barrier: spin for tp->n_spin iterations, then sleep until the last thread arrives
+static void ggml_barrier(const struct ggml_compute_params * params) {
+    struct ggml_threadpool * tp = params->threadpool;
+
+    const int n_threads = tp->n_threads_cur;
+    if (n_threads == 1) {
         return;
     }
 
-    atomic_int * n_barrier = &shared->n_barrier;
-    atomic_int * n_barrier_passed = &shared->n_barrier_passed;
+    atomic_int * n_barrier = &tp->n_barrier;
+    atomic_int * n_barrier_passed = &tp->n_barrier_passed;
 
-    int n_threads = shared->n_threads;
-    int passed_old = atomic_load(n_barrier_passed);
+    const int passed_old = atomic_load(n_barrier_passed);
 
     if (atomic_fetch_add(n_barrier, 1) == n_threads - 1) {
         // last thread
         atomic_store(n_barrier, 0);
         atomic_fetch_add(n_barrier_passed, 1);
-    } else {
-        // wait for other threads
-        const int n_spin_before_sleep = 100000;
-        while (true) {
-            for (int i = 0; i < n_spin_before_sleep; i++) {
-                if (atomic_load(n_barrier_passed) != passed_old) {
-                    return;
-                }
-            #if defined(__SSE3__)
-                _mm_pause();
-            #endif
-            }
-            sched_yield();
+
+        if (atomic_load(&tp->n_barrier_sleepers) > 0) {
+            ggml_barrier_wake(tp);
+        }
+        return;
+    }
+
+    // wait for other threads
+    struct ggml_compute_state * state = &tp->workers[params->ith];
+
+    const int64_t t_start = ggml_time_us();
+
+    state->n_barriers++;
+
+    const uint32_t n_spin = tp->n_spin;
+    for (uint32_t i = 0; i < n_spin; i++) {
+        if (atomic_load(n_barrier_passed) != passed_old) {
+            state->t_spin_us += ggml_time_us() - t_start;
+            return;
         }
+        ggml_thread_cpu_relax();
     }
+
+    const int64_t t_sleep = ggml_time_us();
+
+    state->n_sleeps++;
+    state->t_spin_us += t_sleep - t_start;
+
+    // the last thread checks n_barrier_sleepers after incrementing n_barrier_passed,
+    // so either it sees us here or we see the new value of n_barrier_passed
+    atomic_fetch_add(&tp->n_barrier_sleepers, 1);
+    ggml_barrier_sleep(tp, passed_old);
+    atomic_fetch_sub(&tp->n_barrier_sleepers, 1);
+
+    state->t_sleep_us += ggml_time_us() - t_sleep;
 }
-#endif
 
 // TODO: make this somehow automatically executed
 //       some sort of "sentry" mechanism
@@ -3172,6 +3603,30 @@ bool ggml_is_numa(void) {
     return g_state.numa.n_nodes > 1;
 }
 
+uint32_t ggml_numa_n_nodes(void) {
+    return g_state.numa.n_nodes;
+}
+
+// node of the cpu the calling thread is running on
+static int ggml_numa_current_node(void) {
+#if defined(__gnu_linux__)
+    unsigned int cpu  = 0;
+    unsigned int node = 0;
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ > 28) || defined(__COSMOPOLITAN__)
+    if (getcpu(&cpu, &node) != 0) {
+        return 0;
+    }
+#else
+    if (syscall(SYS_getcpu, &cpu, &node) != 0) {
+        return 0;
+    }
+#endif
+    return node < g_state.numa.n_nodes ? (int) node : 0;
+#else
+    return 0;
+#endif
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void ggml_print_object(const struct ggml_object * obj) {
@@ -3352,6 +3807,8 @@ enum ggml_type ggml_ftype_to_ggml_type(enum ggml_ftype ftype) {
         case GGML_FTYPE_MOSTLY_Q4_0_4_4:      wtype = GGML_TYPE_Q4_0_4_4; break;
         case GGML_FTYPE_MOSTLY_Q4_0_4_8:      wtype = GGML_TYPE_Q4_0_4_8; break;
         case GGML_FTYPE_MOSTLY_Q4_0_8_8:      wtype = GGML_TYPE_Q4_0_8_8; break;
+        case GGML_FTYPE_MOSTLY_F8_E4M3:       wtype = GGML_TYPE_F8_E4M3;  break;
+        case GGML_FTYPE_MOSTLY_F8_E5M2:       wtype = GGML_TYPE_F8_E5M2;  break;
         case GGML_FTYPE_UNKNOWN:              wtype = GGML_TYPE_COUNT; break;
         case GGML_FTYPE_MOSTLY_Q4_1_SOME_F16: wtype = GGML_TYPE_COUNT; break;
     }
@@ -3489,77 +3946,378 @@ static inline int ggml_up(int n, int m) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-struct ggml_context * ggml_init(struct ggml_init_params params) {
-    // make this function thread safe
-    ggml_critical_section_start();
+// tensor name index, see ggml_set_name_index
+// open addressing hash tables of names, the names are not stored: an entry keeps the hash of the name and the first
+// tensor with the name, lookups compare the name of the tensor and fall back to a linear search when it is not known
 
-    static bool is_first_call = true;
+struct ggml_name_index_entry {
+    uint64_t hash;                // 0 = empty
+    struct ggml_tensor * tensor;  // first tensor with the name, NULL = not known
+    int32_t count;                // context: number of tensors with the name, graph: position of the tensor, -1 = not known
+};
 
-    if (is_first_call) {
-        // initialize time system (required on Windows)
-        ggml_time_init();
+struct ggml_name_index {
+    struct ggml_name_index_entry * entries; // [size]
+    size_t size;                            // power of 2
+    size_t n_entries;
+};
 
-        // initialize GELU, Quick GELU, SILU and EXP F32 tables
-        {
-            const uint64_t t_start = ggml_time_us(); UNUSED(t_start);
+// index of the leafs and nodes of a graph, built on the first ggml_graph_get_tensor and extended when nodes are added
+struct ggml_graph_name_index {
+    const struct ggml_cgraph * graph;
+    int n_leafs;
+    int n_nodes;
+    struct ggml_name_index index;
+};
 
-            for (int i = 0; i < (1 << 16); ++i) {
-                union {
-                    uint16_t u16;
-                    ggml_fp16_t fp16;
-                } u = {i};
-                float f = ggml_table_f32_f16[i] = GGML_COMPUTE_FP16_TO_FP32(u.fp16);
-                ggml_table_gelu_f16[i] = GGML_FP32_TO_FP16(ggml_gelu_f32(f));
-                ggml_table_gelu_quick_f16[i] = GGML_FP32_TO_FP16(ggml_gelu_quick_f32(f));
-            }
+struct ggml_context_name_index {
+    struct ggml_name_index tensors;
+    struct ggml_graph_name_index * graphs; // [n_graphs]
+    int n_graphs;
+};
 
-            const uint64_t t_end = ggml_time_us(); UNUSED(t_end);
+// number of contexts with a name index, ggml_set_name does nothing more when there is none
+static int ggml_n_name_index = 0;
 
-            GGML_PRINT_DEBUG("%s: GELU, Quick GELU, SILU and EXP tables initialized in %f ms\n", __func__, (t_end - t_start)/1000.0f);
-        }
+static uint64_t ggml_name_hash(const char * name) {
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const char * p = name; *p; p++) {
+        h = (h ^ (uint8_t) *p) * 0x100000001b3ULL;
+    }
+    return h | 1;
+}
 
-        // initialize g_state
-        {
-            const uint64_t t_start = ggml_time_us(); UNUSED(t_start);
+static void ggml_name_index_free(struct ggml_name_index * index) {
+    free(index->entries);
+    *index = (struct ggml_name_index) { NULL, 0, 0 };
+}
 
-            g_state = (struct ggml_state) {
-                /*.contexts =*/ { { 0 } },
-                /*.numa =*/ {
-                    .n_nodes = 0,
-                    .total_cpus = 0,
-                },
-            };
+// entry of the hash or the empty entry where it goes
+static struct ggml_name_index_entry * ggml_name_index_find(struct ggml_name_index * index, uint64_t hash) {
+    const size_t mask = index->size - 1;
+    size_t i = hash & mask;
+    while (index->entries[i].hash != 0 && index->entries[i].hash != hash) {
+        i = (i + 1) & mask;
+    }
+    return &index->entries[i];
+}
 
-            for (int i = 0; i < GGML_MAX_CONTEXTS; ++i) {
-                g_state.contexts[i].used = false;
+// returns the entry of the hash, new entries are zero-initialized
+static struct ggml_name_index_entry * ggml_name_index_insert(struct ggml_name_index * index, uint64_t hash) {
+    if (2*(index->n_entries + 1) > index->size) {
+        struct ggml_name_index old = *index;
+        index->size = MAX(64, 2*old.size);
+        index->entries = calloc(index->size, sizeof(struct ggml_name_index_entry));
+        GGML_ASSERT(index->entries != NULL);
+        for (size_t i = 0; i < old.size; i++) {
+            if (old.entries[i].hash != 0) {
+                *ggml_name_index_find(index, old.entries[i].hash) = old.entries[i];
             }
-
-            const uint64_t t_end = ggml_time_us(); UNUSED(t_end);
-
-            GGML_PRINT_DEBUG("%s: g_state initialized in %f ms\n", __func__, (t_end - t_start)/1000.0f);
         }
-
-        is_first_call = false;
+        free(old.entries);
     }
-
-    // find non-used context in g_state
-    struct ggml_context * ctx = NULL;
-
-    for (int i = 0; i < GGML_MAX_CONTEXTS; i++) {
-        if (!g_state.contexts[i].used) {
-            g_state.contexts[i].used = true;
-            ctx = &g_state.contexts[i].context;
-
-            GGML_PRINT_DEBUG("%s: found unused context %d\n", __func__, i);
-            break;
-        }
+    struct ggml_name_index_entry * entry = ggml_name_index_find(index, hash);
+    if (entry->hash == 0) {
+        *entry = (struct ggml_name_index_entry) { hash, NULL, 0 };
+        index->n_entries++;
     }
+    return entry;
+}
+
+static struct ggml_name_index_entry * ggml_name_index_get(struct ggml_name_index * index, const char * name) {
+    if (index->size == 0) {
+        return NULL;
+    }
+    struct ggml_name_index_entry * entry = ggml_name_index_find(index, ggml_name_hash(name));
+    return entry->hash != 0 ? entry : NULL;
+}
+
+// the context whose memory contains ptr, if it has a name index
+static struct ggml_context * ggml_name_index_ctx(const void * ptr) {
+    if (ggml_n_name_index == 0) {
+        return NULL;
+    }
+    for (int i = 0; i < GGML_MAX_CONTEXTS; i++) {
+        struct ggml_context * ctx = &g_state.contexts[i].context;
+        if (!g_state.contexts[i].used || ctx->name_index == NULL) {
+            continue;
+        }
+        if ((const char *) ptr >= (const char *) ctx->mem_buffer && (const char *) ptr < (const char *) ctx->mem_buffer + ctx->mem_size) {
+            return ctx;
+        }
+        for (const struct ggml_mem_chunk * chunk = ctx->chunks; chunk != NULL; chunk = chunk->next) {
+            if ((const char *) ptr >= (const char *) chunk && (const char *) ptr < (const char *) chunk + GGML_MEM_CHUNK_HEADER_SIZE + chunk->size) {
+                return ctx;
+            }
+        }
+    }
+    return NULL;
+}
+
+// the tensors are indexed under their current name, empty names are not indexed
+static void ggml_name_index_add(struct ggml_context * ctx, struct ggml_tensor * tensor) {
+    if (tensor->name[0] == '\0') {
+        return;
+    }
+    struct ggml_name_index_entry * entry = ggml_name_index_insert(&ctx->name_index->tensors, ggml_name_hash(tensor->name));
+    // the offsets of the objects of a context are increasing, also in its chunks
+    if (entry->count == 0 || (entry->tensor != NULL && ggml_data_object(tensor)->offs < ggml_data_object(entry->tensor)->offs)) {
+        entry->tensor = tensor;
+    }
+    entry->count++;
+}
+
+static void ggml_name_index_remove(struct ggml_context * ctx, struct ggml_tensor * tensor) {
+    if (tensor->name[0] == '\0') {
+        return;
+    }
+    struct ggml_name_index_entry * entry = ggml_name_index_get(&ctx->name_index->tensors, tensor->name);
+    if (entry == NULL) {
+        return;
+    }
+    entry->count--;
+    if (entry->tensor == tensor) {
+        entry->tensor = NULL;
+    }
+}
+
+static void ggml_name_index_ctx_free(struct ggml_context * ctx) {
+    ggml_name_index_free(&ctx->name_index->tensors);
+    for (int i = 0; i < ctx->name_index->n_graphs; i++) {
+        ggml_name_index_free(&ctx->name_index->graphs[i].index);
+    }
+    free(ctx->name_index->graphs);
+    free(ctx->name_index);
+    ctx->name_index = NULL;
+}
+
+static void ggml_graph_name_index_add(struct ggml_name_index * index, struct ggml_tensor * tensor, int32_t pos) {
+    if (tensor->name[0] == '\0') {
+        return;
+    }
+    struct ggml_name_index_entry * entry = ggml_name_index_insert(index, ggml_name_hash(tensor->name));
+    if (entry->count != -1 && (entry->tensor == NULL || pos < entry->count)) {
+        entry->tensor = tensor;
+        entry->count  = pos;
+    }
+}
+
+// a tensor of the graph may now be the first one with its name, or not anymore:
+// the first tensor with the name is searched again on the next lookup
+static void ggml_graph_name_index_invalidate(struct ggml_tensor * tensor) {
+    if (tensor->name[0] == '\0') {
+        return;
+    }
+    const uint64_t hash = ggml_name_hash(tensor->name);
+    for (int i = 0; i < GGML_MAX_CONTEXTS; i++) {
+        struct ggml_context * ctx = &g_state.contexts[i].context;
+        if (!g_state.contexts[i].used || ctx->name_index == NULL) {
+            continue;
+        }
+        for (int j = 0; j < ctx->name_index->n_graphs; j++) {
+            struct ggml_graph_name_index * gindex = &ctx->name_index->graphs[j];
+            if (ggml_hash_contains(&gindex->graph->visited_hash_set, tensor)) {
+                struct ggml_name_index_entry * entry = ggml_name_index_insert(&gindex->index, hash);
+                entry->tensor = NULL;
+                entry->count  = -1;
+            }
+        }
+    }
+}
+
+// called before and after the name of a tensor changes, returns the context to pass to ggml_name_index_end_rename
+static struct ggml_context * ggml_name_index_begin_rename(struct ggml_tensor * tensor) {
+    if (ggml_n_name_index == 0) {
+        return NULL;
+    }
+    ggml_graph_name_index_invalidate(tensor);
+    struct ggml_context * ctx = ggml_name_index_ctx(tensor);
+    if (ctx != NULL) {
+        ggml_name_index_remove(ctx, tensor);
+    }
+    return ctx;
+}
+
+static void ggml_name_index_end_rename(struct ggml_context * ctx, struct ggml_tensor * tensor) {
+    if (ggml_n_name_index == 0) {
+        return;
+    }
+    ggml_graph_name_index_invalidate(tensor);
+    if (ctx != NULL) {
+        ggml_name_index_add(ctx, tensor);
+    }
+}
+
+// the nodes of the graph are replaced: the graph is indexed again on the next lookup
+static void ggml_graph_name_index_reset(struct ggml_cgraph * cgraph) {
+    if (ggml_n_name_index == 0 || cgraph->size == 0) {
+        return;
+    }
+    struct ggml_context * ctx = ggml_name_index_ctx(cgraph);
+    if (ctx == NULL) {
+        return;
+    }
+    for (int i = 0; i < ctx->name_index->n_graphs; i++) {
+        struct ggml_graph_name_index * gindex = &ctx->name_index->graphs[i];
+        if (gindex->graph == cgraph) {
+            ggml_name_index_free(&gindex->index);
+            gindex->n_leafs = 0;
+            gindex->n_nodes = 0;
+        }
+    }
+}
+
+// the index of the graph brought up to date with its leafs and nodes, NULL if its context has no name index
+static struct ggml_graph_name_index * ggml_graph_name_index(struct ggml_cgraph * cgraph) {
+    if (cgraph->size == 0) {
+        // graph view
+        return NULL;
+    }
+    struct ggml_context * ctx = ggml_name_index_ctx(cgraph);
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    struct ggml_context_name_index * cindex = ctx->name_index;
+    struct ggml_graph_name_index * gindex = NULL;
+    for (int i = 0; i < cindex->n_graphs; i++) {
+        if (cindex->graphs[i].graph == cgraph) {
+            gindex = &cindex->graphs[i];
+            break;
+        }
+    }
+    if (gindex == NULL) {
+        cindex->graphs = realloc(cindex->graphs, (cindex->n_graphs + 1) * sizeof(struct ggml_graph_name_index));
+        GGML_ASSERT(cindex->graphs != NULL);
+        gindex = &cindex->graphs[cindex->n_graphs++];
+        *gindex = (struct ggml_graph_name_index) { cgraph, 0, 0, { NULL, 0, 0 } };
+    }
+
+    if (cgraph->n_leafs < gindex->n_leafs || cgraph->n_nodes < gindex->n_nodes) {
+        // the graph has been cleared
+        ggml_name_index_free(&gindex->index);
+        gindex->n_leafs = 0;
+        gindex->n_nodes = 0;
+    }
+    for (int i = gindex->n_leafs; i < cgraph->n_leafs; i++) {
+        ggml_graph_name_index_add(&gindex->index, cgraph->leafs[i], i);
+    }
+    for (int i = gindex->n_nodes; i < cgraph->n_nodes; i++) {
+        ggml_graph_name_index_add(&gindex->index, cgraph->nodes[i], cgraph->size + i);
+    }
+    gindex->n_leafs = cgraph->n_leafs;
+    gindex->n_nodes = cgraph->n_nodes;
+
+    return gindex;
+}
+
+void ggml_set_name_index(struct ggml_context * ctx, bool enable) {
+    if (enable == (ctx->name_index != NULL)) {
+        return;
+    }
+
+    ggml_critical_section_start();
+
+    if (enable) {
+        ctx->name_index = calloc(1, sizeof(struct ggml_context_name_index));
+        GGML_ASSERT(ctx->name_index != NULL);
+        ggml_n_name_index++;
+
+        for (struct ggml_object * obj = ctx->objects_begin; obj != NULL; obj = obj->next) {
+            if (obj->type == GGML_OBJECT_TYPE_TENSOR) {
+                ggml_name_index_add(ctx, (struct ggml_tensor *) ggml_object_data(obj));
+            }
+        }
+    } else {
+        ggml_name_index_ctx_free(ctx);
+        ggml_n_name_index--;
+    }
+
+    ggml_critical_section_end();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct ggml_context * ggml_init(struct ggml_init_params params) {
+    // make this function thread safe
+    ggml_critical_section_start();
+
+    static bool is_first_call = true;
+
+    if (is_first_call) {
+        // initialize time system (required on Windows)
+        ggml_time_init();
+
+        // initialize GELU, Quick GELU, SILU and EXP F32 tables
+        {
+            const uint64_t t_start = ggml_time_us(); UNUSED(t_start);
+
+            for (int i = 0; i < (1 << 16); ++i) {
+                union {
+                    uint16_t u16;
+                    ggml_fp16_t fp16;
+                } u = {i};
+                float f = ggml_table_f32_f16[i] = GGML_COMPUTE_FP16_TO_FP32(u.fp16);
+                ggml_table_gelu_f16[i] = GGML_FP32_TO_FP16(ggml_gelu_f32(f));
+                ggml_table_gelu_quick_f16[i] = GGML_FP32_TO_FP16(ggml_gelu_quick_f32(f));
+            }
+
+            const uint64_t t_end = ggml_time_us(); UNUSED(t_end);
+
+            GGML_PRINT_DEBUG("%s: GELU, Quick GELU, SILU and EXP tables initialized in %f ms\n", __func__, (t_end - t_start)/1000.0f);
+        }
+
+        // initialize g_state
+        {
+            const uint64_t t_start = ggml_time_us(); UNUSED(t_start);
+
+            g_state = (struct ggml_state) {
+                /*.contexts =*/ { { 0 } },
+                /*.numa =*/ {
+                    .n_nodes = 0,
+                    .total_cpus = 0,
+                },
+            };
+
+            for (int i = 0; i < GGML_MAX_CONTEXTS; ++i) {
+                g_state.contexts[i].used = false;
+            }
+
+            const uint64_t t_end = ggml_time_us(); UNUSED(t_end);
+
+            GGML_PRINT_DEBUG("%s: g_state initialized in %f ms\n", __func__, (t_end - t_start)/1000.0f);
+        }
+
+#if defined(GGML_USE_CPU_VARIANTS)
+        ggml_cpu_variant_init();
+#endif
+
+#if defined(GGML_USE_AMX)
+        ggml_amx_init();
+#endif
+
+        is_first_call = false;
+    }
+
+    // find non-used context in g_state
+    struct ggml_context * ctx = NULL;
+
+    for (int i = 0; i < GGML_MAX_CONTEXTS; i++) {
+        if (!g_state.contexts[i].used) {
+            g_state.contexts[i].used = true;
+            ctx = &g_state.contexts[i].context;
+
+            GGML_PRINT_DEBUG("%s: found unused context %d\n", __func__, i);
+            break;
+        }
+    }
+
+    if (ctx == NULL) {
+        GGML_PRINT_DEBUG("%s: no unused context found\n", __func__);
+
+        ggml_critical_section_end();
 
-    if (ctx == NULL) {
-        GGML_PRINT_DEBUG("%s: no unused context found\n", __func__);
-
-        ggml_critical_section_end();
-
         return NULL;
     }
 
@@ -3574,6 +4332,10 @@ struct ggml_context * ggml_init(struct ggml_init_params params) {
         /*.mem_size           =*/ mem_size,
         /*.mem_buffer         =*/ params.mem_buffer ? params.mem_buffer : GGML_ALIGNED_MALLOC(mem_size),
         /*.mem_buffer_owned   =*/ params.mem_buffer ? false : true,
+        /*.mem_grow           =*/ 0,
+        /*.mem_recycle        =*/ false,
+        /*.chunks             =*/ NULL,
+        /*.chunks_spare       =*/ NULL,
         /*.no_alloc           =*/ params.no_alloc,
         /*.no_alloc_save      =*/ params.no_alloc,
         /*.n_objects          =*/ 0,
@@ -3581,6 +4343,7 @@ struct ggml_context * ggml_init(struct ggml_init_params params) {
         /*.objects_end        =*/ NULL,
         /*.scratch            =*/ { 0, 0, NULL, },
         /*.scratch_save       =*/ { 0, 0, NULL, },
+        /*.name_index         =*/ NULL,
     };
 
     GGML_ASSERT(ctx->mem_buffer != NULL);
@@ -3600,6 +4363,20 @@ struct ggml_context * ggml_init(struct ggml_init_params params) {
     return ctx;
 }
 
+// called in the critical section
+static void ggml_free_context_chunks(struct ggml_context * ctx, struct ggml_mem_chunk * chunks) {
+    while (chunks != NULL) {
+        struct ggml_mem_chunk * chunk = chunks;
+        chunks = chunk->next;
+        if (ctx->mem_recycle) {
+            chunk->next = ggml_recycled_chunks;
+            ggml_recycled_chunks = chunk;
+        } else {
+            GGML_ALIGNED_FREE(chunk);
+        }
+    }
+}
+
 void ggml_free(struct ggml_context * ctx) {
     if (ctx == NULL) {
         return;
@@ -3621,6 +4398,16 @@ void ggml_free(struct ggml_context * ctx) {
                 GGML_ALIGNED_FREE(ctx->mem_buffer);
             }
 
+            ggml_free_context_chunks(ctx, ctx->chunks);
+            ggml_free_context_chunks(ctx, ctx->chunks_spare);
+            ctx->chunks       = NULL;
+            ctx->chunks_spare = NULL;
+
+            if (ctx->name_index != NULL) {
+                ggml_name_index_ctx_free(ctx);
+                ggml_n_name_index--;
+            }
+
             found = true;
             break;
         }
@@ -3633,6 +4420,66 @@ void ggml_free(struct ggml_context * ctx) {
     ggml_critical_section_end();
 }
 
+void ggml_reset(struct ggml_context * ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+
+    ctx->n_objects     = 0;
+    ctx->objects_begin = NULL;
+    ctx->objects_end   = NULL;
+
+    // the chunks are reused in the same order by the next objects
+    while (ctx->chunks != NULL) {
+        struct ggml_mem_chunk * chunk = ctx->chunks;
+        ctx->chunks = chunk->next;
+        chunk->next = ctx->chunks_spare;
+        ctx->chunks_spare = chunk;
+    }
+
+    if (ctx->name_index != NULL) {
+        struct ggml_context_name_index * cindex = ctx->name_index;
+        if (cindex->tensors.size > 0) {
+            memset(cindex->tensors.entries, 0, cindex->tensors.size*sizeof(struct ggml_name_index_entry));
+            cindex->tensors.n_entries = 0;
+        }
+        for (int i = 0; i < cindex->n_graphs; i++) {
+            ggml_name_index_free(&cindex->graphs[i].index);
+        }
+        cindex->n_graphs = 0;
+    }
+}
+
+#if defined(_MSC_VER)
+#define GGML_THREAD_LOCAL __declspec(thread)
+#else
+#define GGML_THREAD_LOCAL _Thread_local
+#endif
+
+// see ggml_graph_arena
+static GGML_THREAD_LOCAL struct ggml_context * ggml_thread_arena = NULL;
+
+struct ggml_context * ggml_graph_arena(struct ggml_init_params params) {
+    GGML_ASSERT(params.mem_buffer == NULL);
+
+    if (ggml_thread_arena == NULL) {
+        ggml_thread_arena = ggml_init(params);
+        GGML_ASSERT(ggml_thread_arena != NULL);
+        ggml_set_mem_grow(ggml_thread_arena, params.mem_size, false);
+    } else {
+        ggml_reset(ggml_thread_arena);
+    }
+
+    ggml_set_no_alloc(ggml_thread_arena, params.no_alloc);
+
+    return ggml_thread_arena;
+}
+
+void ggml_graph_arena_free(void) {
+    ggml_free(ggml_thread_arena);
+    ggml_thread_arena = NULL;
+}
+
 size_t ggml_used_mem(const struct ggml_context * ctx) {
     return ctx->objects_end == NULL ? 0 : ctx->objects_end->offs + ctx->objects_end->size;
 }
@@ -3658,7 +4505,24 @@ void * ggml_get_mem_buffer(const struct ggml_context * ctx) {
 }
 
 size_t ggml_get_mem_size(const struct ggml_context * ctx) {
-    return ctx->mem_size;
+    return ctx->chunks == NULL ? ctx->mem_size : ctx->chunks->offs + ctx->chunks->size;
+}
+
+void ggml_set_mem_grow(struct ggml_context * ctx, size_t chunk_size, bool recycle) {
+    ctx->mem_grow    = chunk_size;
+    ctx->mem_recycle = recycle;
+}
+
+void ggml_free_mem_chunks(void) {
+    ggml_critical_section_start();
+
+    while (ggml_recycled_chunks != NULL) {
+        struct ggml_mem_chunk * chunk = ggml_recycled_chunks;
+        ggml_recycled_chunks = chunk->next;
+        GGML_ALIGNED_FREE(chunk);
+    }
+
+    ggml_critical_section_end();
 }
 
 size_t ggml_get_max_tensor_size(const struct ggml_context * ctx) {
@@ -3695,27 +4559,74 @@ static void ggml_scratch_load(struct ggml_context * ctx) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// adds a chunk of at least size bytes to the memory pool of the context
+static struct ggml_mem_chunk * ggml_new_mem_chunk(struct ggml_context * ctx, size_t size) {
+    size = GGML_PAD(MAX(size, ctx->mem_grow), GGML_MEM_ALIGN);
+
+    struct ggml_mem_chunk * chunk = NULL;
+
+    for (struct ggml_mem_chunk ** p = &ctx->chunks_spare; *p != NULL; p = &(*p)->next) {
+        if ((*p)->size >= size) {
+            chunk = *p;
+            *p = chunk->next;
+            break;
+        }
+    }
+
+    if (chunk == NULL && ctx->mem_recycle) {
+        ggml_critical_section_start();
+        for (struct ggml_mem_chunk ** p = &ggml_recycled_chunks; *p != NULL; p = &(*p)->next) {
+            if ((*p)->size >= size) {
+                chunk = *p;
+                *p = chunk->next;
+                break;
+            }
+        }
+        ggml_critical_section_end();
+    }
+
+    if (chunk == NULL) {
+        chunk = GGML_ALIGNED_MALLOC(GGML_MEM_CHUNK_HEADER_SIZE + size);
+        GGML_ASSERT(chunk != NULL);
+        chunk->size = size;
+    }
+
+    // the offsets of the objects keep increasing in the chunks
+    chunk->offs = ggml_get_mem_size(ctx);
+    chunk->next = ctx->chunks;
+    ctx->chunks = chunk;
+
+    return chunk;
+}
+
 static struct ggml_object * ggml_new_object(struct ggml_context * ctx, enum ggml_object_type type, size_t size) {
     // always insert objects at the end of the context's memory pool
     struct ggml_object * obj_cur = ctx->objects_end;
 
     const size_t cur_offs = obj_cur == NULL ? 0 : obj_cur->offs;
     const size_t cur_size = obj_cur == NULL ? 0 : obj_cur->size;
-    const size_t cur_end  = cur_offs + cur_size;
+    size_t       cur_end  = cur_offs + cur_size;
 
     // align to GGML_MEM_ALIGN
     size_t size_needed = GGML_PAD(size, GGML_MEM_ALIGN);
 
-    char * const mem_buffer = ctx->mem_buffer;
-    struct ggml_object * const obj_new = (struct ggml_object *)(mem_buffer + cur_end);
+    // the objects are added to the last chunk, if any
+    struct ggml_mem_chunk * chunk = ctx->chunks;
 
-    if (cur_end + size_needed + GGML_OBJECT_SIZE > ctx->mem_size) {
-        GGML_PRINT("%s: not enough space in the context's memory pool (needed %zu, available %zu)\n",
-                __func__, cur_end + size_needed, ctx->mem_size);
-        assert(false);
-        return NULL;
+    if (cur_end + size_needed + GGML_OBJECT_SIZE > ggml_get_mem_size(ctx)) {
+        if (ctx->mem_grow == 0) {
+            GGML_PRINT("%s: not enough space in the context's memory pool (needed %zu, available %zu)\n",
+                    __func__, cur_end + size_needed, ctx->mem_size);
+            assert(false);
+            return NULL;
+        }
+        chunk   = ggml_new_mem_chunk(ctx, size_needed + GGML_OBJECT_SIZE);
+        cur_end = chunk->offs;
     }
 
+    char * const mem_buffer = chunk == NULL ? (char *) ctx->mem_buffer : (char *) chunk + GGML_MEM_CHUNK_HEADER_SIZE;
+    struct ggml_object * const obj_new = (struct ggml_object *)(mem_buffer + (chunk == NULL ? cur_end : cur_end - chunk->offs));
+
     *obj_new = (struct ggml_object) {
         .offs = cur_end + GGML_OBJECT_SIZE,
         .size = size_needed,
@@ -3723,7 +4634,7 @@ static struct ggml_object * ggml_new_object(struct ggml_context * ctx, enum ggml
         .type = type,
     };
 
-    GGML_ASSERT_ALIGNED(mem_buffer + obj_new->offs);
+    GGML_ASSERT_ALIGNED(ggml_object_data(obj_new));
 
     if (obj_cur != NULL) {
         obj_cur->next = obj_new;
@@ -3794,7 +4705,7 @@ static struct ggml_tensor * ggml_new_tensor_impl(
 
     // TODO: for recoverable errors, we would need to free the data allocated from the scratch buffer here
 
-    struct ggml_tensor * const result = (struct ggml_tensor *)((char *)ctx->mem_buffer + obj_new->offs);
+    struct ggml_tensor * const result = (struct ggml_tensor *) ggml_object_data(obj_new);
 
 #ifdef __clang__
     // temporary until ggml_tensor::backend is removed
@@ -4382,19 +5293,27 @@ const char * ggml_get_name(const struct ggml_tensor * tensor) {
 }
 
 struct ggml_tensor * ggml_set_name(struct ggml_tensor * tensor, const char * name) {
+    struct ggml_context * ctx = ggml_name_index_begin_rename(tensor);
+
     size_t i;
     for (i = 0; i < sizeof(tensor->name) - 1 && name[i] != '\0'; i++) {
         tensor->name[i] = name[i];
     }
     tensor->name[i] = '\0';
+
+    ggml_name_index_end_rename(ctx, tensor);
     return tensor;
 }
 
 struct ggml_tensor * ggml_format_name(struct ggml_tensor * tensor, const char * fmt, ...) {
+    struct ggml_context * ctx = ggml_name_index_begin_rename(tensor);
+
     va_list args;
     va_start(args, fmt);
     vsnprintf(tensor->name, sizeof(tensor->name), fmt, args);
     va_end(args);
+
+    ggml_name_index_end_rename(ctx, tensor);
     return tensor;
 }
 
@@ -4414,11 +5333,9 @@ struct ggml_tensor * ggml_view_tensor(
 struct ggml_tensor * ggml_get_first_tensor(const struct ggml_context * ctx) {
     struct ggml_object * obj = ctx->objects_begin;
 
-    char * const mem_buffer = ctx->mem_buffer;
-
     while (obj != NULL) {
         if (obj->type == GGML_OBJECT_TYPE_TENSOR) {
-            return (struct ggml_tensor *)(mem_buffer + obj->offs);
+            return (struct ggml_tensor *) ggml_object_data(obj);
         }
 
         obj = obj->next;
@@ -4428,14 +5345,14 @@ struct ggml_tensor * ggml_get_first_tensor(const struct ggml_context * ctx) {
 }
 
 struct ggml_tensor * ggml_get_next_tensor(const struct ggml_context * ctx, struct ggml_tensor * tensor) {
-    struct ggml_object * obj = (struct ggml_object *) ((char *)tensor - GGML_OBJECT_SIZE);
-    obj = obj->next;
+    GGML_UNUSED(ctx);
 
-    char * const mem_buffer = ctx->mem_buffer;
+    struct ggml_object * obj = ggml_data_object(tensor);
+    obj = obj->next;
 
     while (obj != NULL) {
         if (obj->type == GGML_OBJECT_TYPE_TENSOR) {
-            return (struct ggml_tensor *)(mem_buffer + obj->offs);
+            return (struct ggml_tensor *) ggml_object_data(obj);
         }
 
         obj = obj->next;
@@ -4444,14 +5361,12 @@ struct ggml_tensor * ggml_get_next_tensor(const struct ggml_context * ctx, struc
     return NULL;
 }
 
-struct ggml_tensor * ggml_get_tensor(struct ggml_context * ctx, const char * name) {
+static struct ggml_tensor * ggml_get_tensor_linear(struct ggml_context * ctx, const char * name) {
     struct ggml_object * obj = ctx->objects_begin;
 
-    char * const mem_buffer = ctx->mem_buffer;
-
     while (obj != NULL) {
         if (obj->type == GGML_OBJECT_TYPE_TENSOR) {
-            struct ggml_tensor * cur = (struct ggml_tensor *)(mem_buffer + obj->offs);
+            struct ggml_tensor * cur = (struct ggml_tensor *) ggml_object_data(obj);
             if (strcmp(cur->name, name) == 0) {
                 return cur;
             }
@@ -4463,6 +5378,22 @@ struct ggml_tensor * ggml_get_tensor(struct ggml_context * ctx, const char * nam
     return NULL;
 }
 
+struct ggml_tensor * ggml_get_tensor(struct ggml_context * ctx, const char * name) {
+    if (ctx->name_index == NULL || name[0] == '\0') {
+        return ggml_get_tensor_linear(ctx, name);
+    }
+
+    struct ggml_name_index_entry * entry = ggml_name_index_get(&ctx->name_index->tensors, name);
+    if (entry == NULL || entry->count <= 0) {
+        return NULL;
+    }
+    if (entry->tensor == NULL || strcmp(entry->tensor->name, name) != 0) {
+        // the first tensor with the name has been renamed, or the hash of another name is the same
+        entry->tensor = ggml_get_tensor_linear(ctx, name);
+    }
+    return entry->tensor;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 // ggml_dup
@@ -9715,6 +10646,8 @@ static void ggml_compute_forward_add(
         case GGML_TYPE_Q4_0_4_4:
         case GGML_TYPE_Q4_0_4_8:
         case GGML_TYPE_Q4_0_8_8:
+        case GGML_TYPE_F8_E4M3:
+        case GGML_TYPE_F8_E5M2:
             {
                 ggml_compute_forward_add_q_f32(params, dst);
             } break;
@@ -10093,6 +11026,8 @@ static void ggml_compute_forward_add1(
         case GGML_TYPE_Q4_0_4_4:
         case GGML_TYPE_Q4_0_4_8:
         case GGML_TYPE_Q4_0_8_8:
+        case GGML_TYPE_F8_E4M3:
+        case GGML_TYPE_F8_E5M2:
             {
                 ggml_compute_forward_add1_q_f32(params, dst);
             } break;
@@ -10132,7 +11067,7 @@ static void ggml_compute_forward_acc_f32(
                 ((char *) src0->data),
                 ggml_nbytes(dst));
         }
-        ggml_barrier(params->shared);
+        ggml_barrier(params);
     }
 
     const int ith = params->ith;
@@ -10221,6 +11156,8 @@ static void ggml_compute_forward_acc(
         case GGML_TYPE_Q4_0_4_4:
         case GGML_TYPE_Q4_0_4_8:
         case GGML_TYPE_Q4_0_8_8:
+        case GGML_TYPE_F8_E4M3:
+        case GGML_TYPE_F8_E5M2:
         default:
             {
                 GGML_ABORT("fatal error");
@@ -12005,6 +12942,145 @@ static void ggml_compute_forward_hardsigmoid(
     }
 }
 
+// ggml_compute_forward_fused
+//
+// a chain of element-wise nodes marked by ggml_graph_fuse is computed in a single pass over the rows of the
+// first node of the chain (the head): the ops of the chain are applied to a block of a row while it is in the
+// cache and only the result of the last node is written
+// norm and rms_norm apply the ops to each row as soon as they have computed it, for the other heads the ops are
+// applied in a second pass after the head has been computed
+// note: mul_mat is not handled like norm, its chunks are usually only 16 columns wide and the overhead of applying
+//       the ops to such short segments was measured to be higher than the cost of the second pass
+
+// max number of nodes fused after a head
+#define GGML_FUSE_MAX_OPS 4
+
+// number of elements of a row processed at once
+// a multiple of the SIMD width, so that the vectorized functions (e.g. ggml_vec_silu_f32) give the same results
+// as when they are applied to the whole row
+#define GGML_FUSE_BLOCK 256
+
+struct ggml_fused_ops {
+    struct ggml_tensor ** nodes;   // nodes of the chain after the head
+    int                   n;
+    bool                  applied; // set by the head when it has applied the ops to its rows
+};
+
+// applies the fused ops to the row (i01, i02, i03) of head
+static void ggml_compute_forward_fused_apply(
+        const struct ggml_tensor * head,
+        const struct ggml_fused_ops * fused,
+        int64_t i01, int64_t i02, int64_t i03) {
+
+    const struct ggml_tensor * last = fused->nodes[fused->n - 1];
+
+    const float * x = (const float *) ((const char *) head->data + i01*head->nb[1] + i02*head->nb[2] + i03*head->nb[3]);
+          float * y = (float *)       ((char *)       last->data + i01*last->nb[1] + i02*last->nb[2] + i03*last->nb[3]);
+
+    float tmp[GGML_FUSE_BLOCK];
+
+    for (int64_t ib = 0; ib < head->ne[0]; ib += GGML_FUSE_BLOCK) {
+        const int n = (int) MIN(GGML_FUSE_BLOCK, head->ne[0] - ib);
+
+        memcpy(tmp, x + ib, n*sizeof(float));
+
+        const struct ggml_tensor * prev = head;
+
+        for (int k = 0; k < fused->n; k++) {
+            const struct ggml_tensor * node = fused->nodes[k];
+
+            switch (node->op) {
+                case GGML_OP_ADD:
+                case GGML_OP_SUB:
+                case GGML_OP_MUL:
+                case GGML_OP_DIV:
+                    {
+                        // the other operand is broadcast across the rows
+                        const struct ggml_tensor * src1 = node->src[0] == prev ? node->src[1] : node->src[0];
+
+                        const int64_t i11 = i01 < src1->ne[1] ? i01 : i01 % src1->ne[1];
+                        const int64_t i12 = i02 < src1->ne[2] ? i02 : i02 % src1->ne[2];
+                        const int64_t i13 = i03 < src1->ne[3] ? i03 : i03 % src1->ne[3];
+
+                        const float * y1 = (const float *) ((const char *) src1->data + i11*src1->nb[1] + i12*src1->nb[2] + i13*src1->nb[3]) + ib;
+
+                        switch (node->op) {
+                            case GGML_OP_ADD: ggml_vec_add_f32(n, tmp, tmp, y1); break;
+                            case GGML_OP_SUB: ggml_vec_sub_f32(n, tmp, tmp, y1); break;
+                            case GGML_OP_MUL: ggml_vec_mul_f32(n, tmp, tmp, y1); break;
+                            case GGML_OP_DIV: ggml_vec_div_f32(n, tmp, tmp, y1); break;
+                            default: break;
+                        }
+                    } break;
+                case GGML_OP_SCALE:
+                    {
+                        float v;
+                        memcpy(&v, node->op_params, sizeof(float));
+                        ggml_vec_scale_f32(n, tmp, v);
+                    } break;
+                case GGML_OP_DIAG_MASK_INF:
+                case GGML_OP_DIAG_MASK_ZERO:
+                    {
+                        const int   n_past = ((const int32_t *) node->op_params)[0];
+                        const float value  = node->op == GGML_OP_DIAG_MASK_INF ? -INFINITY : 0.0f;
+
+                        for (int i = 0; i < n; i++) {
+                            if (ib + i > n_past + i01) {
+                                tmp[i] = value;
+                            }
+                        }
+                    } break;
+                case GGML_OP_UNARY:
+                    {
+                        switch (ggml_get_unary_op(node)) {
+                            case GGML_UNARY_OP_NEG:        ggml_vec_neg_f32       (n, tmp, tmp); break;
+                            case GGML_UNARY_OP_TANH:       ggml_vec_tanh_f32      (n, tmp, tmp); break;
+                            case GGML_UNARY_OP_RELU:       ggml_vec_relu_f32      (n, tmp, tmp); break;
+                            case GGML_UNARY_OP_SIGMOID:    ggml_vec_sigmoid_f32   (n, tmp, tmp); break;
+                            case GGML_UNARY_OP_GELU:       ggml_vec_gelu_f32      (n, tmp, tmp); break;
+                            case GGML_UNARY_OP_GELU_QUICK: ggml_vec_gelu_quick_f32(n, tmp, tmp); break;
+                            case GGML_UNARY_OP_SILU:       ggml_vec_silu_f32      (n, tmp, tmp); break;
+                            default:
+                                GGML_ABORT("fatal error");
+                        }
+                    } break;
+                default:
+                    {
+                        GGML_ABORT("fatal error");
+                    }
+            }
+
+            prev = node;
+        }
+
+        memcpy(y + ib, tmp, n*sizeof(float));
+    }
+}
+
+// applies the fused ops to all the rows of head
+static void ggml_compute_forward_fused_rows(
+        const struct ggml_compute_params * params,
+        const struct ggml_tensor * head,
+        const struct ggml_fused_ops * fused) {
+
+    const int64_t ne0 = head->ne[0];
+    const int64_t ne1 = head->ne[1];
+    const int64_t ne2 = head->ne[2];
+    const int64_t ne3 = head->ne[3];
+
+    struct ggml_chunk_iter it = ggml_chunk_iter_init(params, ne1*ne2*ne3, ne0*fused->n);
+
+    int64_t ir0, ir1;
+    while (ggml_chunk_iter_next(params, &it, &ir0, &ir1)) {
+        for (int64_t ir = ir0; ir < ir1; ir++) {
+            const int64_t i3 = ir/(ne2*ne1);
+            const int64_t i2 = (ir - i3*ne2*ne1)/ne1;
+            const int64_t i1 = (ir - i3*ne2*ne1 - i2*ne1);
+
+            ggml_compute_forward_fused_apply(head, fused, i1, i2, i3);
+        }
+    }
+}
 
 // ggml_compute_forward_norm
 
@@ -12018,9 +13094,6 @@ static void ggml_compute_forward_norm_f32(
 
     GGML_ASSERT(src0->nb[0] == sizeof(float));
 
-    const int ith = params->ith;
-    const int nth = params->nth;
-
     GGML_TENSOR_UNARY_OP_LOCALS
 
     float eps;
@@ -12028,32 +13101,45 @@ static void ggml_compute_forward_norm_f32(
 
     GGML_ASSERT(eps > 0.0f);
 
-    // TODO: optimize
-    for (int64_t i03 = 0; i03 < ne03; i03++) {
-        for (int64_t i02 = 0; i02 < ne02; i02++) {
-            for (int64_t i01 = ith; i01 < ne01; i01 += nth) {
-                const float * x = (float *) ((char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
+    struct ggml_fused_ops * fused = params->fused;
+    if (fused) {
+        fused->applied = true;
+    }
 
-                ggml_float sum = 0.0;
-                for (int64_t i00 = 0; i00 < ne00; i00++) {
-                    sum += (ggml_float)x[i00];
-                }
+    struct ggml_chunk_iter it = ggml_chunk_iter_init(params, ne01*ne02*ne03, ne00);
 
-                float mean = sum/ne00;
+    int64_t ir0, ir1;
+    while (ggml_chunk_iter_next(params, &it, &ir0, &ir1)) {
+        for (int64_t ir = ir0; ir < ir1; ir++) {
+            const int64_t i03 = ir/(ne02*ne01);
+            const int64_t i02 = (ir - i03*ne02*ne01)/ne01;
+            const int64_t i01 = (ir - i03*ne02*ne01 - i02*ne01);
 
-                float * y = (float *) ((char *) dst->data + i01*nb1 + i02*nb2 + i03*nb3);
+            const float * x = (float *) ((char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
 
-                ggml_float sum2 = 0.0;
-                for (int64_t i00 = 0; i00 < ne00; i00++) {
-                    float v = x[i00] - mean;
-                    y[i00] = v;
-                    sum2 += (ggml_float)(v*v);
-                }
+            ggml_float sum = 0.0;
+            for (int64_t i00 = 0; i00 < ne00; i00++) {
+                sum += (ggml_float)x[i00];
+            }
+
+            float mean = sum/ne00;
+
+            float * y = (float *) ((char *) dst->data + i01*nb1 + i02*nb2 + i03*nb3);
+
+            ggml_float sum2 = 0.0;
+            for (int64_t i00 = 0; i00 < ne00; i00++) {
+                float v = x[i00] - mean;
+                y[i00] = v;
+                sum2 += (ggml_float)(v*v);
+            }
 
-                float variance = sum2/ne00;
-                const float scale = 1.0f/sqrtf(variance + eps);
+            float variance = sum2/ne00;
+            const float scale = 1.0f/sqrtf(variance + eps);
 
-                ggml_vec_scale_f32(ne00, y, scale);
+            ggml_vec_scale_f32(ne00, y, scale);
+
+            if (fused) {
+                ggml_compute_forward_fused_apply(dst, fused, i01, i02, i03);
             }
         }
     }
@@ -12089,9 +13175,6 @@ static void ggml_compute_forward_rms_norm_f32(
 
     GGML_ASSERT(src0->nb[0] == sizeof(float));
 
-    const int ith = params->ith;
-    const int nth = params->nth;
-
     GGML_TENSOR_UNARY_OP_LOCALS
 
     float eps;
@@ -12099,29 +13182,42 @@ static void ggml_compute_forward_rms_norm_f32(
 
     GGML_ASSERT(eps > 0.0f);
 
-    // TODO: optimize
-    for (int64_t i03 = 0; i03 < ne03; i03++) {
-        for (int64_t i02 = 0; i02 < ne02; i02++) {
-            for (int64_t i01 = ith; i01 < ne01; i01 += nth) {
-                const float * x = (float *) ((char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
+    struct ggml_fused_ops * fused = params->fused;
+    if (fused) {
+        fused->applied = true;
+    }
 
-                ggml_float sum = 0.0;
-                for (int64_t i00 = 0; i00 < ne00; i00++) {
-                    sum += (ggml_float)(x[i00] * x[i00]);
-                }
+    struct ggml_chunk_iter it = ggml_chunk_iter_init(params, ne01*ne02*ne03, ne00);
+
+    int64_t ir0, ir1;
+    while (ggml_chunk_iter_next(params, &it, &ir0, &ir1)) {
+        for (int64_t ir = ir0; ir < ir1; ir++) {
+            const int64_t i03 = ir/(ne02*ne01);
+            const int64_t i02 = (ir - i03*ne02*ne01)/ne01;
+            const int64_t i01 = (ir - i03*ne02*ne01 - i02*ne01);
+
+            const float * x = (float *) ((char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
 
-                const float mean = sum/ne00;
+            ggml_float sum = 0.0;
+            for (int64_t i00 = 0; i00 < ne00; i00++) {
+                sum += (ggml_float)(x[i00] * x[i00]);
+            }
+
+            const float mean = sum/ne00;
+
+            float * y = (float *) ((char *) dst->data + i01*nb1 + i02*nb2 + i03*nb3);
 
-                float * y = (float *) ((char *) dst->data + i01*nb1 + i02*nb2 + i03*nb3);
+            memcpy(y, x, ne00 * sizeof(float));
+            // for (int i00 = 0; i00 < ne00; i00++) {
+            //     y[i00] = x[i00];
+            // }
 
-                memcpy(y, x, ne00 * sizeof(float));
-                // for (int i00 = 0; i00 < ne00; i00++) {
-                //     y[i00] = x[i00];
-                // }
+            const float scale = 1.0f/sqrtf(mean + eps);
 
-                const float scale = 1.0f/sqrtf(mean + eps);
+            ggml_vec_scale_f32(ne00, y, scale);
 
-                ggml_vec_scale_f32(ne00, y, scale);
+            if (fused) {
+                ggml_compute_forward_fused_apply(dst, fused, i01, i02, i03);
             }
         }
     }
@@ -12415,6 +13511,22 @@ static void ggml_compute_forward_group_norm(
 
 // ggml_compute_forward_mul_mat
 
+// max number of columns of src1 computed with one pass over the rows of src0, see vec_dot_cols
+#define GGML_MUL_MAT_MAX_COLS 32
+
+// src1 converted to vec_dot_type: at the start of the work buffer, or in the src1 cache at its end when the
+// conversion is shared with other mul_mats (see ggml_src1_cache_next)
+static char * ggml_mul_mat_src1_wdata(const struct ggml_compute_params * params, const struct ggml_tensor * src1, enum ggml_type vec_dot_type) {
+    if (params->src1_cache == GGML_SRC1_CACHE_NONE) {
+        return params->wdata;
+    }
+
+    const size_t size = ggml_row_size(vec_dot_type, ggml_nelements(src1));
+    GGML_ASSERT(params->wsize >= size + CACHE_LINE_SIZE);
+
+    return (char *) params->wdata + ((params->wsize - size) & ~(size_t) (CACHE_LINE_SIZE - 1));
+}
+
 static void ggml_compute_forward_mul_mat_one_chunk(
     const struct ggml_compute_params * params,
     struct ggml_tensor * dst,
@@ -12434,6 +13546,7 @@ static void ggml_compute_forward_mul_mat_one_chunk(
     const bool src1_cont = ggml_is_contiguous(src1);
 
     ggml_vec_dot_t const vec_dot      = type_traits[type].vec_dot;
+    ggml_vec_dot_t const vec_dot_cols = type_traits[type].vec_dot_cols;
     enum ggml_type const vec_dot_type = type_traits[type].vec_dot_type;
 
     // broadcast factors
@@ -12447,7 +13560,9 @@ static void ggml_compute_forward_mul_mat_one_chunk(
         return;
     }
 
-    const void * wdata = (src1->type == vec_dot_type) ? src1->data : params->wdata;
+    const char * src0_data = ggml_compute_src_data(params, src0);
+
+    const void * wdata = (src1->type == vec_dot_type) ? src1->data : ggml_mul_mat_src1_wdata(params, src1, vec_dot_type);
     const size_t row_size = ggml_row_size(vec_dot_type, ne10);
 
     assert(ne12 % ne02 == 0);
@@ -12459,6 +13574,28 @@ static void ggml_compute_forward_mul_mat_one_chunk(
 
     const size_t src1_col_stride = src1_cont || src1->type != vec_dot_type ? row_size : nb11;
 
+    // small batches (e.g. the decode of several sequences): each row of src0 is read once and dotted with all the
+    // columns of the chunk, instead of once per block of 16 columns
+    if (vec_dot_cols && ir1_end - ir1_start <= GGML_MUL_MAT_MAX_COLS &&
+        ir1_start/ne1 == (ir1_end - 1)/ne1) {
+        const int64_t i13 = (ir1_start / (ne12 * ne1));
+        const int64_t i12 = (ir1_start - i13 * ne12 * ne1) / ne1;
+        const int64_t i11 = (ir1_start - i13 * ne12 * ne1 - i12 * ne1);
+
+        const char * src0_row = src0_data + (i12 / r2) * nb02 + (i13 / r3) * nb03;
+
+        const char * src1_col = (const char *) wdata +
+            (src1_cont || src1->type != vec_dot_type
+                ? (i11 + i12 * ne11 + i13 * ne12 * ne11) * row_size
+                : (i11 * nb11 + i12 * nb12 + i13 * nb13));
+        float * dst_col = (float *) ((char *) dst->data + (i11 * nb1 + i12 * nb2 + i13 * nb3));
+
+        for (int64_t ir0 = ir0_start; ir0 < ir0_end; ++ir0) {
+            vec_dot_cols(ne00, &dst_col[ir0], nb1/nb0, src0_row + ir0 * nb01, 0, src1_col, src1_col_stride, ir1_end - ir1_start);
+        }
+        return;
+    }
+
     // attempt to reduce false-sharing (does not seem to make a difference)
     // 16 * 2, accounting for mmla kernels
     float tmp[32];
@@ -12478,7 +13615,7 @@ static void ggml_compute_forward_mul_mat_one_chunk(
                 const int64_t i2 = i12;
                 const int64_t i3 = i13;
 
-                const char * src0_row = (const char*)src0->data + (0 + i02 * nb02 + i03 * nb03);
+                const char * src0_row = src0_data + (0 + i02 * nb02 + i03 * nb03);
 
                 // desc: when src1 is not a contiguous memory block we have to calculate the offset using the strides
                 //       if it is, then we have either copied the data to params->wdata and made it contiguous or we are using
@@ -12518,7 +13655,8 @@ static void ggml_compute_forward_mul_mat(
     const int ith = params->ith;
     const int nth = params->nth;
 
-    const enum ggml_type type = src0->type;
+    // Q4_0 weights may have been repacked for the gemv/gemm kernels (see ggml_backend_cpu_repack_buffer_type)
+    const enum ggml_type type = ggml_backend_cpu_repack_type(src0);
 
     enum ggml_type           const vec_dot_type         = type_traits[type].vec_dot_type;
     ggml_from_float_t        const from_float           = type_traits[vec_dot_type].from_float;
@@ -12547,25 +13685,30 @@ static void ggml_compute_forward_mul_mat(
     // nb01 >= nb00 - src0 is not transposed
     //   compute by src0 rows
 
-#if GGML_USE_LLAMAFILE
+    const char * src0_data = ggml_compute_src_data(params, src0);
+
+#if GGML_USE_LLAMAFILE || GGML_USE_AMX
     // broadcast factors
     const int64_t r2 = ne12 / ne02;
     const int64_t r3 = ne13 / ne03;
+#endif
 
+#if GGML_USE_LLAMAFILE
     const bool src1_cont = ggml_is_contiguous(src1);
 
-    if (src1_cont) {
+    // src1 is converted for the next mul_mats anyway
+    if (src1_cont && params->src1_cache == GGML_SRC1_CACHE_NONE) {
         for (int64_t i13 = 0; i13 < ne13; i13++)
             for (int64_t i12 = 0; i12 < ne12; i12++)
-                if (!llamafile_sgemm(ne01, ne11, ne00/ggml_blck_size(src0->type),
-                                     (const char *)src0->data + i12/r2*nb02 + i13/r3*nb03,
-                                     nb01/ggml_type_size(src0->type),
+                if (!llamafile_sgemm(ne01, ne11, ne00/ggml_blck_size(type),
+                                     src0_data + i12/r2*nb02 + i13/r3*nb03,
+                                     nb01/ggml_type_size(type),
                                      (const char *)src1->data + i12*nb12 + i13*nb13,
                                      nb11/ggml_type_size(src1->type),
                                      (char *)dst->data + i12*nb2 + i13*nb3,
                                      nb1/ggml_type_size(dst->type),
                                      ith, nth,
-                                     src0->type,
+                                     type,
                                      src1->type,
                                      dst->type))
                     goto UseGgmlGemm1;
@@ -12574,8 +13717,11 @@ static void ggml_compute_forward_mul_mat(
 UseGgmlGemm1:;
 #endif
 
-    if (src1->type != vec_dot_type) {
-        char * wdata = params->wdata;
+    // a LOAD finds src1 already converted by a previous mul_mat, there is nothing to wait for
+    const bool src1_conv = src1->type != vec_dot_type && params->src1_cache != GGML_SRC1_CACHE_LOAD;
+
+    if (src1_conv) {
+        char * wdata = ggml_mul_mat_src1_wdata(params, src1, vec_dot_type);
 
         const size_t nbw1 = ggml_row_size(vec_dot_type, ne10);
         const size_t nbw2 = nbw1*ne11;
@@ -12587,7 +13733,7 @@ UseGgmlGemm1:;
         for (int64_t i13 = 0; i13 < ne13; ++i13) {
             for (int64_t i12 = 0; i12 < ne12; ++i12) {
                 int64_t i11_processed = 0;
-                if ((ggml_n_dims(src1) == 2) && from_float_to_mat && gemm) {
+                if (from_float_to_mat && gemm) {
                     for (int64_t i11 = ith * 4; i11 < ne11 - ne11 % 4; i11 += nth * 4) {
                         from_float_to_mat((float *)((char *) src1->data + i13*nb13 + i12*nb12 + i11*nb11),
                                           (void *)               (wdata + i13*nbw3 + i12*nbw2 + i11*nbw1),
@@ -12604,29 +13750,62 @@ UseGgmlGemm1:;
         }
     }
 
-    if (ith == 0) {
-        // Every thread starts at ith, so the first unprocessed chunk is nth.  This save a bit of coordination right at the start.
-        atomic_store(&params->shared->current_chunk, nth);
+    if (src1_conv) {
+        // wait for the other threads to finish converting src1
+        ggml_barrier(params);
     }
 
-    ggml_barrier(params->shared);
+#if GGML_USE_AMX
+    {
+        // AMX tiles for BF16, Q8_0 and Q4_0 weights, with src1 in the vec_dot type
+        // src1 is read from wdata when it is not in the vec_dot type, converted here or by a previous mul_mat for a LOAD
+        const bool src1_converted = src1->type != vec_dot_type;
+
+        const char * wdata = src1_converted ? ggml_mul_mat_src1_wdata(params, src1, vec_dot_type) : (const char *) src1->data;
+        const size_t row_size = ggml_row_size(vec_dot_type, ne10);
+
+        const size_t nbw1 = src1_converted ? row_size           : nb11;
+        const size_t nbw2 = src1_converted ? row_size*ne11      : nb12;
+        const size_t nbw3 = src1_converted ? row_size*ne11*ne12 : nb13;
+
+        const int64_t k = ne00/ggml_blck_size(type);
+
+        void * work = (char *) params->wdata + (src1_converted ? ne13*nbw3 : 0) + ith*ggml_amx_work_size(type, k);
+
+        for (int64_t i13 = 0; i13 < ne13; i13++)
+            for (int64_t i12 = 0; i12 < ne12; i12++)
+                if (!ggml_amx_mul_mat(ne01, ne11, k,
+                                      src0_data + i12/r2*nb02 + i13/r3*nb03,
+                                      nb01/ggml_type_size(type),
+                                      wdata + i12*nbw2 + i13*nbw3,
+                                      nbw1/ggml_type_size(vec_dot_type),
+                                      (float *) ((char *) dst->data + i12*nb2 + i13*nb3),
+                                      nb1/ggml_type_size(dst->type),
+                                      work, ith, nth,
+                                      type,
+                                      vec_dot_type))
+                    goto UseGgmlGemmAmx;
+        return;
+    }
+UseGgmlGemmAmx:;
+#endif
 
 #if GGML_USE_LLAMAFILE
     if (src1->type != vec_dot_type) {
-        const void* wdata = (src1->type == vec_dot_type) ? src1->data : params->wdata;
+        const void* wdata = ggml_mul_mat_src1_wdata(params, src1, vec_dot_type);
         const size_t row_size = ggml_row_size(vec_dot_type, ne10);
 
         for (int64_t i13 = 0; i13 < ne13; i13++)
             for (int64_t i12 = 0; i12 < ne12; i12++)
-                if (!llamafile_sgemm(ne01, ne11, ne00/ggml_blck_size(src0->type),
-                                     (const char *)src0->data + i12/r2*nb02 + i13/r3*nb03,
-                                     nb01/ggml_type_size(src0->type),
+                if (!llamafile_sgemm(ne01, ne11, ne00/ggml_blck_size(type),
+                                     src0_data + i12/r2*nb02 + i13/r3*nb03,
+                                     nb01/ggml_type_size(type),
                                      (const char *)wdata + (i12*ne11 + i13*ne12*ne11)*row_size,
                                      row_size/ggml_type_size(vec_dot_type),
                                      (char *)dst->data + i12*nb2 + i13*nb3,
                                      nb1/ggml_type_size(dst->type),
                                      ith, nth,
-                                     src0->type,
+                                     type,
                                      vec_dot_type,
                                      dst->type))
                     goto UseGgmlGemm2;
@@ -12663,21 +13842,36 @@ UseGgmlGemm2:;
     int64_t nchunk0 = (nr0 + chunk_size - 1) / chunk_size;
     int64_t nchunk1 = (nr1 + chunk_size - 1) / chunk_size;
 
+    // small batches are computed with one pass over src0 (see vec_dot_cols), only src0 is split
+    if (type_traits[type].vec_dot_cols && nr1 == ne1 && nr1 <= GGML_MUL_MAT_MAX_COLS) {
+        nchunk1 = 1;
+    }
+
     // If the chunking is poor for the number of threads on this setup, scrap the whole plan.  Re-chunk it by thread.
     //   Also, chunking by thread was measured to have perform better on NUMA systems.  See https://github.com/ggerganov/llama.cpp/pull/6915
     //   In theory, chunking should be just as useful on NUMA and non NUMA systems, but testing disagreed with that.
-    if (nchunk0 * nchunk1 < nth * 4 || ggml_is_numa()) {
+    //   On NUMA systems the src0 rows are split in one contiguous block per node, matching the placement of the
+    //   GGML_BACKEND_CPU_NUMA_DISTRIBUTE buffers, and the threads work on the block of their node first.
+    const int n_numa = ggml_is_numa() && nr0 > nr1 ? (int) ggml_numa_n_nodes() : 0;
+
+    int64_t nchunk_numa = 0; // chunks per NUMA node
+
+    if (n_numa > 0) {
+        nchunk_numa = MAX(1, MIN(nr0/n_numa, (nth + n_numa - 1)/n_numa));
+        nchunk0 = n_numa*nchunk_numa;
+        nchunk1 = 1;
+    } else if (nchunk0 * nchunk1 < nth * 4 || ggml_is_numa()) {
         // distribute the thread work across the inner or outer loop based on which one is larger
         nchunk0 = nr0 > nr1 ? nth : 1; // parallelize by src0 rows
         nchunk1 = nr0 > nr1 ? 1 : nth; // parallelize by src1 rows
     }
 
-    // The number of elements in each chunk
-    const int64_t dr0 = (nr0 + nchunk0 - 1) / nchunk0;
-    const int64_t dr1 = (nr1 + nchunk1 - 1) / nchunk1;
+    // The number of elements in each chunk, a multiple of the rows and columns computed by a vec_dot call
+    const int64_t dr0 = GGML_PAD((nr0 + nchunk0 - 1) / nchunk0, num_rows_per_vec_dot);
+    const int64_t dr1 = GGML_PAD((nr1 + nchunk1 - 1) / nchunk1, num_rows_per_vec_dot);
 
     if ((ggml_n_dims(src0) == 2) && gemv) {
-        const void * src1_wdata      = (src1->type == vec_dot_type) ? src1->data : params->wdata;
+        const void * src1_wdata      = (src1->type == vec_dot_type) ? src1->data : ggml_mul_mat_src1_wdata(params, src1, vec_dot_type);
         const size_t src1_col_stride = ggml_is_contiguous(src1) || src1->type != vec_dot_type ? ggml_row_size(vec_dot_type, ne10) : nb11;
         int64_t src0_start = (ith * ne01) / nth;
         int64_t src0_end   = ((ith + 1) * ne01) / nth;
@@ -12685,15 +13879,38 @@ UseGgmlGemm2:;
         src0_end   = (src0_end   % matmul_num_cols) ? src0_end   + matmul_num_cols - (src0_end   % matmul_num_cols): src0_end;
         if (src0_start >= src0_end) return;
 
-        // If there are more than three rows in src1, use gemm; otherwise, use gemv.
-        if (gemm && (ne11 > 3)) {
-            gemm(ne00, (float *)((char *) dst->data) + src0_start, ne01, (const char *) src0->data + src0_start * nb01,
-                 (const char *) src1_wdata, ne11 - ne11 % 4, src0_end - src0_start);
+        // gemm needs the rows of src1 converted in groups of 4 by from_float_to_mat
+        const int64_t ne11_mat = gemm && from_float_to_mat && src1->type != vec_dot_type ? ne11 - ne11 % 4 : 0;
+
+        for (int64_t i13 = 0; i13 < ne13; i13++) {
+            for (int64_t i12 = 0; i12 < ne12; i12++) {
+                const char * src1_batch = src1->type != vec_dot_type
+                    ? (const char *) src1_wdata + (i12 + i13*ne12)*ne11*src1_col_stride
+                    : (const char *) src1_wdata + i12*nb12 + i13*nb13;
+                char       * dst_batch  = (char *) dst->data + i12*nb2 + i13*nb3;
+
+                // If there are more than three rows in src1, use gemm; otherwise, use gemv.
+                if (ne11_mat > 0) {
+                    gemm(ne00, (float *) dst_batch + src0_start, nb1/nb0, src0_data + src0_start * nb01,
+                         src1_batch, ne11_mat, src0_end - src0_start);
+                }
+                for (int64_t iter = ne11_mat; iter < ne11; iter++) {
+                    gemv(ne00, (float *)(dst_batch + (iter * nb1)) + src0_start, ne01,
+                         src0_data + src0_start * nb01, src1_batch + (src1_col_stride * iter), 1,
+                         src0_end - src0_start);
+                }
+            }
         }
-        for (int iter = gemm ? ne11 - ne11 % 4 : 0; iter < ne11; iter++) {
-            gemv(ne00, (float *)((char *) dst->data + (iter * nb1)) + src0_start, ne01,
-                 (const char *) src0->data + src0_start * nb01, (const char *) src1_wdata + (src1_col_stride * iter), 1,
-                 src0_end - src0_start);
+        return;
+    }
+
+    if (n_numa > 0) {
+        for (int64_t chunk = ggml_chunk_claim_numa(params, n_numa, nchunk_numa); chunk < nchunk0;
+                     chunk = ggml_chunk_claim_numa(params, n_numa, nchunk_numa)) {
+            const int64_t ir0_start = dr0 * chunk;
+            const int64_t ir0_end = MIN(ir0_start + dr0, nr0);
+
+            ggml_compute_forward_mul_mat_one_chunk(params, dst, num_rows_per_vec_dot, ir0_start, ir0_end, 0, nr1);
         }
         return;
     }
@@ -12717,7 +13934,7 @@ UseGgmlGemm2:;
             break;
         }
 
-        current_chunk = atomic_fetch_add(&params->shared->current_chunk, 1);
+        current_chunk = ggml_chunk_claim(params);
     }
 }
 
@@ -12772,8 +13989,11 @@ static void ggml_compute_forward_mul_mat_id(
     int64_t * matrix_row_counts = (int64_t *) (wdata_src1_end); // [n_as]
     struct mmid_row_mapping * matrix_rows = (struct mmid_row_mapping *)(matrix_row_counts + n_as); // [n_as][ne11]
 
-    if (src1->type != vec_dot_type) {
-        char * wdata = params->wdata;
+    // a LOAD finds src1 already converted by a previous mul_mat, there is nothing to wait for
+    const bool src1_conv = src1->type != vec_dot_type && params->src1_cache != GGML_SRC1_CACHE_LOAD;
+
+    if (src1_conv) {
+        char * wdata = ggml_mul_mat_src1_wdata(params, src1, vec_dot_type);
 
         const size_t nbw1 = ggml_row_size(vec_dot_type, ne10);
         const size_t nbw2 = nbw1*ne11;
@@ -12812,7 +14032,7 @@ static void ggml_compute_forward_mul_mat_id(
         }
     }
 
-    ggml_barrier(params->shared);
+    ggml_barrier(params);
 
     // compute each matrix multiplication in sequence
     for (int cur_a = 0; cur_a < n_as; ++cur_a) {
@@ -12822,7 +14042,7 @@ static void ggml_compute_forward_mul_mat_id(
             continue;
         }
 
-        const char * src0_cur = (const char *) src0->data + cur_a*nb02;
+        const char * src0_cur = ggml_compute_src_data(params, src0) + cur_a*nb02;
 
         const void * wdata    = (src1->type == vec_dot_type) ? src1->data : params->wdata;
         const size_t row_size = ggml_row_size(vec_dot_type, ne10);
@@ -12966,7 +14186,7 @@ static void ggml_compute_forward_out_prod_f32(
     if (ith == 0) {
         ggml_vec_set_f32(ne0*ne1*ne2*ne3, dst->data, 0);
     }
-    ggml_barrier(params->shared);
+    ggml_barrier(params);
 
     // dst[:,:,:,:] = 0
     // for i2,i3:
@@ -13084,7 +14304,7 @@ static void ggml_compute_forward_out_prod_q_f32(
     if (ith == 0) {
         ggml_vec_set_f32(ne0*ne1*ne2*ne3, dst->data, 0);
     }
-    ggml_barrier(params->shared);
+    ggml_barrier(params);
 
     // parallelize by last three dimensions
 
@@ -13162,6 +14382,8 @@ static void ggml_compute_forward_out_prod(
         case GGML_TYPE_Q4_0_4_4:
         case GGML_TYPE_Q4_0_4_8:
         case GGML_TYPE_Q4_0_8_8:
+        case GGML_TYPE_F8_E4M3:
+        case GGML_TYPE_F8_E5M2:
             {
                 ggml_compute_forward_out_prod_q_f32(params, dst);
             } break;
@@ -13270,7 +14492,7 @@ static void ggml_compute_forward_set_f32(
                 ((char *) src0->data),
                 ggml_nbytes(dst));
         }
-        ggml_barrier(params->shared);
+        ggml_barrier(params);
     }
 
     const int ith = params->ith;
@@ -13350,6 +14572,8 @@ static void ggml_compute_forward_set(
         case GGML_TYPE_Q4_0_4_4:
         case GGML_TYPE_Q4_0_4_8:
         case GGML_TYPE_Q4_0_8_8:
+        case GGML_TYPE_F8_E4M3:
+        case GGML_TYPE_F8_E5M2:
         default:
             {
                 GGML_ABORT("fatal error");
@@ -13435,27 +14659,24 @@ static void ggml_compute_forward_get_rows_q(
     assert(nb00 == ggml_type_size(type));
     assert(ggml_nrows(dst) == nr);
 
-    const int ith = params->ith;
-    const int nth = params->nth;
-
-    // rows per thread
-    const int dr = (nr + nth - 1)/nth;
+    const char * src0_data = ggml_compute_src_data(params, src0);
 
-    // row range for this thread
-    const int ir0 = dr*ith;
-    const int ir1 = MIN(ir0 + dr, nr);
+    struct ggml_chunk_iter it = ggml_chunk_iter_init(params, nr, nc);
 
-    for (int64_t i = ir0; i < ir1; ++i) {
-        const int64_t i12 = i/(ne11*ne10);
-        const int64_t i11 = (i - i12*ne11*ne10)/ne10;
-        const int64_t i10 = (i - i12*ne11*ne10 - i11*ne10);
-        const int64_t i01 = *(int32_t *) ((char *) src1->data + i10*nb10 + i11*nb11 + i12*nb12);
+    int64_t ir0, ir1;
+    while (ggml_chunk_iter_next(params, &it, &ir0, &ir1)) {
+        for (int64_t i = ir0; i < ir1; ++i) {
+            const int64_t i12 = i/(ne11*ne10);
+            const int64_t i11 = (i - i12*ne11*ne10)/ne10;
+            const int64_t i10 = (i - i12*ne11*ne10 - i11*ne10);
+            const int64_t i01 = *(int32_t *) ((char *) src1->data + i10*nb10 + i11*nb11 + i12*nb12);
 
-        assert(i01 >= 0 && i01 < ne01);
+            assert(i01 >= 0 && i01 < ne01);
 
-        dequantize_row_q(
-                (const void *) ((char *) src0->data + i01*nb01 + i11*nb02 + i12*nb03),
-                     (float *) ((char *)  dst->data + i10*nb1  + i11*nb2  + i12*nb3), nc);
+            dequantize_row_q(
+                    (const void *) (src0_data + i01*nb01 + i11*nb02 + i12*nb03),
+                         (float *) ((char *)  dst->data + i10*nb1  + i11*nb2  + i12*nb3), nc);
+        }
     }
 }
 
@@ -13476,27 +14697,24 @@ static void ggml_compute_forward_get_rows_f16(
     assert(nb00 == sizeof(ggml_fp16_t));
     assert(ggml_nrows(dst) == nr);
 
-    const int ith = params->ith;
-    const int nth = params->nth;
-
-    // rows per thread
-    const int dr = (nr + nth - 1)/nth;
+    const char * src0_data = ggml_compute_src_data(params, src0);
 
-    // row range for this thread
-    const int ir0 = dr*ith;
-    const int ir1 = MIN(ir0 + dr, nr);
+    struct ggml_chunk_iter it = ggml_chunk_iter_init(params, nr, nc);
 
-    for (int64_t i = ir0; i < ir1; ++i) {
-        const int64_t i12 = i/(ne11*ne10);
-        const int64_t i11 = (i - i12*ne11*ne10)/ne10;
-        const int64_t i10 = (i - i12*ne11*ne10 - i11*ne10);
-        const int64_t i01 = *(int32_t *) ((char *) src1->data + i10*nb10 + i11*nb11 + i12*nb12);
+    int64_t ir0, ir1;
+    while (ggml_chunk_iter_next(params, &it, &ir0, &ir1)) {
+        for (int64_t i = ir0; i < ir1; ++i) {
+            const int64_t i12 = i/(ne11*ne10);
+            const int64_t i11 = (i - i12*ne11*ne10)/ne10;
+            const int64_t i10 = (i - i12*ne11*ne10 - i11*ne10);
+            const int64_t i01 = *(int32_t *) ((char *) src1->data + i10*nb10 + i11*nb11 + i12*nb12);
 
-        assert(i01 >= 0 && i01 < ne01);
+            assert(i01 >= 0 && i01 < ne01);
 
-        ggml_fp16_to_fp32_row(
-                (const void *) ((char *) src0->data + i01*nb01 + i11*nb02 + i12*nb03),
-                     (float *) ((char *)  dst->data + i10*nb1  + i11*nb2  + i12*nb3), nc);
+            ggml_fp16_to_fp32_row(
+                    (const void *) (src0_data + i01*nb01 + i11*nb02 + i12*nb03),
+                         (float *) ((char *)  dst->data + i10*nb1  + i11*nb2  + i12*nb3), nc);
+        }
     }
 }
 
@@ -13517,27 +14735,24 @@ static void ggml_compute_forward_get_rows_bf16(
     assert(nb00 == sizeof(ggml_bf16_t));
     assert(ggml_nrows(dst) == nr);
 
-    const int ith = params->ith;
-    const int nth = params->nth;
-
-    // rows per thread
-    const int dr = (nr + nth - 1)/nth;
+    const char * src0_data = ggml_compute_src_data(params, src0);
 
-    // row range for this thread
-    const int ir0 = dr*ith;
-    const int ir1 = MIN(ir0 + dr, nr);
+    struct ggml_chunk_iter it = ggml_chunk_iter_init(params, nr, nc);
 
-    for (int64_t i = ir0; i < ir1; ++i) {
-        const int64_t i12 = i/(ne11*ne10);
-        const int64_t i11 = (i - i12*ne11*ne10)/ne10;
-        const int64_t i10 = (i - i12*ne11*ne10 - i11*ne10);
-        const int64_t i01 = *(int32_t *) ((char *) src1->data + i10*nb10 + i11*nb11 + i12*nb12);
+    int64_t ir0, ir1;
+    while (ggml_chunk_iter_next(params, &it, &ir0, &ir1)) {
+        for (int64_t i = ir0; i < ir1; ++i) {
+            const int64_t i12 = i/(ne11*ne10);
+            const int64_t i11 = (i - i12*ne11*ne10)/ne10;
+            const int64_t i10 = (i - i12*ne11*ne10 - i11*ne10);
+            const int64_t i01 = *(int32_t *) ((char *) src1->data + i10*nb10 + i11*nb11 + i12*nb12);
 
-        assert(i01 >= 0 && i01 < ne01);
+            assert(i01 >= 0 && i01 < ne01);
 
-        ggml_bf16_to_fp32_row(
-                (const void *) ((char *) src0->data + i01*nb01 + i11*nb02 + i12*nb03),
-                     (float *) ((char *)  dst->data + i10*nb1  + i11*nb2  + i12*nb3), nc);
+            ggml_bf16_to_fp32_row(
+                    (const void *) (src0_data + i01*nb01 + i11*nb02 + i12*nb03),
+                         (float *) ((char *)  dst->data + i10*nb1  + i11*nb2  + i12*nb3), nc);
+        }
     }
 }
 
@@ -13558,27 +14773,24 @@ static void ggml_compute_forward_get_rows_f32(
     assert(nb00 == sizeof(float));
     assert(ggml_nrows(dst) == nr);
 
-    const int ith = params->ith;
-    const int nth = params->nth;
-
-    // rows per thread
-    const int dr = (nr + nth - 1)/nth;
+    const char * src0_data = ggml_compute_src_data(params, src0);
 
-    // row range for this thread
-    const int ir0 = dr*ith;
-    const int ir1 = MIN(ir0 + dr, nr);
+    struct ggml_chunk_iter it = ggml_chunk_iter_init(params, nr, nc);
 
-    for (int64_t i = ir0; i < ir1; ++i) {
-        const int64_t i12 = i/(ne11*ne10);
-        const int64_t i11 = (i - i12*ne11*ne10)/ne10;
-        const int64_t i10 = (i - i12*ne11*ne10 - i11*ne10);
-        const int64_t i01 = *(int32_t *) ((char *) src1->data + i10*nb10 + i11*nb11 + i12*nb12);
+    int64_t ir0, ir1;
+    while (ggml_chunk_iter_next(params, &it, &ir0, &ir1)) {
+        for (int64_t i = ir0; i < ir1; ++i) {
+            const int64_t i12 = i/(ne11*ne10);
+            const int64_t i11 = (i - i12*ne11*ne10)/ne10;
+            const int64_t i10 = (i - i12*ne11*ne10 - i11*ne10);
+            const int64_t i01 = *(int32_t *) ((char *) src1->data + i10*nb10 + i11*nb11 + i12*nb12);
 
-        assert(i01 >= 0 && i01 < ne01);
+            assert(i01 >= 0 && i01 < ne01);
 
-        ggml_vec_cpy_f32(nc,
-                (float *) ((char *)  dst->data + i10*nb1  + i11*nb2  + i12*nb3),
-                (float *) ((char *) src0->data + i01*nb01 + i11*nb02 + i12*nb03));
+            ggml_vec_cpy_f32(nc,
+                    (float *) ((char *)  dst->data + i10*nb1  + i11*nb2  + i12*nb3),
+                    (const float *) (src0_data + i01*nb01 + i11*nb02 + i12*nb03));
+        }
     }
 }
 
@@ -13612,6 +14824,8 @@ static void ggml_compute_forward_get_rows(
         case GGML_TYPE_Q4_0_4_4:
         case GGML_TYPE_Q4_0_4_8:
         case GGML_TYPE_Q4_0_8_8:
+        case GGML_TYPE_F8_E4M3:
+        case GGML_TYPE_F8_E5M2:
             {
                 ggml_compute_forward_get_rows_q(params, dst);
             } break;
@@ -13849,7 +15063,7 @@ static void ggml_compute_forward_diag_mask_f32(
                 ((char *) src0->data),
                 ggml_nbytes(dst));
         }
-        ggml_barrier(params->shared);
+        ggml_barrier(params);
     }
 
     // TODO: handle transposed/permuted matrices
@@ -13930,7 +15144,6 @@ static void ggml_compute_forward_soft_max_f32(
     // TODO: handle transposed/permuted matrices
 
     const int ith = params->ith;
-    const int nth = params->nth;
 
     GGML_TENSOR_UNARY_OP_LOCALS
 
@@ -13947,65 +15160,63 @@ static void ggml_compute_forward_soft_max_f32(
     const int nc = src0->ne[0];
     const int nr = ggml_nrows(src0);
 
-    // rows per thread
-    const int dr = (nr + nth - 1)/nth;
-
-    // row range for this thread
-    const int ir0 = dr*ith;
-    const int ir1 = MIN(ir0 + dr, nr);
+    struct ggml_chunk_iter it = ggml_chunk_iter_init(params, nr, nc);
 
     float * wp = (float *) params->wdata + (nc + CACHE_LINE_SIZE_F32) * ith;
 
     const bool use_f16 = (src1 && src1->type == GGML_TYPE_F16);
 
-    for (int i1 = ir0; i1 < ir1; i1++) {
-        // ALiBi
-        const uint32_t h = (i1/ne01)%ne02; // head
-        const float slope = (max_bias > 0.0f) ? h < n_head_log2 ? powf(m0, h + 1) : powf(m1, 2*(h - n_head_log2) + 1) : 1.0f;
-
-        float * sp = (float *)((char *) src0->data + i1*src0->nb[1]);
-        float * dp = (float *)((char *)  dst->data +  i1*dst->nb[1]);
-
-        // broadcast the mask across rows
-        ggml_fp16_t * mp_f16 = src1 ? (ggml_fp16_t *)((char *) src1->data) + (i1%ne01)*ne00 : NULL;
-        float       * mp_f32 = src1 ? (float       *)((char *) src1->data) + (i1%ne01)*ne00 : NULL;
-
-        ggml_vec_cpy_f32  (nc, wp, sp);
-        ggml_vec_scale_f32(nc, wp, scale);
-        if (mp_f32) {
-            if (use_f16) {
-                for (int i = 0; i < nc; ++i) {
-                    wp[i] += slope*GGML_FP16_TO_FP32(mp_f16[i]);
-                }
-            } else {
-                for (int i = 0; i < nc; ++i) {
-                    wp[i] += slope*mp_f32[i];
+    int64_t ir0, ir1;
+    while (ggml_chunk_iter_next(params, &it, &ir0, &ir1)) {
+        for (int64_t i1 = ir0; i1 < ir1; i1++) {
+            // ALiBi
+            const uint32_t h = (i1/ne01)%ne02; // head
+            const float slope = (max_bias > 0.0f) ? h < n_head_log2 ? powf(m0, h + 1) : powf(m1, 2*(h - n_head_log2) + 1) : 1.0f;
+
+            float * sp = (float *)((char *) src0->data + i1*src0->nb[1]);
+            float * dp = (float *)((char *)  dst->data +  i1*dst->nb[1]);
+
+            // broadcast the mask across rows
+            ggml_fp16_t * mp_f16 = src1 ? (ggml_fp16_t *)((char *) src1->data) + (i1%ne01)*ne00 : NULL;
+            float       * mp_f32 = src1 ? (float       *)((char *) src1->data) + (i1%ne01)*ne00 : NULL;
+
+            ggml_vec_cpy_f32  (nc, wp, sp);
+            ggml_vec_scale_f32(nc, wp, scale);
+            if (mp_f32) {
+                if (use_f16) {
+                    for (int i = 0; i < nc; ++i) {
+                        wp[i] += slope*GGML_FP16_TO_FP32(mp_f16[i]);
+                    }
+                } else {
+                    for (int i = 0; i < nc; ++i) {
+                        wp[i] += slope*mp_f32[i];
+                    }
                 }
             }
-        }
 
 #ifndef NDEBUG
-        for (int i = 0; i < nc; ++i) {
-            //printf("p[%d] = %f\n", i, p[i]);
-            assert(!isnan(wp[i]));
-        }
+            for (int i = 0; i < nc; ++i) {
+                //printf("p[%d] = %f\n", i, p[i]);
+                assert(!isnan(wp[i]));
+            }
 #endif
 
-        float max = -INFINITY;
-        ggml_vec_max_f32(nc, &max, wp);
+            float max = -INFINITY;
+            ggml_vec_max_f32(nc, &max, wp);
 
-        ggml_float sum = ggml_vec_soft_max_f32(nc, dp, wp, max);
-        assert(sum > 0.0);
+            ggml_float sum = ggml_vec_soft_max_f32(nc, dp, wp, max);
+            assert(sum > 0.0);
 
-        sum = 1.0/sum;
-        ggml_vec_scale_f32(nc, dp, sum);
+            sum = 1.0/sum;
+            ggml_vec_scale_f32(nc, dp, sum);
 
 #ifndef NDEBUG
-        for (int i = 0; i < nc; ++i) {
-            assert(!isnan(dp[i]));
-            assert(!isinf(dp[i]));
-        }
+            for (int i = 0; i < nc; ++i) {
+                assert(!isnan(dp[i]));
+                assert(!isinf(dp[i]));
+            }
 #endif
+        }
     }
 }
 
@@ -14202,6 +15413,8 @@ static void ggml_compute_forward_clamp(
         case GGML_TYPE_Q4_0_4_4:
         case GGML_TYPE_Q4_0_4_8:
         case GGML_TYPE_Q4_0_8_8:
+        case GGML_TYPE_F8_E4M3:
+        case GGML_TYPE_F8_E5M2:
         case GGML_TYPE_I8:
         case GGML_TYPE_I16:
         case GGML_TYPE_I32:
@@ -14304,22 +15517,13 @@ static void ggml_compute_forward_rope_f32(
     GGML_ASSERT(nb00 == sizeof(float));
 
     const int ith = params->ith;
-    const int nth = params->nth;
 
     const int nr = ggml_nrows(dst);
 
     GGML_ASSERT(n_dims <= ne0);
     GGML_ASSERT(n_dims % 2 == 0);
 
-    // rows per thread
-    const int dr = (nr + nth - 1)/nth;
-
-    // row range for this thread
-    const int ir0 = dr*ith;
-    const int ir1 = MIN(ir0 + dr, nr);
-
-    // row index used to determine which thread to use
-    int ir = 0;
+    struct ggml_chunk_iter it = ggml_chunk_iter_init(params, nr, ne0);
 
     const float theta_scale = powf(freq_base, -2.0f/n_dims);
 
@@ -14342,56 +15546,60 @@ static void ggml_compute_forward_rope_f32(
 
     const int32_t * pos = (const int32_t *) src1->data;
 
-    for (int64_t i3 = 0; i3 < ne3; i3++) {
-        for (int64_t i2 = 0; i2 < ne2; i2++) {
-            const int64_t p = pos[i2];
+    float * cache = (float *) params->wdata + (ne0 + CACHE_LINE_SIZE_F32)*ith;
 
-            float * cache = (float *) params->wdata + (ne0 + CACHE_LINE_SIZE_F32)*ith;
-            ggml_rope_cache_init(p, freq_scale, freq_factors, corr_dims, ne0, ext_factor, attn_factor, cache, sin_sign, theta_scale);
+    int64_t cache_i2 = -1; // the cache depends only on the position of the row
 
-            for (int64_t i1 = 0; i1 < ne1; i1++) {
-                if (ir++ < ir0) continue;
-                if (ir   > ir1) break;
+    int64_t ir0, ir1;
+    while (ggml_chunk_iter_next(params, &it, &ir0, &ir1)) {
+        for (int64_t ir = ir0; ir < ir1; ir++) {
+            const int64_t i3 = ir/(ne2*ne1);
+            const int64_t i2 = (ir - i3*ne2*ne1)/ne1;
+            const int64_t i1 = (ir - i3*ne2*ne1 - i2*ne1);
 
-                if (!is_neox) {
-                    for (int64_t i0 = 0; i0 < n_dims; i0 += 2) {
-                        const float cos_theta = cache[i0 + 0];
-                        const float sin_theta = cache[i0 + 1];
+            if (i2 != cache_i2) {
+                ggml_rope_cache_init(pos[i2], freq_scale, freq_factors, corr_dims, ne0, ext_factor, attn_factor, cache, sin_sign, theta_scale);
+                cache_i2 = i2;
+            }
 
-                        const float * const src = (float *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
-                              float * dst_data  = (float *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
+            if (!is_neox) {
+                for (int64_t i0 = 0; i0 < n_dims; i0 += 2) {
+                    const float cos_theta = cache[i0 + 0];
+                    const float sin_theta = cache[i0 + 1];
 
-                        const float x0 = src[0];
-                        const float x1 = src[1];
+                    const float * const src = (float *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
+                          float * dst_data  = (float *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
 
-                        dst_data[0] = x0*cos_theta - x1*sin_theta;
-                        dst_data[1] = x0*sin_theta + x1*cos_theta;
-                    }
-                } else {
-                    for (int64_t i0 = 0; i0 < n_dims; i0 += 2) {
-                        const int64_t ic = i0/2;
+                    const float x0 = src[0];
+                    const float x1 = src[1];
 
-                        const float cos_theta = cache[i0 + 0];
-                        const float sin_theta = cache[i0 + 1];
+                    dst_data[0] = x0*cos_theta - x1*sin_theta;
+                    dst_data[1] = x0*sin_theta + x1*cos_theta;
+                }
+            } else {
+                for (int64_t i0 = 0; i0 < n_dims; i0 += 2) {
+                    const int64_t ic = i0/2;
 
-                        const float * const src = (float *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + ic*nb00);
-                        float * dst_data  = (float *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + ic*nb0);
+                    const float cos_theta = cache[i0 + 0];
+                    const float sin_theta = cache[i0 + 1];
 
-                        const float x0 = src[0];
-                        const float x1 = src[n_dims/2];
+                    const float * const src = (float *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + ic*nb00);
+                    float * dst_data  = (float *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + ic*nb0);
 
-                        dst_data[0]        = x0*cos_theta - x1*sin_theta;
-                        dst_data[n_dims/2] = x0*sin_theta + x1*cos_theta;
-                    }
+                    const float x0 = src[0];
+                    const float x1 = src[n_dims/2];
+
+                    dst_data[0]        = x0*cos_theta - x1*sin_theta;
+                    dst_data[n_dims/2] = x0*sin_theta + x1*cos_theta;
                 }
+            }
 
-                for (int64_t i0 = n_dims; i0 < ne0; i0 += 2) {
-                    const float * const src = (float *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
-                    float * dst_data  = (float *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
+            for (int64_t i0 = n_dims; i0 < ne0; i0 += 2) {
+                const float * const src = (float *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
+                float * dst_data  = (float *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
 
-                    dst_data[0] = src[0];
-                    dst_data[1] = src[1];
-                }
+                dst_data[0] = src[0];
+                dst_data[1] = src[1];
             }
         }
     }
@@ -14429,22 +15637,13 @@ static void ggml_compute_forward_rope_f16(
     GGML_ASSERT(nb0 == sizeof(ggml_fp16_t));
 
     const int ith = params->ith;
-    const int nth = params->nth;
 
     const int nr = ggml_nrows(dst);
 
     GGML_ASSERT(n_dims <= ne0);
     GGML_ASSERT(n_dims % 2 == 0);
 
-    // rows per thread
-    const int dr = (nr + nth - 1)/nth;
-
-    // row range for this thread
-    const int ir0 = dr*ith;
-    const int ir1 = MIN(ir0 + dr, nr);
-
-    // row index used to determine which thread to use
-    int ir = 0;
+    struct ggml_chunk_iter it = ggml_chunk_iter_init(params, nr, ne0);
 
     const float theta_scale = powf(freq_base, -2.0f/n_dims);
 
@@ -14467,56 +15666,60 @@ static void ggml_compute_forward_rope_f16(
 
     const int32_t * pos = (const int32_t *) src1->data;
 
-    for (int64_t i3 = 0; i3 < ne3; i3++) {
-        for (int64_t i2 = 0; i2 < ne2; i2++) {
-            const int64_t p = pos[i2];
+    float * cache = (float *) params->wdata + (ne0 + CACHE_LINE_SIZE_F32)*ith;
 
-            float * cache = (float *) params->wdata + (ne0 + CACHE_LINE_SIZE_F32)*ith;
-            ggml_rope_cache_init(p, freq_scale, freq_factors, corr_dims, ne0, ext_factor, attn_factor, cache, sin_sign, theta_scale);
+    int64_t cache_i2 = -1; // the cache depends only on the position of the row
 
-            for (int64_t i1 = 0; i1 < ne1; i1++) {
-                if (ir++ < ir0) continue;
-                if (ir   > ir1) break;
+    int64_t ir0, ir1;
+    while (ggml_chunk_iter_next(params, &it, &ir0, &ir1)) {
+        for (int64_t ir = ir0; ir < ir1; ir++) {
+            const int64_t i3 = ir/(ne2*ne1);
+            const int64_t i2 = (ir - i3*ne2*ne1)/ne1;
+            const int64_t i1 = (ir - i3*ne2*ne1 - i2*ne1);
 
-                if (!is_neox) {
-                    for (int64_t i0 = 0; i0 < n_dims; i0 += 2) {
-                        const float cos_theta = cache[i0 + 0];
-                        const float sin_theta = cache[i0 + 1];
+            if (i2 != cache_i2) {
+                ggml_rope_cache_init(pos[i2], freq_scale, freq_factors, corr_dims, ne0, ext_factor, attn_factor, cache, sin_sign, theta_scale);
+                cache_i2 = i2;
+            }
 
-                        const ggml_fp16_t * const src = (ggml_fp16_t *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
-                              ggml_fp16_t * dst_data  = (ggml_fp16_t *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
+            if (!is_neox) {
+                for (int64_t i0 = 0; i0 < n_dims; i0 += 2) {
+                    const float cos_theta = cache[i0 + 0];
+                    const float sin_theta = cache[i0 + 1];
 
-                        const float x0 = GGML_FP16_TO_FP32(src[0]);
-                        const float x1 = GGML_FP16_TO_FP32(src[1]);
+                    const ggml_fp16_t * const src = (ggml_fp16_t *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
+                          ggml_fp16_t * dst_data  = (ggml_fp16_t *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
 
-                        dst_data[0] = GGML_FP32_TO_FP16(x0*cos_theta - x1*sin_theta);
-                        dst_data[1] = GGML_FP32_TO_FP16(x0*sin_theta + x1*cos_theta);
-                    }
-                } else {
-                    for (int64_t i0 = 0; i0 < n_dims; i0 += 2) {
-                        const int64_t ic = i0/2;
+                    const float x0 = GGML_FP16_TO_FP32(src[0]);
+                    const float x1 = GGML_FP16_TO_FP32(src[1]);
 
-                        const float cos_theta = cache[i0 + 0];
-                        const float sin_theta = cache[i0 + 1];
+                    dst_data[0] = GGML_FP32_TO_FP16(x0*cos_theta - x1*sin_theta);
+                    dst_data[1] = GGML_FP32_TO_FP16(x0*sin_theta + x1*cos_theta);
+                }
+            } else {
+                for (int64_t i0 = 0; i0 < n_dims; i0 += 2) {
+                    const int64_t ic = i0/2;
 
-                        const ggml_fp16_t * const src = (ggml_fp16_t *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + ic*nb00);
-                        ggml_fp16_t * dst_data  = (ggml_fp16_t *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + ic*nb0);
+                    const float cos_theta = cache[i0 + 0];
+                    const float sin_theta = cache[i0 + 1];
 
-                        const float x0 = GGML_FP16_TO_FP32(src[0]);
-                        const float x1 = GGML_FP16_TO_FP32(src[n_dims/2]);
+                    const ggml_fp16_t * const src = (ggml_fp16_t *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + ic*nb00);
+                    ggml_fp16_t * dst_data  = (ggml_fp16_t *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + ic*nb0);
 
-                        dst_data[0]        = GGML_FP32_TO_FP16(x0*cos_theta - x1*sin_theta);
-                        dst_data[n_dims/2] = GGML_FP32_TO_FP16(x0*sin_theta + x1*cos_theta);
-                    }
+                    const float x0 = GGML_FP16_TO_FP32(src[0]);
+                    const float x1 = GGML_FP16_TO_FP32(src[n_dims/2]);
+
+                    dst_data[0]        = GGML_FP32_TO_FP16(x0*cos_theta - x1*sin_theta);
+                    dst_data[n_dims/2] = GGML_FP32_TO_FP16(x0*sin_theta + x1*cos_theta);
                 }
+            }
 
-                for (int64_t i0 = n_dims; i0 < ne0; i0 += 2) {
-                    const ggml_fp16_t * const src = (ggml_fp16_t *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
-                    ggml_fp16_t * dst_data  = (ggml_fp16_t *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
+            for (int64_t i0 = n_dims; i0 < ne0; i0 += 2) {
+                const ggml_fp16_t * const src = (ggml_fp16_t *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
+                ggml_fp16_t * dst_data  = (ggml_fp16_t *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
 
-                    dst_data[0] = src[0];
-                    dst_data[1] = src[1];
-                }
+                dst_data[0] = src[0];
+                dst_data[1] = src[1];
             }
         }
     }
@@ -14625,7 +15828,7 @@ static void ggml_compute_forward_conv_transpose_1d_f16_f32(
         // need to zero dst since we are accumulating into it
         memset(dst->data, 0, ggml_nbytes(dst));
     }
-    ggml_barrier(params->shared);
+    ggml_barrier(params);
 
     const int32_t s0 = ((const int32_t*)(dst->op_params))[0];
 
@@ -14713,7 +15916,7 @@ static void ggml_compute_forward_conv_transpose_1d_f32(
         // need to zero dst since we are accumulating into it
         memset(dst->data, 0, ggml_nbytes(dst));
     }
-    ggml_barrier(params->shared);
+    ggml_barrier(params);
 
     const int32_t s0 = ((const int32_t*)(dst->op_params))[0];
 
@@ -15093,7 +16296,7 @@ static void ggml_compute_forward_conv_transpose_2d(
 
         memset(dst->data, 0, ggml_nbytes(dst));
     }
-    ggml_barrier(params->shared);
+    ggml_barrier(params);
 
     const int32_t stride = ggml_get_op_params_i32(dst, 0);
 
@@ -15685,7 +16888,6 @@ static void ggml_compute_forward_flash_attn_ext_f16(
     GGML_TENSOR_LOCALS(size_t,  nb,  dst, nb)
 
     const int ith = params->ith;
-    const int nth = params->nth;
 
     const int64_t D = neq0;
     const int64_t N = neq1;
@@ -15723,12 +16925,8 @@ static void ggml_compute_forward_flash_attn_ext_f16(
     // total rows in q
     const int nr = neq1*neq2*neq3;
 
-    // rows per thread
-    const int dr = (nr + nth - 1)/nth;
-
-    // row range for this thread
-    const int ir0 = dr*ith;
-    const int ir1 = MIN(ir0 + dr, nr);
+    // each row attends to all the nek1 keys
+    struct ggml_chunk_iter it = ggml_chunk_iter_init(params, nr, nek1*D);
 
     float scale         = 1.0f;
     float max_bias      = 0.0f;
@@ -15754,128 +16952,131 @@ static void ggml_compute_forward_flash_attn_ext_f16(
     ggml_to_float_t   const v_to_float     = type_traits[v->type].to_float;
 
     // loop over n_batch and n_head
-    for (int ir = ir0; ir < ir1; ++ir) {
-        // q indices
-        const int iq3 = ir/(neq2*neq1);
-        const int iq2 = (ir - iq3*neq2*neq1)/neq1;
-        const int iq1 = (ir - iq3*neq2*neq1 - iq2*neq1);
-
-        const uint32_t h = iq2; // head index
-        const float slope = (max_bias > 0.0f) ? h < n_head_log2 ? powf(m0, h + 1) : powf(m1, 2*(h - n_head_log2) + 1) : 1.0f;
+    int64_t ir0, ir1;
+    while (ggml_chunk_iter_next(params, &it, &ir0, &ir1)) {
+        for (int64_t ir = ir0; ir < ir1; ++ir) {
+            // q indices
+            const int iq3 = ir/(neq2*neq1);
+            const int iq2 = (ir - iq3*neq2*neq1)/neq1;
+            const int iq1 = (ir - iq3*neq2*neq1 - iq2*neq1);
 
-        float S = 0.0f;      // sum
-        float M = -INFINITY; // maximum KQ value
+            const uint32_t h = iq2; // head index
+            const float slope = (max_bias > 0.0f) ? h < n_head_log2 ? powf(m0, h + 1) : powf(m1, 2*(h - n_head_log2) + 1) : 1.0f;
 
-        float       * VKQ32 = (float       *) params->wdata + ith*(3*D + CACHE_LINE_SIZE_F32); // FP32 VKQ accumulator
-        float       * V32   =                 (VKQ32 + 1*D); // (temporary) FP32 V buffer
-        ggml_fp16_t * VKQ16 = (ggml_fp16_t *) (VKQ32 + 1*D); // (temporary) FP16 VKQ accumulator
-        ggml_fp16_t * Q_q   = (ggml_fp16_t *) (VKQ32 + 2*D); // (temporary) buffer for Q converted to quantized/FP16
+            float S = 0.0f;      // sum
+            float M = -INFINITY; // maximum KQ value
 
-        if (v->type == GGML_TYPE_F16) {
-            memset(VKQ16, 0, D*sizeof(ggml_fp16_t));
-        } else {
-            memset(VKQ32, 0, D*sizeof(float));
-        }
+            float       * VKQ32 = (float       *) params->wdata + ith*(3*D + CACHE_LINE_SIZE_F32); // FP32 VKQ accumulator
+            float       * V32   =                 (VKQ32 + 1*D); // (temporary) FP32 V buffer
+            ggml_fp16_t * VKQ16 = (ggml_fp16_t *) (VKQ32 + 1*D); // (temporary) FP16 VKQ accumulator
+            ggml_fp16_t * Q_q   = (ggml_fp16_t *) (VKQ32 + 2*D); // (temporary) buffer for Q converted to quantized/FP16
 
-        const ggml_fp16_t * mp = mask ? (ggml_fp16_t *)((char *) mask->data + iq1*mask->nb[1]) : NULL;
+            if (v->type == GGML_TYPE_F16) {
+                memset(VKQ16, 0, D*sizeof(ggml_fp16_t));
+            } else {
+                memset(VKQ32, 0, D*sizeof(float));
+            }
 
-        // k indices
-        const int ik3 = iq3 / rk3;
-        const int ik2 = iq2 / rk2;
+            const ggml_fp16_t * mp = mask ? (ggml_fp16_t *)((char *) mask->data + iq1*mask->nb[1]) : NULL;
 
-        // v indices
-        const int iv3 = iq3 / rv3;
-        const int iv2 = iq2 / rv2;
+            // k indices
+            const int ik3 = iq3 / rk3;
+            const int ik2 = iq2 / rk2;
 
-        const float * pq = (const float *) ((char *) q->data + (iq1*nbq1 + iq2*nbq2 + iq3*nbq3));
-        q_to_vec_dot(pq, Q_q, D);
+            // v indices
+            const int iv3 = iq3 / rv3;
+            const int iv2 = iq2 / rv2;
 
-        // online softmax / attention
-        // loop over n_kv and n_head_kv
-        // ref: https://arxiv.org/pdf/2112.05682.pdf
-        for (int64_t ic = 0; ic < nek1; ++ic) {
-            const float mv = mp ? slope*GGML_FP16_TO_FP32(mp[ic]) : 0.0f;
-            if (mv == -INFINITY) {
-                continue;
-            }
+            const float * pq = (const float *) ((char *) q->data + (iq1*nbq1 + iq2*nbq2 + iq3*nbq3));
+            q_to_vec_dot(pq, Q_q, D);
 
-            float s; // KQ value
+            // online softmax / attention
+            // loop over n_kv and n_head_kv
+            // ref: https://arxiv.org/pdf/2112.05682.pdf
+            for (int64_t ic = 0; ic < nek1; ++ic) {
+                const float mv = mp ? slope*GGML_FP16_TO_FP32(mp[ic]) : 0.0f;
+                if (mv == -INFINITY) {
+                    continue;
+                }
 
-            const char * k_data = (const char *) k->data + ( ic*nbk1 + ik2*nbk2 + ik3*nbk3);
-            kq_vec_dot(D, &s, 0, k_data, 0, Q_q, 0, 1);
+                float s; // KQ value
 
-            s = s*scale; // scale KQ value
+                const char * k_data = (const char *) k->data + ( ic*nbk1 + ik2*nbk2 + ik3*nbk3);
+                kq_vec_dot(D, &s, 0, k_data, 0, Q_q, 0, 1);
 
-            if (logit_softcap != 0.0f) {
-                s = logit_softcap*tanhf(s);
-            }
+                s = s*scale; // scale KQ value
 
-            s += mv; // apply mask
+                if (logit_softcap != 0.0f) {
+                    s = logit_softcap*tanhf(s);
+                }
 
-            const float Mold = M;
+                s += mv; // apply mask
 
-            float ms = 1.0f; // upon new higher max val, scale VKQ and KQ sum with this value
-            float vs = 1.0f; // post-softmax KQ value, expf(s - M)
+                const float Mold = M;
 
-            const char * v_data = ((const char *) v->data + (ic*nbv1 + iv2*nbv2 + iv3*nbv3));
+                float ms = 1.0f; // upon new higher max val, scale VKQ and KQ sum with this value
+                float vs = 1.0f; // post-softmax KQ value, expf(s - M)
 
-            if (v->type == GGML_TYPE_F16) {
-                if (s > M) {
-                    // s is new maximum, ms < 1.0f, vs == expf(s - s) == 1.0f
-                    M = s;
-                    ms = expf(Mold - M);
+                const char * v_data = ((const char *) v->data + (ic*nbv1 + iv2*nbv2 + iv3*nbv3));
 
-                    // V = V*expf(Mold - M)
-                    ggml_vec_scale_f16(D, VKQ16, ms);
-                } else {
-                    // no new maximum, ms == 1.0f, vs != 1.0f
-                    vs = expf(s - M);
-                }
+                if (v->type == GGML_TYPE_F16) {
+                    if (s > M) {
+                        // s is new maximum, ms < 1.0f, vs == expf(s - s) == 1.0f
+                        M = s;
+                        ms = expf(Mold - M);
 
-                // V += v*expf(s - M)
-                ggml_vec_mad_f16(D, VKQ16, (const ggml_fp16_t *) v_data, vs);
-            } else {
-                if (s > M) {
-                    // s is new maximum, ms < 1.0f, vs == expf(s - s) == 1.0f
-                    M = s;
-                    ms = expf(Mold - M);
+                        // V = V*expf(Mold - M)
+                        ggml_vec_scale_f16(D, VKQ16, ms);
+                    } else {
+                        // no new maximum, ms == 1.0f, vs != 1.0f
+                        vs = expf(s - M);
+                    }
 
-                    // V = V*expf(Mold - M)
-                    ggml_vec_scale_f32(D, VKQ32, ms);
+                    // V += v*expf(s - M)
+                    ggml_vec_mad_f16(D, VKQ16, (const ggml_fp16_t *) v_data, vs);
                 } else {
-                    // no new maximum, ms == 1.0f, vs != 1.0f
-                    vs = expf(s - M);
-                }
+                    if (s > M) {
+                        // s is new maximum, ms < 1.0f, vs == expf(s - s) == 1.0f
+                        M = s;
+                        ms = expf(Mold - M);
+
+                        // V = V*expf(Mold - M)
+                        ggml_vec_scale_f32(D, VKQ32, ms);
+                    } else {
+                        // no new maximum, ms == 1.0f, vs != 1.0f
+                        vs = expf(s - M);
+                    }
 
-                v_to_float(v_data, V32, D);
+                    v_to_float(v_data, V32, D);
 
-                // V += v*expf(s - M)
-                ggml_vec_mad_f32(D, VKQ32, V32, vs);
-            }
+                    // V += v*expf(s - M)
+                    ggml_vec_mad_f32(D, VKQ32, V32, vs);
+                }
 
-            S = S*ms + vs; // scale and increment sum with partial sum
-        }
+                S = S*ms + vs; // scale and increment sum with partial sum
+            }
 
-        if (v->type == GGML_TYPE_F16) {
-            for (int64_t d = 0; d < D; ++d) {
-                VKQ32[d] = GGML_FP16_TO_FP32(VKQ16[d]);
+            if (v->type == GGML_TYPE_F16) {
+                for (int64_t d = 0; d < D; ++d) {
+                    VKQ32[d] = GGML_FP16_TO_FP32(VKQ16[d]);
+                }
             }
-        }
 
-        // V /= S
-        const float S_inv = 1.0f/S;
-        ggml_vec_scale_f32(D, VKQ32, S_inv);
+            // V /= S
+            const float S_inv = 1.0f/S;
+            ggml_vec_scale_f32(D, VKQ32, S_inv);
 
-        // dst indices
-        const int i1 = iq1;
-        const int i2 = iq2;
-        const int i3 = iq3;
+            // dst indices
+            const int i1 = iq1;
+            const int i2 = iq2;
+            const int i3 = iq3;
 
-        // original
-        //memcpy((char *) dst->data + (i1*nb1 + i2*nb2 + i3*nb3), V, nev0*sizeof(float));
+            // original
+            //memcpy((char *) dst->data + (i1*nb1 + i2*nb2 + i3*nb3), V, nev0*sizeof(float));
 
-        // permute(0, 2, 1, 3)
-        memcpy((char *) dst->data + (i3*ne2*ne1 + i2 + i1*ne1)*nb1, VKQ32, nb1);
+            // permute(0, 2, 1, 3)
+            memcpy((char *) dst->data + (i3*ne2*ne1 + i2 + i1*ne1)*nb1, VKQ32, nb1);
+        }
     }
 }
 
@@ -15961,7 +17162,7 @@ static void ggml_compute_forward_flash_attn_back_f32(
     if (ith == 0) {
         memset(dst->data, 0, nb0*ne0*ne1*ne2*ne3);
     }
-    ggml_barrier(params->shared);
+    ggml_barrier(params);
 
     const int64_t elem_q = ggml_nelements(q);
     const int64_t elem_k = ggml_nelements(k);
@@ -16652,7 +17853,7 @@ static void ggml_compute_forward_add_rel_pos_f32(
         if (params->ith == 0) {
             memcpy((char *) dst->data, (char *) src0->data, ggml_nbytes(dst));
         }
-        ggml_barrier(params->shared);
+        ggml_barrier(params);
     }
     // ref: https://github.com/facebookresearch/segment-anything/blob/main/segment_anything/modeling/image_encoder.py#L357-L359
 
@@ -16937,7 +18138,7 @@ static void ggml_compute_forward_cross_entropy_loss_f32(
     if (ith == 0) {
         memset(sums, 0, sizeof(float) * (nth + nth * nc));
     }
-    ggml_barrier(params->shared);
+    ggml_barrier(params);
 
     // rows per thread
     const int dr = (nr + nth - 1)/nth;
@@ -16978,7 +18179,7 @@ static void ggml_compute_forward_cross_entropy_loss_f32(
         }
 #endif
     }
-    ggml_barrier(params->shared);
+    ggml_barrier(params);
 
     if (ith == 0) {
         float * dp = (float *) dst->data;
@@ -17440,6 +18641,50 @@ static void ggml_compute_forward(struct ggml_compute_params * params, struct ggm
     }
 }
 
+// computes the head nodes[0] and the n nodes fused after it
+static void ggml_compute_forward_fused(const struct ggml_compute_params * params, struct ggml_tensor ** nodes, int n) {
+    struct ggml_tensor * head = nodes[0];
+
+    if (nodes[1]->op == GGML_OP_SOFT_MAX) {
+        // scale -> soft_max: soft_max applies the scale to its input
+        GGML_ASSERT(n == 1 && head->op == GGML_OP_SCALE);
+
+        struct ggml_tensor soft_max = *nodes[1];
+        soft_max.src[0] = head->src[0];
+        memcpy(soft_max.op_params, head->op_params, sizeof(float));
+
+        ggml_compute_forward_soft_max(params, &soft_max);
+        return;
+    }
+
+    struct ggml_fused_ops fused = { nodes + 1, n, false };
+
+    struct ggml_compute_params params_head = *params;
+
+    switch (head->op) {
+        case GGML_OP_NORM:
+        case GGML_OP_RMS_NORM:
+            {
+                params_head.fused = &fused;
+            } break;
+        default:
+            break;
+    }
+
+    ggml_compute_forward(&params_head, head);
+
+    if (!fused.applied) {
+        // wait for all the rows of the head
+        ggml_barrier(params);
+
+        // the chunk counter of the last fused node is not used by anything else
+        struct ggml_compute_params params_rows = *params;
+        params_rows.chunk = params->chunk + n*params->threadpool->node_chunks_stride;
+
+        ggml_compute_forward_fused_rows(&params_rows, head, &fused);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 struct ggml_hash_set ggml_hash_set_new(size_t size) {
@@ -18688,7 +19933,7 @@ size_t ggml_graph_overhead(void) {
 struct ggml_cgraph * ggml_new_graph_custom(struct ggml_context * ctx, size_t size, bool grads) {
     const size_t obj_size = ggml_graph_nbytes(size, grads);
     struct ggml_object * obj = ggml_new_object(ctx, GGML_OBJECT_TYPE_GRAPH, obj_size);
-    struct ggml_cgraph * cgraph = (struct ggml_cgraph *) ((char *) ctx->mem_buffer + obj->offs);
+    struct ggml_cgraph * cgraph = (struct ggml_cgraph *) ggml_object_data(obj);
 
     // the size of the hash table is doubled since it needs to hold both nodes and leafs
     size_t hash_size = ggml_hash_size(size * 2);
@@ -18744,6 +19989,8 @@ void ggml_graph_cpy(struct ggml_cgraph * src, struct ggml_cgraph * dst) {
     GGML_ASSERT(dst->size >= src->n_nodes);
     GGML_ASSERT(dst->visited_hash_set.size >= src->visited_hash_set.size);
 
+    ggml_graph_name_index_reset(dst);
+
     dst->n_leafs = src->n_leafs;
     dst->n_nodes = src->n_nodes;
     dst->order   = src->order;
@@ -18789,6 +20036,7 @@ void ggml_graph_reset(struct ggml_cgraph * cgraph) {
 }
 
 void ggml_graph_clear(struct ggml_cgraph * cgraph) {
+    ggml_graph_name_index_reset(cgraph);
     cgraph->n_leafs = 0;
     cgraph->n_nodes = 0;
     ggml_hash_set_reset(&cgraph->visited_hash_set);
@@ -18927,6 +20175,174 @@ static void set_numa_thread_affinity(int thread_n) { UNUSED(thread_n);  }
 static void clear_numa_thread_affinity(void) {}
 #endif
 
+//
+// thread placement and priority
+//
+
+static bool ggml_thread_cpumask_is_valid(const bool * mask) {
+    for (int i = 0; i < GGML_MAX_N_THREADS; i++) {
+        if (mask[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// computes the mask of the next thread from the mask of the threadpool
+// with strict placement every thread gets the next cpu of the mask (wrapping around), otherwise the whole mask
+static void ggml_thread_cpumask_next(const bool * global_mask, bool * local_mask, bool strict, int32_t * iter) {
+    if (!strict) {
+        memcpy(local_mask, global_mask, GGML_MAX_N_THREADS);
+        return;
+    }
+
+    memset(local_mask, 0, GGML_MAX_N_THREADS);
+
+    const int32_t base_idx = *iter;
+    for (int32_t i = 0; i < GGML_MAX_N_THREADS; i++) {
+        int32_t idx = base_idx + i;
+        if (idx >= GGML_MAX_N_THREADS) {
+            // wrap around
+            idx -= GGML_MAX_N_THREADS;
+        }
+        if (global_mask[idx]) {
+            local_mask[idx] = true;
+            *iter = idx + 1;
+            return;
+        }
+    }
+}
+
+#if defined(_WIN32)
+
+static bool ggml_thread_apply_affinity(const bool * mask) {
+    // only the first processor group is supported
+    DWORD_PTR m = 0;
+    for (int i = 0; i < GGML_MAX_N_THREADS && i < (int) (8*sizeof(DWORD_PTR)); i++) {
+        if (mask[i]) {
+            m |= (DWORD_PTR) 1 << i;
+        }
+    }
+
+    if (m == 0 || SetThreadAffinityMask(GetCurrentThread(), m) == 0) {
+        fprintf(stderr, "warn: failed to set affinity mask 0x%llx : (%lu)\n", (unsigned long long) m, GetLastError());
+        return false;
+    }
+
+    return true;
+}
+
+static bool ggml_thread_apply_priority(int32_t prio) {
+    int p = THREAD_PRIORITY_NORMAL;
+    switch (prio) {
+        case GGML_SCHED_PRIO_NORMAL:   return true; // keep the priority of the process
+        case GGML_SCHED_PRIO_MEDIUM:   p = THREAD_PRIORITY_ABOVE_NORMAL;  break;
+        case GGML_SCHED_PRIO_HIGH:     p = THREAD_PRIORITY_HIGHEST;       break;
+        case GGML_SCHED_PRIO_REALTIME: p = THREAD_PRIORITY_TIME_CRITICAL; break;
+    }
+
+    if (!SetThreadPriority(GetCurrentThread(), p)) {
+        fprintf(stderr, "warn: failed to set thread priority %d : (%lu)\n", prio, GetLastError());
+        return false;
+    }
+
+    return true;
+}
+
+#else // posix
+
+#if defined(__gnu_linux__)
+static bool ggml_thread_apply_affinity(const bool * mask) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+
+    for (int i = 0; i < GGML_MAX_N_THREADS && i < CPU_SETSIZE; i++) {
+        if (mask[i]) {
+            CPU_SET(i, &cpuset);
+        }
+    }
+
+    const int err = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (err != 0) {
+        fprintf(stderr, "warn: failed to set affinity mask : %s (%d)\n", strerror(err), err);
+        return false;
+    }
+
+    return true;
+}
+#else
+// TODO: macOS only supports affinity tags, Android's bionic does not support pthread_setaffinity_np
+static bool ggml_thread_apply_affinity(const bool * mask) {
+    UNUSED(mask);
+    return false;
+}
+#endif
+
+static bool ggml_thread_apply_priority(int32_t prio) {
+    struct sched_param p;
+    int32_t policy = SCHED_OTHER;
+    switch (prio) {
+        case GGML_SCHED_PRIO_NORMAL:   return true; // keep the inherited policy and priority
+        case GGML_SCHED_PRIO_MEDIUM:   policy = SCHED_FIFO; p.sched_priority = 40; break;
+        case GGML_SCHED_PRIO_HIGH:     policy = SCHED_FIFO; p.sched_priority = 80; break;
+        case GGML_SCHED_PRIO_REALTIME: policy = SCHED_FIFO; p.sched_priority = 90; break;
+        default:                       return false;
+    }
+
+    const int err = pthread_setschedparam(pthread_self(), policy, &p);
+    if (err != 0) {
+        fprintf(stderr, "warn: failed to set thread priority %d : %s (%d)\n", prio, strerror(err), err);
+        return false;
+    }
+
+    return true;
+}
+
+#endif
+
+// applies the priority of the threadpool and the cpumask of the worker (or the NUMA affinity without a cpumask) to the calling thread
+static void ggml_thread_apply_placement(const struct ggml_threadpool * tp, const struct ggml_compute_state * state) {
+    ggml_thread_apply_priority(tp->prio);
+    if (ggml_thread_cpumask_is_valid(state->cpumask)) {
+        ggml_thread_apply_affinity(state->cpumask);
+    } else {
+        set_numa_thread_affinity(state->ith);
+    }
+}
+
+#ifdef GGML_USE_OPENMP
+// the placement last applied to the calling thread
+static GGML_THREAD_LOCAL struct {
+    bool    applied;
+    int32_t prio;
+    int     ith;
+    bool    cpumask[GGML_MAX_N_THREADS];
+} ggml_thread_placement;
+
+static void ggml_thread_apply_placement_cached(const struct ggml_threadpool * tp, const struct ggml_compute_state * state) {
+    if (ggml_thread_placement.applied && ggml_thread_placement.prio == tp->prio && ggml_thread_placement.ith == state->ith &&
+        memcmp(ggml_thread_placement.cpumask, state->cpumask, GGML_MAX_N_THREADS) == 0) {
+        return;
+    }
+
+    ggml_thread_apply_placement(tp, state);
+
+    ggml_thread_placement.applied = true;
+    ggml_thread_placement.prio    = tp->prio;
+    ggml_thread_placement.ith     = state->ith;
+    memcpy(ggml_thread_placement.cpumask, state->cpumask, GGML_MAX_N_THREADS);
+}
+#endif
+
+// the calling thread is worker 0 of the threadpool: it gets the priority of the threadpool and the cpumask of worker 0, if any
+// the previous settings of the thread are not restored
+static void ggml_threadpool_apply_main_placement(const struct ggml_threadpool * tp) {
+    ggml_thread_apply_priority(tp->prio);
+    if (ggml_thread_cpumask_is_valid(tp->workers[0].cpumask)) {
+        ggml_thread_apply_affinity(tp->workers[0].cpumask);
+    }
+}
+
 static int ggml_get_n_tasks(struct ggml_tensor * node, int n_threads) {
     int n_tasks = 0;
 
@@ -19133,9 +20549,162 @@ static int ggml_get_n_tasks(struct ggml_tensor * node, int n_threads) {
     return n_tasks;
 }
 
-struct ggml_cplan ggml_graph_plan(const struct ggml_cgraph * cgraph, int n_threads) {
+// size of the work buffer needed by a node when computed with n_tasks threads
+static size_t ggml_graph_node_work_size(const struct ggml_tensor * node, int n_tasks) {
+    size_t cur = 0;
+
+    switch (node->op) {
+        case GGML_OP_CPY:
+        case GGML_OP_DUP:
+            {
+                if (ggml_is_quantized(node->type) ||
+                    // F16 -> BF16 and BF16 -> F16 copies go through intermediate F32
+                    (node->src[0]->type == GGML_TYPE_F16  && node->src[1] && node->src[1]->type == GGML_TYPE_BF16) ||
+                    (node->src[0]->type == GGML_TYPE_BF16 && node->src[1] && node->src[1]->type == GGML_TYPE_F16)) {
+                    cur = ggml_type_size(GGML_TYPE_F32) * node->ne[0] * n_tasks;
+                }
+            } break;
+        case GGML_OP_ADD:
+        case GGML_OP_ADD1:
+            {
+                if (ggml_is_quantized(node->src[0]->type)) {
+                    cur = ggml_type_size(GGML_TYPE_F32) * node->src[0]->ne[0] * n_tasks;
+                }
+            } break;
+        case GGML_OP_ACC:
+            {
+                if (ggml_is_quantized(node->src[0]->type)) {
+                    cur = ggml_type_size(GGML_TYPE_F32) * node->src[1]->ne[0] * n_tasks;
+                }
+            } break;
+        case GGML_OP_MUL_MAT:
+            {
+                const enum ggml_type vec_dot_type = type_traits[node->src[0]->type].vec_dot_type;
+
+                if (node->src[1]->type != vec_dot_type) {
+                    cur = ggml_row_size(vec_dot_type, ggml_nelements(node->src[1]));
+                }
+#if defined(GGML_USE_AMX)
+                // per thread scratch memory of the AMX kernels, after the converted src1
+                cur += n_tasks*ggml_amx_work_size(node->src[0]->type, node->src[0]->ne[0]/ggml_blck_size(node->src[0]->type));
+#endif
+            } break;
+        case GGML_OP_MUL_MAT_ID:
+            {
+                cur = 0;
+                const struct ggml_tensor * src0 = node->src[0];
+                const struct ggml_tensor * src1 = node->src[1];
+                const enum ggml_type vec_dot_type = type_traits[src0->type].vec_dot_type;
+                if (src1->type != vec_dot_type) {
+                    cur += ggml_row_size(vec_dot_type, ggml_nelements(src1));
+                }
+                const int n_as = src0->ne[2];
+                cur += GGML_PAD(cur, sizeof(int64_t));       // align
+                cur += n_as * sizeof(int64_t);               // matrix_row_counts
+                cur += n_as * src1->ne[2] * sizeof(int64_t); // matrix_rows
+            } break;
+        case GGML_OP_OUT_PROD:
+            {
+                if (ggml_is_quantized(node->src[0]->type)) {
+                    cur = ggml_type_size(GGML_TYPE_F32) * node->src[0]->ne[0] * n_tasks;
+                }
+            } break;
+        case GGML_OP_SOFT_MAX:
+        case GGML_OP_ROPE:
+            {
+                cur = ggml_type_size(GGML_TYPE_F32) * node->ne[0] * n_tasks;
+            } break;
+        case GGML_OP_CONV_TRANSPOSE_1D:
+            {
+                GGML_ASSERT(node->src[0]->ne[3] == 1);
+                GGML_ASSERT(node->src[1]->ne[2] == 1);
+                GGML_ASSERT(node->src[1]->ne[3] == 1);
+
+                const int64_t ne00 = node->src[0]->ne[0];  // K
+                const int64_t ne01 = node->src[0]->ne[1];  // Cout
+                const int64_t ne02 = node->src[0]->ne[2];  // Cin
+
+                const int64_t ne10 = node->src[1]->ne[0];  // L
+                const int64_t ne11 = node->src[1]->ne[1];  // Cin
+
+                if ((node->src[0]->type == GGML_TYPE_F16 ||
+                     node->src[0]->type == GGML_TYPE_BF16) &&
+                    node->src[1]->type == GGML_TYPE_F32) {
+                    cur += sizeof(ggml_fp16_t)*ne00*ne01*ne02;
+                    cur += sizeof(ggml_fp16_t)*ne10*ne11;
+                } else if (node->src[0]->type == GGML_TYPE_F32 &&
+                           node->src[1]->type == GGML_TYPE_F32) {
+                    cur += sizeof(float)*ne00*ne01*ne02;
+                    cur += sizeof(float)*ne10*ne11;
+                } else {
+                    GGML_ABORT("fatal error");
+                }
+            } break;
+        case GGML_OP_CONV_TRANSPOSE_2D:
+            {
+                const int64_t ne00 = node->src[0]->ne[0]; // W
+                const int64_t ne01 = node->src[0]->ne[1]; // H
+                const int64_t ne02 = node->src[0]->ne[2]; // Channels Out
+                const int64_t ne03 = node->src[0]->ne[3]; // Channels In
+
+                const int64_t ne10 = node->src[1]->ne[0]; // W
+                const int64_t ne11 = node->src[1]->ne[1]; // H
+                const int64_t ne12 = node->src[1]->ne[2]; // Channels In
+
+                cur += sizeof(ggml_fp16_t)*ne00*ne01*ne02*ne03;
+                cur += sizeof(ggml_fp16_t)*ne10*ne11*ne12;
+            } break;
+        case GGML_OP_FLASH_ATTN_EXT:
+            {
+                const int64_t ne00 = node->src[0]->ne[0]; // D
+
+                cur = 3*sizeof(float)*ne00*n_tasks; // 3x head size/thread
+            } break;
+        case GGML_OP_FLASH_ATTN_BACK:
+            {
+                const int64_t    D = node->src[0]->ne[0];
+                const int64_t ne11 = ggml_up(node->src[1]->ne[1], GGML_SOFT_MAX_UNROLL);
+                const int64_t mxDn = MAX(D, ne11) * 2; // *2 because of S and SM in ggml_compute_forward_flash_attn_back
+                if (node->src[1]->type == GGML_TYPE_F32) {
+                    cur  = sizeof(float)*mxDn*n_tasks; // TODO: this can become (n_tasks-1)
+                    cur += sizeof(float)*mxDn*n_tasks; // this is overestimated by x2
+                } else if (node->src[1]->type == GGML_TYPE_F16) {
+                    cur  = sizeof(float)*mxDn*n_tasks; // TODO: this can become (n_tasks-1)
+                    cur += sizeof(float)*mxDn*n_tasks; // this is overestimated by x2
+                } else if (node->src[1]->type == GGML_TYPE_BF16) {
+                    cur  = sizeof(float)*mxDn*n_tasks; // TODO: this can become (n_tasks-1)
+                    cur += sizeof(float)*mxDn*n_tasks; // this is overestimated by x2
+                }
+            } break;
+
+        case GGML_OP_CROSS_ENTROPY_LOSS:
+            {
+                cur = ggml_type_size(node->type)*(n_tasks + node->src[0]->ne[0]*n_tasks);
+            } break;
+        case GGML_OP_COUNT:
+            {
+                GGML_ABORT("fatal error");
+            }
+        default:
+            break;
+    }
+
+    return cur;
+}
+
+static size_t ggml_graph_src1_cache_size(const struct ggml_cgraph * cgraph);
+
+struct ggml_cplan ggml_graph_plan(
+          const struct ggml_cgraph * cgraph,
+                               int   n_threads,
+            struct ggml_threadpool * threadpool) {
+
     if (n_threads <= 0) {
-        n_threads = GGML_DEFAULT_N_THREADS;
+        n_threads = threadpool ? threadpool->n_threads_max : GGML_DEFAULT_N_THREADS;
+    }
+
+    if (threadpool && n_threads > threadpool->n_threads_max) {
+        n_threads = threadpool->n_threads_max;
     }
 
     size_t work_size = 0;
@@ -19149,143 +20718,14 @@ struct ggml_cplan ggml_graph_plan(const struct ggml_cgraph * cgraph, int n_threa
     for (int i = 0; i < cgraph->n_nodes; i++) {
         struct ggml_tensor * node = cgraph->nodes[i];
 
+        // the repacked weights are only understood by mul_mat (see ggml_backend_cpu_repack_buffer_type)
+        GGML_ASSERT(ggml_backend_cpu_repack_supports_op(node));
+
         const int n_tasks = ggml_get_n_tasks(node, n_threads);
 
         max_tasks = MAX(max_tasks, n_tasks);
 
-        size_t cur = 0;
-
-        switch (node->op) {
-            case GGML_OP_CPY:
-            case GGML_OP_DUP:
-                {
-                    if (ggml_is_quantized(node->type) ||
-                        // F16 -> BF16 and BF16 -> F16 copies go through intermediate F32
-                        (node->src[0]->type == GGML_TYPE_F16  && node->src[1] && node->src[1]->type == GGML_TYPE_BF16) ||
-                        (node->src[0]->type == GGML_TYPE_BF16 && node->src[1] && node->src[1]->type == GGML_TYPE_F16)) {
-                        cur = ggml_type_size(GGML_TYPE_F32) * node->ne[0] * n_tasks;
-                    }
-                } break;
-            case GGML_OP_ADD:
-            case GGML_OP_ADD1:
-                {
-                    if (ggml_is_quantized(node->src[0]->type)) {
-                        cur = ggml_type_size(GGML_TYPE_F32) * node->src[0]->ne[0] * n_tasks;
-                    }
-                } break;
-            case GGML_OP_ACC:
-                {
-                    if (ggml_is_quantized(node->src[0]->type)) {
-                        cur = ggml_type_size(GGML_TYPE_F32) * node->src[1]->ne[0] * n_tasks;
-                    }
-                } break;
-            case GGML_OP_MUL_MAT:
-                {
-                    const enum ggml_type vec_dot_type = type_traits[node->src[0]->type].vec_dot_type;
-
-                    if (node->src[1]->type != vec_dot_type) {
-                        cur = ggml_row_size(vec_dot_type, ggml_nelements(node->src[1]));
-                    }
-                } break;
-            case GGML_OP_MUL_MAT_ID:
-                {
-                    cur = 0;
-                    const struct ggml_tensor * src0 = node->src[0];
-                    const struct ggml_tensor * src1 = node->src[1];
-                    const enum ggml_type vec_dot_type = type_traits[src0->type].vec_dot_type;
-                    if (src1->type != vec_dot_type) {
-                        cur += ggml_row_size(vec_dot_type, ggml_nelements(src1));
-                    }
-                    const int n_as = src0->ne[2];
-                    cur += GGML_PAD(cur, sizeof(int64_t));       // align
-                    cur += n_as * sizeof(int64_t);               // matrix_row_counts
-                    cur += n_as * src1->ne[2] * sizeof(int64_t); // matrix_rows
-                } break;
-            case GGML_OP_OUT_PROD:
-                {
-                    if (ggml_is_quantized(node->src[0]->type)) {
-                        cur = ggml_type_size(GGML_TYPE_F32) * node->src[0]->ne[0] * n_tasks;
-                    }
-                } break;
-            case GGML_OP_SOFT_MAX:
-            case GGML_OP_ROPE:
-                {
-                    cur = ggml_type_size(GGML_TYPE_F32) * node->ne[0] * n_tasks;
-                } break;
-            case GGML_OP_CONV_TRANSPOSE_1D:
-                {
-                    GGML_ASSERT(node->src[0]->ne[3] == 1);
-                    GGML_ASSERT(node->src[1]->ne[2] == 1);
-                    GGML_ASSERT(node->src[1]->ne[3] == 1);
-
-                    const int64_t ne00 = node->src[0]->ne[0];  // K
-                    const int64_t ne01 = node->src[0]->ne[1];  // Cout
-                    const int64_t ne02 = node->src[0]->ne[2];  // Cin
-
-                    const int64_t ne10 = node->src[1]->ne[0];  // L
-                    const int64_t ne11 = node->src[1]->ne[1];  // Cin
-
-                    if ((node->src[0]->type == GGML_TYPE_F16 ||
-                         node->src[0]->type == GGML_TYPE_BF16) &&
-                        node->src[1]->type == GGML_TYPE_F32) {
-                        cur += sizeof(ggml_fp16_t)*ne00*ne01*ne02;
-                        cur += sizeof(ggml_fp16_t)*ne10*ne11;
-                    } else if (node->src[0]->type == GGML_TYPE_F32 &&
-                               node->src[1]->type == GGML_TYPE_F32) {
-                        cur += sizeof(float)*ne00*ne01*ne02;
-                        cur += sizeof(float)*ne10*ne11;
-                    } else {
-                        GGML_ABORT("fatal error");
-                    }
-                } break;
-            case GGML_OP_CONV_TRANSPOSE_2D:
-                {
-                    const int64_t ne00 = node->src[0]->ne[0]; // W
-                    const int64_t ne01 = node->src[0]->ne[1]; // H
-                    const int64_t ne02 = node->src[0]->ne[2]; // Channels Out
-                    const int64_t ne03 = node->src[0]->ne[3]; // Channels In
-
-                    const int64_t ne10 = node->src[1]->ne[0]; // W
-                    const int64_t ne11 = node->src[1]->ne[1]; // H
-                    const int64_t ne12 = node->src[1]->ne[2]; // Channels In
-
-                    cur += sizeof(ggml_fp16_t)*ne00*ne01*ne02*ne03;
-                    cur += sizeof(ggml_fp16_t)*ne10*ne11*ne12;
-                } break;
-            case GGML_OP_FLASH_ATTN_EXT:
-                {
-                    const int64_t ne00 = node->src[0]->ne[0]; // D
-
-                    cur = 3*sizeof(float)*ne00*n_tasks; // 3x head size/thread
-                } break;
-            case GGML_OP_FLASH_ATTN_BACK:
-                {
-                    const int64_t    D = node->src[0]->ne[0];
-                    const int64_t ne11 = ggml_up(node->src[1]->ne[1], GGML_SOFT_MAX_UNROLL);
-                    const int64_t mxDn = MAX(D, ne11) * 2; // *2 because of S and SM in ggml_compute_forward_flash_attn_back
-                    if (node->src[1]->type == GGML_TYPE_F32) {
-                        cur  = sizeof(float)*mxDn*n_tasks; // TODO: this can become (n_tasks-1)
-                        cur += sizeof(float)*mxDn*n_tasks; // this is overestimated by x2
-                    } else if (node->src[1]->type == GGML_TYPE_F16) {
-                        cur  = sizeof(float)*mxDn*n_tasks; // TODO: this can become (n_tasks-1)
-                        cur += sizeof(float)*mxDn*n_tasks; // this is overestimated by x2
-                    } else if (node->src[1]->type == GGML_TYPE_BF16) {
-                        cur  = sizeof(float)*mxDn*n_tasks; // TODO: this can become (n_tasks-1)
-                        cur += sizeof(float)*mxDn*n_tasks; // this is overestimated by x2
-                    }
-                } break;
-
-            case GGML_OP_CROSS_ENTROPY_LOSS:
-                {
-                    cur = ggml_type_size(node->type)*(n_tasks + node->src[0]->ne[0]*n_tasks);
-                } break;
-            case GGML_OP_COUNT:
-                {
-                    GGML_ABORT("fatal error");
-                }
-            default:
-                break;
-        }
+        const size_t cur = ggml_graph_node_work_size(node, n_tasks);
 
         work_size = MAX(work_size, cur);
     }
@@ -19294,68 +20734,1078 @@ struct ggml_cplan ggml_graph_plan(const struct ggml_cgraph * cgraph, int n_threa
         work_size += CACHE_LINE_SIZE*(n_threads - 1);
     }
 
-    cplan.n_threads = MIN(max_tasks, n_threads);
-    cplan.work_size = work_size;
-    cplan.work_data = NULL;
+    // the src1 cache is after the work buffer of the nodes, aligned to a cache line
+    const size_t src1_cache_size = ggml_graph_src1_cache_size(cgraph);
+    if (src1_cache_size > 0) {
+        work_size += src1_cache_size + CACHE_LINE_SIZE;
+    }
+
+    cplan.threadpool = threadpool;
+    cplan.n_threads  = MIN(max_tasks, n_threads);
+    cplan.work_size  = work_size;
+    cplan.work_data  = NULL;
 
     return cplan;
 }
 
-static thread_ret_t ggml_graph_compute_thread(void * data) {
-    struct ggml_compute_state * state = (struct ggml_compute_state *) data;
+// max number of memory ranges tracked between two barriers in GGML_GRAPH_EXEC_MODE_DEPENDENCY
+#define GGML_DEP_MAX_RANGES 64
 
-    const struct ggml_cgraph * cgraph = state->shared->cgraph;
-    const struct ggml_cplan  * cplan  = state->shared->cplan;
+struct ggml_mem_range {
+    uintptr_t b; // begin
+    uintptr_t e; // end (exclusive)
+};
 
-    set_numa_thread_affinity(state->ith);
+static struct ggml_mem_range ggml_tensor_mem_range(const struct ggml_tensor * t) {
+    const uintptr_t b = (uintptr_t) t->data;
+    return (struct ggml_mem_range) { b, b + ggml_nbytes(t) };
+}
 
-    struct ggml_compute_params params = {
-        /*.ith   =*/ state->ith,
-        /*.nth   =*/ state->shared->n_threads,
-        /*.wsize =*/ cplan->work_size,
-        /*.wdata =*/ cplan->work_data,
-        /*.shared=*/ state->shared,
+static bool ggml_mem_range_overlaps(struct ggml_mem_range r, const struct ggml_mem_range * ranges, int n) {
+    for (int i = 0; i < n; i++) {
+        if (r.b < ranges[i].e && ranges[i].b < r.e) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ggml_graph_node_is_noop(const struct ggml_tensor * node) {
+    switch (node->op) {
+        case GGML_OP_NONE:
+        case GGML_OP_RESHAPE:
+        case GGML_OP_VIEW:
+        case GGML_OP_PERMUTE:
+        case GGML_OP_TRANSPOSE:
+            return true;
+        default:
+            return ggml_is_empty(node);
+    }
+}
+
+//
+// src1 cache
+//
+// the mul_mats that convert the same src1 to the same vec_dot_type (e.g. the Q, K and V projections, or the gate
+// and up projections of a FFN) share the conversion: the first one converts src1 in the src1 cache at the end of
+// the work buffer, the next ones use it as is and skip both the conversion and the barrier after it
+// the cache holds one src1 at a time and is valid until a node writes to the memory of src1
+//
+
+// max number of nodes searched after a mul_mat for another mul_mat with the same src1
+#define GGML_SRC1_CACHE_LOOKAHEAD 64
+
+struct ggml_src1_cache {
+    const struct ggml_tensor * src1; // NULL if the cache is empty
+    enum ggml_type             vec_dot_type;
+    bool                       mat;  // converted in groups of 4 rows for the gemm kernels
+};
+
+// returns false if the mul_mat uses src1 as is
+static bool ggml_mul_mat_src1_conv(const struct ggml_tensor * node, enum ggml_type * vec_dot_type, bool * mat) {
+    const enum ggml_type type = ggml_backend_cpu_repack_type(node->src[0]);
+
+    *vec_dot_type = type_traits[type].vec_dot_type;
+    *mat          = type_traits[type].gemm != NULL && type_traits[*vec_dot_type].from_float_to_mat != NULL;
+
+    return node->src[1]->type != *vec_dot_type;
+}
+
+static bool ggml_src1_cache_match(const struct ggml_tensor * node, const struct ggml_src1_cache * cache) {
+    enum ggml_type vec_dot_type;
+    bool mat;
+
+    return node->op == GGML_OP_MUL_MAT && node->src[1] == cache->src1 &&
+           ggml_mul_mat_src1_conv(node, &vec_dot_type, &mat) && vec_dot_type == cache->vec_dot_type && mat == cache->mat;
+}
+
+// the use of the src1 cache by the node i, the nodes must be visited in order
+// cache is the state of the cache after the previous nodes and is updated for the next ones
+static enum ggml_src1_cache_mode ggml_src1_cache_next(const struct ggml_cgraph * cgraph, int i, struct ggml_src1_cache * cache) {
+    const struct ggml_tensor * node = cgraph->nodes[i];
+
+    if (ggml_graph_node_is_noop(node)) {
+        return GGML_SRC1_CACHE_NONE;
+    }
+
+    if (cache->src1) {
+        if (ggml_src1_cache_match(node, cache)) {
+            return GGML_SRC1_CACHE_LOAD;
+        }
+
+        const struct ggml_mem_range src1_range = ggml_tensor_mem_range(cache->src1);
+        if (ggml_mem_range_overlaps(ggml_tensor_mem_range(node), &src1_range, 1)) {
+            cache->src1 = NULL;
+        }
+    }
+
+    struct ggml_src1_cache conv = { node->src[1], GGML_TYPE_COUNT, false };
+
+    if (node->op != GGML_OP_MUL_MAT || !ggml_mul_mat_src1_conv(node, &conv.vec_dot_type, &conv.mat)) {
+        return GGML_SRC1_CACHE_NONE;
+    }
+
+    // store the conversion only if another mul_mat will load it
+    const struct ggml_mem_range src1_range = ggml_tensor_mem_range(node->src[1]);
+
+    for (int j = i + 1; j < MIN(cgraph->n_nodes, i + 1 + GGML_SRC1_CACHE_LOOKAHEAD); j++) {
+        const struct ggml_tensor * next = cgraph->nodes[j];
+
+        if (ggml_graph_node_is_noop(next)) {
+            continue;
+        }
+
+        if (ggml_src1_cache_match(next, &conv)) {
+            *cache = conv;
+            return GGML_SRC1_CACHE_STORE;
+        }
+
+        if (ggml_mem_range_overlaps(ggml_tensor_mem_range(next), &src1_range, 1)) {
+            break;
+        }
+    }
+
+    return GGML_SRC1_CACHE_NONE;
+}
+
+// size of the largest src1 stored in the src1 cache
+static size_t ggml_graph_src1_cache_size(const struct ggml_cgraph * cgraph) {
+    struct ggml_src1_cache cache = { NULL, GGML_TYPE_COUNT, false };
+
+    size_t size = 0;
+
+    for (int i = 0; i < cgraph->n_nodes; i++) {
+        if (ggml_src1_cache_next(cgraph, i, &cache) == GGML_SRC1_CACHE_STORE) {
+            size = MAX(size, ggml_row_size(cache.vec_dot_type, ggml_nelements(cache.src1)));
+        }
+    }
+
+    return size;
+}
+
+static bool ggml_fuse_is_f32_cont(const struct ggml_tensor * t) {
+    return t->type == GGML_TYPE_F32 && ggml_is_contiguous(t);
+}
+
+// node can be computed in the same pass over the rows as prev
+static bool ggml_fuse_can_append(const struct ggml_tensor * prev, const struct ggml_tensor * node) {
+    if (!ggml_fuse_is_f32_cont(node) || !ggml_are_same_shape(prev, node)) {
+        return false;
+    }
+
+    switch (node->op) {
+        case GGML_OP_ADD:
+        case GGML_OP_SUB:
+        case GGML_OP_MUL:
+        case GGML_OP_DIV:
+            {
+                const struct ggml_tensor * src1;
+                if (node->src[0] == prev) {
+                    src1 = node->src[1];
+                } else if (node->src[1] == prev && (node->op == GGML_OP_ADD || node->op == GGML_OP_MUL)) {
+                    src1 = node->src[0];
+                } else {
+                    return false;
+                }
+
+                return src1->type == GGML_TYPE_F32 && src1->nb[0] == sizeof(float) && src1->ne[0] == node->ne[0] &&
+                    ggml_can_repeat(src1, node);
+            }
+        case GGML_OP_SCALE:
+        case GGML_OP_DIAG_MASK_INF:
+        case GGML_OP_DIAG_MASK_ZERO:
+            return node->src[0] == prev;
+        case GGML_OP_UNARY:
+            {
+                if (node->src[0] != prev) {
+                    return false;
+                }
+
+                switch (ggml_get_unary_op(node)) {
+                    case GGML_UNARY_OP_NEG:
+                    case GGML_UNARY_OP_TANH:
+                    case GGML_UNARY_OP_RELU:
+                    case GGML_UNARY_OP_SIGMOID:
+                    case GGML_UNARY_OP_GELU:
+                    case GGML_UNARY_OP_GELU_QUICK:
+                    case GGML_UNARY_OP_SILU:
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+        default:
+            return false;
+    }
+}
+
+// the result of t is only used by the next node of the graph, so it does not need to be written
+static bool ggml_fuse_is_temporary(const struct ggml_cgraph * cgraph, const int32_t * n_uses, struct ggml_tensor * t) {
+    if (t->flags & (GGML_TENSOR_FLAG_INPUT | GGML_TENSOR_FLAG_OUTPUT | GGML_TENSOR_FLAG_PARAM)) {
+        return false;
+    }
+    return n_uses[ggml_hash_find(&cgraph->visited_hash_set, t)] == 1;
+}
+
+// soft_max(scale(a, s)) is computed as soft_max_ext(a, mask, s, max_bias)
+static bool ggml_fuse_can_fold_scale(const struct ggml_cgraph * cgraph, const int32_t * n_uses, struct ggml_tensor * scale, const struct ggml_tensor * soft_max) {
+    if (scale->op != GGML_OP_SCALE || soft_max->op != GGML_OP_SOFT_MAX || soft_max->src[0] != scale) {
+        return false;
+    }
+
+    float soft_max_scale;
+    memcpy(&soft_max_scale, soft_max->op_params, sizeof(float));
+
+    return soft_max_scale == 1.0f && ggml_fuse_is_f32_cont(scale->src[0]) && ggml_fuse_is_temporary(cgraph, n_uses, scale);
+}
+
+int ggml_graph_fuse(struct ggml_cgraph * cgraph) {
+    for (int i = 0; i < cgraph->n_nodes; i++) {
+        cgraph->nodes[i]->flags &= ~GGML_TENSOR_FLAG_FUSED;
+    }
+
+    // the intermediate results are needed to compute the gradients
+    // graph views do not have a hash set to count the uses of the nodes
+    if (cgraph->grads != NULL || cgraph->visited_hash_set.size == 0) {
+        return 0;
+    }
+
+    int32_t * n_uses = GGML_CALLOC(cgraph->visited_hash_set.size, sizeof(int32_t));
+
+    for (int i = 0; i < cgraph->n_nodes; i++) {
+        struct ggml_tensor * node = cgraph->nodes[i];
+        for (int j = 0; j < GGML_MAX_SRC; j++) {
+            if (node->src[j] && ggml_hash_contains(&cgraph->visited_hash_set, node->src[j])) {
+                n_uses[ggml_hash_find(&cgraph->visited_hash_set, node->src[j])]++;
+            }
+        }
+    }
+
+    int n_fused = 0;
+
+    for (int i = 0; i < cgraph->n_nodes - 1; i++) {
+        struct ggml_tensor * head = cgraph->nodes[i];
+
+        if (ggml_graph_node_is_noop(head) || !ggml_fuse_is_f32_cont(head)) {
+            continue;
+        }
+
+        if (ggml_fuse_can_fold_scale(cgraph, n_uses, head, cgraph->nodes[i + 1])) {
+            cgraph->nodes[i + 1]->flags |= GGML_TENSOR_FLAG_FUSED;
+            n_fused++;
+            i++;
+            continue;
+        }
+
+        // the head is always written, the nodes after it only when they are the last of the chain
+        struct ggml_tensor * prev = head;
+
+        int n = 0;
+        while (n < GGML_FUSE_MAX_OPS && i + n + 1 < cgraph->n_nodes) {
+            struct ggml_tensor * node = cgraph->nodes[i + n + 1];
+
+            if (prev != head && !ggml_fuse_is_temporary(cgraph, n_uses, prev)) {
+                break;
+            }
+
+            // leave the scale to the soft_max after it
+            if (i + n + 2 < cgraph->n_nodes && ggml_fuse_can_fold_scale(cgraph, n_uses, node, cgraph->nodes[i + n + 2])) {
+                break;
+            }
+
+            if (!ggml_fuse_can_append(prev, node)) {
+                break;
+            }
+
+            node->flags |= GGML_TENSOR_FLAG_FUSED;
+            prev = node;
+            n++;
+        }
+
+        n_fused += n;
+        i += n;
+    }
+
+    GGML_FREE(n_uses);
+
+    return n_fused;
+}
+
+// number of nodes fused after the node i, see ggml_graph_fuse
+static int ggml_graph_fused_count(const struct ggml_cgraph * cgraph, int i) {
+    if (i + 1 >= cgraph->n_nodes || !(cgraph->nodes[i + 1]->flags & GGML_TENSOR_FLAG_FUSED) || ggml_graph_node_is_noop(cgraph->nodes[i])) {
+        return 0;
+    }
+
+    const struct ggml_tensor * prev = cgraph->nodes[i];
+
+    int n = 0;
+    while (n < GGML_FUSE_MAX_OPS && i + n + 1 < cgraph->n_nodes) {
+        const struct ggml_tensor * node = cgraph->nodes[i + n + 1];
+
+        if (!(node->flags & GGML_TENSOR_FLAG_FUSED) || (node->src[0] != prev && node->src[1] != prev)) {
+            break;
+        }
+
+        n++;
+
+        if (node->op == GGML_OP_SOFT_MAX) {
+            break;
+        }
+
+        prev = node;
+    }
+
+    return n;
+}
+
+// build the steps computed by the threads, the nodes that do nothing (views, reshapes, ...) are skipped
+// returns the number of steps, steps must have room for cgraph->n_nodes steps
+// GGML_GRAPH_EXEC_MODE_SEQUENTIAL: there is a barrier after each step
+// GGML_GRAPH_EXEC_MODE_DEPENDENCY: find the steps after which a barrier is needed
+//   all threads still go through the steps in order, but a thread that finishes its part of a step can
+//   start working on the next one without waiting for the others, as long as the next step does not read
+//   or write memory that was written (or read) by the steps since the last barrier
+//   the steps that use the work buffer cannot overlap with each other either
+static int ggml_graph_schedule(const struct ggml_cgraph * cgraph, int n_threads, enum ggml_graph_exec_mode exec_mode, struct ggml_graph_step * steps) {
+    const bool deps = exec_mode == GGML_GRAPH_EXEC_MODE_DEPENDENCY && n_threads > 1;
+
+    struct ggml_mem_range reads [GGML_DEP_MAX_RANGES];
+    struct ggml_mem_range writes[GGML_DEP_MAX_RANGES];
+
+    int  n_reads  = 0;
+    int  n_writes = 0;
+    bool scratch  = false; // a step since the last barrier uses the work buffer or the chunk counter
+    bool cached   = false; // a step since the last barrier uses the src1 cache
+    int  n_steps  = 0;
+
+    struct ggml_src1_cache src1_cache = { NULL, GGML_TYPE_COUNT, false };
+
+    for (int i = 0; i < cgraph->n_nodes; i++) {
+        struct ggml_tensor * node = cgraph->nodes[i];
+
+        if (ggml_graph_node_is_noop(node)) {
+            continue;
+        }
+
+        // the nodes fused after this one are computed with it and are handled as a single node
+        const int n_fused = ggml_graph_fused_count(cgraph, i);
+
+        const enum ggml_src1_cache_mode src1_cache_mode = ggml_src1_cache_next(cgraph, i, &src1_cache);
+        for (int k = i + 1; k <= i + n_fused; k++) {
+            ggml_src1_cache_next(cgraph, k, &src1_cache);
+        }
+
+        bool dep = true;
+
+        if (deps) {
+            dep = n_writes + n_fused + 1 > GGML_DEP_MAX_RANGES || n_reads + (n_fused + 1)*GGML_MAX_SRC > GGML_DEP_MAX_RANGES;
+
+            bool node_scratch = false;
+
+            for (int k = i; k <= i + n_fused; k++) {
+                node = cgraph->nodes[k];
+
+                node_scratch = node_scratch || ggml_graph_node_work_size(node, ggml_get_n_tasks(node, n_threads)) > 0;
+
+                const struct ggml_mem_range w = ggml_tensor_mem_range(node);
+
+                // write after read, write after write
+                dep = dep || ggml_mem_range_overlaps(w, reads, n_reads) || ggml_mem_range_overlaps(w, writes, n_writes);
+
+                // read after write
+                for (int j = 0; j < GGML_MAX_SRC && !dep; j++) {
+                    if (node->src[j] && node->src[j]->data) {
+                        dep = ggml_mem_range_overlaps(ggml_tensor_mem_range(node->src[j]), writes, n_writes);
+                    }
+                }
+            }
+
+            dep = dep || (node_scratch && scratch);
+
+            // a STORE overwrites the src1 cache, a LOAD only needs the STORE before it (which has its own barrier)
+            dep = dep || (src1_cache_mode == GGML_SRC1_CACHE_STORE && cached);
+
+            if (dep) {
+                n_reads  = 0;
+                n_writes = 0;
+                scratch  = false;
+                cached   = false;
+            }
+
+            for (int k = i; k <= i + n_fused; k++) {
+                node = cgraph->nodes[k];
+
+                writes[n_writes++] = ggml_tensor_mem_range(node);
+                for (int j = 0; j < GGML_MAX_SRC; j++) {
+                    if (node->src[j] && node->src[j]->data) {
+                        reads[n_reads++] = ggml_tensor_mem_range(node->src[j]);
+                    }
+                }
+            }
+            scratch = scratch || node_scratch;
+            cached  = cached  || src1_cache_mode != GGML_SRC1_CACHE_NONE;
+        }
+
+        if (dep && n_steps > 0) {
+            steps[n_steps - 1].sync = true;
+        }
+
+        steps[n_steps++] = (struct ggml_graph_step) {
+            /*.node_n     =*/ i,
+            /*.n_fused    =*/ n_fused,
+            /*.sync       =*/ false,
+            /*.src1_cache =*/ src1_cache_mode,
+        };
+
+        i += n_fused;
+    }
+
+    // the threads must be done with the graph when ggml_graph_compute returns
+    if (n_steps > 0) {
+        steps[n_steps - 1].sync = true;
+    }
+
+    return n_steps;
+}
+
+static thread_ret_t ggml_graph_compute_thread(void * data) {
+    struct ggml_compute_state * state = (struct ggml_compute_state *) data;
+    struct ggml_threadpool    * tp    = state->threadpool;
+
+    const struct ggml_cgraph * cgraph = tp->cgraph;
+    const struct ggml_cplan  * cplan  = tp->cplan;
+
+    if (state->ith == 0) {
+        // the main thread belongs to the caller: only the NUMA affinity is set, and cleared after the graph
+        // the priority and the cpumask are applied when the threadpool is resumed, see ggml_threadpool_apply_main_placement
+        if (!ggml_thread_cpumask_is_valid(state->cpumask)) {
+            set_numa_thread_affinity(0);
+        }
+    } else {
+#ifdef GGML_USE_OPENMP
+        // the OpenMP threads are not owned by the threadpool, the placement is applied when it changes
+        ggml_thread_apply_placement_cached(tp, state);
+#endif
+    }
+
+    struct ggml_compute_params params = {
+        /*.ith       =*/ state->ith,
+        /*.nth       =*/ tp->n_threads_cur,
+        /*.wsize     =*/ cplan->work_size,
+        /*.wdata     =*/ cplan->work_data,
+        /*.threadpool=*/ tp,
+        /*.chunk     =*/ NULL,
+        /*.numa_node =*/ ggml_is_numa() ? ggml_numa_current_node() : 0,
+        /*.fused     =*/ NULL,
+        /*.src1_cache=*/ GGML_SRC1_CACHE_NONE,
     };
 
-    for (int node_n = 0; node_n < cgraph->n_nodes; node_n++) {
-        struct ggml_tensor * node = cgraph->nodes[node_n];
+    // note: the main thread may return and the caller free the graph as soon as the last barrier
+    //       is passed, so the graph must not be accessed after that
+    struct ggml_tensor ** nodes = cgraph->nodes;
+
+    const struct ggml_graph_step * steps   = tp->steps;
+    const int                      n_steps = tp->n_steps;
+
+    for (int step_n = 0; step_n < n_steps; step_n++) {
+        const struct ggml_graph_step * step = &steps[step_n];
+
+        params.chunk      = &tp->node_chunks[step->node_n*tp->node_chunks_stride];
+        params.src1_cache = step->src1_cache;
+
+        if (step->n_fused > 0) {
+            ggml_compute_forward_fused(&params, nodes + step->node_n, step->n_fused);
+        } else {
+            ggml_compute_forward(&params, nodes[step->node_n]);
+        }
+
+        if (!step->sync) {
+            // the next step does not depend on this one
+            continue;
+        }
+
+        if (state->ith == 0 && cplan->abort_callback && cplan->abort_callback(cplan->abort_callback_data)) {
+            tp->ec = GGML_STATUS_ABORTED;
+        }
+
+        ggml_barrier(&params);
+
+        if (tp->ec != GGML_STATUS_SUCCESS) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+#ifndef GGML_USE_OPENMP
+
+static thread_ret_t ggml_graph_compute_secondary_thread(void * data) {
+    struct ggml_compute_state * state      = (struct ggml_compute_state *) data;
+    struct ggml_threadpool    * threadpool = state->threadpool;
+
+    // the thread is used only by this threadpool, the placement is applied once
+    ggml_thread_apply_placement(threadpool, state);
+
+    while (true) {
+        // poll for a new graph for a while before going to sleep, this keeps the
+        // latency low when graphs are submitted back to back (e.g. token by token decoding)
+        for (uint32_t i = 0; i < threadpool->n_spin && atomic_load(&threadpool->n_graph) == state->last_graph; i++) {
+            ggml_thread_cpu_relax();
+        }
+
+        // park until there is a new graph to work on or the threadpool is stopped
+        ggml_mutex_lock(&threadpool->mutex);
+        while (!threadpool->stop && (threadpool->pause || atomic_load(&threadpool->n_graph) == state->last_graph)) {
+            ggml_cond_wait(&threadpool->cond, &threadpool->mutex);
+        }
+        const bool stop = threadpool->stop;
+        // the graph and its number of threads are read together: a thread that is not used by the graph is not
+        // waited for, and the next graph (with another number of threads) may be started before it gets here
+        state->last_graph = atomic_load(&threadpool->n_graph);
+        const int n_threads = threadpool->n_threads_cur;
+        ggml_mutex_unlock(&threadpool->mutex);
+
+        if (stop) {
+            break;
+        }
+
+        if (state->ith < n_threads) {
+            ggml_graph_compute_thread(state);
+            atomic_fetch_sub(&threadpool->n_active, 1);
+        }
+    }
+
+    return (thread_ret_t) 0;
+}
+
+// start processing the graph that is set in the threadpool
+static void ggml_graph_compute_kickoff(struct ggml_threadpool * threadpool, int n_threads) {
+    ggml_mutex_lock(&threadpool->mutex);
+
+    threadpool->n_threads_cur = n_threads;
+    atomic_store(&threadpool->n_active, n_threads - 1);
+    atomic_fetch_add(&threadpool->n_graph, 1);
+
+    // submitting work resumes a paused threadpool
+    if (threadpool->pause) {
+        ggml_threadpool_apply_main_placement(threadpool);
+        threadpool->pause = false;
+    }
+
+    ggml_cond_broadcast(&threadpool->cond);
+    ggml_mutex_unlock(&threadpool->mutex);
+}
+
+#endif // GGML_USE_OPENMP
+
+// number of CPUs available to the process
+static int ggml_get_n_cpus(void) {
+#if defined(__gnu_linux__)
+    cpu_set_t mask;
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        return CPU_COUNT(&mask);
+    }
+    return (int) sysconf(_SC_NPROCESSORS_ONLN);
+#elif defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int) info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    return (int) sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    return GGML_DEFAULT_N_THREADS;
+#endif
+}
+
+#if defined(__gnu_linux__)
+// parses a cpu list such as "0-3,8,10-11" from a sysfs file into mask
+static bool ggml_cpu_read_list(const char * path, bool * mask) {
+    FILE * f = ggml_fopen(path, "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    char buf[1024];
+    const bool ok = fgets(buf, sizeof(buf), f) != NULL;
+    fclose(f);
+    if (!ok) {
+        return false;
+    }
+
+    memset(mask, 0, GGML_MAX_N_THREADS);
+
+    const char * p = buf;
+    while (*p >= '0' && *p <= '9') {
+        char * end;
+        long first = strtol(p, &end, 10);
+        long last  = first;
+        if (*end == '-') {
+            last = strtol(end + 1, &end, 10);
+        }
+        for (long i = first; i <= last && i < GGML_MAX_N_THREADS; i++) {
+            mask[i] = true;
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+
+    return true;
+}
+#endif
+
+static int ggml_cpu_read_compute_mask(bool * cpumask) {
+    memset(cpumask, 0, GGML_MAX_N_THREADS);
+
+#if defined(__gnu_linux__)
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return 0;
+    }
+
+    // hybrid cpus (e.g. Intel Alder Lake) list their performance cores in a separate PMU
+    bool pcores[GGML_MAX_N_THREADS];
+    bool hybrid = ggml_cpu_read_list("/sys/devices/cpu_core/cpus", pcores);
+    if (hybrid) {
+        // if the process can only run on efficiency cores, use them
+        hybrid = false;
+        for (int cpu = 0; cpu < GGML_MAX_N_THREADS && cpu < CPU_SETSIZE; cpu++) {
+            hybrid = hybrid || (pcores[cpu] && CPU_ISSET(cpu, &allowed));
+        }
+    }
+
+    int n = 0;
+    for (int cpu = 0; cpu < GGML_MAX_N_THREADS && cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || (hybrid && !pcores[cpu])) {
+            continue;
+        }
+
+        // keep only the first allowed hardware thread of each core
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+
+        bool siblings[GGML_MAX_N_THREADS];
+        bool first = true;
+        if (ggml_cpu_read_list(path, siblings)) {
+            for (int i = 0; i < cpu; i++) {
+                if (siblings[i] && CPU_ISSET(i, &allowed)) {
+                    first = false;
+                    break;
+                }
+            }
+        }
+
+        if (first) {
+            cpumask[cpu] = true;
+            n++;
+        }
+    }
+
+    return n;
+#else
+    return 0;
+#endif
+}
+
+// the topology is read from sysfs once, and used by all the threadpools created afterwards
+struct ggml_cpu_topology {
+    bool initialized;
+    int  n_cpus;                           // see ggml_get_n_cpus
+    int  n_compute;                        // see ggml_cpu_get_compute_mask
+    bool compute_mask[GGML_MAX_N_THREADS];
+};
+
+static struct ggml_cpu_topology g_cpu_topology;
+
+static const struct ggml_cpu_topology * ggml_cpu_get_topology(void) {
+    ggml_critical_section_start();
+
+    if (!g_cpu_topology.initialized) {
+        g_cpu_topology.n_cpus      = ggml_get_n_cpus();
+        g_cpu_topology.n_compute   = ggml_cpu_read_compute_mask(g_cpu_topology.compute_mask);
+        g_cpu_topology.initialized = true;
+    }
 
-        ggml_compute_forward(&params, node);
+    ggml_critical_section_end();
 
-        if (state->ith == 0 && cplan->abort_callback && cplan->abort_callback(cplan->abort_callback_data)) {
-            state->shared->ec = GGML_STATUS_ABORTED;
+    return &g_cpu_topology;
+}
+
+int ggml_cpu_get_compute_mask(bool * cpumask) {
+    const struct ggml_cpu_topology * topo = ggml_cpu_get_topology();
+    memcpy(cpumask, topo->compute_mask, GGML_MAX_N_THREADS);
+    return topo->n_compute;
+}
+
+int ggml_cpu_get_n_threads_default(void) {
+    const struct ggml_cpu_topology * topo = ggml_cpu_get_topology();
+    return topo->n_compute > 0 ? topo->n_compute : MAX(1, MIN(topo->n_cpus, GGML_MAX_N_THREADS));
+}
+
+void ggml_threadpool_params_init(struct ggml_threadpool_params * p, int n_threads) {
+    memset(p, 0, sizeof(*p));
+    p->n_threads  = n_threads > 0 ? n_threads : ggml_cpu_get_n_threads_default();
+    p->prio       = GGML_SCHED_PRIO_NORMAL;
+    p->poll       = 50;    // hybrid-polling enabled
+    p->strict_cpu = false; // no strict placement
+    p->paused     = false; // threads are ready to go
+}
+
+struct ggml_threadpool_params ggml_threadpool_params_default(int n_threads) {
+    struct ggml_threadpool_params p;
+    ggml_threadpool_params_init(&p, n_threads);
+    return p;
+}
+
+bool ggml_threadpool_params_match(const struct ggml_threadpool_params * p0, const struct ggml_threadpool_params * p1) {
+    if (p0->n_threads  != p1->n_threads ) return false;
+    if (p0->prio       != p1->prio      ) return false;
+    if (p0->poll       != p1->poll      ) return false;
+    if (p0->strict_cpu != p1->strict_cpu) return false;
+    return memcmp(p0->cpumask, p1->cpumask, GGML_MAX_N_THREADS) == 0;
+}
+
+bool ggml_threadpool_params_partition(const struct ggml_threadpool_params * params, int n_parts, const int * n_threads, struct ggml_threadpool_params * parts) {
+    GGML_ASSERT(n_parts > 0);
+
+    // params may be one of the parts
+    const struct ggml_threadpool_params src = *params;
+
+    bool cpus[GGML_MAX_N_THREADS];
+    int  n_cpus = 0;
+    if (ggml_thread_cpumask_is_valid(src.cpumask)) {
+        memcpy(cpus, src.cpumask, GGML_MAX_N_THREADS);
+        for (int i = 0; i < GGML_MAX_N_THREADS; i++) {
+            n_cpus += cpus[i];
+        }
+    } else {
+        n_cpus = ggml_cpu_get_compute_mask(cpus);
+        if (n_cpus == 0) {
+            // unknown topology, use all the cpus
+            n_cpus = MIN(ggml_cpu_get_topology()->n_cpus, GGML_MAX_N_THREADS);
+            for (int i = 0; i < GGML_MAX_N_THREADS; i++) {
+                cpus[i] = i < n_cpus;
+            }
+        }
+    }
+
+    int n_total = 0;
+    for (int i = 0; i < n_parts; i++) {
+        if (n_threads != NULL && n_threads[i] <= 0) {
+            return false;
         }
+        n_total += n_threads != NULL ? n_threads[i] : 1;
+    }
+    if (n_total > n_cpus) {
+        return false;
+    }
 
-        ggml_barrier(state->shared);
+    // contiguous blocks of cpus, so that the parts share as few caches as possible
+    int cpu = 0;
+    for (int i = 0; i < n_parts; i++) {
+        const int n = n_threads != NULL ? n_threads[i] : n_cpus/n_parts + (i < n_cpus % n_parts);
 
-        if (state->shared->ec != GGML_STATUS_SUCCESS) {
-            break;
+        parts[i] = src;
+        memset(parts[i].cpumask, 0, GGML_MAX_N_THREADS);
+        parts[i].n_threads  = n;
+        parts[i].strict_cpu = true;
+
+        for (int j = 0; j < n; cpu++) {
+            if (cpus[cpu]) {
+                parts[i].cpumask[cpu] = true;
+                j++;
+            }
         }
     }
 
-    return 0;
+    return true;
 }
 
-enum ggml_status ggml_graph_compute(struct ggml_cgraph * cgraph, struct ggml_cplan * cplan) {
-    GGML_ASSERT(cplan);
-    GGML_ASSERT(cplan->n_threads > 0);
-    GGML_ASSERT(cplan->work_size == 0 || cplan->work_data != NULL);
+static struct ggml_threadpool * ggml_threadpool_new_impl(
+        struct ggml_threadpool_params * tpp,
+           const struct ggml_cgraph   * cgraph,
+           const struct ggml_cplan    * cplan) {
+    GGML_ASSERT(tpp->n_threads > 0 && tpp->n_threads <= GGML_MAX_N_THREADS);
+
+    struct ggml_threadpool * threadpool = GGML_ALIGNED_MALLOC(sizeof(struct ggml_threadpool));
+    {
+        threadpool->cgraph             = cgraph;
+        threadpool->cplan              = cplan;
+        threadpool->n_graph            = 0;
+        threadpool->n_active           = 0;
+        threadpool->n_barrier          = 0;
+        threadpool->n_barrier_passed   = 0;
+        threadpool->n_barrier_sleepers = 0;
+        threadpool->stop               = false;
+        threadpool->pause              = tpp->paused;
+        threadpool->workers            = NULL;
+        threadpool->n_threads_max      = tpp->n_threads;
+        threadpool->n_threads_cur      = tpp->n_threads;
+        threadpool->prio               = tpp->prio;
+        threadpool->poll               = MIN(tpp->poll, 100u);
+        threadpool->n_spin             = threadpool->poll * GGML_POLL_SPIN_ITER;
+        threadpool->steps              = NULL;
+        threadpool->n_steps            = 0;
+        threadpool->steps_buf          = NULL;
+        threadpool->steps_size         = 0;
+        threadpool->node_chunks        = NULL;
+        threadpool->node_chunks_size   = 0;
+        threadpool->node_chunks_stride = 1;
+        threadpool->ec                 = GGML_STATUS_SUCCESS;
+        threadpool->async_started      = false;
+        threadpool->async_stop         = false;
+        threadpool->async_busy         = false;
+        threadpool->async_cgraph       = NULL;
+        threadpool->async_cplan        = NULL;
+        threadpool->async_ec           = GGML_STATUS_SUCCESS;
+    }
+
+    const struct ggml_cpu_topology * topo = ggml_cpu_get_topology();
+
+    if (tpp->n_threads > topo->n_cpus) {
+        // oversubscribed: a spinning thread would only take the CPU away from the threads we are waiting for
+        threadpool->n_spin = 0;
+    }
+
+    // allocate and init workers state
+    const size_t workers_size = sizeof(struct ggml_compute_state) * tpp->n_threads;
+    struct ggml_compute_state * workers = GGML_ALIGNED_MALLOC(workers_size);
+
+    memset(workers, 0, workers_size);
+    for (int j = 0; j < tpp->n_threads; j++) {
+        workers[j].threadpool = threadpool;
+        workers[j].ith        = j;
+    }
+
+    // cpu placement
+    if (ggml_thread_cpumask_is_valid(tpp->cpumask)) {
+        int32_t cpumask_iter = 0;
+        for (int j = 0; j < tpp->n_threads; j++) {
+            ggml_thread_cpumask_next(tpp->cpumask, workers[j].cpumask, tpp->strict_cpu, &cpumask_iter);
+        }
+    } else if (cgraph == NULL && !ggml_is_numa()) {
+        // by default keep the worker threads off the hyperthread siblings and the efficiency cores, if there
+        // are enough of the other cores for all the threads
+        // the main thread (worker 0) belongs to the caller and is left alone
+        // the disposable threadpools of ggml_graph_compute (cgraph != NULL) are not pinned
+        if (topo->n_compute >= tpp->n_threads && topo->n_compute < topo->n_cpus) {
+            for (int j = 1; j < tpp->n_threads; j++) {
+                memcpy(workers[j].cpumask, topo->compute_mask, GGML_MAX_N_THREADS);
+            }
+        }
+    }
+
+    threadpool->workers = workers;
+
+    ggml_mutex_init(&threadpool->barrier_mutex);
+    ggml_cond_init(&threadpool->barrier_cond);
+
+    ggml_mutex_init(&threadpool->graph_mutex);
+
+    ggml_mutex_init(&threadpool->async_mutex);
+    ggml_cond_init(&threadpool->async_cond);
+
+#ifndef GGML_USE_OPENMP
+    ggml_mutex_init(&threadpool->mutex);
+    ggml_cond_init(&threadpool->cond);
+
+    // the main thread is worker 0, spawn the rest
+    for (int j = 1; j < tpp->n_threads; j++) {
+        const int rc = ggml_thread_create(&workers[j].thrd, NULL, ggml_graph_compute_secondary_thread, &workers[j]);
+        GGML_ASSERT(rc == 0);
+        UNUSED(rc);
+    }
+#endif
+
+    return threadpool;
+}
+
+struct ggml_threadpool * ggml_threadpool_new(struct ggml_threadpool_params * tpp) {
+    return ggml_threadpool_new_impl(tpp, NULL, NULL);
+}
+
+void ggml_threadpool_free(struct ggml_threadpool * threadpool) {
+    if (!threadpool) {
+        return;
+    }
+
+    // finish the async graph and stop its thread before the workers
+    ggml_mutex_lock(&threadpool->async_mutex);
+    while (threadpool->async_busy) {
+        ggml_cond_wait(&threadpool->async_cond, &threadpool->async_mutex);
+    }
+    threadpool->async_stop = true;
+    ggml_cond_broadcast(&threadpool->async_cond);
+    ggml_mutex_unlock(&threadpool->async_mutex);
+
+    if (threadpool->async_started) {
+        const int rc = ggml_thread_join(threadpool->async_thrd, NULL);
+        GGML_ASSERT(rc == 0);
+        UNUSED(rc);
+    }
+
+#ifndef GGML_USE_OPENMP
+    struct ggml_compute_state * workers = threadpool->workers;
+    const int n_threads = threadpool->n_threads_max;
+
+    ggml_mutex_lock(&threadpool->mutex);
+    threadpool->stop  = true;
+    threadpool->pause = false;
+    ggml_cond_broadcast(&threadpool->cond);
+    ggml_mutex_unlock(&threadpool->mutex);
+
+    for (int j = 1; j < n_threads; j++) {
+        const int rc = ggml_thread_join(workers[j].thrd, NULL);
+        GGML_ASSERT(rc == 0);
+        UNUSED(rc);
+    }
+
+    ggml_mutex_destroy(&threadpool->mutex);
+    ggml_cond_destroy(&threadpool->cond);
+#endif
+
+    ggml_mutex_destroy(&threadpool->barrier_mutex);
+    ggml_cond_destroy(&threadpool->barrier_cond);
 
+    ggml_mutex_destroy(&threadpool->graph_mutex);
+
+    ggml_mutex_destroy(&threadpool->async_mutex);
+    ggml_cond_destroy(&threadpool->async_cond);
+
+    free(threadpool->steps_buf);
+    free(threadpool->node_chunks);
+    GGML_ALIGNED_FREE(threadpool->workers);
+    GGML_ALIGNED_FREE(threadpool);
+}
+
+int ggml_threadpool_get_n_threads(struct ggml_threadpool * threadpool) {
+    return threadpool->n_threads_max;
+}
+
+void ggml_threadpool_pause(struct ggml_threadpool * threadpool) {
+#ifndef GGML_USE_OPENMP
+    ggml_mutex_lock(&threadpool->mutex);
+    threadpool->pause = true;
+    ggml_mutex_unlock(&threadpool->mutex);
+#else
+    UNUSED(threadpool);
+#endif
+}
+
+void ggml_threadpool_resume(struct ggml_threadpool * threadpool) {
+#ifndef GGML_USE_OPENMP
+    ggml_mutex_lock(&threadpool->mutex);
+    if (threadpool->pause) {
+        ggml_threadpool_apply_main_placement(threadpool);
+        threadpool->pause = false;
+    }
+    ggml_cond_broadcast(&threadpool->cond);
+    ggml_mutex_unlock(&threadpool->mutex);
+#else
+    if (threadpool->pause) {
+        ggml_threadpool_apply_main_placement(threadpool);
+        threadpool->pause = false;
+    }
+#endif
+}
+
+void ggml_threadpool_get_stats(struct ggml_threadpool * threadpool, struct ggml_threadpool_stats * stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    for (int j = 0; j < threadpool->n_threads_max; j++) {
+        const struct ggml_compute_state * state = &threadpool->workers[j];
+
+        stats->n_barriers += state->n_barriers;
+        stats->n_sleeps   += state->n_sleeps;
+        stats->t_spin_us  += state->t_spin_us;
+        stats->t_sleep_us += state->t_sleep_us;
+    }
+}
+
+void ggml_threadpool_reset_stats(struct ggml_threadpool * threadpool) {
+    for (int j = 0; j < threadpool->n_threads_max; j++) {
+        struct ggml_compute_state * state = &threadpool->workers[j];
+
+        state->n_barriers = 0;
+        state->n_sleeps   = 0;
+        state->t_spin_us  = 0;
+        state->t_sleep_us = 0;
+    }
+}
+
+// steps: the schedule of a captured graph, NULL to build the schedule of the graph
+static enum ggml_status ggml_graph_compute_impl(
+        struct ggml_cgraph           * cgraph,
+        const struct ggml_cplan      * cplan,
+        const struct ggml_graph_step * steps,
+        int                            n_steps) {
     int n_threads = cplan->n_threads;
+    struct ggml_threadpool * threadpool = cplan->threadpool;
 
-    struct ggml_compute_state_shared state_shared = {
-        /*.cgraph                  =*/ cgraph,
-        /*.cgraph_plan             =*/ cplan,
-        /*.n_threads               =*/ n_threads,
-        /*.n_barrier               =*/ 0,
-        /*.n_barrier_passed        =*/ 0,
-        /*.abort_callback          =*/ NULL,
-        /*.abort_callback_data     =*/ NULL,
-        /*.current_chunk           =*/ 0,
-        /*.ec                      =*/ GGML_STATUS_SUCCESS,
-    };
+    bool disposable_threadpool = false;
+
+    if (threadpool == NULL) {
+        GGML_PRINT_DEBUG("Threadpool is not specified. Will create a disposable threadpool : n_threads %d\n", n_threads);
+        disposable_threadpool = true;
+
+        struct ggml_threadpool_params ttp = ggml_threadpool_params_default(n_threads);
+        threadpool = ggml_threadpool_new_impl(&ttp, cgraph, cplan);
+    } else {
+        // the threadpool may be shared by several callers (e.g. CPU backends), one graph at a time
+        ggml_mutex_lock(&threadpool->graph_mutex);
+
+#ifndef GGML_USE_OPENMP
+        // wait for the workers of the previous graph to finish before resetting the shared state
+        while (atomic_load(&threadpool->n_active) > 0) {
+            sched_yield();
+        }
+#endif
+
+        threadpool->cgraph        = cgraph;
+        threadpool->cplan         = cplan;
+        threadpool->ec            = GGML_STATUS_SUCCESS;
+    }
+
+    if (n_threads > threadpool->n_threads_max) {
+        GGML_PRINT("WARNING: cplan requested more threads (%d) than available (%d)\n", n_threads, threadpool->n_threads_max);
+        n_threads = threadpool->n_threads_max;
+    }
+
+    threadpool->node_chunks_stride = 1 + (ggml_is_numa() ? (int) g_state.numa.n_nodes : 0);
+
+    const int n_chunks = MAX(cgraph->n_nodes, 1)*threadpool->node_chunks_stride;
+    if (threadpool->node_chunks_size < n_chunks) {
+        free(threadpool->node_chunks);
+        threadpool->node_chunks_size = n_chunks;
+        threadpool->node_chunks      = GGML_MALLOC(threadpool->node_chunks_size*sizeof(atomic_int));
+    }
+#ifndef GGML_USE_OPENMP
+    // the counters are shared by all the threads of the graph: the workers of the previous graph must be done with
+    // them (the threads that were not used by the previous graph do not touch them, see ggml_graph_compute_secondary_thread)
+    GGML_ASSERT(atomic_load(&threadpool->n_active) == 0);
+#endif
+    memset(threadpool->node_chunks, 0, n_chunks*sizeof(atomic_int));
+
+    if (steps == NULL) {
+        if (threadpool->steps_size < MAX(cgraph->n_nodes, 1)) {
+            free(threadpool->steps_buf);
+            threadpool->steps_size = MAX(cgraph->n_nodes, 1);
+            threadpool->steps_buf  = GGML_MALLOC(threadpool->steps_size*sizeof(struct ggml_graph_step));
+        }
+        n_steps = ggml_graph_schedule(cgraph, n_threads, cplan->exec_mode, threadpool->steps_buf);
+        steps   = threadpool->steps_buf;
+    }
+
+    threadpool->steps   = steps;
+    threadpool->n_steps = n_steps;
 
 #ifdef GGML_USE_OPENMP
+    // a threadpool created paused is resumed by its first graph
+    if (threadpool->pause) {
+        ggml_threadpool_apply_main_placement(threadpool);
+        threadpool->pause = false;
+    }
+
     if (n_threads > 1) {
         #pragma omp parallel num_threads(n_threads)
         {
@@ -19363,76 +21813,211 @@ enum ggml_status ggml_graph_compute(struct ggml_cgraph * cgraph, struct ggml_cpl
             {
                 // update the number of threads from the actual number of threads that we got from OpenMP
                 n_threads = omp_get_num_threads();
-                state_shared.n_threads = n_threads;
+                threadpool->n_threads_cur = n_threads;
             }
 
-            struct ggml_compute_state worker = {
-                .thrd   = 0,
-                .ith    = omp_get_thread_num(),
-                .shared = &state_shared,
-            };
-            ggml_graph_compute_thread(&worker);
+            ggml_graph_compute_thread(&threadpool->workers[omp_get_thread_num()]);
         }
     } else {
-        struct ggml_compute_state worker = {
-            .thrd   = 0,
-            .ith    = 0,
-            .shared = &state_shared,
-        };
-        ggml_graph_compute_thread(&worker);
+        threadpool->n_threads_cur = 1;
+        ggml_graph_compute_thread(&threadpool->workers[0]);
     }
 #else
-    struct ggml_compute_state * workers = alloca(sizeof(struct ggml_compute_state)*n_threads);
+    // kick all threads to start the new graph
+    ggml_graph_compute_kickoff(threadpool, n_threads);
 
-    for (int j = 0; j < n_threads; ++j) {
-        workers[j] = (struct ggml_compute_state) {
-            .thrd   = 0,
-            .ith    = j,
-            .shared = &state_shared,
-        };
+    // this is a work thread too
+    ggml_graph_compute_thread(&threadpool->workers[0]);
+#endif
+
+    // don't leave affinity set on the main thread, unless it was requested with the cpumask
+    if (!ggml_thread_cpumask_is_valid(threadpool->workers[0].cpumask)) {
+        clear_numa_thread_affinity();
     }
 
-    // create thread pool
-    for (int j = 1; j < n_threads; ++j) {
-        const int rc = ggml_thread_create(&workers[j].thrd, NULL, ggml_graph_compute_thread, &workers[j]);
-        GGML_ASSERT(rc == 0);
-        UNUSED(rc);
+    enum ggml_status ret = threadpool->ec;
+
+    if (disposable_threadpool) {
+        ggml_threadpool_free(threadpool);
+    } else {
+        ggml_mutex_unlock(&threadpool->graph_mutex);
     }
 
-    // this is a work thread too
-    ggml_graph_compute_thread(&workers[0]);
+    return ret;
+}
 
-    // join or kill thread pool
-    if (n_threads > 1) {
-        for (int j = 1; j < n_threads; j++) {
-            const int rc = ggml_thread_join(workers[j].thrd, NULL);
-            GGML_ASSERT(rc == 0);
-            UNUSED(rc);
+enum ggml_status ggml_graph_compute(struct ggml_cgraph * cgraph, struct ggml_cplan * cplan) {
+    GGML_ASSERT(cplan);
+    GGML_ASSERT(cplan->n_threads > 0);
+    GGML_ASSERT(cplan->work_size == 0 || cplan->work_data != NULL);
+
+    return ggml_graph_compute_impl(cgraph, cplan, NULL, 0);
+}
+
+struct ggml_graph_capture {
+    struct ggml_cgraph     * cgraph;
+    struct ggml_cplan        cplan;
+
+    struct ggml_graph_step * steps;
+    int                      n_steps;
+    int                      n_threads; // number of threads the schedule is built for
+
+    // the barriers (GGML_GRAPH_EXEC_MODE_DEPENDENCY) and the src1 cache depend on the addresses of the tensors
+    uint64_t                 data_hash;
+};
+
+static uint64_t ggml_graph_capture_data_hash(const struct ggml_cgraph * cgraph) {
+    // FNV-1a over the data pointers of the nodes and their sources
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (int i = 0; i < cgraph->n_nodes; i++) {
+        const struct ggml_tensor * node = cgraph->nodes[i];
+
+        h = (h ^ (uint64_t) (uintptr_t) node->data) * 0x100000001b3ULL;
+        for (int j = 0; j < GGML_MAX_SRC; j++) {
+            if (node->src[j]) {
+                h = (h ^ (uint64_t) (uintptr_t) node->src[j]->data) * 0x100000001b3ULL;
+            }
         }
     }
-#endif
 
-    // don't leave affinity set on the main thread
-    clear_numa_thread_affinity();
+    return h;
+}
+
+static void ggml_graph_capture_schedule(struct ggml_graph_capture * capture) {
+    capture->n_steps   = ggml_graph_schedule(capture->cgraph, capture->n_threads, capture->cplan.exec_mode, capture->steps);
+    capture->data_hash = ggml_graph_capture_data_hash(capture->cgraph);
+}
+
+struct ggml_graph_capture * ggml_graph_capture_new(struct ggml_cgraph * cgraph, const struct ggml_cplan * cplan) {
+    GGML_ASSERT(cplan);
+    GGML_ASSERT(cplan->n_threads > 0);
+    GGML_ASSERT(cplan->work_size == 0 || cplan->work_data != NULL);
+
+    struct ggml_graph_capture * capture = GGML_MALLOC(sizeof(struct ggml_graph_capture));
+
+    int n_threads = cplan->n_threads;
+    if (cplan->threadpool) {
+        n_threads = MIN(n_threads, cplan->threadpool->n_threads_max);
+    }
+
+    capture->cgraph    = cgraph;
+    capture->cplan     = *cplan;
+    capture->steps     = GGML_MALLOC(MAX(cgraph->n_nodes, 1)*sizeof(struct ggml_graph_step));
+    capture->n_steps   = 0;
+    capture->n_threads = n_threads;
+    capture->data_hash = 0;
+
+    ggml_graph_capture_schedule(capture);
+
+    return capture;
+}
+
+enum ggml_status ggml_graph_capture_compute(struct ggml_graph_capture * capture) {
+    // the tensors may have been moved since the last compute (e.g. views of the KV cache at a new position)
+    if (ggml_graph_capture_data_hash(capture->cgraph) != capture->data_hash) {
+        ggml_graph_capture_schedule(capture);
+    }
+
+    return ggml_graph_compute_impl(capture->cgraph, &capture->cplan, capture->steps, capture->n_steps);
+}
+
+void ggml_graph_capture_free(struct ggml_graph_capture * capture) {
+    if (capture == NULL) {
+        return;
+    }
+
+    GGML_FREE(capture->steps);
+    GGML_FREE(capture);
+}
+
+static thread_ret_t ggml_graph_compute_async_thread(void * data) {
+    struct ggml_threadpool * threadpool = data;
+
+    ggml_mutex_lock(&threadpool->async_mutex);
+    while (true) {
+        while (!threadpool->async_busy && !threadpool->async_stop) {
+            ggml_cond_wait(&threadpool->async_cond, &threadpool->async_mutex);
+        }
+        if (!threadpool->async_busy) {
+            break;
+        }
+
+        struct ggml_cgraph * cgraph = threadpool->async_cgraph;
+        struct ggml_cplan  * cplan  = threadpool->async_cplan;
+        ggml_mutex_unlock(&threadpool->async_mutex);
+
+        const enum ggml_status ec = ggml_graph_compute(cgraph, cplan);
+
+        ggml_mutex_lock(&threadpool->async_mutex);
+        cplan->async_status    = ec;
+        threadpool->async_ec   = ec;
+        threadpool->async_busy = false;
+        ggml_cond_broadcast(&threadpool->async_cond);
+    }
+    ggml_mutex_unlock(&threadpool->async_mutex);
+
+    return (thread_ret_t) 0;
+}
+
+void ggml_graph_compute_async(struct ggml_cgraph * cgraph, struct ggml_cplan * cplan) {
+    GGML_ASSERT(cplan);
+    GGML_ASSERT(cplan->n_threads > 0);
+    GGML_ASSERT(cplan->work_size == 0 || cplan->work_data != NULL);
+    GGML_ASSERT(cplan->threadpool != NULL && "async compute requires a threadpool");
+
+    struct ggml_threadpool * threadpool = cplan->threadpool;
+
+    ggml_mutex_lock(&threadpool->async_mutex);
+
+    // one graph at a time
+    while (threadpool->async_busy) {
+        ggml_cond_wait(&threadpool->async_cond, &threadpool->async_mutex);
+    }
+
+    if (!threadpool->async_started) {
+        const int rc = ggml_thread_create(&threadpool->async_thrd, NULL, ggml_graph_compute_async_thread, threadpool);
+        GGML_ASSERT(rc == 0);
+        UNUSED(rc);
+        threadpool->async_started = true;
+    }
+
+    threadpool->async_cgraph = cgraph;
+    threadpool->async_cplan  = cplan;
+    threadpool->async_busy   = true;
+    ggml_cond_broadcast(&threadpool->async_cond);
 
-    return state_shared.ec;
+    ggml_mutex_unlock(&threadpool->async_mutex);
+}
+
+enum ggml_status ggml_threadpool_wait(struct ggml_threadpool * threadpool) {
+    ggml_mutex_lock(&threadpool->async_mutex);
+    while (threadpool->async_busy) {
+        ggml_cond_wait(&threadpool->async_cond, &threadpool->async_mutex);
+    }
+    const enum ggml_status ec = threadpool->async_ec;
+    ggml_mutex_unlock(&threadpool->async_mutex);
+
+    return ec;
 }
 
 enum ggml_status ggml_graph_compute_with_ctx(struct ggml_context * ctx, struct ggml_cgraph * cgraph, int n_threads) {
-    struct ggml_cplan cplan = ggml_graph_plan(cgraph, n_threads);
+    struct ggml_cplan cplan = ggml_graph_plan(cgraph, n_threads, NULL);
 
     struct ggml_object * obj = ggml_new_object(ctx, GGML_OBJECT_TYPE_WORK_BUFFER, cplan.work_size);
 
-    cplan.work_data = (uint8_t *)ctx->mem_buffer + obj->offs;
+    cplan.work_data = (uint8_t *) ggml_object_data(obj);
 
     return ggml_graph_compute(cgraph, &cplan);
 }
 
-struct ggml_tensor * ggml_graph_get_tensor(struct ggml_cgraph * cgraph, const char * name) {
+// also returns the position of the tensor in the order of ggml_graph_name_index
+static struct ggml_tensor * ggml_graph_get_tensor_linear(struct ggml_cgraph * cgraph, const char * name, int32_t * pos) {
     for (int i = 0; i < cgraph->n_leafs; i++) {
         struct ggml_tensor * leaf = cgraph->leafs[i];
 
         if (strcmp(leaf->name, name) == 0) {
+            *pos = i;
             return leaf;
         }
     }
@@ -19441,6 +22026,7 @@ struct ggml_tensor * ggml_graph_get_tensor(struct ggml_cgraph * cgraph, const ch
         struct ggml_tensor * node = cgraph->nodes[i];
 
         if (strcmp(node->name, name) == 0) {
+            *pos = cgraph->size + i;
             return node;
         }
     }
@@ -19448,6 +22034,33 @@ struct ggml_tensor * ggml_graph_get_tensor(struct ggml_cgraph * cgraph, const ch
     return NULL;
 }
 
+struct ggml_tensor * ggml_graph_get_tensor(struct ggml_cgraph * cgraph, const char * name) {
+    struct ggml_graph_name_index * gindex = name[0] != '\0' ? ggml_graph_name_index(cgraph) : NULL;
+    if (gindex != NULL) {
+        struct ggml_name_index_entry * entry = ggml_name_index_get(&gindex->index, name);
+        if (entry != NULL && entry->count == -1) {
+            int32_t pos;
+            struct ggml_tensor * tensor = ggml_graph_get_tensor_linear(cgraph, name, &pos);
+            if (tensor != NULL) {
+                entry->tensor = tensor;
+                entry->count  = pos;
+            }
+            return tensor;
+        }
+        // tensors moved since they were indexed (e.g. by ggml_graph_reorder_for_memory) are found with the linear search
+        if (entry != NULL && entry->tensor != NULL && strcmp(entry->tensor->name, name) == 0) {
+            const int32_t pos = entry->count;
+            if ((pos <  cgraph->size && pos < cgraph->n_leafs && cgraph->leafs[pos] == entry->tensor) ||
+                (pos >= cgraph->size && pos - cgraph->size < cgraph->n_nodes && cgraph->nodes[pos - cgraph->size] == entry->tensor)) {
+                return entry->tensor;
+            }
+        }
+    }
+
+    int32_t pos;
+    return ggml_graph_get_tensor_linear(cgraph, name, &pos);
+}
+
 static void ggml_graph_export_leaf(const struct ggml_tensor * tensor, FILE * fout) {
     const int64_t * ne = tensor->ne;
     const size_t  * nb = tensor->nb;
@@ -19804,7 +22417,7 @@ struct ggml_cgraph * ggml_graph_import(const char * fname, struct ggml_context *
                 tensor->op    = (enum ggml_op) op;
                 tensor->flags = flags;
 
-                memcpy(tensor->name,      ptr, GGML_MAX_NAME);      ptr += GGML_MAX_NAME;
+                ggml_set_name(tensor, ptr);                         ptr += GGML_MAX_NAME;
                 memcpy(tensor->op_params, ptr, GGML_MAX_OP_PARAMS); ptr += GGML_MAX_OP_PARAMS;
 
                 for (int j = 0; j < GGML_MAX_DIMS; ++j) {
@@ -19907,7 +22520,7 @@ struct ggml_cgraph * ggml_graph_import(const char * fname, struct ggml_context *
                         } break;
                 }
 
-                memcpy(tensor->name,      ptr_name,      GGML_MAX_NAME);
+                ggml_set_name(tensor, ptr_name);
                 memcpy(tensor->op_params, ptr_op_params, GGML_MAX_OP_PARAMS);
 
                 for (int j = 0; j < GGML_MAX_DIMS; ++j) {
@@ -20235,9 +22848,9 @@ static enum ggml_opt_result ggml_opt_adam(
 
     float * pf = params.past > 0 ? opt->adam.pf->data : NULL; // past function values
 
-    struct ggml_cplan cplan = ggml_graph_plan(gb, params.n_threads);
+    struct ggml_cplan cplan = ggml_graph_plan(gb, params.n_threads, NULL);
     struct ggml_object * obj = ggml_new_object(ctx, GGML_OBJECT_TYPE_WORK_BUFFER, cplan.work_size);
-    cplan.work_data = (uint8_t *)ctx->mem_buffer + obj->offs;
+    cplan.work_data = (uint8_t *) ggml_object_data(obj);
 
     bool cancel = false;
 
@@ -20582,9 +23195,9 @@ static enum ggml_opt_result ggml_opt_lbfgs(
         opt->iter = iter;
     }
 
-    struct ggml_cplan cplan = ggml_graph_plan(gb, params.n_threads);
+    struct ggml_cplan cplan = ggml_graph_plan(gb, params.n_threads, NULL);
     struct ggml_object * obj = ggml_new_object(ctx, GGML_OBJECT_TYPE_WORK_BUFFER, cplan.work_size);
-    cplan.work_data = (uint8_t *)ctx->mem_buffer + obj->offs;
+    cplan.work_data = (uint8_t *) ggml_object_data(obj);
 
     float * x  = opt->lbfgs.x->data;  // current parameters
     float * xp = opt->lbfgs.xp->data; // previous parameters
@@ -21141,6 +23754,8 @@ size_t ggml_quantize_chunk(
         case GGML_TYPE_Q4_0_4_4: result = quantize_q4_0_4x4(src + start, (char *) dst + start_row * row_size, nrows, n_per_row, imatrix); break;
         case GGML_TYPE_Q4_0_4_8: result = quantize_q4_0_4x8(src + start, (char *) dst + start_row * row_size, nrows, n_per_row, imatrix); break;
         case GGML_TYPE_Q4_0_8_8: result = quantize_q4_0_8x8(src + start, (char *) dst + start_row * row_size, nrows, n_per_row, imatrix); break;
+        case GGML_TYPE_F8_E4M3: result = quantize_f8_e4m3(src + start, (char *) dst + start_row * row_size, nrows, n_per_row, imatrix); break;
+        case GGML_TYPE_F8_E5M2: result = quantize_f8_e5m2(src + start, (char *) dst + start_row * row_size, nrows, n_per_row, imatrix); break;
         case GGML_TYPE_F16:
             {
                 size_t elemsize = sizeof(ggml_fp16_t);
@@ -21168,6 +23783,139 @@ size_t ggml_quantize_chunk(
     return result;
 }
 
+struct ggml_quantize_chunk_mt_params {
+    enum ggml_type type;
+    const float *  src;
+    void *         dst;
+    int64_t        start;
+    int64_t        nrows;
+    int64_t        n_per_row;
+    const float *  imatrix;
+
+    int64_t        chunk_rows;
+    atomic_int     next_chunk;
+};
+
+static void ggml_quantize_chunk_mt_thread(struct ggml_tensor * dst, const struct ggml_tensor * a, int ith, int nth, void * userdata) {
+    struct ggml_quantize_chunk_mt_params * p = userdata;
+
+    GGML_UNUSED(dst);
+    GGML_UNUSED(a);
+    GGML_UNUSED(ith);
+    GGML_UNUSED(nth);
+
+    const int64_t n_chunks = (p->nrows + p->chunk_rows - 1)/p->chunk_rows;
+
+    // the rows are claimed in chunks, the cost of a row varies between the types but not within a tensor
+    for (int64_t c = atomic_fetch_add(&p->next_chunk, 1); c < n_chunks; c = atomic_fetch_add(&p->next_chunk, 1)) {
+        const int64_t ir0 = c*p->chunk_rows;
+        const int64_t ir1 = MIN(ir0 + p->chunk_rows, p->nrows);
+
+        ggml_quantize_chunk(p->type, p->src, p->dst, p->start + ir0*p->n_per_row, ir1 - ir0, p->n_per_row, p->imatrix);
+    }
+}
+
+size_t ggml_quantize_chunk_mt(
+        enum ggml_type   type,
+           const float * src,
+                  void * dst,
+               int64_t   start,
+               int64_t   nrows,
+               int64_t   n_per_row,
+           const float * imatrix,
+                   int   n_threads,
+  struct ggml_threadpool * threadpool) {
+    if (threadpool) {
+        n_threads = ggml_threadpool_get_n_threads(threadpool);
+    }
+
+    if (n_threads <= 1 || nrows <= 1) {
+        return ggml_quantize_chunk(type, src, dst, start, nrows, n_per_row, imatrix);
+    }
+
+    // initialized once here instead of by the first chunk of every thread
+    ggml_quantize_init(type);
+
+    // the interleaved types are quantized in groups of rows
+    int64_t rows_per_group = 1;
+    switch (type) {
+        case GGML_TYPE_Q4_0_4_4:
+        case GGML_TYPE_Q4_0_4_8: rows_per_group = 4; break;
+        case GGML_TYPE_Q4_0_8_8: rows_per_group = 8; break;
+        default: break;
+    }
+    GGML_ASSERT(nrows % rows_per_group == 0);
+
+    // a few chunks per thread so that the threads that finish first take the rest
+    const int64_t n_groups = nrows/rows_per_group;
+
+    struct ggml_quantize_chunk_mt_params p = {
+        /*.type       =*/ type,
+        /*.src        =*/ src,
+        /*.dst        =*/ dst,
+        /*.start      =*/ start,
+        /*.nrows      =*/ nrows,
+        /*.n_per_row  =*/ n_per_row,
+        /*.imatrix    =*/ imatrix,
+        /*.chunk_rows =*/ MAX(1, n_groups/(4*n_threads))*rows_per_group,
+        /*.next_chunk =*/ 0,
+    };
+
+    // the rows are quantized by a custom op so that the threads are those of the graphs (and of threadpool)
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 2*ggml_tensor_overhead() + ggml_graph_overhead_custom(1, false),
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ true,
+    };
+    struct ggml_context * ctx = ggml_init(params);
+
+    struct ggml_tensor * t  = ggml_map_custom1(ctx, ggml_new_tensor_1d(ctx, GGML_TYPE_I8, 1), ggml_quantize_chunk_mt_thread, GGML_N_TASKS_MAX, &p);
+    struct ggml_cgraph * gf = ggml_new_graph_custom(ctx, 1, false);
+    ggml_build_forward_expand(gf, t);
+
+    struct ggml_cplan cplan = ggml_graph_plan(gf, n_threads, threadpool);
+    GGML_ASSERT(cplan.work_size == 0);
+    ggml_graph_compute(gf, &cplan);
+
+    ggml_free(ctx);
+
+    return nrows*ggml_row_size(type, n_per_row);
+}
+
+size_t ggml_quantize_fp8(enum ggml_type type, const uint8_t * src, const float * scale, int64_t n_per_scale, void * dst, int64_t n) {
+    GGML_ASSERT(type == GGML_TYPE_F8_E4M3 || type == GGML_TYPE_F8_E5M2);
+    GGML_ASSERT(n % QK_F8 == 0 && n_per_scale % QK_F8 == 0);
+
+    const ggml_to_float_t   to_float   = type_traits[type].to_float;
+    const ggml_from_float_t from_float = type_traits[type].from_float_ref;
+
+    block_f8 * y = (block_f8 *) dst;
+
+    for (int64_t i = 0; i < n/QK_F8; ++i) {
+        const float       d  = scale[i*QK_F8/n_per_scale];
+        const ggml_fp16_t dh = GGML_FP32_TO_FP16(d);
+
+        memcpy(y[i].qs, src + i*QK_F8, QK_F8);
+
+        // keep the codes unless the scale is outside of the normal range of fp16, the error of its rounding is
+        // then far below the one of quantizing the block again
+        if (fabsf(GGML_FP16_TO_FP32(dh) - d) <= fabsf(d)*0x1p-11f) {
+            y[i].d = dh;
+            continue;
+        }
+
+        float tmp[QK_F8];
+        y[i].d = GGML_FP32_TO_FP16(1.0f);
+        to_float(&y[i], tmp, QK_F8);
+        for (int j = 0; j < QK_F8; ++j) {
+            tmp[j] *= d;
+        }
+        from_float(tmp, &y[i], QK_F8);
+    }
+
+    return (n/QK_F8)*sizeof(block_f8);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 struct gguf_str {
@@ -22380,6 +25128,8 @@ void gguf_get_meta_data(const struct gguf_context * ctx, void * data) {
 int ggml_cpu_has_avx(void) {
 #if defined(__AVX__)
     return 1;
+#elif defined(GGML_USE_CPU_VARIANTS)
+    return ggml_cpu_variant != NULL;
 #else
     return 0;
 #endif
@@ -22388,6 +25138,8 @@ int ggml_cpu_has_avx(void) {
 int ggml_cpu_has_avx_vnni(void) {
 #if defined(__AVXVNNI__)
     return 1;
+#elif defined(GGML_USE_CPU_VARIANTS)
+    return ggml_cpu_variant != NULL && ggml_cpu_variant->avx_vnni;
 #else
     return 0;
 #endif
@@ -22396,6 +25148,8 @@ int ggml_cpu_has_avx_vnni(void) {
 int ggml_cpu_has_avx2(void) {
 #if defined(__AVX2__)
     return 1;
+#elif defined(GGML_USE_CPU_VARIANTS)
+    return ggml_cpu_variant != NULL;
 #else
     return 0;
 #endif
@@ -22404,6 +25158,8 @@ int ggml_cpu_has_avx2(void) {
 int ggml_cpu_has_avx512(void) {
 #if defined(__AVX512F__)
     return 1;
+#elif defined(GGML_USE_CPU_VARIANTS)
+    return ggml_cpu_variant != NULL && ggml_cpu_variant->avx512;
 #else
     return 0;
 #endif
@@ -22420,6 +25176,8 @@ int ggml_cpu_has_avx512_vbmi(void) {
 int ggml_cpu_has_avx512_vnni(void) {
 #if defined(__AVX512VNNI__)
     return 1;
+#elif defined(GGML_USE_CPU_VARIANTS)
+    return ggml_cpu_variant != NULL && ggml_cpu_variant->avx512_vnni;
 #else
     return 0;
 #endif
@@ -22436,6 +25194,8 @@ int ggml_cpu_has_avx512_bf16(void) {
 int ggml_cpu_has_fma(void) {
 #if defined(__FMA__)
     return 1;
+#elif defined(GGML_USE_CPU_VARIANTS)
+    return ggml_cpu_variant != NULL;
 #else
     return 0;
 #endif
@@ -22476,6 +25236,8 @@ int ggml_cpu_has_metal(void) {
 int ggml_cpu_has_f16c(void) {
 #if defined(__F16C__)
     return 1;
+#elif defined(GGML_USE_CPU_VARIANTS)
+    return ggml_cpu_variant != NULL;
 #else
     return 0;
 #endif
@@ -22561,6 +25323,14 @@ int ggml_cpu_has_llamafile(void) {
 #endif
 }
 
+int ggml_cpu_has_amx(void) {
+#if defined(GGML_USE_AMX)
+    return ggml_amx_enabled();
+#else
+    return 0;
+#endif
+}
+
 int ggml_cpu_has_gpublas(void) {
     return ggml_cpu_has_cuda() || ggml_cpu_has_vulkan() || ggml_cpu_has_kompute() || ggml_cpu_has_sycl();
 }
@@ -22568,6 +25338,8 @@ int ggml_cpu_has_gpublas(void) {
 int ggml_cpu_has_sse3(void) {
 #if defined(__SSE3__)
     return 1;
+#elif defined(GGML_USE_CPU_VARIANTS)
+    return ggml_cpu_variant != NULL;
 #else
     return 0;
 #endif
@@ -22576,6 +25348,8 @@ int ggml_cpu_has_sse3(void) {
 int ggml_cpu_has_ssse3(void) {
 #if defined(__SSSE3__)
     return 1;
+#elif defined(GGML_USE_CPU_VARIANTS)
+    return ggml_cpu_variant != NULL;
 #else
     return 0;
 #endif
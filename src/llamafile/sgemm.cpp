@@ -0,0 +1,519 @@
+// register tiled and cache blocked matrix multiplication for the CPU
+//
+// computes C = Aᵀ * B where A is m×k and B is n×k (the rows of src0 and src1 of ggml_mul_mat) and C is n×m
+//
+// the output is split in tiles of RM×RN values whose dot products are accumulated over k in vector registers,
+// so that each vector of A that is loaded is used RN times and each vector of B RM times
+// the tiles are grouped in blocks of up to GEMM_MB_TILES rows of A and as many rows of B as fit in the
+// L2 cache (GEMM_L2_BYTES), a thread computes the tiles of a block row by row, so the rows of A of a tile stay
+// in L1 while the rows of B of the block are read from L2
+// the blocks are split evenly between the threads, the blocks of a thread share the same rows of B as long as
+// possible
+//
+// supported types (C is always F32):
+//   F32  x F32
+//   F16  x F32, F16
+//   BF16 x BF16
+//   Q8_0 x Q8_0
+//   Q4_0 x Q8_0
+// with AVX2 and F16C, AVX512F (AVX512BF16 for BF16) on x86 and NEON on ARM (with the dot product extension for the
+// quantized types)
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Wignored-attributes"
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+// false positives in the _mm*_undefined_* intrinsics of GCC 12 when compiled as C++
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include "sgemm.h"
+#include "ggml-impl.h"
+#include "ggml-quants.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#pragma warning(disable: 4244 4267) // possible loss of data
+#endif
+
+#if defined(__FMA__) || (defined(_MSC_VER) && (defined(__AVX2__) || defined(__AVX512F__)))
+#define GEMM_FMA 1
+#endif
+
+namespace {
+
+// bytes of B that a block of tiles keeps in the L2 cache
+constexpr size_t  GEMM_L2_BYTES = 256*1024;
+
+// maximum number of tiles of A in a block
+constexpr int64_t GEMM_MB_TILES = 16;
+
+inline float unhalf(ggml_fp16_t d) {
+    return GGML_FP16_TO_FP32(d);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// vector operations
+
+#if defined(__AVX__) || defined(__AVX2__) || defined(__AVX512F__)
+inline __m256 add(__m256 x, __m256 y) { return _mm256_add_ps(x, y); }
+inline __m256 mul(__m256 x, __m256 y) { return _mm256_mul_ps(x, y); }
+
+inline __m256 madd(__m256 a, __m256 b, __m256 c) {
+#ifdef GEMM_FMA
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return add(mul(a, b), c);
+#endif
+}
+
+inline float hsum(__m128 x) {
+    x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+    return _mm_cvtss_f32(x);
+}
+
+inline float hsum(__m256 x) {
+    return hsum(_mm_add_ps(_mm256_extractf128_ps(x, 1), _mm256_castps256_ps128(x)));
+}
+#endif
+
+#if defined(__AVX512F__)
+inline __m512 madd(__m512 a, __m512 b, __m512 c) { return _mm512_fmadd_ps(a, b, c); }
+
+inline float hsum(__m512 x) { return _mm512_reduce_add_ps(x); }
+#endif
+
+#if defined(__AVX512BF16__)
+inline __m512 madd(__m512bh a, __m512bh b, __m512 c) { return _mm512_dpbf16_ps(c, a, b); }
+#endif
+
+#if defined(__ARM_NEON)
+inline float32x4_t madd(float32x4_t a, float32x4_t b, float32x4_t c) { return vfmaq_f32(c, a, b); }
+
+inline float hsum(float32x4_t x) { return vaddvq_f32(x); }
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// vector loads, converted to the type of the accumulation
+
+template <typename V, typename T> V load(const T * p);
+
+#if defined(__AVX__) || defined(__AVX2__) || defined(__AVX512F__)
+template <> inline __m256 load(const float * p) { return _mm256_loadu_ps(p); }
+#endif
+
+#if defined(__AVX2__)
+// bf16 -> f32: the bits of a bf16 are the upper bits of the f32
+template <> inline __m256 load(const ggml_bf16_t * p) {
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) p)), 16));
+}
+#endif
+
+#if defined(__F16C__)
+template <> inline __m256 load(const ggml_fp16_t * p) { return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) p)); }
+#endif
+
+#if defined(__AVX512F__)
+template <> inline __m512 load(const float * p) { return _mm512_loadu_ps(p); }
+
+template <> inline __m512 load(const ggml_fp16_t * p) { return _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *) p)); }
+
+template <> inline __m512 load(const ggml_bf16_t * p) {
+    return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *) p)), 16));
+}
+#endif
+
+#if defined(__AVX512BF16__)
+template <> inline __m512bh load(const ggml_bf16_t * p) { return (__m512bh) _mm512_loadu_ps((const float *) p); }
+#endif
+
+#if defined(__ARM_NEON)
+template <> inline float32x4_t load(const float * p) { return vld1q_f32(p); }
+
+template <> inline float32x4_t load(const ggml_fp16_t * p) { return vcvt_f32_f16(vld1_f16((const float16_t *) p)); }
+
+template <> inline float32x4_t load(const ggml_bf16_t * p) {
+    return vreinterpretq_f32_u32(vshll_n_u16(vld1_u16((const uint16_t *) p), 16));
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// blocking
+
+// computes the tiles of the blocks assigned to the thread ith with kernel.tile(rm, rn, ii, jj)
+// row_size_b: size of a row of B in bytes
+template <int RM, int RN, typename K>
+void gemm_blocked(const K & kernel, int64_t m, int64_t n, size_t row_size_b, int ith, int nth) {
+    const int64_t mt = (m + RM - 1)/RM; // tiles of A
+    const int64_t nt = (n + RN - 1)/RN; // tiles of B
+
+    int64_t mb = std::min(mt, GEMM_MB_TILES);
+    int64_t nb = std::min(nt, std::max<int64_t>(1, GEMM_L2_BYTES/(row_size_b*RN)));
+
+    // smaller blocks when there are not enough of them for all the threads
+    while (((mt + mb - 1)/mb)*((nt + nb - 1)/nb) < nth && (mb > 1 || nb > 1)) {
+        if (mb > 1) {
+            mb = (mb + 1)/2;
+        } else {
+            nb = (nb + 1)/2;
+        }
+    }
+
+    const int64_t n_mblocks = (mt + mb - 1)/mb;
+    const int64_t n_nblocks = (nt + nb - 1)/nb;
+    const int64_t n_blocks  = n_mblocks*n_nblocks;
+
+    const int64_t start = n_blocks*ith/nth;
+    const int64_t end   = n_blocks*(ith + 1)/nth;
+
+    for (int64_t block = start; block < end; ++block) {
+        const int64_t ib = block % n_mblocks;
+        const int64_t jb = block / n_mblocks;
+
+        const int64_t it1 = std::min(mt, (ib + 1)*mb);
+        const int64_t jt1 = std::min(nt, (jb + 1)*nb);
+
+        for (int64_t it = ib*mb; it < it1; ++it) {
+            for (int64_t jt = jb*nb; jt < jt1; ++jt) {
+                const int64_t ii = it*RM;
+                const int64_t jj = jt*RN;
+                kernel.tile((int) std::min<int64_t>(RM, m - ii), (int) std::min<int64_t>(RN, n - jj), ii, jj);
+            }
+        }
+    }
+}
+
+// calls gemm_tile<rm, rn>(ii, jj) for the edge tiles too
+// the sizes are clamped to RM×RN so that only the tiles that can be used are instantiated
+#define GEMM_TILE_CASE(TM, TN) \
+    case (TM)*16 + (TN): gemm_tile<((TM) < RM ? (TM) : RM), ((TN) < RN ? (TN) : RN)>(ii, jj); break;
+
+#define GEMM_TILE_SWITCH(rm, rn)                                                                                       \
+    static_assert(RM <= 4 && RN <= 6, "tile too large");                                                               \
+    switch ((rm)*16 + (rn)) {                                                                                          \
+        GEMM_TILE_CASE(4, 6) GEMM_TILE_CASE(4, 5) GEMM_TILE_CASE(4, 4) GEMM_TILE_CASE(4, 3) GEMM_TILE_CASE(4, 2) GEMM_TILE_CASE(4, 1) \
+        GEMM_TILE_CASE(3, 6) GEMM_TILE_CASE(3, 5) GEMM_TILE_CASE(3, 4) GEMM_TILE_CASE(3, 3) GEMM_TILE_CASE(3, 2) GEMM_TILE_CASE(3, 1) \
+        GEMM_TILE_CASE(2, 6) GEMM_TILE_CASE(2, 5) GEMM_TILE_CASE(2, 4) GEMM_TILE_CASE(2, 3) GEMM_TILE_CASE(2, 2) GEMM_TILE_CASE(2, 1) \
+        GEMM_TILE_CASE(1, 6) GEMM_TILE_CASE(1, 5) GEMM_TILE_CASE(1, 4) GEMM_TILE_CASE(1, 3) GEMM_TILE_CASE(1, 2) GEMM_TILE_CASE(1, 1) \
+        default: GGML_ABORT("invalid tile %dx%d", (rm), (rn));                                                        \
+    }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// floating point kernel
+//
+// KN: number of values of k per vector
+// D:  type of the accumulators
+// V:  type of the loaded vectors
+
+template <int KN, typename D, typename V, typename TA, typename TB, typename TC, int RM, int RN>
+class tinyBLAS {
+  public:
+    tinyBLAS(int64_t k, const TA * A, int64_t lda, const TB * B, int64_t ldb, TC * C, int64_t ldc)
+        : A(A), B(B), C(C), k(k), lda(lda), ldb(ldb), ldc(ldc) {
+    }
+
+    void matmul(int64_t m, int64_t n, int ith, int nth) const {
+        gemm_blocked<RM, RN>(*this, m, n, k*sizeof(TB), ith, nth);
+    }
+
+    void tile(int rm, int rn, int64_t ii, int64_t jj) const {
+        GEMM_TILE_SWITCH(rm, rn)
+    }
+
+  private:
+    template <int TM, int TN>
+    void gemm_tile(int64_t ii, int64_t jj) const {
+        D Cv[TN][TM] = {};
+        for (int64_t l = 0; l < k; l += KN) {
+            V Av[TM];
+            for (int i = 0; i < TM; ++i) {
+                Av[i] = load<V>(A + lda*(ii + i) + l);
+            }
+            for (int j = 0; j < TN; ++j) {
+                const V Bv = load<V>(B + ldb*(jj + j) + l);
+                for (int i = 0; i < TM; ++i) {
+                    Cv[j][i] = madd(Av[i], Bv, Cv[j][i]);
+                }
+            }
+        }
+        for (int j = 0; j < TN; ++j) {
+            for (int i = 0; i < TM; ++i) {
+                C[ldc*(jj + j) + (ii + i)] = hsum(Cv[j][i]);
+            }
+        }
+    }
+
+    const TA * const A;
+    const TB * const B;
+    TC       * const C;
+    const int64_t k;
+    const int64_t lda;
+    const int64_t ldb;
+    const int64_t ldc;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// quantized kernels: Q8_0 and Q4_0 against Q8_0, k is in blocks
+
+#if defined(__AVX2__)
+// dot products of 4 consecutive int8 pairs (unsigned x signed), as floats
+inline __m256 updot(__m256i u, __m256i s) {
+    const __m256i res = _mm256_madd_epi16(_mm256_set1_epi16(1), _mm256_maddubs_epi16(u, s));
+    return _mm256_cvtepi32_ps(res);
+}
+
+inline __m256i load(const block_q8_0 * b) {
+    return _mm256_loadu_si256((const __m256i *) b->qs);
+}
+
+inline __m256i load(const block_q4_0 * b) {
+    // the low nibbles are the first 16 values, the high nibbles the last 16
+    const __m128i x = _mm_loadu_si128((const __m128i *) b->qs);
+    const __m256i q = _mm256_and_si256(_mm256_set1_epi8(15),
+            _mm256_insertf128_si256(_mm256_castsi128_si256(x), _mm_srli_epi16(x, 4), 1));
+    return _mm256_sub_epi8(q, _mm256_set1_epi8(8));
+}
+
+template <typename TA, int RM, int RN>
+class tinyBLAS_Q0_AVX2 {
+  public:
+    tinyBLAS_Q0_AVX2(int64_t k, const TA * A, int64_t lda, const block_q8_0 * B, int64_t ldb, float * C, int64_t ldc)
+        : A(A), B(B), C(C), k(k), lda(lda), ldb(ldb), ldc(ldc) {
+    }
+
+    void matmul(int64_t m, int64_t n, int ith, int nth) const {
+        gemm_blocked<RM, RN>(*this, m, n, k*sizeof(block_q8_0), ith, nth);
+    }
+
+    void tile(int rm, int rn, int64_t ii, int64_t jj) const {
+        GEMM_TILE_SWITCH(rm, rn)
+    }
+
+  private:
+    template <int TM, int TN>
+    void gemm_tile(int64_t ii, int64_t jj) const {
+        __m256 Cv[TN][TM] = {};
+        for (int64_t l = 0; l < k; ++l) {
+            // |a| and the signs of a, so that the products can be computed with unsigned x signed multiplies
+            __m256i Au[TM];
+            __m256i As[TM];
+            float   Ad[TM];
+            for (int i = 0; i < TM; ++i) {
+                const TA * a = A + lda*(ii + i) + l;
+                As[i] = load(a);
+                Au[i] = _mm256_sign_epi8(As[i], As[i]);
+                Ad[i] = unhalf(a->d);
+            }
+            for (int j = 0; j < TN; ++j) {
+                const block_q8_0 * b = B + ldb*(jj + j) + l;
+                const __m256i Bv = load(b);
+                const float   Bd = unhalf(b->d);
+                for (int i = 0; i < TM; ++i) {
+                    const __m256 dot = updot(Au[i], _mm256_sign_epi8(Bv, As[i]));
+                    Cv[j][i] = madd(_mm256_set1_ps(Ad[i]*Bd), dot, Cv[j][i]);
+                }
+            }
+        }
+        for (int j = 0; j < TN; ++j) {
+            for (int i = 0; i < TM; ++i) {
+                C[ldc*(jj + j) + (ii + i)] = hsum(Cv[j][i]);
+            }
+        }
+    }
+
+    const TA         * const A;
+    const block_q8_0 * const B;
+    float            * const C;
+    const int64_t k;
+    const int64_t lda;
+    const int64_t ldb;
+    const int64_t ldc;
+};
+#endif // __AVX2__
+
+#if defined(__ARM_NEON) && defined(__ARM_FEATURE_DOTPROD)
+inline int8x16_t load_lo(const block_q8_0 * b) { return vld1q_s8(b->qs); }
+inline int8x16_t load_hi(const block_q8_0 * b) { return vld1q_s8(b->qs + 16); }
+
+inline int8x16_t load_lo(const block_q4_0 * b) {
+    return vsubq_s8(vreinterpretq_s8_u8(vandq_u8(vld1q_u8(b->qs), vdupq_n_u8(0x0f))), vdupq_n_s8(8));
+}
+
+inline int8x16_t load_hi(const block_q4_0 * b) {
+    return vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(vld1q_u8(b->qs), 4)), vdupq_n_s8(8));
+}
+
+template <typename TA, int RM, int RN>
+class tinyBLAS_Q0_ARM {
+  public:
+    tinyBLAS_Q0_ARM(int64_t k, const TA * A, int64_t lda, const block_q8_0 * B, int64_t ldb, float * C, int64_t ldc)
+        : A(A), B(B), C(C), k(k), lda(lda), ldb(ldb), ldc(ldc) {
+    }
+
+    void matmul(int64_t m, int64_t n, int ith, int nth) const {
+        gemm_blocked<RM, RN>(*this, m, n, k*sizeof(block_q8_0), ith, nth);
+    }
+
+    void tile(int rm, int rn, int64_t ii, int64_t jj) const {
+        GEMM_TILE_SWITCH(rm, rn)
+    }
+
+  private:
+    template <int TM, int TN>
+    void gemm_tile(int64_t ii, int64_t jj) const {
+        float32x4_t Cv[TN][TM] = {};
+        for (int64_t l = 0; l < k; ++l) {
+            int8x16_t Alo[TM];
+            int8x16_t Ahi[TM];
+            float     Ad[TM];
+            for (int i = 0; i < TM; ++i) {
+                const TA * a = A + lda*(ii + i) + l;
+                Alo[i] = load_lo(a);
+                Ahi[i] = load_hi(a);
+                Ad[i]  = unhalf(a->d);
+            }
+            for (int j = 0; j < TN; ++j) {
+                const block_q8_0 * b = B + ldb*(jj + j) + l;
+                const int8x16_t Blo = load_lo(b);
+                const int8x16_t Bhi = load_hi(b);
+                const float     Bd  = unhalf(b->d);
+                for (int i = 0; i < TM; ++i) {
+                    const int32x4_t dot = vdotq_s32(vdotq_s32(vdupq_n_s32(0), Alo[i], Blo), Ahi[i], Bhi);
+                    Cv[j][i] = vmlaq_n_f32(Cv[j][i], vcvtq_f32_s32(dot), Ad[i]*Bd);
+                }
+            }
+        }
+        for (int j = 0; j < TN; ++j) {
+            for (int i = 0; i < TM; ++i) {
+                C[ldc*(jj + j) + (ii + i)] = hsum(Cv[j][i]);
+            }
+        }
+    }
+
+    const TA         * const A;
+    const block_q8_0 * const B;
+    float            * const C;
+    const int64_t k;
+    const int64_t lda;
+    const int64_t ldb;
+    const int64_t ldc;
+};
+#endif // __ARM_NEON && __ARM_FEATURE_DOTPROD
+
+template <typename K>
+bool gemm(const K & kernel, int64_t m, int64_t n, int ith, int nth) {
+    kernel.matmul(m, n, ith, nth);
+    return true;
+}
+
+template <typename TA>
+bool gemm_q0(int64_t m, int64_t n, int64_t k, const void * A, int64_t lda, const void * B, int64_t ldb, float * C, int64_t ldc, int ith, int nth) {
+#if defined(__AVX512F__) && defined(__AVX512VL__) && defined(__AVX2__)
+    // 32 vector registers
+    return gemm(tinyBLAS_Q0_AVX2<TA, 4, 4>(k, (const TA *) A, lda, (const block_q8_0 *) B, ldb, C, ldc), m, n, ith, nth);
+#elif defined(__AVX2__)
+    return gemm(tinyBLAS_Q0_AVX2<TA, 2, 3>(k, (const TA *) A, lda, (const block_q8_0 *) B, ldb, C, ldc), m, n, ith, nth);
+#elif defined(__ARM_NEON) && defined(__ARM_FEATURE_DOTPROD)
+    return gemm(tinyBLAS_Q0_ARM<TA, 4, 4>(k, (const TA *) A, lda, (const block_q8_0 *) B, ldb, C, ldc), m, n, ith, nth);
+#else
+    GGML_UNUSED(m); GGML_UNUSED(n); GGML_UNUSED(k); GGML_UNUSED(A); GGML_UNUSED(lda); GGML_UNUSED(B); GGML_UNUSED(ldb);
+    GGML_UNUSED(C); GGML_UNUSED(ldc); GGML_UNUSED(ith); GGML_UNUSED(nth);
+    return false;
+#endif
+}
+
+// floating point types
+template <typename TA, typename TB>
+bool gemm_f(int64_t m, int64_t n, int64_t k, const void * A, int64_t lda, const void * B, int64_t ldb, float * C, int64_t ldc, int ith, int nth) {
+#if defined(__AVX512F__)
+    if (k % 16) {
+        return false;
+    }
+    return gemm(tinyBLAS<16, __m512, __m512, TA, TB, float, 4, 6>(k, (const TA *) A, lda, (const TB *) B, ldb, C, ldc), m, n, ith, nth);
+#elif defined(__AVX2__) && defined(__F16C__)
+    if (k % 8) {
+        return false;
+    }
+    return gemm(tinyBLAS<8, __m256, __m256, TA, TB, float, 3, 3>(k, (const TA *) A, lda, (const TB *) B, ldb, C, ldc), m, n, ith, nth);
+#elif defined(__ARM_NEON)
+    if (k % 4) {
+        return false;
+    }
+    return gemm(tinyBLAS<4, float32x4_t, float32x4_t, TA, TB, float, 4, 6>(k, (const TA *) A, lda, (const TB *) B, ldb, C, ldc), m, n, ith, nth);
+#else
+    GGML_UNUSED(m); GGML_UNUSED(n); GGML_UNUSED(k); GGML_UNUSED(A); GGML_UNUSED(lda); GGML_UNUSED(B); GGML_UNUSED(ldb);
+    GGML_UNUSED(C); GGML_UNUSED(ldc); GGML_UNUSED(ith); GGML_UNUSED(nth);
+    return false;
+#endif
+}
+
+} // namespace
+
+bool llamafile_sgemm(int64_t m, int64_t n, int64_t k,
+                     const void * A, int64_t lda,
+                     const void * B, int64_t ldb,
+                           void * C, int64_t ldc,
+                     int ith, int nth,
+                     int Atype, int Btype, int Ctype) {
+    assert(m >= 0);
+    assert(n >= 0);
+    assert(k >= 0);
+    assert(lda >= k);
+    assert(ldb >= k);
+    assert(ldc >= m);
+    assert(nth > 0);
+    assert(ith < nth);
+
+    if (Ctype != GGML_TYPE_F32) {
+        return false;
+    }
+
+    float * Cf = (float *) C;
+
+    switch (Atype) {
+        case GGML_TYPE_F32:
+            if (Btype != GGML_TYPE_F32) {
+                return false;
+            }
+            return gemm_f<float, float>(m, n, k, A, lda, B, ldb, Cf, ldc, ith, nth);
+        case GGML_TYPE_F16:
+            if (Btype == GGML_TYPE_F32) {
+                return gemm_f<ggml_fp16_t, float>(m, n, k, A, lda, B, ldb, Cf, ldc, ith, nth);
+            }
+            if (Btype == GGML_TYPE_F16) {
+                return gemm_f<ggml_fp16_t, ggml_fp16_t>(m, n, k, A, lda, B, ldb, Cf, ldc, ith, nth);
+            }
+            return false;
+        case GGML_TYPE_BF16:
+            if (Btype != GGML_TYPE_BF16) {
+                return false;
+            }
+#if defined(__AVX512BF16__)
+            // the pairs of bf16 are multiplied and accumulated in f32 with a single instruction
+            if (k % 32) {
+                return false;
+            }
+            return gemm(tinyBLAS<32, __m512, __m512bh, ggml_bf16_t, ggml_bf16_t, float, 4, 6>(
+                        k, (const ggml_bf16_t *) A, lda, (const ggml_bf16_t *) B, ldb, Cf, ldc), m, n, ith, nth);
+#else
+            return gemm_f<ggml_bf16_t, ggml_bf16_t>(m, n, k, A, lda, B, ldb, Cf, ldc, ith, nth);
+#endif
+        case GGML_TYPE_Q8_0:
+            if (Btype != GGML_TYPE_Q8_0) {
+                return false;
+            }
+            return gemm_q0<block_q8_0>(m, n, k, A, lda, B, ldb, Cf, ldc, ith, nth);
+        case GGML_TYPE_Q4_0:
+            if (Btype != GGML_TYPE_Q8_0) {
+                return false;
+            }
+            return gemm_q0<block_q4_0>(m, n, k, A, lda, B, ldb, Cf, ldc, ith, nth);
+        default:
+            return false;
+    }
+}
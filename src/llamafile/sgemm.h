@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// C = Aᵀ * B for the rows of A (m×k) and B (n×k) and the columns of C (n×m), see sgemm.cpp
+// lda, ldb and ldc are in elements (blocks for the quantized types), k too
+// the work is split between the nth threads, each thread calls the function with its ith
+// returns false if the types or the shapes are not supported, nothing is computed then
+bool llamafile_sgemm(int64_t m, int64_t n, int64_t k,
+                     const void * A, int64_t lda,
+                     const void * B, int64_t ldb,
+                           void * C, int64_t ldc,
+                     int ith, int nth,
+                     int Atype, int Btype, int Ctype);
+
+#ifdef __cplusplus
+}
+#endif
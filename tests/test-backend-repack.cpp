@@ -0,0 +1,163 @@
+// the Q4_0 weights of ggml_backend_cpu_repack_buffer_type are repacked when they are set and unpacked when they are read:
+// the round trip must give the data back, also for partial writes and reads, and mul_mat must give the results of the
+// unpacked weights in a regular buffer; the other ops cannot read the repacked weights
+#include "ggml.h"
+#include "ggml-backend.h"
+
+#include "test-common.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#define N_EMBD 256
+#define N_ROWS 64
+
+int main(void) {
+    ggml_backend_t backend = ggml_backend_cpu_init();
+    ggml_backend_buffer_type_t buft = ggml_backend_cpu_repack_buffer_type();
+
+    // without kernels for the interleaved types the buffer is a regular host buffer
+    const bool repacked = !ggml_backend_buft_is_host(buft);
+    printf("repacking: %s\n", repacked ? "on" : "off");
+
+    ggml_init_params params = {
+        /*.mem_size   =*/ 16*ggml_tensor_overhead() + ggml_graph_overhead(),
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ true,
+    };
+    ggml_context * ctx_w   = ggml_init(params);
+    ggml_context * ctx_ref = ggml_init(params);
+
+    ggml_tensor * w     = ggml_new_tensor_2d(ctx_w,   GGML_TYPE_Q4_0, N_EMBD, N_ROWS);
+    ggml_tensor * w_ref = ggml_new_tensor_2d(ctx_ref, GGML_TYPE_Q4_0, N_EMBD, N_ROWS);
+
+    ggml_backend_buffer_t buf_w   = ggml_backend_alloc_ctx_tensors_from_buft(ctx_w, buft);
+    ggml_backend_buffer_t buf_ref = ggml_backend_alloc_ctx_tensors(ctx_ref, backend);
+
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    // two sets of weights, the second one is written over parts of the first one
+    const size_t nbytes = ggml_nbytes(w);
+
+    std::vector<uint8_t> q[2];
+    for (int i = 0; i < 2; i++) {
+        std::vector<float> data(N_EMBD*N_ROWS);
+        for (float & v : data) {
+            v = dist(rng);
+        }
+        q[i].resize(nbytes);
+        ggml_quantize_chunk(GGML_TYPE_Q4_0, data.data(), q[i].data(), 0, N_ROWS, N_EMBD, NULL);
+    }
+
+    int n_failed = 0;
+
+    std::vector<uint8_t> expected = q[0];
+    std::vector<uint8_t> res(nbytes);
+
+    ggml_backend_tensor_set(w, expected.data(), 0, nbytes);
+    ggml_backend_tensor_get(w, res.data(), 0, nbytes);
+    if (res != expected) {
+        fprintf(stderr, "the data read back differs from the data that was set\n");
+        n_failed++;
+    }
+
+    // the groups of rows partially covered by a write or a read are unpacked, updated and repacked
+    for (int iter = 0; iter < 200 && n_failed == 0; iter++) {
+        const size_t offset = rng() % nbytes;
+        const size_t size   = 1 + rng() % (nbytes - offset);
+
+        if (iter % 2 == 0) {
+            ggml_backend_tensor_set(w, q[1].data() + offset, offset, size);
+            memcpy(expected.data() + offset, q[1].data() + offset, size);
+        }
+
+        std::fill(res.begin(), res.end(), 0);
+        ggml_backend_tensor_get(w, res.data() + offset, offset, size);
+        if (memcmp(res.data() + offset, expected.data() + offset, size) != 0) {
+            fprintf(stderr, "iteration %d: [%zu, %zu) differs\n", iter, offset, offset + size);
+            n_failed++;
+        }
+    }
+
+    ggml_backend_tensor_get(w, res.data(), 0, nbytes);
+    if (res != expected) {
+        fprintf(stderr, "the data read back differs from the data that was set\n");
+        n_failed++;
+    }
+
+    // the unpacked weights in a regular buffer
+    ggml_backend_tensor_set(w_ref, res.data(), 0, nbytes);
+
+    // the gemv and the gemm kernels, and the rows that are left to the gemv kernel
+    for (int n_tokens : { 1, 4, 7 }) {
+        ggml_context * ctx = ggml_init(params);
+
+        ggml_tensor * x     = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, N_EMBD, n_tokens);
+        ggml_tensor * y     = ggml_mul_mat(ctx, w,     x);
+        ggml_tensor * y_ref = ggml_mul_mat(ctx, w_ref, x);
+
+        ggml_cgraph * gf = ggml_new_graph(ctx);
+        ggml_build_forward_expand(gf, y);
+        ggml_build_forward_expand(gf, y_ref);
+
+        ggml_backend_buffer_t buf = ggml_backend_alloc_ctx_tensors(ctx, backend);
+
+        srand(n_tokens);
+        test_fill(x, -1.0f, 1.0f);
+
+        GGML_ASSERT(ggml_backend_supports_op(backend, y));
+        GGML_ASSERT(ggml_backend_graph_compute(backend, gf) == GGML_STATUS_SUCCESS);
+
+        std::vector<float> out(ggml_nelements(y));
+        std::vector<float> out_ref(ggml_nelements(y_ref));
+        ggml_backend_tensor_get(y,     out.data(),     0, ggml_nbytes(y));
+        ggml_backend_tensor_get(y_ref, out_ref.data(), 0, ggml_nbytes(y_ref));
+
+        // the kernels sum the products of the blocks in a different order
+        double err = 0.0;
+        double ref = 0.0;
+        for (size_t i = 0; i < out.size(); i++) {
+            err += (out[i] - out_ref[i])*(out[i] - out_ref[i]);
+            ref += out_ref[i]*out_ref[i];
+        }
+        if (!(err <= 1e-10*ref)) {
+            fprintf(stderr, "n_tokens = %d: mul_mat differs from the unpacked weights, nmse = %g\n", n_tokens, err/ref);
+            n_failed++;
+        }
+
+        ggml_backend_buffer_free(buf);
+        ggml_free(ctx);
+    }
+
+    // the other ops, and mul_mat on a view, would read the interleaved blocks as Q4_0 blocks
+    {
+        ggml_context * ctx = ggml_init(params);
+
+        ggml_tensor * ids = ggml_new_tensor_1d(ctx, GGML_TYPE_I32, 4);
+        ggml_tensor * x   = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, N_EMBD, 4);
+
+        ggml_tensor * rows     = ggml_get_rows(ctx, w,     ids);
+        ggml_tensor * rows_ref = ggml_get_rows(ctx, w_ref, ids);
+        ggml_tensor * mm_view  = ggml_mul_mat(ctx, ggml_view_2d(ctx, w, N_EMBD, N_ROWS/2, w->nb[1], 0), x);
+        ggml_tensor * mm       = ggml_mul_mat(ctx, w, x);
+
+        if (ggml_backend_supports_op(backend, rows) == repacked || !ggml_backend_supports_op(backend, rows_ref) ||
+            ggml_backend_supports_op(backend, mm_view) == repacked || !ggml_backend_supports_op(backend, mm)) {
+            fprintf(stderr, "unexpected supports_op\n");
+            n_failed++;
+        }
+
+        ggml_free(ctx);
+    }
+
+    ggml_backend_buffer_free(buf_w);
+    ggml_backend_buffer_free(buf_ref);
+    ggml_free(ctx_w);
+    ggml_free(ctx_ref);
+    ggml_backend_free(backend);
+
+    return test_report(n_failed);
+}
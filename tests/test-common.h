@@ -0,0 +1,76 @@
+// helpers of the tests that compute a graph in two ways and compare the results
+#pragma once
+
+#include "ggml.h"
+#include "ggml-backend.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// uniform values in [min, max) from rand(), the tests use srand() for their seed
+static inline void test_fill(struct ggml_tensor * t, float min, float max) {
+    const int64_t n = ggml_nelements(t);
+
+    if (t->buffer == NULL) {
+        for (int64_t i = 0; i < n; i++) {
+            ggml_set_f32_1d(t, (int) i, min + (max - min)*((float) rand()/((float) RAND_MAX + 1.0f)));
+        }
+        return;
+    }
+
+    GGML_ASSERT(t->type == GGML_TYPE_F32);
+
+    float * data = (float *) malloc(n*sizeof(float));
+    for (int64_t i = 0; i < n; i++) {
+        data[i] = min + (max - min)*((float) rand()/((float) RAND_MAX + 1.0f));
+    }
+    ggml_backend_tensor_set(t, data, 0, n*sizeof(float));
+    free(data);
+}
+
+// relative error of at most 1e-5, the infinities (masked positions) must match
+static inline bool test_compare(const float * res, const float * ref, int64_t n, const char * what) {
+    for (int64_t i = 0; i < n; i++) {
+        if (!(fabsf(res[i] - ref[i]) <= 1e-5f*fmaxf(1.0f, fabsf(ref[i]))) && !(isinf(res[i]) && res[i] == ref[i])) {
+            fprintf(stderr, "%s: [%d] = %f, expected %f\n", what, (int) i, res[i], ref[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// for the results that are computed by the same kernels in the same order
+static inline bool test_equal(const float * res, const float * ref, int64_t n, const char * what) {
+    for (int64_t i = 0; i < n; i++) {
+        if (memcmp(&res[i], &ref[i], sizeof(float)) != 0) {
+            fprintf(stderr, "%s: [%d] = %f, expected %f\n", what, (int) i, res[i], ref[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline enum ggml_status test_compute(struct ggml_cgraph * gf, int n_threads, struct ggml_threadpool * threadpool, enum ggml_graph_exec_mode exec_mode) {
+    struct ggml_cplan cplan = ggml_graph_plan(gf, n_threads, threadpool);
+    cplan.work_data = cplan.work_size > 0 ? (uint8_t *) malloc(cplan.work_size) : NULL;
+    cplan.exec_mode = exec_mode;
+
+    const enum ggml_status status = ggml_graph_compute(gf, &cplan);
+
+    free(cplan.work_data);
+
+    return status;
+}
+
+static inline const char * test_exec_mode_name(enum ggml_graph_exec_mode exec_mode) {
+    return exec_mode == GGML_GRAPH_EXEC_MODE_SEQUENTIAL ? "sequential" : "dependency";
+}
+
+// prints the result of the test and returns its exit code
+static inline int test_report(int n_failed) {
+    printf("%s\n", n_failed == 0 ? "OK" : "FAILED");
+
+    return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+// the offline planning of ggml_gallocr (ggml_gallocr_set_plan) must give the results of the default allocation,
+// with a compute buffer that is not larger than the default one and not smaller than the lower bound
+#include "ggml.h"
+#include "ggml-alloc.h"
+#include "ggml-backend.h"
+
+#include "test-common.h"
+
+#include <cstdio>
+#include <vector>
+
+#define N_EMBD   64
+#define N_TOKENS 48
+#define N_LAYERS 3
+#define N_NODES  4096
+
+struct test_model {
+    ggml_context          * ctx;
+    ggml_backend_buffer_t   buf;
+
+    ggml_tensor               * x;
+    std::vector<ggml_tensor *> w;
+};
+
+// attention and feed-forward layers: tensors of different sizes with overlapping lifetimes,
+// a view that keeps its source alive (with_view) and an inplace op
+static ggml_cgraph * test_build(ggml_context * ctx, const test_model & model, bool with_view) {
+    ggml_cgraph * gf = ggml_new_graph_custom(ctx, N_NODES, false);
+
+    ggml_tensor * x = model.x;
+    size_t iw = 0;
+
+    for (int l = 0; l < N_LAYERS; l++) {
+        ggml_tensor * q = ggml_mul_mat(ctx, model.w[iw++], x);
+        ggml_tensor * k = ggml_mul_mat(ctx, model.w[iw++], x);
+        ggml_tensor * v = ggml_mul_mat(ctx, model.w[iw++], x);
+
+        ggml_tensor * kq = ggml_mul_mat(ctx, k, q);
+        kq = ggml_soft_max_inplace(ctx, ggml_scale(ctx, kq, 0.125f));
+
+        ggml_tensor * kqv = ggml_mul_mat(ctx, ggml_cont(ctx, ggml_transpose(ctx, v)), kq);
+
+        ggml_tensor * h = ggml_gelu(ctx, ggml_mul_mat(ctx, model.w[iw++], x));
+        ggml_tensor * f = ggml_mul_mat(ctx, model.w[iw++], h);
+        if (with_view) {
+            ggml_tensor * hh = ggml_concat(ctx, h, h, 1);
+            f = ggml_add(ctx, f, ggml_view_2d(ctx, hh, N_EMBD, N_TOKENS, hh->nb[1], 0));
+        }
+
+        x = ggml_norm(ctx, ggml_add(ctx, x, ggml_add(ctx, kqv, f)), 1e-5f);
+    }
+
+    ggml_set_output(x);
+    ggml_build_forward_expand(gf, x);
+
+    return gf;
+}
+
+struct test_result {
+    std::vector<float> out;
+    size_t size;
+    size_t min_size;
+};
+
+static test_result test_run(ggml_backend_t backend, const test_model & model, bool plan, bool with_view) {
+    ggml_init_params params = {
+        /*.mem_size   =*/ ggml_tensor_overhead()*N_NODES + ggml_graph_overhead_custom(N_NODES, false),
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ true,
+    };
+    ggml_context * ctx = ggml_init(params);
+
+    ggml_cgraph * gf = test_build(ctx, model, with_view);
+
+    ggml_gallocr_t galloc = ggml_gallocr_new(ggml_backend_get_default_buffer_type(backend));
+    ggml_gallocr_set_plan(galloc, plan);
+
+    GGML_ASSERT(ggml_gallocr_reserve(galloc, gf));
+    GGML_ASSERT(ggml_gallocr_alloc_graph(galloc, gf));
+
+    test_result res;
+    res.size     = ggml_gallocr_get_buffer_size(galloc, 0);
+    res.min_size = ggml_gallocr_get_buffer_min_size(galloc, 0);
+
+    GGML_ASSERT(ggml_backend_graph_compute(backend, gf) == GGML_STATUS_SUCCESS);
+
+    ggml_tensor * out = gf->nodes[gf->n_nodes - 1];
+    res.out.resize(ggml_nelements(out));
+    ggml_backend_tensor_get(out, res.out.data(), 0, ggml_nbytes(out));
+
+    ggml_gallocr_free(galloc);
+    ggml_free(ctx);
+
+    return res;
+}
+
+int main(void) {
+    ggml_backend_t backend = ggml_backend_cpu_init();
+
+    test_model model;
+
+    ggml_init_params params = {
+        /*.mem_size   =*/ ggml_tensor_overhead()*(1 + 5*N_LAYERS),
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ true,
+    };
+    model.ctx = ggml_init(params);
+    model.x   = ggml_new_tensor_2d(model.ctx, GGML_TYPE_F32, N_EMBD, N_TOKENS);
+    for (int l = 0; l < N_LAYERS; l++) {
+        for (int i = 0; i < 3; i++) {
+            model.w.push_back(ggml_new_tensor_2d(model.ctx, GGML_TYPE_F32, N_EMBD, N_EMBD));
+        }
+        model.w.push_back(ggml_new_tensor_2d(model.ctx, GGML_TYPE_F32, N_EMBD, 4*N_EMBD));
+        model.w.push_back(ggml_new_tensor_2d(model.ctx, GGML_TYPE_F32, 4*N_EMBD, N_EMBD));
+    }
+    model.buf = ggml_backend_alloc_ctx_tensors(model.ctx, backend);
+
+    srand(1);
+    for (ggml_tensor * t = ggml_get_first_tensor(model.ctx); t != NULL; t = ggml_get_next_tensor(model.ctx, t)) {
+        test_fill(t, -0.2f, 0.2f);
+    }
+
+    int n_failed = 0;
+
+    for (int with_view = 0; with_view < 2; with_view++) {
+        const test_result def  = test_run(backend, model, false, with_view);
+        const test_result plan = test_run(backend, model, true,  with_view);
+
+        printf("with_view = %d: default %zu bytes, planned %zu bytes, lower bound %zu bytes\n", with_view, def.size, plan.size, plan.min_size);
+
+        // the results are computed by the same kernels, only the addresses of the tensors change
+        const bool same = def.out.size() == plan.out.size() &&
+            test_equal(plan.out.data(), def.out.data(), def.out.size(), "out");
+
+        if (!same) {
+            fprintf(stderr, "with_view = %d: the results of the planned allocation differ\n", with_view);
+            n_failed++;
+        }
+        if (plan.size > def.size || plan.size < plan.min_size || plan.min_size != def.min_size) {
+            fprintf(stderr, "with_view = %d: unexpected buffer size\n", with_view);
+            n_failed++;
+        }
+    }
+
+    ggml_backend_buffer_free(model.buf);
+    ggml_free(model.ctx);
+    ggml_backend_free(backend);
+
+    return test_report(n_failed);
+}
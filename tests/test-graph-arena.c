@@ -0,0 +1,186 @@
+// ggml_reset reuses the memory of a context (and its chunks, in the same order) for the next objects, and forgets the names of
+// the previous ones; ggml_graph_arena is a context of the thread that is reset at every call
+#include "ggml.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_EMBD   64
+#define N_LAYERS 100
+#define N_STEPS  5
+
+struct test_step {
+    struct ggml_cgraph * gf;
+    struct ggml_tensor * tensors[3*N_LAYERS + 1]; // in their order of creation
+    int                  n_tensors;
+};
+
+// a new graph at every step, with the same tensors (and names) every time
+static void test_build(struct ggml_context * ctx, struct test_step * step) {
+    step->n_tensors = 0;
+
+    struct ggml_tensor * x = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, N_EMBD, 4);
+    ggml_set_name(x, "x");
+    step->tensors[step->n_tensors++] = x;
+
+    for (int il = 0; il < N_LAYERS; il++) {
+        struct ggml_tensor * w = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, N_EMBD, N_EMBD);
+        ggml_format_name(w, "w%d", il);
+        step->tensors[step->n_tensors++] = w;
+
+        struct ggml_tensor * y = ggml_mul_mat(ctx, w, x);
+        step->tensors[step->n_tensors++] = y;
+
+        x = ggml_add(ctx, y, x);
+        ggml_format_name(x, "l%d", il);
+        step->tensors[step->n_tensors++] = x;
+    }
+
+    step->gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(step->gf, x);
+}
+
+// the objects of the step are the only objects of the context, and they are at the addresses of the previous step
+static bool test_check_step(struct ggml_context * ctx, const struct test_step * step, const struct test_step * prev, const char * what, int s) {
+    int i = 0;
+    for (struct ggml_tensor * t = ggml_get_first_tensor(ctx); t != NULL; t = ggml_get_next_tensor(ctx, t), i++) {
+        if (i >= step->n_tensors || t != step->tensors[i]) {
+            fprintf(stderr, "%s: step %d: tensor %d is not a tensor of the step\n", what, s, i);
+            return false;
+        }
+        if (prev != NULL && (t != prev->tensors[i] || t->data != prev->tensors[i]->data)) {
+            fprintf(stderr, "%s: step %d: tensor %d is not at the address of the previous step\n", what, s, i);
+            return false;
+        }
+    }
+    if (i != step->n_tensors) {
+        fprintf(stderr, "%s: step %d: %d tensors, expected %d\n", what, s, i, step->n_tensors);
+        return false;
+    }
+    if (prev != NULL && step->gf != prev->gf) {
+        fprintf(stderr, "%s: step %d: the graph is not at the address of the previous step\n", what, s);
+        return false;
+    }
+    return true;
+}
+
+// the names are looked up in the index of the context
+static bool test_check_names(struct ggml_context * ctx, const struct test_step * step, const char * what, int s) {
+    for (int il = 0; il < N_LAYERS; il += 7) {
+        char name[16];
+        snprintf(name, sizeof(name), "l%d", il);
+
+        struct ggml_tensor * t = ggml_get_tensor(ctx, name);
+        if (t != step->tensors[3*il + 3] || ggml_graph_get_tensor(step->gf, name) != t) {
+            fprintf(stderr, "%s: step %d: %s not found\n", what, s, name);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool test_reset(void) {
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 16*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+    struct ggml_context * ctx = ggml_init(params);
+    ggml_set_mem_grow(ctx, 64*1024, false);
+    ggml_set_name_index(ctx, true);
+
+    static struct test_step steps[2];
+
+    bool ok = true;
+    size_t used_mem = 0;
+
+    for (int s = 0; s < N_STEPS && ok; s++) {
+        struct test_step * step = &steps[s % 2];
+        struct test_step * prev = s > 0 ? &steps[(s + 1) % 2] : NULL;
+
+        if (s > 0) {
+            ggml_reset(ctx);
+
+            // the names of the previous step are forgotten
+            if (ggml_get_tensor(ctx, "x") != NULL || ggml_get_tensor(ctx, "l0") != NULL) {
+                fprintf(stderr, "%s: step %d: a tensor of the previous step was found\n", __func__, s);
+                ok = false;
+                break;
+            }
+            if (ggml_used_mem(ctx) != 0) {
+                fprintf(stderr, "%s: step %d: used memory %zu after the reset\n", __func__, s, ggml_used_mem(ctx));
+                ok = false;
+                break;
+            }
+        }
+
+        test_build(ctx, step);
+
+        ok = test_check_step(ctx, step, prev, __func__, s) && test_check_names(ctx, step, __func__, s);
+
+        if (ok && s > 0 && ggml_used_mem(ctx) != used_mem) {
+            fprintf(stderr, "%s: step %d: used memory %zu, expected %zu\n", __func__, s, ggml_used_mem(ctx), used_mem);
+            ok = false;
+        }
+        used_mem = ggml_used_mem(ctx);
+    }
+
+    ggml_free(ctx);
+
+    return ok;
+}
+
+static bool test_arena(void) {
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 16*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+
+    static struct test_step steps[2];
+
+    bool ok = true;
+
+    for (int s = 0; s < N_STEPS && ok; s++) {
+        struct test_step * step = &steps[s % 2];
+        struct test_step * prev = s > 0 ? &steps[(s + 1) % 2] : NULL;
+
+        struct ggml_context * ctx = ggml_graph_arena(params);
+        if (s == 0) {
+            ggml_set_name_index(ctx, true);
+        }
+
+        test_build(ctx, step);
+
+        for (int i = 0; i < step->n_tensors; i++) {
+            struct ggml_tensor * t = step->tensors[i];
+            if (t->op == GGML_OP_NONE) {
+                for (int j = 0; j < ggml_nelements(t); j++) {
+                    ((float *) t->data)[j] = 0.01f*(s + 1);
+                }
+            }
+        }
+
+        ok = test_check_step(ctx, step, prev, __func__, s) && test_check_names(ctx, step, __func__, s) &&
+            ggml_graph_compute_with_ctx(ctx, step->gf, 2) == GGML_STATUS_SUCCESS;
+    }
+
+    ggml_graph_arena_free();
+
+    return ok;
+}
+
+int main(void) {
+    int n_failed = 0;
+
+    const bool ok_reset = test_reset();
+    printf("test_reset: %s\n", ok_reset ? "OK" : "FAILED");
+    n_failed += !ok_reset;
+
+    const bool ok_arena = test_arena();
+    printf("test_arena: %s\n", ok_arena ? "OK" : "FAILED");
+    n_failed += !ok_arena;
+
+    return n_failed == 0 ? 0 : 1;
+}
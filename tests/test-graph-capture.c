@@ -0,0 +1,174 @@
+// a captured graph that is replayed with new inputs, new op params and moved tensors must give the results of a graph built for each step
+#include "ggml.h"
+
+#include "test-common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define N_EMBD   64
+#define N_TOKENS 4
+#define N_STEPS  6
+#define N_CTX    (N_TOKENS*N_STEPS)
+
+struct test_model {
+    struct ggml_context * ctx;
+
+    struct ggml_tensor * wq;
+    struct ggml_tensor * wk;
+    struct ggml_tensor * cache_k;
+};
+
+struct test_step {
+    struct ggml_tensor * x;
+    struct ggml_tensor * k_new; // view of the cache at n_past
+    struct ggml_tensor * k_cpy; // view of k_new
+    struct ggml_tensor * kq;    // ggml_diag_mask_inf with n_past
+    struct ggml_tensor * out;
+};
+
+static struct ggml_cgraph * test_build(struct test_model * model, struct ggml_context * ctx, int n_past, struct test_step * step) {
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+
+    step->x = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, N_EMBD, N_TOKENS);
+
+    struct ggml_tensor * q = ggml_mul_mat(ctx, model->wq, step->x);
+    struct ggml_tensor * k = ggml_mul_mat(ctx, model->wk, step->x);
+
+    step->k_new = ggml_view_2d(ctx, model->cache_k, N_EMBD, N_TOKENS, model->cache_k->nb[1], n_past*model->cache_k->nb[1]);
+    step->k_cpy = ggml_cpy(ctx, k, step->k_new);
+    ggml_build_forward_expand(gf, step->k_cpy);
+
+    // the whole cache is used, the positions after n_past + i are masked
+    struct ggml_tensor * kq = ggml_mul_mat(ctx, model->cache_k, q);
+    kq = ggml_scale(ctx, kq, 0.125f);
+    kq = ggml_diag_mask_inf(ctx, kq, n_past);
+    step->kq = ggml_soft_max(ctx, kq);
+
+    struct ggml_tensor * v_t = ggml_cont(ctx, ggml_transpose(ctx, model->cache_k));
+    step->out = ggml_add(ctx, ggml_mul_mat(ctx, v_t, step->kq), step->x);
+
+    ggml_build_forward_expand(gf, step->out);
+
+    return gf;
+}
+
+// the captured graph is moved to the next position: the op params and the addresses of the views of the cache
+static void test_step_update(struct test_model * model, struct test_step * step, int n_past) {
+    const size_t offs = n_past*model->cache_k->nb[1];
+
+    step->k_new->data      = (char *) model->cache_k->data + offs;
+    step->k_new->view_offs = offs;
+    step->k_cpy->data      = step->k_new->data;
+
+    ((int32_t *) step->kq->src[0]->op_params)[0] = n_past;
+}
+
+static bool test_run(struct test_model * model, int n_threads, struct ggml_threadpool * threadpool, enum ggml_graph_exec_mode exec_mode) {
+    static float ref_out[N_STEPS][N_EMBD*N_TOKENS];
+    static float ref_kq [N_STEPS][N_CTX*N_TOKENS];
+    static float inputs [N_STEPS][N_EMBD*N_TOKENS];
+
+    // reference: a new graph for each step
+    memset(model->cache_k->data, 0, ggml_nbytes(model->cache_k));
+    for (int s = 0; s < N_STEPS; s++) {
+        struct ggml_init_params params = {
+            /*.mem_size   =*/ 4*1024*1024,
+            /*.mem_buffer =*/ NULL,
+            /*.no_alloc   =*/ false,
+        };
+        struct ggml_context * ctx = ggml_init(params);
+
+        struct test_step step;
+        struct ggml_cgraph * gf = test_build(model, ctx, s*N_TOKENS, &step);
+        test_fill(step.x, -0.5f, 0.5f);
+        memcpy(inputs[s], step.x->data, ggml_nbytes(step.x));
+
+        GGML_ASSERT(ggml_graph_compute_with_ctx(ctx, gf, 1) == GGML_STATUS_SUCCESS);
+
+        memcpy(ref_out[s], step.out->data, ggml_nbytes(step.out));
+        memcpy(ref_kq [s], step.kq->data,  ggml_nbytes(step.kq));
+
+        ggml_free(ctx);
+    }
+
+    // the same steps with a single graph, captured once
+    memset(model->cache_k->data, 0, ggml_nbytes(model->cache_k));
+
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 4*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+    struct ggml_context * ctx = ggml_init(params);
+
+    struct test_step step;
+    struct ggml_cgraph * gf = test_build(model, ctx, 0, &step);
+
+    struct ggml_cplan cplan = ggml_graph_plan(gf, n_threads, threadpool);
+    cplan.work_data = cplan.work_size > 0 ? malloc(cplan.work_size) : NULL;
+    cplan.exec_mode = exec_mode;
+
+    struct ggml_graph_capture * capture = ggml_graph_capture_new(gf, &cplan);
+
+    bool ok = true;
+    for (int s = 0; s < N_STEPS && ok; s++) {
+        test_step_update(model, &step, s*N_TOKENS);
+        memcpy(step.x->data, inputs[s], ggml_nbytes(step.x));
+
+        ok = ggml_graph_capture_compute(capture) == GGML_STATUS_SUCCESS &&
+             test_compare((const float *) step.out->data, ref_out[s], ggml_nelements(step.out), "out") &&
+             test_compare((const float *) step.kq->data,  ref_kq [s], ggml_nelements(step.kq),  "kq");
+        if (!ok) {
+            fprintf(stderr, "step %d: FAILED\n", s);
+        }
+    }
+
+    ggml_graph_capture_free(capture);
+    free(cplan.work_data);
+    ggml_free(ctx);
+
+    return ok;
+}
+
+int main(void) {
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 4*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+
+    struct test_model model;
+    model.ctx     = ggml_init(params);
+    model.wq      = ggml_new_tensor_2d(model.ctx, GGML_TYPE_F32, N_EMBD, N_EMBD);
+    model.wk      = ggml_new_tensor_2d(model.ctx, GGML_TYPE_F32, N_EMBD, N_EMBD);
+    model.cache_k = ggml_new_tensor_2d(model.ctx, GGML_TYPE_F32, N_EMBD, N_CTX);
+
+    srand(3);
+    test_fill(model.wq, -0.5f, 0.5f);
+    test_fill(model.wk, -0.5f, 0.5f);
+
+    struct ggml_threadpool_params tpp = ggml_threadpool_params_default(4);
+    struct ggml_threadpool * threadpool = ggml_threadpool_new(&tpp);
+
+    int n_failed = 0;
+
+    for (int n_threads = 1; n_threads <= 4; n_threads++) {
+        for (int mode = 0; mode < 2; mode++) {
+            const enum ggml_graph_exec_mode exec_mode = mode == 0 ? GGML_GRAPH_EXEC_MODE_SEQUENTIAL : GGML_GRAPH_EXEC_MODE_DEPENDENCY;
+
+            for (int tp = 0; tp < 2; tp++) {
+                if (!test_run(&model, n_threads, tp == 0 ? NULL : threadpool, exec_mode)) {
+                    fprintf(stderr, "n_threads = %d, exec_mode = %s, threadpool = %s: FAILED\n",
+                            n_threads, test_exec_mode_name(exec_mode), tp == 0 ? "no" : "yes");
+                    n_failed++;
+                }
+            }
+        }
+    }
+
+    ggml_threadpool_free(threadpool);
+    ggml_free(model.ctx);
+
+    return test_report(n_failed);
+}
@@ -0,0 +1,156 @@
+// GGML_GRAPH_EXEC_MODE_DEPENDENCY skips the barriers between the nodes that do not depend on each other,
+// the results must be the same as with GGML_GRAPH_EXEC_MODE_SEQUENTIAL
+#include "ggml.h"
+
+#include "test-common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define N_EMBD   64
+#define N_TOKENS 8
+#define N_STEPS  4
+#define N_CTX    (N_TOKENS*N_STEPS)
+
+struct test_model {
+    struct ggml_context * ctx;
+
+    struct ggml_tensor * wq;
+    struct ggml_tensor * wk;
+    struct ggml_tensor * wv;
+    struct ggml_tensor * wo;
+
+    struct ggml_tensor * cache_k; // written with ggml_cpy into views
+    struct ggml_tensor * cache_v;
+};
+
+struct test_results {
+    float out[N_STEPS][N_EMBD*N_TOKENS];
+    float kq [N_STEPS][N_CTX*N_TOKENS];
+};
+
+static void test_model_init(struct test_model * model) {
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 64*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+    model->ctx = ggml_init(params);
+
+    // F16 weights: the src1 of the mul_mats is converted, and shared by the mul_mats with the same src1
+    model->wq = ggml_new_tensor_2d(model->ctx, GGML_TYPE_F16, N_EMBD, N_EMBD);
+    model->wk = ggml_new_tensor_2d(model->ctx, GGML_TYPE_F16, N_EMBD, N_EMBD);
+    model->wv = ggml_new_tensor_2d(model->ctx, GGML_TYPE_F16, N_EMBD, N_EMBD);
+    model->wo = ggml_new_tensor_2d(model->ctx, GGML_TYPE_F32, N_EMBD, N_EMBD);
+    test_fill(model->wq, -0.5f, 0.5f);
+    test_fill(model->wk, -0.5f, 0.5f);
+    test_fill(model->wv, -0.5f, 0.5f);
+    test_fill(model->wo, -0.5f, 0.5f);
+
+    model->cache_k = ggml_new_tensor_2d(model->ctx, GGML_TYPE_F32, N_EMBD, N_CTX);
+    model->cache_v = ggml_new_tensor_2d(model->ctx, GGML_TYPE_F32, N_CTX, N_EMBD);
+}
+
+// one attention step: the keys and values of the new tokens are copied to the caches, then all of them are used
+static struct ggml_cgraph * test_build_step(struct test_model * model, struct ggml_context * ctx, struct ggml_tensor * x, int n_past,
+        struct ggml_tensor ** out, struct ggml_tensor ** kq) {
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+
+    struct ggml_tensor * q = ggml_mul_mat(ctx, model->wq, x);
+    struct ggml_tensor * k = ggml_mul_mat(ctx, model->wk, x);
+    struct ggml_tensor * v = ggml_mul_mat(ctx, model->wv, x);
+
+    struct ggml_tensor * k_new = ggml_view_2d(ctx, model->cache_k, N_EMBD, N_TOKENS, model->cache_k->nb[1], n_past*model->cache_k->nb[1]);
+    struct ggml_tensor * v_new = ggml_view_2d(ctx, model->cache_v, N_TOKENS, N_EMBD, model->cache_v->nb[1], n_past*ggml_element_size(model->cache_v));
+    ggml_build_forward_expand(gf, ggml_cpy(ctx, k, k_new));
+    ggml_build_forward_expand(gf, ggml_cpy(ctx, ggml_transpose(ctx, v), v_new));
+
+    const int n_kv = n_past + N_TOKENS;
+
+    struct ggml_tensor * k_all = ggml_view_2d(ctx, model->cache_k, N_EMBD, n_kv, model->cache_k->nb[1], 0);
+    struct ggml_tensor * v_all = ggml_view_2d(ctx, model->cache_v, n_kv, N_EMBD, model->cache_v->nb[1], 0);
+
+    *kq = ggml_mul_mat(ctx, k_all, q);
+    *kq = ggml_scale_inplace(ctx, *kq, 0.125f);
+    *kq = ggml_soft_max_inplace(ctx, *kq);
+
+    struct ggml_tensor * kqv = ggml_mul_mat(ctx, v_all, *kq);
+
+    // inplace ops on the results of the mul_mats
+    struct ggml_tensor * cur = ggml_add_inplace(ctx, kqv, q);
+    cur = ggml_gelu_inplace(ctx, cur);
+    *out = ggml_add(ctx, ggml_mul_mat(ctx, model->wo, cur), x);
+
+    ggml_build_forward_expand(gf, *out);
+
+    return gf;
+}
+
+static void test_run(struct test_model * model, int n_threads, enum ggml_graph_exec_mode exec_mode, struct test_results * res) {
+    memset(model->cache_k->data, 0, ggml_nbytes(model->cache_k));
+    memset(model->cache_v->data, 0, ggml_nbytes(model->cache_v));
+
+    srand(42);
+
+    for (int step = 0; step < N_STEPS; step++) {
+        struct ggml_init_params params = {
+            /*.mem_size   =*/ 16*1024*1024,
+            /*.mem_buffer =*/ NULL,
+            /*.no_alloc   =*/ false,
+        };
+        struct ggml_context * ctx = ggml_init(params);
+
+        struct ggml_tensor * x = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, N_EMBD, N_TOKENS);
+        test_fill(x, -0.5f, 0.5f);
+
+        struct ggml_tensor * out;
+        struct ggml_tensor * kq;
+        struct ggml_cgraph * gf = test_build_step(model, ctx, x, step*N_TOKENS, &out, &kq);
+
+        GGML_ASSERT(test_compute(gf, n_threads, NULL, exec_mode) == GGML_STATUS_SUCCESS);
+
+        memset(res->kq[step], 0, sizeof(res->kq[step]));
+        memcpy(res->out[step], out->data, ggml_nbytes(out));
+        memcpy(res->kq [step], kq->data,  ggml_nbytes(kq));
+
+        ggml_free(ctx);
+    }
+}
+
+int main(void) {
+    struct test_model model;
+    test_model_init(&model);
+
+    static struct test_results ref;
+    static struct test_results res;
+
+    test_run(&model, 1, GGML_GRAPH_EXEC_MODE_SEQUENTIAL, &ref);
+
+    int n_failed = 0;
+
+    for (int n_threads = 2; n_threads <= 4; n_threads++) {
+        for (int rep = 0; rep < 10; rep++) {
+            for (int mode = 0; mode < 2; mode++) {
+                const enum ggml_graph_exec_mode exec_mode = mode == 0 ? GGML_GRAPH_EXEC_MODE_SEQUENTIAL : GGML_GRAPH_EXEC_MODE_DEPENDENCY;
+
+                test_run(&model, n_threads, exec_mode, &res);
+
+                int step = 0;
+                for (; step < N_STEPS; step++) {
+                    if (!test_compare(res.out[step], ref.out[step], N_EMBD*N_TOKENS, "out") ||
+                        !test_compare(res.kq [step], ref.kq [step], N_CTX*N_TOKENS,  "kq")) {
+                        break;
+                    }
+                }
+                if (step < N_STEPS) {
+                    fprintf(stderr, "n_threads = %d, exec_mode = %s, step %d: FAILED\n", n_threads, test_exec_mode_name(exec_mode), step);
+                    n_failed++;
+                }
+            }
+        }
+    }
+
+    ggml_free(model.ctx);
+
+    return test_report(n_failed);
+}
@@ -0,0 +1,116 @@
+// the chains marked by ggml_graph_fuse are computed in a single pass, the results must be the same as without fusion
+#include "ggml.h"
+
+#include "test-common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define N_EMBD   96
+#define N_FF     128
+#define N_TOKENS 7
+
+struct test_weights {
+    struct ggml_tensor * norm_w;
+    struct ggml_tensor * norm_b;
+    struct ggml_tensor * w1;
+    struct ggml_tensor * b1;
+    struct ggml_tensor * w2;
+    struct ggml_tensor * w3;
+    struct ggml_tensor * wq;
+};
+
+// the chains that the fusion pass handles: norm -> mul -> add, mul_mat -> add -> gelu, silu -> mul,
+// scale -> diag_mask_inf -> soft_max, and a residual add that is needed twice (not temporary)
+static struct ggml_tensor * test_build(struct ggml_context * ctx, const struct test_weights * w, struct ggml_tensor * x, struct ggml_tensor ** kq) {
+    struct ggml_tensor * cur = ggml_norm(ctx, x, 1e-5f);
+    cur = ggml_add(ctx, ggml_mul(ctx, cur, w->norm_w), w->norm_b);
+
+    struct ggml_tensor * q = ggml_mul_mat(ctx, w->wq, cur);
+    *kq = ggml_mul_mat(ctx, q, q);
+    *kq = ggml_scale(ctx, *kq, 0.125f);
+    *kq = ggml_diag_mask_inf(ctx, *kq, 0);
+    *kq = ggml_soft_max(ctx, *kq);
+    ggml_set_output(*kq);
+
+    struct ggml_tensor * qt  = ggml_cont(ctx, ggml_transpose(ctx, q));
+    struct ggml_tensor * res = ggml_add(ctx, ggml_mul_mat(ctx, qt, *kq), x);
+
+    struct ggml_tensor * up   = ggml_gelu(ctx, ggml_add(ctx, ggml_mul_mat(ctx, w->w1, res), w->b1));
+    struct ggml_tensor * gate = ggml_silu(ctx, ggml_mul_mat(ctx, w->w3, res));
+    cur = ggml_mul(ctx, up, gate);
+    cur = ggml_scale(ctx, ggml_mul_mat(ctx, w->w2, cur), 0.5f);
+
+    return ggml_add(ctx, cur, res);
+}
+
+int main(void) {
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 64*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+    struct ggml_context * ctx = ggml_init(params);
+
+    srand(7);
+
+    struct test_weights w = {
+        /*.norm_w =*/ ggml_new_tensor_1d(ctx, GGML_TYPE_F32, N_EMBD),
+        /*.norm_b =*/ ggml_new_tensor_1d(ctx, GGML_TYPE_F32, N_EMBD),
+        /*.w1     =*/ ggml_new_tensor_2d(ctx, GGML_TYPE_F32, N_EMBD, N_FF),
+        /*.b1     =*/ ggml_new_tensor_1d(ctx, GGML_TYPE_F32, N_FF),
+        /*.w2     =*/ ggml_new_tensor_2d(ctx, GGML_TYPE_F32, N_FF, N_EMBD),
+        /*.w3     =*/ ggml_new_tensor_2d(ctx, GGML_TYPE_F32, N_EMBD, N_FF),
+        /*.wq     =*/ ggml_new_tensor_2d(ctx, GGML_TYPE_F32, N_EMBD, N_EMBD),
+    };
+    test_fill(w.norm_w, -0.5f, 0.5f);
+    test_fill(w.norm_b, -0.5f, 0.5f);
+    test_fill(w.w1,     -0.5f, 0.5f);
+    test_fill(w.b1,     -0.5f, 0.5f);
+    test_fill(w.w2,     -0.5f, 0.5f);
+    test_fill(w.w3,     -0.5f, 0.5f);
+    test_fill(w.wq,     -0.5f, 0.5f);
+
+    struct ggml_tensor * x = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, N_EMBD, N_TOKENS);
+    test_fill(x, -0.5f, 0.5f);
+
+    // the same graph twice, the second one is fused
+    struct ggml_tensor * kq_ref;
+    struct ggml_tensor * kq_fused;
+    struct ggml_tensor * out_ref   = test_build(ctx, &w, x, &kq_ref);
+    struct ggml_tensor * out_fused = test_build(ctx, &w, x, &kq_fused);
+    ggml_set_output(out_ref);
+    ggml_set_output(out_fused);
+
+    struct ggml_cgraph * gf_ref = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf_ref, out_ref);
+
+    struct ggml_cgraph * gf_fused = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf_fused, out_fused);
+
+    const int n_fused = ggml_graph_fuse(gf_fused);
+    printf("fused nodes: %d of %d\n", n_fused, gf_fused->n_nodes);
+
+    bool ok = n_fused >= 6;
+    if (!ok) {
+        fprintf(stderr, "expected at least 6 fused nodes\n");
+    }
+
+    GGML_ASSERT(test_compute(gf_ref, 1, NULL, GGML_GRAPH_EXEC_MODE_SEQUENTIAL) == GGML_STATUS_SUCCESS);
+
+    for (int n_threads = 1; n_threads <= 4 && ok; n_threads++) {
+        memset(out_fused->data, 0, ggml_nbytes(out_fused));
+        memset(kq_fused->data,  0, ggml_nbytes(kq_fused));
+
+        ok = test_compute(gf_fused, n_threads, NULL, GGML_GRAPH_EXEC_MODE_SEQUENTIAL) == GGML_STATUS_SUCCESS &&
+             test_compare((const float *) out_fused->data, (const float *) out_ref->data, ggml_nelements(out_ref), "out") &&
+             test_compare((const float *) kq_fused->data,  (const float *) kq_ref->data,  ggml_nelements(kq_ref),  "kq");
+        if (!ok) {
+            fprintf(stderr, "n_threads = %d: FAILED\n", n_threads);
+        }
+    }
+
+    ggml_free(ctx);
+
+    return test_report(!ok);
+}
@@ -0,0 +1,209 @@
+// ggml_graph_reorder_for_memory must keep the dependencies of the nodes, the results must be the same as in the original order
+#include "ggml.h"
+#include "ggml-alloc.h"
+#include "ggml-backend.h"
+
+#include "test-common.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#define N_EMBD   32
+#define N_GRAPHS 100
+#define N_NODES  8192
+
+struct test_env {
+    ggml_context          * ctx;
+    ggml_backend_buffer_t   buf;
+
+    ggml_tensor * in;
+    ggml_tensor * cache; // written with ggml_cpy into views, and read back
+
+    std::vector<ggml_tensor *> w;
+};
+
+// a random graph of element-wise ops, mul_mats, large intermediates, inplace ops and writes to the cache
+static ggml_cgraph * test_build(ggml_context * ctx, const test_env & env, unsigned seed, bool fuse, std::vector<ggml_tensor *> & outs) {
+    std::mt19937 rng(seed);
+
+    ggml_cgraph * gf = ggml_new_graph_custom(ctx, N_NODES, false);
+
+    std::vector<ggml_tensor *> pool = { env.in };
+    int n_cache = 0;
+
+    const int n_ops = 60 + rng() % 80;
+    for (int i = 0; i < n_ops; i++) {
+        ggml_tensor * a = pool[rng() % pool.size()];
+        ggml_tensor * b = pool[rng() % pool.size()];
+        ggml_tensor * t = NULL;
+
+        switch (rng() % 9) {
+            case 0: t = ggml_add(ctx, a, b); break;
+            case 1: t = ggml_mul(ctx, a, b); break;
+            case 2: t = ggml_scale(ctx, a, 0.5f); break;
+            case 3: t = ggml_tanh(ctx, a); break;
+            case 4: t = ggml_mul_mat(ctx, env.w[rng() % env.w.size()], a); break;
+            case 5:
+                {
+                    ggml_tensor * big = ggml_tanh(ctx, ggml_repeat(ctx, a, ggml_new_tensor_2d(ctx, GGML_TYPE_F32, N_EMBD, 8*N_EMBD)));
+                    t = ggml_cont(ctx, ggml_view_2d(ctx, big, N_EMBD, N_EMBD, big->nb[1], 3*N_EMBD*big->nb[1]));
+                } break;
+            case 6:
+                {
+                    // the reads of the cache must stay after the writes that precede them
+                    if (n_cache < N_EMBD/2) {
+                        ggml_tensor * col = ggml_view_2d(ctx, a, N_EMBD, 1, a->nb[1], 0);
+                        ggml_tensor * dst = ggml_view_2d(ctx, env.cache, N_EMBD, 1, env.cache->nb[1], n_cache*env.cache->nb[1]);
+                        ggml_build_forward_expand(gf, ggml_cpy(ctx, col, dst));
+                        n_cache++;
+                    }
+                    t = ggml_cont(ctx, ggml_view_2d(ctx, env.cache, N_EMBD, N_EMBD, env.cache->nb[1], 0));
+                } break;
+            case 7: t = ggml_add_inplace(ctx, ggml_scale(ctx, a, 2.0f), a); break;
+            case 8: t = ggml_soft_max(ctx, a); break;
+        }
+
+        pool.push_back(t);
+
+        // the output flag of a view does not keep its source alive in ggml_gallocr
+        if (rng() % 10 == 0 && t->view_src == NULL) {
+            ggml_set_output(t);
+            outs.push_back(t);
+            ggml_build_forward_expand(gf, t);
+        }
+    }
+
+    ggml_tensor * res = pool.back();
+    for (int i = 0; i < 4; i++) {
+        res = ggml_add(ctx, ggml_sum(ctx, res), ggml_sum(ctx, pool[rng() % pool.size()]));
+    }
+    ggml_set_output(res);
+    outs.push_back(res);
+    ggml_build_forward_expand(gf, res);
+
+    if (fuse) {
+        ggml_graph_fuse(gf);
+    }
+
+    return gf;
+}
+
+static bool test_check_order(const ggml_cgraph * gf) {
+    for (int i = 0; i < gf->n_nodes; i++) {
+        const ggml_tensor * node = gf->nodes[i];
+        for (int j = 0; j < GGML_MAX_SRC; j++) {
+            const ggml_tensor * src = node->src[j];
+            if (src == NULL) {
+                continue;
+            }
+            for (int k = i + 1; k < gf->n_nodes; k++) {
+                if (gf->nodes[k] == src) {
+                    fprintf(stderr, "node %d (%s) is before its source %d (%s)\n", i, ggml_op_desc(node), k, ggml_op_desc(src));
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// the outputs and the cache after the compute of the graph
+static std::vector<float> test_run(ggml_backend_t backend, test_env & env, unsigned seed, bool fuse, bool reorder, bool * ok, int * n_reordered) {
+    ggml_init_params params = {
+        /*.mem_size   =*/ ggml_tensor_overhead()*N_NODES + ggml_graph_overhead_custom(N_NODES, false),
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ true,
+    };
+    ggml_context * ctx = ggml_init(params);
+
+    std::vector<ggml_tensor *> outs;
+    ggml_cgraph * gf = test_build(ctx, env, seed, fuse, outs);
+
+    ggml_tensor * last = gf->nodes[gf->n_nodes - 1];
+
+    if (reorder) {
+        *n_reordered += ggml_graph_reorder_for_memory(gf, NULL);
+        *ok = test_check_order(gf) && *ok;
+        if (gf->nodes[gf->n_nodes - 1] != last) {
+            fprintf(stderr, "the last node was moved\n");
+            *ok = false;
+        }
+    }
+
+    std::vector<float> zero(ggml_nelements(env.cache), 0.0f);
+    ggml_backend_tensor_set(env.cache, zero.data(), 0, ggml_nbytes(env.cache));
+
+    ggml_gallocr_t galloc = ggml_gallocr_new(ggml_backend_get_default_buffer_type(backend));
+    GGML_ASSERT(ggml_gallocr_alloc_graph(galloc, gf));
+    GGML_ASSERT(ggml_backend_graph_compute(backend, gf) == GGML_STATUS_SUCCESS);
+
+    std::vector<float> res;
+    outs.push_back(env.cache);
+    for (ggml_tensor * t : outs) {
+        const size_t n = res.size();
+        res.resize(n + ggml_nelements(t));
+        ggml_backend_tensor_get(t, res.data() + n, 0, ggml_nbytes(t));
+    }
+
+    ggml_gallocr_free(galloc);
+    ggml_free(ctx);
+
+    return res;
+}
+
+int main(void) {
+    ggml_backend_t backend = ggml_backend_cpu_init();
+
+    test_env env;
+
+    ggml_init_params params = {
+        /*.mem_size   =*/ ggml_tensor_overhead()*8,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ true,
+    };
+    env.ctx   = ggml_init(params);
+    env.in    = ggml_new_tensor_2d(env.ctx, GGML_TYPE_F32, N_EMBD, N_EMBD);
+    env.cache = ggml_new_tensor_2d(env.ctx, GGML_TYPE_F32, N_EMBD, N_EMBD);
+    for (int i = 0; i < 4; i++) {
+        env.w.push_back(ggml_new_tensor_2d(env.ctx, GGML_TYPE_F32, N_EMBD, N_EMBD));
+    }
+    env.buf = ggml_backend_alloc_ctx_tensors(env.ctx, backend);
+
+    srand(7);
+    for (ggml_tensor * t = ggml_get_first_tensor(env.ctx); t != NULL; t = ggml_get_next_tensor(env.ctx, t)) {
+        test_fill(t, -0.3f, 0.3f);
+    }
+
+    int n_failed    = 0;
+    int n_reordered = 0;
+
+    for (int g = 0; g < N_GRAPHS; g++) {
+        const bool fuse = g % 2 == 1;
+
+        bool ok = true;
+        const std::vector<float> ref = test_run(backend, env, g, fuse, false, &ok, &n_reordered);
+        const std::vector<float> res = test_run(backend, env, g, fuse, true,  &ok, &n_reordered);
+
+        if (ref.size() != res.size() || !test_equal(res.data(), ref.data(), ref.size(), "outputs")) {
+            fprintf(stderr, "graph %d: the results differ\n", g);
+            ok = false;
+        }
+
+        n_failed += !ok;
+    }
+
+    printf("%d of %d graphs reordered\n", n_reordered, N_GRAPHS);
+
+    // the random graphs are built in an order that is rarely the best one
+    if (n_reordered == 0) {
+        fprintf(stderr, "no graph was reordered\n");
+        n_failed++;
+    }
+
+    ggml_backend_buffer_free(env.buf);
+    ggml_free(env.ctx);
+    ggml_backend_free(backend);
+
+    return test_report(n_failed);
+}
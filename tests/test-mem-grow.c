@@ -0,0 +1,168 @@
+// a context with ggml_set_mem_grow adds chunks to its memory pool when it is full: the tensors must not move,
+// and with recycle the chunks of the freed contexts are reused by the next ones
+#include "ggml.h"
+
+#include "test-common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_TENSORS  3000
+#define MEM_SIZE   1024
+#define CHUNK_SIZE (64*1024)
+#define N_DECOYS   64
+
+struct test_tensors {
+    struct ggml_tensor * t[N_TENSORS];
+    void               * data[N_TENSORS];
+};
+
+static bool test_in_pool(struct ggml_context * ctx, const void * ptr) {
+    const char * begin = (const char *) ggml_get_mem_buffer(ctx);
+    return (const char *) ptr >= begin && (const char *) ptr < begin + MEM_SIZE;
+}
+
+// small tensors, and some that are larger than the chunks
+static bool test_fill_context(struct ggml_context * ctx, struct test_tensors * tensors, unsigned seed) {
+    srand(seed);
+
+    size_t nbytes = 0;
+
+    for (int i = 0; i < N_TENSORS; i++) {
+        const int n = rand() % 7 == 0 ? 40000 : 1 + rand() % 300;
+
+        const size_t used = ggml_used_mem(ctx);
+
+        struct ggml_tensor * t = ggml_new_tensor_1d(ctx, GGML_TYPE_F32, n);
+        ggml_format_name(t, "t%d", i);
+        for (int j = 0; j < n; j++) {
+            ((float *) t->data)[j] = (float) i;
+        }
+
+        tensors->t[i]    = t;
+        tensors->data[i] = t->data;
+
+        nbytes += ggml_nbytes(t);
+
+        if (ggml_used_mem(ctx) <= used || ggml_used_mem(ctx) > ggml_get_mem_size(ctx)) {
+            fprintf(stderr, "%s: tensor %d: used memory %zu, memory size %zu\n", __func__, i, ggml_used_mem(ctx), ggml_get_mem_size(ctx));
+            return false;
+        }
+    }
+
+    if (ggml_used_mem(ctx) < nbytes + N_TENSORS*ggml_tensor_overhead()) {
+        fprintf(stderr, "%s: used memory %zu, less than the tensors\n", __func__, ggml_used_mem(ctx));
+        return false;
+    }
+
+    return true;
+}
+
+// the tensors have not moved, their data is intact and they are enumerated first, in their order of creation
+static bool test_check_context(struct ggml_context * ctx, const struct test_tensors * tensors) {
+    int i = 0;
+    for (struct ggml_tensor * t = ggml_get_first_tensor(ctx); t != NULL && i < N_TENSORS; t = ggml_get_next_tensor(ctx, t), i++) {
+        if (t != tensors->t[i] || t->data != tensors->data[i]) {
+            fprintf(stderr, "%s: tensor %d has moved\n", __func__, i);
+            return false;
+        }
+        for (int j = 0; j < t->ne[0]; j++) {
+            if (((float *) t->data)[j] != (float) i) {
+                fprintf(stderr, "%s: tensor %d was overwritten\n", __func__, i);
+                return false;
+            }
+        }
+    }
+    if (i != N_TENSORS) {
+        fprintf(stderr, "%s: %d tensors, expected %d\n", __func__, i, N_TENSORS);
+        return false;
+    }
+    return true;
+}
+
+// a graph and its work buffer in the chunks
+static bool test_compute_in_chunks(struct ggml_context * ctx) {
+    struct ggml_tensor * a = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, 64, 64);
+    struct ggml_tensor * b = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, 64, 64);
+    for (int i = 0; i < 64*64; i++) {
+        ((float *) a->data)[i] = 1.0f;
+        ((float *) b->data)[i] = 2.0f;
+    }
+
+    struct ggml_tensor * y = ggml_mul_mat(ctx, a, b);
+    for (int i = 0; i < 200; i++) {
+        y = ggml_scale(ctx, y, 1.0f);
+    }
+
+    struct ggml_cgraph * gf = ggml_new_graph_custom(ctx, 4096, false);
+    ggml_build_forward_expand(gf, y);
+
+    if (ggml_graph_compute_with_ctx(ctx, gf, 2) != GGML_STATUS_SUCCESS || ((float *) y->data)[0] != 128.0f) {
+        fprintf(stderr, "%s: compute failed\n", __func__);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ MEM_SIZE,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+
+    static struct test_tensors tensors;
+    static struct test_tensors tensors_prev;
+
+    void * decoys[N_DECOYS] = { NULL }; // the memory freed by a context, kept until the end of the test
+
+    int n_failed = 0;
+
+    for (int round = 0; round < 4; round++) {
+        const bool recycle = round >= 2;
+
+        struct ggml_context * ctx = ggml_init(params);
+        ggml_set_mem_grow(ctx, CHUNK_SIZE, recycle);
+
+        bool ok = test_fill_context(ctx, &tensors, 1) && test_check_context(ctx, &tensors);
+
+        if (ok && ggml_get_mem_size(ctx) <= params.mem_size) {
+            fprintf(stderr, "round %d: the memory pool did not grow\n", round);
+            ok = false;
+        }
+
+        // the same tensors in the recycled chunks of the previous context
+        if (ok && round == 3) {
+            for (int i = 0; i < N_TENSORS; i++) {
+                if (!test_in_pool(ctx, tensors.data[i]) && tensors.data[i] != tensors_prev.data[i]) {
+                    fprintf(stderr, "round %d: tensor %d is not in the recycled chunks\n", round, i);
+                    ok = false;
+                    break;
+                }
+            }
+        }
+
+        ok = ok && test_compute_in_chunks(ctx) && test_check_context(ctx, &tensors);
+
+        tensors_prev = tensors;
+
+        ggml_free(ctx);
+
+        // the memory freed by the context is taken, so that only the recycled chunks can be at the same addresses in the next one
+        for (int i = 0; i < N_DECOYS; i++) {
+            free(decoys[i]);
+            decoys[i] = malloc(i % 2 == 0 ? CHUNK_SIZE + 256 : 40000*sizeof(float) + 256);
+        }
+
+        printf("round %d (recycle = %d): %s\n", round, recycle, ok ? "OK" : "FAILED");
+        n_failed += !ok;
+    }
+
+    for (int i = 0; i < N_DECOYS; i++) {
+        free(decoys[i]);
+    }
+
+    ggml_free_mem_chunks();
+
+    return test_report(n_failed);
+}
@@ -0,0 +1,139 @@
+// the AMX tiles compute the mul_mats with at least 16 columns in src1, the results must be the ones of the vec_dot kernels,
+// which compute the mul_mats with fewer columns: partial tiles (m and n not multiples of the tile sizes) and broadcast batches
+#include "ggml.h"
+#include "ggml-backend.h"
+
+#include "test-common.h"
+
+#include <cstdio>
+#include <vector>
+
+#define N_SPLIT 8 // columns of src1 in each mul_mat of the reference, fewer than the minimum of the AMX path
+
+struct test_case {
+    int64_t k;
+    int64_t m;
+    int64_t n;
+    int64_t ne2[2]; // batches of src0 and src1, src1 may broadcast src0
+    int64_t ne3[2];
+};
+
+static bool test_mul_mat(ggml_backend_t backend, ggml_type type, const test_case & tc, int n_threads) {
+    ggml_init_params params = {
+        /*.mem_size   =*/ 64*ggml_tensor_overhead() + ggml_graph_overhead(),
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ true,
+    };
+    ggml_context * ctx = ggml_init(params);
+
+    ggml_tensor * w = ggml_new_tensor_4d(ctx, type,          tc.k, tc.m, tc.ne2[0], tc.ne3[0]);
+    ggml_tensor * x = ggml_new_tensor_4d(ctx, GGML_TYPE_F32, tc.k, tc.n, tc.ne2[1], tc.ne3[1]);
+
+    ggml_tensor * y = ggml_mul_mat(ctx, w, x);
+
+    ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, y);
+
+    std::vector<ggml_tensor *> y_ref;
+    for (int64_t i = 0; i < tc.n; i += N_SPLIT) {
+        const int64_t n = tc.n - i < N_SPLIT ? tc.n - i : N_SPLIT;
+        ggml_tensor * xi = ggml_view_4d(ctx, x, tc.k, n, tc.ne2[1], tc.ne3[1], x->nb[1], x->nb[2], x->nb[3], i*x->nb[1]);
+        y_ref.push_back(ggml_mul_mat(ctx, w, xi));
+        ggml_build_forward_expand(gf, y_ref.back());
+    }
+
+    ggml_backend_buffer_t buf = ggml_backend_alloc_ctx_tensors(ctx, backend);
+
+    // the weights are quantized from random values
+    std::vector<float> wf(ggml_nelements(w));
+    for (float & v : wf) {
+        v = 2.0f*rand()/RAND_MAX - 1.0f;
+    }
+    std::vector<uint8_t> wq(ggml_nbytes(w));
+    ggml_quantize_chunk(type, wf.data(), wq.data(), 0, ggml_nrows(w), tc.k, NULL);
+    ggml_backend_tensor_set(w, wq.data(), 0, wq.size());
+
+    test_fill(x, -1.0f, 1.0f);
+
+    ggml_backend_cpu_set_n_threads(backend, n_threads);
+    GGML_ASSERT(ggml_backend_graph_compute(backend, gf) == GGML_STATUS_SUCCESS);
+
+    std::vector<float> out(ggml_nelements(y));
+    ggml_backend_tensor_get(y, out.data(), 0, ggml_nbytes(y));
+
+    // the same products of blocks, summed in a different order
+    double err = 0.0;
+    double ref = 0.0;
+    for (size_t j = 0; j < y_ref.size(); j++) {
+        std::vector<float> out_ref(ggml_nelements(y_ref[j]));
+        ggml_backend_tensor_get(y_ref[j], out_ref.data(), 0, ggml_nbytes(y_ref[j]));
+
+        const int64_t n = y_ref[j]->ne[1];
+        for (int64_t i3 = 0; i3 < y->ne[3]; i3++) {
+            for (int64_t i2 = 0; i2 < y->ne[2]; i2++) {
+                for (int64_t i1 = 0; i1 < n; i1++) {
+                    for (int64_t i0 = 0; i0 < tc.m; i0++) {
+                        const float a = out    [((i3*y->ne[2] + i2)*tc.n + j*N_SPLIT + i1)*tc.m + i0];
+                        const float b = out_ref[((i3*y->ne[2] + i2)*n     +             i1)*tc.m + i0];
+                        err += (a - b)*(a - b);
+                        ref += b*b;
+                    }
+                }
+            }
+        }
+    }
+
+    ggml_backend_buffer_free(buf);
+    ggml_free(ctx);
+
+    if (!(err <= 1e-10*ref)) {
+        fprintf(stderr, "%s: k = %d, m = %d, n = %d, batches = %dx%d/%dx%d, n_threads = %d: nmse = %g\n", ggml_type_name(type),
+                (int) tc.k, (int) tc.m, (int) tc.n, (int) tc.ne2[0], (int) tc.ne3[0], (int) tc.ne2[1], (int) tc.ne3[1], n_threads, err/ref);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    // the AMX tiles are enabled by the first ggml_init
+    ggml_init_params params = {
+        /*.mem_size   =*/ ggml_tensor_overhead(),
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ true,
+    };
+    ggml_free(ggml_init(params));
+
+    if (!ggml_cpu_has_amx()) {
+        printf("AMX is not available, skipping\n");
+        return 0;
+    }
+
+    ggml_backend_t backend = ggml_backend_cpu_init();
+
+    const test_case cases[] = {
+        { 32,   16, 16, { 1, 1 }, { 1, 1 } },
+        { 64,   33, 17, { 1, 1 }, { 1, 1 } },
+        { 256, 100, 31, { 1, 1 }, { 1, 1 } },
+        { 256,  64, 50, { 2, 4 }, { 1, 1 } },
+        { 128,  48, 32, { 1, 2 }, { 2, 2 } },
+        { 4096, 48, 20, { 1, 1 }, { 1, 1 } },
+    };
+
+    const ggml_type types[] = { GGML_TYPE_BF16, GGML_TYPE_Q8_0, GGML_TYPE_Q4_0 };
+
+    srand(1);
+
+    int n_failed = 0;
+
+    for (ggml_type type : types) {
+        for (const test_case & tc : cases) {
+            for (int n_threads : { 1, 3 }) {
+                n_failed += !test_mul_mat(backend, type, tc, n_threads);
+            }
+        }
+    }
+
+    ggml_backend_free(backend);
+
+    return test_report(n_failed);
+}
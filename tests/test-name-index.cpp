@@ -0,0 +1,161 @@
+// with ggml_set_name_index, ggml_get_tensor and ggml_graph_get_tensor must return the tensors found by a linear search:
+// the first tensor with the name when several tensors have it, and no tensor for the names that were replaced
+#include "ggml.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#define N_ROUNDS 50
+#define N_STEPS  3000
+#define N_NAMES  60
+
+static ggml_tensor * test_get_tensor(ggml_context * ctx, const char * name) {
+    for (ggml_tensor * t = ggml_get_first_tensor(ctx); t != NULL; t = ggml_get_next_tensor(ctx, t)) {
+        if (strcmp(t->name, name) == 0) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static ggml_tensor * test_graph_get_tensor(ggml_cgraph * gf, const char * name) {
+    for (int i = 0; i < gf->n_leafs; i++) {
+        if (strcmp(gf->leafs[i]->name, name) == 0) {
+            return gf->leafs[i];
+        }
+    }
+    for (int i = 0; i < gf->n_nodes; i++) {
+        if (strcmp(gf->nodes[i]->name, name) == 0) {
+            return gf->nodes[i];
+        }
+    }
+    return NULL;
+}
+
+int main(void) {
+    std::mt19937 rng(3);
+
+    // few names for many tensors: most names are shared by several tensors
+    auto random_name = [&]() {
+        return "t" + std::to_string(rng() % N_NAMES);
+    };
+
+    int n_failed = 0;
+
+    for (int round = 0; round < N_ROUNDS; round++) {
+        ggml_init_params params = {
+            /*.mem_size   =*/ 64*1024*1024,
+            /*.mem_buffer =*/ NULL,
+            /*.no_alloc   =*/ true,
+        };
+        ggml_context * ctx   = ggml_init(params);
+        ggml_context * other = ggml_init(params); // not indexed, its tensors are in the graph too
+
+        ggml_cgraph * gf = ggml_new_graph(ctx);
+
+        std::vector<ggml_tensor *> tensors;
+
+        for (int step = 0; step < N_STEPS; step++) {
+            // the index is built from the existing tensors when it is enabled, and can be disabled again
+            if (step == 500 + round) {
+                ggml_set_name_index(ctx, true);
+            }
+            if (step == 2000 && round % 5 == 0) {
+                ggml_set_name_index(ctx, false);
+            }
+
+            const unsigned op = rng() % 10;
+
+            if (op < 2 || tensors.empty()) {
+                ggml_tensor * t = ggml_new_tensor_1d(ctx, GGML_TYPE_F32, 4);
+                if (rng() % 2) {
+                    ggml_set_name(t, random_name().c_str());
+                }
+                tensors.push_back(t);
+            } else if (op < 4) {
+                // renames, and names removed with an empty name
+                ggml_tensor * t = tensors[rng() % tensors.size()];
+                if (rng() % 3 == 0) {
+                    ggml_format_name(t, "%s", random_name().c_str());
+                } else {
+                    ggml_set_name(t, rng() % 8 ? random_name().c_str() : "");
+                }
+            } else if (op < 6) {
+                const std::string name = random_name();
+                if (ggml_get_tensor(ctx, name.c_str()) != test_get_tensor(ctx, name.c_str())) {
+                    fprintf(stderr, "round %d, step %d: ggml_get_tensor(%s) differs from the linear search\n", round, step, name.c_str());
+                    n_failed++;
+                }
+            } else if (op < 8) {
+                ggml_tensor * a = tensors[rng() % tensors.size()];
+                ggml_tensor * b = tensors[rng() % tensors.size()];
+                ggml_tensor * c = rng() % 2 ? ggml_add(ctx, a, b) : ggml_scale(ctx, a, 1.0f);
+                if (rng() % 2) {
+                    ggml_set_name(c, random_name().c_str());
+                }
+                tensors.push_back(c);
+                if (rng() % 2) {
+                    ggml_build_forward_expand(gf, c);
+                }
+            } else if (op == 8) {
+                // the nodes without a name get a default one ("node_%d") when they are added to the graph
+                const std::string name = rng() % 4 ? random_name() : "node_" + std::to_string(rng() % 30);
+                if (ggml_graph_get_tensor(gf, name.c_str()) != test_graph_get_tensor(gf, name.c_str())) {
+                    fprintf(stderr, "round %d, step %d: ggml_graph_get_tensor(%s) differs from the linear search\n", round, step, name.c_str());
+                    n_failed++;
+                }
+            } else {
+                if (rng() % 20 == 0) {
+                    ggml_graph_clear(gf);
+                }
+                if (rng() % 40 == 0) {
+                    ggml_tensor * t = ggml_new_tensor_1d(other, GGML_TYPE_F32, 4);
+                    ggml_set_name(t, random_name().c_str());
+                    ggml_build_forward_expand(gf, ggml_add(ctx, t, tensors[0]));
+                }
+            }
+
+            if (n_failed > 10) {
+                break;
+            }
+        }
+
+        ggml_free(other);
+        ggml_free(ctx);
+    }
+
+    // a model with unique names: every tensor is found
+    {
+        const int n_tensors = 10000;
+
+        ggml_init_params params = {
+            /*.mem_size   =*/ n_tensors*ggml_tensor_overhead(),
+            /*.mem_buffer =*/ NULL,
+            /*.no_alloc   =*/ true,
+        };
+        ggml_context * ctx = ggml_init(params);
+        ggml_set_name_index(ctx, true);
+
+        std::vector<ggml_tensor *> tensors;
+        for (int i = 0; i < n_tensors; i++) {
+            tensors.push_back(ggml_format_name(ggml_new_tensor_1d(ctx, GGML_TYPE_F32, 4), "blk.%d.weight", i));
+        }
+        for (int i = 0; i < n_tensors; i++) {
+            const std::string name = "blk." + std::to_string(i) + ".weight";
+            if (ggml_get_tensor(ctx, name.c_str()) != tensors[i]) {
+                fprintf(stderr, "%s not found\n", name.c_str());
+                n_failed++;
+                break;
+            }
+        }
+
+        ggml_free(ctx);
+    }
+
+    printf("%s\n", n_failed == 0 ? "OK" : "FAILED");
+
+    return n_failed == 0 ? 0 : 1;
+}
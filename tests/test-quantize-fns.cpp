@@ -20,6 +20,8 @@ constexpr float MAX_QUANTIZATION_TOTAL_ERROR_3BITS = 0.0040f;
 constexpr float MAX_QUANTIZATION_TOTAL_ERROR_3BITS_XXS = 0.0050f;
 constexpr float MAX_DOT_PRODUCT_ERROR = 0.02f;
 constexpr float MAX_DOT_PRODUCT_ERROR_LOWBIT = 0.04f;
+constexpr float MAX_DOT_PRODUCT_COLS_ERROR = 1e-5f;
+constexpr int   MAX_DOT_PRODUCT_COLS = 32; // GGML_MUL_MAT_MAX_COLS
 
 static const char* RESULT_STR[] = {"ok", "FAILED"};
 
@@ -94,6 +96,81 @@ static float dot_product_error(
     return fabsf(result - dot_ref) / test_size;
 }
 
+// vec_dot_cols against one vec_dot per column, for 1 to MAX_DOT_PRODUCT_COLS columns: max relative error
+static float dot_product_cols_error(ggml_type_traits_t & qfns, size_t test_size, const float * test_data1) {
+    auto vdot = ggml_internal_get_type_traits(qfns.vec_dot_type);
+
+    const size_t row_size = ggml_row_size(qfns.vec_dot_type, test_size);
+
+    std::vector<uint8_t> tmp_q1(2*test_size);
+    std::vector<uint8_t> tmp_q2(MAX_DOT_PRODUCT_COLS*row_size);
+    std::vector<float>   tmp_y(test_size);
+
+    qfns.from_float(test_data1, tmp_q1.data(), test_size);
+    for (int j = 0; j < MAX_DOT_PRODUCT_COLS; j++) {
+        generate_data(1.0 + j, test_size, tmp_y.data());
+        vdot.from_float(tmp_y.data(), tmp_q2.data() + j*row_size, test_size);
+    }
+
+    std::vector<float> ref(MAX_DOT_PRODUCT_COLS);
+    for (int j = 0; j < MAX_DOT_PRODUCT_COLS; j++) {
+        qfns.vec_dot(test_size, &ref[j], 0, tmp_q1.data(), 0, tmp_q2.data() + j*row_size, 0, 1);
+    }
+
+    float max_error = 0.0f;
+
+    // the results are strided like the columns of dst, the values between them must not be written
+    const size_t bs = 3;
+    std::vector<float> result(MAX_DOT_PRODUCT_COLS*bs);
+
+    for (int nc = 1; nc <= MAX_DOT_PRODUCT_COLS; nc++) {
+        std::fill(result.begin(), result.end(), INFINITY);
+        qfns.vec_dot_cols(test_size, result.data(), bs, tmp_q1.data(), 0, tmp_q2.data(), row_size, nc);
+
+        for (int j = 0; j < MAX_DOT_PRODUCT_COLS; j++) {
+            for (size_t k = 0; k < bs; k++) {
+                const float v = result[j*bs + k];
+                if (k > 0 || j >= nc) {
+                    if (v != INFINITY) {
+                        max_error = INFINITY; // written outside of the results
+                    }
+                    continue;
+                }
+                max_error = fmaxf(max_error, fabsf(v - ref[j]) / fmaxf(1.0f, fabsf(ref[j])));
+            }
+        }
+    }
+
+    return max_error;
+}
+
+// ggml_quantize_chunk_mt must write the bytes of ggml_quantize_chunk, for any number of threads and a chunk that does not
+// start at the first row
+static bool quantize_chunk_mt_matches(ggml_type type, const float * test_data, int64_t nrows, int64_t n_per_row) {
+    const int64_t start    = 8*n_per_row;
+    const size_t  row_size = ggml_row_size(type, n_per_row);
+
+    std::vector<float>   src(start + nrows*n_per_row);
+    std::vector<uint8_t> ref(row_size*(start/n_per_row + nrows));
+    std::vector<uint8_t> res(ref.size());
+
+    for (size_t i = 0; i < src.size(); i++) {
+        src[i] = test_data[i % (nrows*n_per_row)];
+    }
+
+    const size_t size_ref = ggml_quantize_chunk(type, src.data(), ref.data(), start, nrows, n_per_row, NULL);
+
+    for (int n_threads : { 2, 5, 8 }) {
+        std::fill(res.begin(), res.end(), 0);
+        const size_t size = ggml_quantize_chunk_mt(type, src.data(), res.data(), start, nrows, n_per_row, NULL, n_threads, NULL);
+        if (size != size_ref || res != ref) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 int main(int argc, char * argv[]) {
     bool verbose = false;
     const size_t test_size = 32 * 128;
@@ -172,6 +249,28 @@ int main(int argc, char * argv[]) {
             if (failed || verbose) {
                 printf("%5s dot product error:              %s (%f)\n", ggml_type_name(type), RESULT_STR[failed], vec_dot_error);
             }
+
+            if (qfns.vec_dot_cols) {
+                const float vec_dot_cols_error = dot_product_cols_error(qfns, test_size, test_data.data());
+                failed = !(vec_dot_cols_error < MAX_DOT_PRODUCT_COLS_ERROR);
+                num_failed += failed;
+                if (failed || verbose) {
+                    printf("%5s multi-column dot product error: %s (%g)\n", ggml_type_name(type), RESULT_STR[failed], vec_dot_cols_error);
+                }
+            }
+        }
+    }
+
+    // 16 rows of 256 values, the interleaved types quantize groups of 8 rows
+    const ggml_type mt_types[] = {
+        GGML_TYPE_Q4_0, GGML_TYPE_Q8_0, GGML_TYPE_Q4_K, GGML_TYPE_Q6_K, GGML_TYPE_IQ4_NL,
+        GGML_TYPE_F16, GGML_TYPE_F8_E4M3, GGML_TYPE_Q4_0_4_4, GGML_TYPE_Q4_0_8_8,
+    };
+    for (ggml_type type : mt_types) {
+        failed = !quantize_chunk_mt_matches(type, test_data.data(), test_size/256, 256);
+        num_failed += failed;
+        if (failed || verbose) {
+            printf("%5s multithreaded quantization:     %s\n", ggml_type_name(type), RESULT_STR[failed]);
         }
     }
 
@@ -0,0 +1,430 @@
+#include "ggml.h"
+#include "ggml-backend.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+typedef HANDLE test_thread_t;
+static int test_thread_create(test_thread_t * thrd, DWORD (WINAPI * fn)(LPVOID), void * arg) {
+    *thrd = CreateThread(NULL, 0, fn, arg, 0, NULL);
+    return *thrd == NULL;
+}
+static void test_thread_join(test_thread_t thrd) {
+    WaitForSingleObject(thrd, INFINITE);
+    CloseHandle(thrd);
+}
+#define TEST_THREAD_RET DWORD WINAPI
+#else
+#include <pthread.h>
+typedef pthread_t test_thread_t;
+static int test_thread_create(test_thread_t * thrd, void * (*fn)(void *), void * arg) {
+    return pthread_create(thrd, NULL, fn, arg);
+}
+static void test_thread_join(test_thread_t thrd) {
+    pthread_join(thrd, NULL);
+}
+#define TEST_THREAD_RET void *
+#endif
+
+#define N_EMBD   64
+#define N_TOKENS 8
+#define N_LAYERS 6
+
+// a mul_mat + soft_max chain that uses several threads, and a sum that uses only one
+struct test_model {
+    struct ggml_context * ctx;
+    struct ggml_tensor  * x;
+    struct ggml_tensor  * chain_out;
+    struct ggml_tensor  * sum_out;
+    struct ggml_cgraph  * chain;
+    struct ggml_cgraph  * sum;
+};
+
+static void test_model_init(struct test_model * model, int seed) {
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 16*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+    model->ctx = ggml_init(params);
+
+    srand(seed);
+
+    model->x = ggml_new_tensor_2d(model->ctx, GGML_TYPE_F32, N_EMBD, N_TOKENS);
+    for (int i = 0; i < N_EMBD*N_TOKENS; i++) {
+        ((float *) model->x->data)[i] = (float) rand()/RAND_MAX - 0.5f;
+    }
+
+    struct ggml_tensor * cur = model->x;
+    for (int l = 0; l < N_LAYERS; l++) {
+        struct ggml_tensor * w = ggml_new_tensor_2d(model->ctx, GGML_TYPE_F32, N_EMBD, N_EMBD);
+        for (int i = 0; i < N_EMBD*N_EMBD; i++) {
+            ((float *) w->data)[i] = (float) rand()/RAND_MAX - 0.5f;
+        }
+        cur = ggml_soft_max(model->ctx, ggml_mul_mat(model->ctx, w, cur));
+        cur = ggml_scale(model->ctx, cur, (float) N_EMBD);
+    }
+    model->chain_out = cur;
+    model->sum_out   = ggml_sum(model->ctx, model->x);
+
+    model->chain = ggml_new_graph(model->ctx);
+    ggml_build_forward_expand(model->chain, model->chain_out);
+
+    model->sum = ggml_new_graph(model->ctx);
+    ggml_build_forward_expand(model->sum, model->sum_out);
+}
+
+// perturbs the input, so that a graph computed twice or not at all gives different results
+static void test_model_set_input(struct test_model * model, int iter) {
+    ((float *) model->x->data)[iter % (N_EMBD*N_TOKENS)] += 0.25f;
+}
+
+struct test_results {
+    float chain[N_EMBD*N_TOKENS];
+    float sum;
+};
+
+static enum ggml_status test_compute(struct ggml_cgraph * graph, int n_threads, struct ggml_threadpool * threadpool) {
+    struct ggml_cplan cplan = ggml_graph_plan(graph, n_threads, threadpool);
+    uint8_t * work_data = cplan.work_size > 0 ? malloc(cplan.work_size) : NULL;
+    cplan.work_data = work_data;
+
+    const enum ggml_status status = ggml_graph_compute(graph, &cplan);
+
+    free(work_data);
+    return status;
+}
+
+static void test_model_reference(struct test_model * model, struct test_results * ref) {
+    test_compute(model->chain, 1, NULL);
+    test_compute(model->sum,   1, NULL);
+    memcpy(ref->chain, model->chain_out->data, sizeof(ref->chain));
+    ref->sum = *(float *) model->sum_out->data;
+}
+
+static bool test_model_check(const struct test_model * model, const struct test_results * ref, const char * what, int iter) {
+    for (int i = 0; i < N_EMBD*N_TOKENS; i++) {
+        const float v = ((float *) model->chain_out->data)[i];
+        if (!(fabsf(v - ref->chain[i]) <= 1e-4f*fmaxf(1.0f, fabsf(ref->chain[i])))) {
+            fprintf(stderr, "%s: iteration %d: chain[%d] = %f, expected %f\n", what, iter, i, v, ref->chain[i]);
+            return false;
+        }
+    }
+    const float sum = *(float *) model->sum_out->data;
+    if (!(fabsf(sum - ref->sum) <= 1e-4f*fmaxf(1.0f, fabsf(ref->sum)))) {
+        fprintf(stderr, "%s: iteration %d: sum = %f, expected %f\n", what, iter, sum, ref->sum);
+        return false;
+    }
+    return true;
+}
+
+// the graphs of one iteration, on the threadpool
+static bool test_iteration(struct test_model * model, struct ggml_threadpool * threadpool, int n_threads, const char * what, int iter) {
+    struct test_results ref;
+
+    test_model_set_input(model, iter);
+    test_model_reference(model, &ref);
+
+    memset(model->chain_out->data, 0, ggml_nbytes(model->chain_out));
+    memset(model->sum_out->data,   0, ggml_nbytes(model->sum_out));
+
+    if (test_compute(model->sum,   n_threads, threadpool) != GGML_STATUS_SUCCESS ||
+        test_compute(model->chain, n_threads, threadpool) != GGML_STATUS_SUCCESS) {
+        fprintf(stderr, "%s: iteration %d: compute failed\n", what, iter);
+        return false;
+    }
+
+    return test_model_check(model, &ref, what, iter);
+}
+
+static bool test_reuse(struct ggml_threadpool * threadpool) {
+    struct test_model model;
+    test_model_init(&model, 1);
+
+    bool ok = true;
+    for (int iter = 0; iter < 50 && ok; iter++) {
+        ok = test_iteration(&model, threadpool, 4, __func__, iter);
+    }
+
+    ggml_free(model.ctx);
+    return ok;
+}
+
+// the sum uses a single thread, the other threads of the pool are idle and may see the next graph late
+static bool test_n_threads(struct ggml_threadpool * threadpool) {
+    struct test_model model;
+    test_model_init(&model, 2);
+
+    bool ok = true;
+    for (int iter = 0; iter < 300 && ok; iter++) {
+        ok = test_iteration(&model, threadpool, 1 + iter % 4, __func__, iter);
+    }
+
+    ggml_free(model.ctx);
+    return ok;
+}
+
+static bool test_pause_resume(struct ggml_threadpool * threadpool) {
+    struct test_model model;
+    test_model_init(&model, 3);
+
+    bool ok = true;
+    for (int iter = 0; iter < 20 && ok; iter++) {
+        ggml_threadpool_pause(threadpool);
+        if (iter % 2 == 0) {
+            ggml_threadpool_resume(threadpool);
+        }
+        // computing a graph resumes a paused threadpool
+        ok = test_iteration(&model, threadpool, 4, __func__, iter);
+    }
+    ggml_threadpool_resume(threadpool);
+
+    ggml_free(model.ctx);
+    return ok;
+}
+
+struct test_caller {
+    struct ggml_threadpool * threadpool;
+    int  seed;
+    bool ok;
+};
+
+static TEST_THREAD_RET test_caller_thread(void * data) {
+    struct test_caller * caller = (struct test_caller *) data;
+
+    struct test_model model;
+    test_model_init(&model, caller->seed);
+
+    caller->ok = true;
+    for (int iter = 0; iter < 100 && caller->ok; iter++) {
+        caller->ok = test_iteration(&model, caller->threadpool, 2 + iter % 3, "test_shared", iter);
+    }
+
+    ggml_free(model.ctx);
+    return 0;
+}
+
+// several callers compute their graphs on the same threadpool at the same time
+static bool test_shared(struct ggml_threadpool * threadpool) {
+    struct test_caller callers[3];
+    test_thread_t      threads[3];
+
+    for (int i = 0; i < 3; i++) {
+        callers[i] = (struct test_caller) { threadpool, 10 + i, false };
+        if (test_thread_create(&threads[i], test_caller_thread, &callers[i]) != 0) {
+            fprintf(stderr, "%s: failed to create thread\n", __func__);
+            return false;
+        }
+    }
+
+    bool ok = true;
+    for (int i = 0; i < 3; i++) {
+        test_thread_join(threads[i]);
+        ok = ok && callers[i].ok;
+    }
+    return ok;
+}
+
+static bool test_async(struct ggml_threadpool * threadpool) {
+    struct test_model model;
+    test_model_init(&model, 4);
+
+    bool ok = true;
+    for (int iter = 0; iter < 50 && ok; iter++) {
+        struct test_results ref;
+
+        test_model_set_input(&model, iter);
+        test_model_reference(&model, &ref);
+
+        memset(model.chain_out->data, 0, ggml_nbytes(model.chain_out));
+        memset(model.sum_out->data,   0, ggml_nbytes(model.sum_out));
+
+        struct ggml_cplan cplan_sum   = ggml_graph_plan(model.sum,   4, threadpool);
+        struct ggml_cplan cplan_chain = ggml_graph_plan(model.chain, 1 + iter % 4, threadpool);
+        cplan_sum.work_data   = cplan_sum.work_size   > 0 ? malloc(cplan_sum.work_size)   : NULL;
+        cplan_chain.work_data = cplan_chain.work_size > 0 ? malloc(cplan_chain.work_size) : NULL;
+
+        // the second submission waits for the first one
+        ggml_graph_compute_async(model.sum,   &cplan_sum);
+        ggml_graph_compute_async(model.chain, &cplan_chain);
+
+        if (ggml_threadpool_wait(threadpool) != GGML_STATUS_SUCCESS) {
+            fprintf(stderr, "%s: iteration %d: compute failed\n", __func__, iter);
+            ok = false;
+        }
+
+        free(cplan_sum.work_data);
+        free(cplan_chain.work_data);
+
+        ok = ok && test_model_check(&model, &ref, __func__, iter);
+    }
+
+    ggml_free(model.ctx);
+    return ok;
+}
+
+// the plans of the CPU backend keep using the threadpool they were created with when the number of threads changes
+static bool test_backend_plan(struct ggml_threadpool * threadpool) {
+    struct test_model model;
+    test_model_init(&model, 5);
+
+    struct test_results ref;
+    test_model_reference(&model, &ref);
+
+    ggml_backend_t backend = ggml_backend_cpu_init();
+    ggml_backend_cpu_set_n_threads(backend, 4);
+
+    ggml_backend_graph_plan_t plan = ggml_backend_graph_plan_create(backend, model.chain);
+
+    bool ok = true;
+    for (int iter = 0; iter < 10 && ok; iter++) {
+        ggml_backend_cpu_set_n_threads(backend, 1 + iter % 4);
+
+        memset(model.sum_out->data,   0, ggml_nbytes(model.sum_out));
+        memset(model.chain_out->data, 0, ggml_nbytes(model.chain_out));
+
+        ok = ggml_backend_graph_compute(backend, model.sum) == GGML_STATUS_SUCCESS &&
+             ggml_backend_graph_plan_compute(backend, plan) == GGML_STATUS_SUCCESS &&
+             test_model_check(&model, &ref, __func__, iter);
+    }
+
+    ggml_backend_graph_plan_free(backend, plan);
+    ggml_backend_free(backend);
+    ggml_free(model.ctx);
+
+    GGML_UNUSED(threadpool);
+    return ok;
+}
+
+static bool test_abort(void * data) {
+    GGML_UNUSED(data);
+    return true;
+}
+
+// async graphs on the CPU backend, waited for with the events and with ggml_backend_synchronize
+static bool test_backend_async(struct ggml_threadpool * threadpool) {
+    struct test_model model;
+    test_model_init(&model, 6);
+
+    ggml_backend_t backend = ggml_backend_cpu_init();
+    ggml_backend_cpu_set_n_threads(backend, 4);
+    ggml_backend_cpu_set_async(backend, true);
+
+    ggml_backend_event_t ev_sum   = ggml_backend_event_new(backend);
+    ggml_backend_event_t ev_chain = ggml_backend_event_new(backend);
+
+    bool ok = true;
+    for (int iter = 0; iter < 20 && ok; iter++) {
+        // the owned threadpool and a user threadpool
+        ggml_backend_cpu_set_threadpool(backend, iter % 2 == 0 ? NULL : threadpool);
+
+        struct test_results ref;
+
+        test_model_set_input(&model, iter);
+        test_model_reference(&model, &ref);
+
+        memset(model.sum_out->data,   0, ggml_nbytes(model.sum_out));
+        memset(model.chain_out->data, 0, ggml_nbytes(model.chain_out));
+
+        ok = ggml_backend_graph_compute_async(backend, model.sum) == GGML_STATUS_SUCCESS;
+        ggml_backend_event_record(ev_sum);
+        ok = ok && ggml_backend_graph_compute_async(backend, model.chain) == GGML_STATUS_SUCCESS;
+        ggml_backend_event_record(ev_chain);
+
+        if (iter % 3 == 0) {
+            ggml_backend_synchronize(backend);
+        } else {
+            ggml_backend_event_synchronize(ev_sum);
+            ggml_backend_event_synchronize(ev_chain);
+        }
+
+        ok = ok && test_model_check(&model, &ref, __func__, iter);
+    }
+
+    // the status of an aborted graph is returned by the next compute, and only once
+    ggml_backend_cpu_set_abort_callback(backend, test_abort, NULL);
+    ok = ok && ggml_backend_graph_compute_async(backend, model.chain) == GGML_STATUS_SUCCESS;
+    ggml_backend_synchronize(backend);
+    ggml_backend_cpu_set_abort_callback(backend, NULL, NULL);
+    ok = ok && ggml_backend_graph_compute_async(backend, model.sum) == GGML_STATUS_ABORTED;
+    ok = ok && ggml_backend_graph_compute_async(backend, model.sum) == GGML_STATUS_SUCCESS;
+    ggml_backend_synchronize(backend);
+
+    ggml_backend_event_free(ev_sum);
+    ggml_backend_event_free(ev_chain);
+    ggml_backend_free(backend);
+    ggml_free(model.ctx);
+
+    return ok;
+}
+
+// the owned threadpool is replaced when the number of threads changes, not before the graph in flight is done with it
+static bool test_backend_async_n_threads(struct ggml_threadpool * threadpool) {
+    struct test_model model;
+    test_model_init(&model, 7);
+
+    struct test_results ref;
+    test_model_reference(&model, &ref);
+
+    ggml_backend_t backend = ggml_backend_cpu_init();
+    ggml_backend_cpu_set_async(backend, true);
+
+    bool ok = true;
+    for (int iter = 0; iter < 10 && ok; iter++) {
+        ggml_backend_cpu_set_n_threads(backend, 2 + iter % 3);
+
+        memset(model.sum_out->data,   0, ggml_nbytes(model.sum_out));
+        memset(model.chain_out->data, 0, ggml_nbytes(model.chain_out));
+
+        ok = ggml_backend_graph_compute_async(backend, model.chain) == GGML_STATUS_SUCCESS;
+
+        ggml_backend_cpu_set_n_threads(backend, 1 + iter % 3);
+
+        ggml_backend_graph_plan_t plan = ggml_backend_graph_plan_create(backend, model.sum);
+        ggml_backend_synchronize(backend);
+
+        ok = ok && ggml_backend_graph_plan_compute(backend, plan) == GGML_STATUS_SUCCESS &&
+             test_model_check(&model, &ref, __func__, iter);
+
+        ggml_backend_graph_plan_free(backend, plan);
+    }
+
+    ggml_backend_free(backend);
+    ggml_free(model.ctx);
+
+    GGML_UNUSED(threadpool);
+    return ok;
+}
+
+int main(void) {
+    struct ggml_threadpool_params params = ggml_threadpool_params_default(4);
+    struct ggml_threadpool * threadpool = ggml_threadpool_new(&params);
+
+    int n_failed = 0;
+
+#define RUN_TEST(test) \
+    do { \
+        const bool ok = test(threadpool); \
+        printf("%s: %s\n", #test, ok ? "OK" : "FAILED"); \
+        n_failed += !ok; \
+    } while (0)
+
+    RUN_TEST(test_reuse);
+    RUN_TEST(test_n_threads);
+    RUN_TEST(test_pause_resume);
+    RUN_TEST(test_shared);
+    RUN_TEST(test_async);
+    RUN_TEST(test_backend_plan);
+    RUN_TEST(test_backend_async);
+    RUN_TEST(test_backend_async_n_threads);
+
+#undef RUN_TEST
+
+    ggml_threadpool_free(threadpool);
+
+    return n_failed == 0 ? 0 : 1;
+}